@@ -0,0 +1,186 @@
+// Native benchmark for the level filter chain (src/WS_Filter.cpp): time per sample of the
+// median + EMA and median + Kalman paths (plus median only and the disabled pass-through
+// as a floor), and what each buys on a synthetic level trace: RMS error against the true
+// level, the worst error while a spike passes, and how many samples a level step
+// takes to settle. The trace is a random walk with sensor noise, 2% outlier spikes and a
+// step every 500 samples, from a fixed seed. Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Isrc scripts/filter_bench/filter_bench.cpp src/WS_Filter.cpp -o filter_bench
+//
+//   ./filter_bench --samples 1000000
+
+#include "WS_Filter.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+
+static uint64_t NowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t Cycles()
+{
+#if BENCH_HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static uint32_t g_seed = 12345;
+
+static uint32_t Rand()
+{
+  g_seed = g_seed * 1664525U + 1013904223U;
+  return g_seed >> 8;
+}
+
+// Uniform in [-a, a].
+static int32_t Noise(int32_t a)
+{
+  return (int32_t)(Rand() % (uint32_t)(2 * a + 1)) - a;
+}
+
+static const uint32_t kStepEvery = 500;
+
+struct Trace {
+  std::vector<uint16_t> raw;
+  std::vector<uint16_t> truth;
+  std::vector<uint8_t> spike;
+};
+
+static Trace MakeTrace(uint32_t n)
+{
+  Trace t;
+  t.raw.resize(n);
+  t.truth.resize(n);
+  t.spike.resize(n);
+  int32_t level = 1500;  // mm
+  for (uint32_t i = 0; i < n; ++i) {
+    if (i > 0 && i % kStepEvery == 0) {
+      level += (i / kStepEvery) % 2 ? 200 : -200;  // pump on / off
+    }
+    if (Rand() % 4 == 0) {
+      level += Noise(1);
+    }
+    int32_t x = level + Noise(4) + Noise(4);  // roughly triangular, +-8 mm
+    const bool spike = (Rand() % 50) == 0;
+    if (spike) {
+      x += (Rand() % 2) ? 600 : -600;  // echo off a bracket / foam
+    }
+    t.truth[i] = (uint16_t)level;
+    t.raw[i] = (uint16_t)(x < 0 ? 0 : (x > 0xFFFF ? 0xFFFF : x));
+    t.spike[i] = spike ? 1 : 0;
+  }
+  return t;
+}
+
+struct Result {
+  uint64_t ns = 0;
+  uint64_t cycles = 0;
+  double rms = 0;
+  int max_spike_err = 0;
+  double settle = 0;  // mean samples after a step until within 20 mm (10%) for 5 samples
+};
+
+static Result Run(const char* name, const WS_FilterConfig& cfg, const Trace& t, std::vector<uint16_t>& out)
+{
+  Result r;
+  const uint32_t n = (uint32_t)t.raw.size();
+  out.resize(n);
+
+  WS_FilterState f;
+  for (uint32_t i = 0; i < n && i < 1000; ++i) {  // warm up
+    (void)WS_Filter_Step(f, cfg, t.raw[i]);
+  }
+  WS_Filter_Reset(f);
+  const uint64_t t0 = NowNs();
+  const uint64_t c0 = Cycles();
+  for (uint32_t i = 0; i < n; ++i) {
+    out[i] = WS_Filter_Step(f, cfg, t.raw[i]);
+  }
+  r.cycles = Cycles() - c0;
+  r.ns = NowNs() - t0;
+
+  double sq = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    const int err = (int)out[i] - (int)t.truth[i];
+    sq += (double)err * err;
+    // Spikes right after a step or the first sample would mix in the step response.
+    const bool quiet = (i % kStepEvery) >= 50 && i >= kStepEvery;
+    if (t.spike[i] && quiet && abs(err) > r.max_spike_err) {
+      r.max_spike_err = abs(err);
+    }
+  }
+  r.rms = sqrt(sq / (double)(n ? n : 1));
+
+  uint64_t settleSum = 0;
+  uint32_t steps = 0;
+  for (uint32_t s = kStepEvery; s + kStepEvery <= n; s += kStepEvery) {
+    uint32_t run = 0;
+    uint32_t k = 0;
+    for (; k < kStepEvery && run < 5; ++k) {
+      run = (abs((int)out[s + k] - (int)t.truth[s + k]) <= 20) ? run + 1 : 0;
+    }
+    settleSum += k - run;
+    steps++;
+  }
+  r.settle = (double)settleSum / (double)(steps ? steps : 1);
+
+  printf("%-18s %7.2f ns/sample", name, (double)r.ns / (double)(n ? n : 1));
+  if (BENCH_HAVE_TSC) {
+    printf(" %7.1f cycles/sample", (double)r.cycles / (double)(n ? n : 1));
+  }
+  printf("  rms %5.2f mm  spike max %4d mm  settle %5.1f samples\n", r.rms, r.max_spike_err, r.settle);
+  return r;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t samples = 1000000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+      samples = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--samples N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  const Trace t = MakeTrace(samples);
+  std::vector<uint16_t> out;
+  printf("samples=%u step=+-200 mm every %u, noise +-8 mm, spikes 2%% of +-600 mm\n", (unsigned)samples,
+         (unsigned)kStepEvery);
+
+  WS_FilterConfig cfg;
+  cfg.enabled = false;
+  Run("disabled", cfg, t, out);
+
+  cfg = WS_FilterConfig();
+  cfg.kind = WS_FILTER_NONE;
+  Run("median5", cfg, t, out);
+
+  cfg = WS_FilterConfig();  // firmware default: median 5 + EMA 1/4
+  Run("median5+ema", cfg, t, out);
+
+  cfg = WS_FilterConfig();
+  cfg.kind = WS_FILTER_KALMAN;
+  Run("median5+kalman", cfg, t, out);
+
+  cfg.median_n = WS_FILTER_MEDIAN_MAX;
+  Run("median9+kalman", cfg, t, out);
+  return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+// Minimal Arduino shim so src/WS_Modbus*.cpp build natively for the host tools
+// (modbus_master_test, modbus_bench). Each tool defines millis() itself.
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+using std::max;
+using std::min;
+
+uint32_t millis();
+
+class Stream {
+public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual size_t write(const uint8_t* buf, size_t len) = 0;
+};
+
+#endif
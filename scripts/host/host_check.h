@@ -0,0 +1,26 @@
+#ifndef _HOST_CHECK_H_
+#define _HOST_CHECK_H_
+
+// Check helpers shared by the host tests under scripts/ (one translation unit per test).
+// A failed CHECK prints the condition and lets the test continue.
+
+#include <stdio.h>
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                 \
+  do {                                                              \
+    if (!(cond)) {                                                  \
+      printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+      g_failures++;                                                 \
+    }                                                               \
+  } while (0)
+
+// Prints PASS / FAIL and returns the process exit code.
+inline int CheckSummary()
+{
+  printf("%s\n", g_failures == 0 ? "PASS" : "FAIL");
+  return g_failures == 0 ? 0 : 1;
+}
+
+#endif
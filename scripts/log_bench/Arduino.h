@@ -0,0 +1,38 @@
+#ifndef _LOG_BENCH_ARDUINO_H_
+#define _LOG_BENCH_ARDUINO_H_
+
+// Minimal Arduino shim so src/WS_Log*.cpp build natively for log_bench.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+uint32_t millis();
+uint32_t micros();
+
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  bool reserve(unsigned int n) { s_.reserve(n); return true; }
+  bool concat(const char* p, unsigned int n) { s_.append(p, n); return true; }
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o; return *this; }
+  friend String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+  int indexOf(char c, unsigned int from = 0) const
+  {
+    const size_t p = s_.find(c, from);
+    return (p == std::string::npos) ? -1 : (int)p;
+  }
+  String substring(unsigned int from) const { String r; r.s_ = s_.substr(from); return r; }
+
+private:
+  std::string s_;
+};
+
+#endif
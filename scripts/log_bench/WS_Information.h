@@ -0,0 +1,6 @@
+#ifndef _LOG_BENCH_WS_INFORMATION_H_
+#define _LOG_BENCH_WS_INFORMATION_H_
+
+// log_bench uses the firmware defaults (src/WS_Log.h, src/WS_Log.cpp); override with -D.
+
+#endif
@@ -0,0 +1,233 @@
+// Native benchmark for the text log call path (src/WS_Log.cpp) on a RAM file system.
+// Compares what a WS_Log_Action() call costs the caller when the line is formatted
+// immediately (WS_Log_Printf: vsnprintf + timestamp + staging) with the deferred path
+// (argument packing into the ring; rendering happens later in WS_Log_Loop), and
+// reports the deferred render cost separately. Then checks that deferred lines
+// render like WS_Log_Printf, also when the arguments overflow the packing buffer (exit
+// code 1 otherwise). Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Iscripts/log_bench -Isrc scripts/log_bench/log_bench.cpp src/WS_Log.cpp src/WS_LogRing.cpp src/WS_MeasCodec.cpp -o log_bench
+//
+//   ./log_bench --calls 200000
+
+#include "Arduino.h"
+#include "LittleFS.h"
+#include "WS_Log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+
+LittleFSFS LittleFS;
+
+bool WS_FS_EnsureMounted()
+{
+  return true;
+}
+
+static uint64_t NowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint32_t millis()
+{
+  return (uint32_t)(NowNs() / 1000000ULL);
+}
+
+uint32_t micros()
+{
+  return (uint32_t)(NowNs() / 1000ULL);
+}
+
+static uint32_t Epoch()
+{
+  return 1700000000UL + millis() / 1000UL;
+}
+
+static uint64_t Cycles()
+{
+#if BENCH_HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+struct Result {
+  uint64_t ns = 0;
+  uint64_t cycles = 0;
+  unsigned long calls = 0;
+};
+
+// A typical action line from MAIN_ALL.ino: string, ints, a float.
+static void CallImmediate(unsigned long i)
+{
+  WS_Log_Printf(WS_LOG_ACTION, "gate=%s mode=%s inner_mm=%u outer_mm=%u t1=%.1f rssi=%d",
+                (i & 1) ? "open" : "close", "auto", (unsigned)(i % 4000), (unsigned)((i * 7) % 4000),
+                21.5 + (double)(i % 10) / 10.0, -60 - (int)(i % 20));
+}
+
+static void CallDeferred(unsigned long i)
+{
+  WS_Log_Action("gate=%s mode=%s inner_mm=%u outer_mm=%u t1=%.1f rssi=%d",
+                (i & 1) ? "open" : "close", "auto", (unsigned)(i % 4000), (unsigned)((i * 7) % 4000),
+                21.5 + (double)(i % 10) / 10.0, -60 - (int)(i % 20));
+}
+
+// Calls run in bursts that fit the defer ring; WS_Log_Loop (render + flush) runs between
+// bursts, outside the timed section for "call" and inside it for "render".
+static void Run(bool deferred, unsigned long calls, Result& call, Result& render)
+{
+  unsigned long i = 0;
+  while (i < calls) {
+    const uint64_t t0 = NowNs();
+    const uint64_t c0 = Cycles();
+    unsigned long n = 0;
+    for (; n < LOG_DEFER_SLOTS && i < calls; n++, i++) {
+      if (deferred) {
+        CallDeferred(i);
+      } else {
+        CallImmediate(i);
+      }
+    }
+    const uint64_t c1 = Cycles();
+    const uint64_t t1 = NowNs();
+    WS_Log_Loop();
+    const uint64_t c2 = Cycles();
+    const uint64_t t2 = NowNs();
+    call.ns += t1 - t0;
+    call.cycles += c1 - c0;
+    call.calls += n;
+    render.ns += t2 - t1;
+    render.cycles += c2 - c1;
+    render.calls += n;
+  }
+}
+
+static void Print(const char* name, const Result& r)
+{
+  if (r.calls == 0) {
+    return;
+  }
+  printf("%-18s %9.1f ns/call", name, (double)r.ns / (double)r.calls);
+  if (BENCH_HAVE_TSC) {
+    printf(" %9.1f cycles/call", (double)r.cycles / (double)r.calls);
+  }
+  printf("\n");
+}
+
+// ---- Deferred rendering checks ----
+static std::string g_lastMsg;
+
+static void CaptureLine(const char* name, const char* line)
+{
+  if (strcmp(name, "action") != 0) {
+    return;
+  }
+  // "<time> [tag] msg\r\n" -> msg
+  const char* m = strstr(line, "] ");
+  std::string msg = m ? m + 2 : line;
+  while (!msg.empty() && (msg.back() == '\r' || msg.back() == '\n')) {
+    msg.pop_back();
+  }
+  g_lastMsg = msg;
+}
+
+static bool Expect(const char* what, const std::string& want)
+{
+  WS_Log_Loop();
+  const bool ok = (g_lastMsg == want);
+  printf("check %-14s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) {
+    printf("  want: %s\n  got:  %s\n", want.c_str(), g_lastMsg.c_str());
+  }
+  return ok;
+}
+
+// Pack into a buffer whose unused tail looks like stale stack bytes (a string tag with a
+// 0xFF length): rendering must stop at the packed data, not parse the tail.
+template <typename... A>
+static void DeferOnDirtyArgs(const char* fmt, A... args)
+{
+  WS_LogArgs a;
+  for (size_t i = 0; i < sizeof(a.buf); i++) {
+    a.buf[i] = (i & 1) ? 0xFF : WS_LOG_ARG_STR;
+  }
+  WS_Log_PackAll(a, args...);
+  WS_Log_Defer(WS_LOG_ACTION, fmt, a);
+}
+
+static bool CheckDeferred()
+{
+  WS_Log_SetLineSink(CaptureLine);
+  bool ok = true;
+
+  WS_Log_Printf(WS_LOG_ACTION, "gate=%s mm=%u t1=%.1f rssi=%d", "open", 1234U, 21.5, -61);
+  const std::string imm = (WS_Log_Loop(), g_lastMsg);
+  WS_Log_Action("gate=%s mm=%u t1=%.1f rssi=%d", "open", 1234U, 21.5, -61);
+  ok &= Expect("same text", imm);
+
+  // 96-char string + two ints: the second int does not fit and renders as '?'.
+  const std::string s96(96, 'x');
+  DeferOnDirtyArgs("%s n=%d m=%d", s96.c_str(), 5, 7);
+  ok &= Expect("overflow int", s96 + " n=5 m=?");
+  DeferOnDirtyArgs("%s t=%.2f", s96.c_str(), 1.5, 2);
+  ok &= Expect("overflow dbl", s96 + " t=1.50");
+
+  // A later argument that would still fit must not slide into the slot of a dropped one.
+  DeferOnDirtyArgs("%s a=%d b=%d c=%s", s96.c_str(), 1, 2, "z");
+  ok &= Expect("after full", s96 + " a=1 b=? c=?");
+
+  // Strings are cut to the room left; nothing after them fits.
+  const std::string s200(200, 'y');
+  DeferOnDirtyArgs("%s n=%d", s200.c_str(), 3);
+  ok &= Expect("long string", std::string(LOG_DEFER_ARG_BYTES - 2, 'y') + " n=?");
+
+  WS_Log_SetLineSink(nullptr);
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long calls = 200000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--calls") == 0 && i + 1 < argc) {
+      calls = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--calls N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  WS_Log_Init();
+  WS_Log_SetTimeProvider(Epoch);
+
+  Result immCall, immLoop, defCall, defRender;
+  Run(false, calls / 10, immCall, immLoop);  // warm up
+  Run(true, calls / 10, defCall, defRender);
+  immCall = immLoop = defCall = defRender = Result();
+
+  Run(false, calls, immCall, immLoop);
+  Run(true, calls, defCall, defRender);
+
+  WS_LogStats st;
+  WS_Log_GetStats("action", st);
+  printf("calls=%lu defer_slots=%u arg_bytes=%u lines=%lu defer_full=%lu\n", calls,
+         (unsigned)LOG_DEFER_SLOTS, (unsigned)LOG_DEFER_ARG_BYTES, (unsigned long)st.lines,
+         (unsigned long)st.defer_full);
+  Print("immediate call", immCall);
+  Print("immediate loop", immLoop);
+  Print("deferred call", defCall);
+  Print("deferred render", defRender);
+  return CheckDeferred() ? 0 : 1;
+}
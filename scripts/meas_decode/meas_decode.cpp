@@ -0,0 +1,142 @@
+// Host decoder for the binary measurement log (see src/WS_MeasCodec.h).
+// Input: the raw download (/api/log/download?name=measure&fmt=bin) or segment files
+// copied off the device (/log_measure.N, their 16-byte ring header is skipped).
+// Converts one or more files to CSV (default) or to the device's text log lines.
+// Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Isrc scripts/meas_decode/meas_decode.cpp src/WS_MeasCodec.cpp -o meas_decode
+//
+//   ./meas_decode log_measure.bin > measure.csv
+//   ./meas_decode --text log_measure.bin
+//   ./meas_decode --stats log_measure.bin
+
+#include "WS_MeasCodec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct Options {
+  bool text = false;
+  bool stats = false;
+  bool header_done = false;
+  uint32_t from = 0;
+  uint32_t to = 0xFFFFFFFFUL;
+};
+
+struct Stats {
+  unsigned long blocks = 0;
+  unsigned long bad_blocks = 0;
+  unsigned long records = 0;
+  unsigned long record_bytes = 0;
+};
+
+static void PrintCsvHeader(uint8_t count)
+{
+  printf("t,time,clock");
+  for (uint8_t i = 0; i < count; i++) {
+    printf(",level%u_mm,temp%u_x10,online%u,valid%u", i + 1, i + 1, i + 1, i + 1);
+  }
+  printf("\n");
+}
+
+static void PrintCsv(const WS_MLogRecord& r)
+{
+  char ts[32] = "";
+  if (r.epoch) {
+    time_t tt = (time_t)r.t;
+    struct tm tmv;
+    if (gmtime_r(&tt, &tmv)) {
+      strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tmv);
+    }
+  }
+  printf("%lu,%s,%s", (unsigned long)r.t, ts, r.epoch ? "epoch" : "uptime");
+  for (uint8_t i = 0; i < r.count; i++) {
+    printf(",%u,%d,%d,%d", (unsigned)r.level_mm[i], (int)r.temp_x10[i],
+           (r.online >> i) & 1, (r.valid >> i) & 1);
+  }
+  printf("\n");
+}
+
+static bool DecodeFile(const char* path, Options& opt, Stats& st)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+  uint8_t blk[WS_MLOG_BLOCK_BYTES];
+  size_t n = fread(blk, 1, 4, f);
+  if (n != 4 || memcmp(blk, "WSLG", 4) != 0) {
+    fseek(f, 0, SEEK_SET);
+  } else {
+    fseek(f, 16, SEEK_SET);  // segment file header
+  }
+  while ((n = fread(blk, 1, sizeof(blk), f)) > 0) {
+    st.blocks++;
+    WS_MLogBlockReader rd;
+    if (!WS_MLog_BlockBegin(rd, blk, n)) {
+      st.bad_blocks++;
+      continue;
+    }
+    WS_MLogRecord r;
+    size_t prevPos = rd.pos;
+    while (WS_MLog_BlockNext(rd, r)) {
+      st.records++;
+      st.record_bytes += (unsigned long)(rd.pos - prevPos);
+      prevPos = rd.pos;
+      if (opt.stats || r.t < opt.from || r.t > opt.to) {
+        continue;
+      }
+      if (opt.text) {
+        char line[WS_MLOG_LINE_MAX];
+        WS_MLog_FormatLine(r, line, sizeof(line));
+        fputs(line, stdout);
+      } else {
+        if (!opt.header_done) {
+          PrintCsvHeader(r.count);
+          opt.header_done = true;
+        }
+        PrintCsv(r);
+      }
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  Options opt;
+  int files = 0;
+  Stats st;
+  bool ok = true;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--text") == 0) {
+      opt.text = true;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      opt.stats = true;
+    } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+      opt.from = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+      opt.to = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [--text|--stats] [--from T] [--to T] file.bin...\n", argv[0]);
+      return 2;
+    } else {
+      ok = DecodeFile(argv[i], opt, st) && ok;
+      files++;
+    }
+  }
+  if (files == 0) {
+    fprintf(stderr, "usage: %s [--text|--stats] [--from T] [--to T] file.bin...\n", argv[0]);
+    return 2;
+  }
+  if (opt.stats) {
+    printf("blocks=%lu bad_blocks=%lu records=%lu bytes_per_record=%.2f\n",
+           st.blocks, st.bad_blocks, st.records,
+           st.records ? (double)st.record_bytes / (double)st.records : 0.0);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+// Native driver for the firmware Modbus master (src/WS_Modbus.cpp) against a
+// serial port or the pty of scripts/modbus_sim.py. Reports polls/sec, latency
+// and how often a noisy reply (stray bytes / bad CRC / wrong header) was still
+// recovered. Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Iscripts/host -Isrc scripts/modbus_bench/modbus_bench.cpp src/WS_Modbus.cpp src/WS_ModbusCodec.cpp -o modbus_bench
+//
+//   ./modbus_bench /tmp/ttyMB0 --ids 1,2 --seconds 20
+
+#include "Arduino.h"
+#include "WS_Modbus.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+uint32_t millis()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+class FdStream : public Stream {
+public:
+  explicit FdStream(int fd) : fd_(fd) {}
+  int available() override
+  {
+    int n = 0;
+    return (ioctl(fd_, FIONREAD, &n) == 0) ? n : 0;
+  }
+  int read() override
+  {
+    uint8_t b = 0;
+    return (::read(fd_, &b, 1) == 1) ? b : -1;
+  }
+  size_t write(const uint8_t* buf, size_t len) override
+  {
+    const ssize_t n = ::write(fd_, buf, len);
+    return (n > 0) ? (size_t)n : 0;
+  }
+
+private:
+  int fd_;
+};
+
+static int OpenRaw(const char* path)
+{
+  const int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) {
+    return -1;
+  }
+  struct termios t;
+  if (tcgetattr(fd, &t) == 0) {
+    cfmakeraw(&t);
+    tcsetattr(fd, TCSANOW, &t);
+  }
+  return fd;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <tty> [--ids 1,2] [--seconds 10] [--baud 9600] [--timeout 250] [--retries 2] [--regs 4]\n", argv[0]);
+    return 2;
+  }
+  const char* path = argv[1];
+  uint8_t ids[32];
+  uint8_t idCount = 0;
+  uint32_t seconds = 10, baud = 9600, timeoutMs = 250, attempts = 2, regs = 4;
+  const char* idList = "1,2";
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--ids")) idList = argv[i + 1];
+    else if (!strcmp(argv[i], "--seconds")) seconds = (uint32_t)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--baud")) baud = (uint32_t)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--timeout")) timeoutMs = (uint32_t)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--retries")) attempts = (uint32_t)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--regs")) regs = (uint32_t)atoi(argv[i + 1]);
+  }
+  for (const char* p = idList; *p && idCount < sizeof(ids);) {
+    ids[idCount++] = (uint8_t)strtoul(p, (char**)&p, 0);
+    if (*p == ',') p++;
+  }
+  if (idCount == 0) {
+    fprintf(stderr, "no ids\n");
+    return 2;
+  }
+
+  const int fd = OpenRaw(path);
+  if (fd < 0) {
+    perror(path);
+    return 1;
+  }
+  FdStream port(fd);
+  WS_ModbusMaster m;
+  WS_Modbus_Begin(m, port, baud);
+  m.timeout_ms = (uint16_t)timeoutMs;
+  m.attempts = (uint8_t)attempts;
+
+  uint32_t polls = 0, ok = 0, fail = 0, exc = 0, sent = 0, timeouts = 0, crc = 0, hdr = 0;
+  uint32_t noisy = 0, noisyOk = 0, latSum = 0, latMax = 0;
+  uint8_t next = 0;
+  const uint32_t t0 = millis();
+  while ((millis() - t0) < seconds * 1000UL) {
+    if (!WS_Modbus_IsBusy(m)) {
+      WS_Modbus_StartRead(m, ids[next], WS_MB_FC_READ_HOLDING, 0, (uint16_t)regs, millis());
+      next = (uint8_t)((next + 1U) % idCount);
+    }
+    const WS_ModbusResult r = WS_Modbus_Poll(m, millis());
+    if (r == WS_MB_RESULT_OK || r == WS_MB_RESULT_FAIL) {
+      const WS_ModbusTxnStats& st = m.stats;
+      polls++;
+      sent += st.sent;
+      timeouts += st.timeouts;
+      crc += st.crc_errors;
+      hdr += st.header_errors;
+      // Noise the scanner had to skip. Stray bytes count only when they preceded a reply.
+      const bool wasNoisy = st.crc_errors || st.header_errors || m.rx.stray_bytes;
+      noisy += wasNoisy ? 1 : 0;
+      if (r == WS_MB_RESULT_OK) {
+        ok++;
+        noisyOk += wasNoisy ? 1 : 0;
+        latSum += st.latency_ms;
+        latMax = max(latMax, (uint32_t)st.latency_ms);
+      } else {
+        fail++;
+        exc += m.last_exception ? 1 : 0;
+      }
+    }
+    usleep(200);
+  }
+  close(fd);
+
+  const double dt = (millis() - t0) / 1000.0;
+  printf("polls=%u in %.1fs -> %.1f polls/s\n", polls, dt, polls / dt);
+  printf("ok=%u fail=%u (exception=%u) frames_sent=%u timeouts=%u crc_err=%u hdr_err=%u\n",
+         ok, fail, exc, sent, timeouts, crc, hdr);
+  printf("latency avg=%.1fms max=%ums\n", ok ? (double)latSum / ok : 0.0, latMax);
+  printf("resync: %u/%u noisy transactions recovered (%.1f%%)\n",
+         noisyOk, noisy, noisy ? 100.0 * noisyOk / noisy : 100.0);
+  return 0;
+}
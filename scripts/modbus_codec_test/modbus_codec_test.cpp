@@ -0,0 +1,265 @@
+// Host test for the Modbus RTU codec (src/WS_ModbusCodec.cpp): CRC16 test vectors,
+// the request builders for 0x03 / 0x04 / 0x06 / 0x10 against reference frames, and the
+// reply scanner on clean, noisy and broken input (resync after garbage, CRC mismatch,
+// header mismatch, exception reply, buffer compaction). Ends with the scanner cost per
+// reply frame. Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Iscripts/host -Isrc scripts/modbus_codec_test/modbus_codec_test.cpp src/WS_ModbusCodec.cpp -o modbus_codec_test
+//
+//   ./modbus_codec_test                 # exit code 1 on failure
+//   ./modbus_codec_test --iters 1000000
+
+#include "WS_ModbusCodec.h"
+#include "host_check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+static uint64_t NowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static bool SameBytes(const uint8_t* got, size_t n, const std::vector<uint8_t>& want)
+{
+  return n == want.size() && memcmp(got, want.data(), n) == 0;
+}
+
+// Feed bytes until the scanner reports something; returns the result and how many bytes it took.
+static WS_MB_ScanResult Feed(WS_MB_Scanner& s, const std::vector<uint8_t>& bytes, size_t* used = nullptr)
+{
+  WS_MB_ScanResult r = WS_MB_SCAN_MORE;
+  size_t i = 0;
+  while (r == WS_MB_SCAN_MORE && i < bytes.size()) {
+    r = WS_MB_ScanByte(s, bytes[i++]);
+  }
+  if (used != nullptr) {
+    *used = i;
+  }
+  return r;
+}
+
+static std::vector<uint8_t> Cat(std::vector<uint8_t> a, const std::vector<uint8_t>& b)
+{
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+// ---- Reference frames (CRC low byte first, as on the wire) ----
+static const std::vector<uint8_t> kReadHolding1 = {0x01, 0x03, 0x00, 0x00, 0x00, 0x01, 0x84, 0x0A};
+static const std::vector<uint8_t> kReadHolding10 = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+static const std::vector<uint8_t> kReadInput = {0x11, 0x04, 0x00, 0x08, 0x00, 0x01, 0xB2, 0x98};
+static const std::vector<uint8_t> kWriteSingle = {0x01, 0x06, 0x00, 0x01, 0x00, 0x03, 0x98, 0x0B};
+static const std::vector<uint8_t> kWriteMultiple = {0x01, 0x10, 0x00, 0x01, 0x00, 0x02, 0x04,
+                                                    0x00, 0x0A, 0x01, 0x02, 0x92, 0x30};
+static const std::vector<uint8_t> kReplyRead1 = {0x01, 0x03, 0x02, 0x01, 0x02, 0x38, 0x15};
+static const std::vector<uint8_t> kReplyWriteMultiple = {0x01, 0x10, 0x00, 0x01, 0x00, 0x02, 0x10, 0x08};
+static const std::vector<uint8_t> kReplyException = {0x01, 0x83, 0x02, 0xC0, 0xF1};
+
+static void TestCrc()
+{
+  printf("crc16\n");
+  const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  CHECK(WS_MB_Crc16(check, sizeof(check)) == 0x4B37);  // CRC-16/MODBUS check value
+  CHECK(WS_MB_Crc16(nullptr, 0) == 0xFFFF);
+  CHECK(WS_MB_Crc16(kReadHolding1.data(), 6) == 0x0A84);
+  CHECK(WS_MB_Crc16(kReadHolding10.data(), 6) == 0xCDC5);
+
+  // A frame followed by its own CRC (low byte first) leaves a zero remainder.
+  const std::vector<uint8_t>* frames[] = {&kReadHolding1, &kReadInput, &kWriteSingle, &kWriteMultiple, &kReplyException};
+  for (const std::vector<uint8_t>* f : frames) {
+    CHECK(WS_MB_Crc16(f->data(), f->size()) == 0);
+  }
+
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < sizeof(check); ++i) {
+    crc = WS_MB_Crc16Update(crc, check[i]);
+  }
+  CHECK(crc == 0x4B37);
+}
+
+static void TestBuilders()
+{
+  printf("builders\n");
+  uint8_t out[WS_MB_MAX_REQ_LEN];
+
+  size_t n = WS_MB_BuildRead(out, sizeof(out), 0x01, WS_MB_FC_READ_HOLDING, 0x0000, 1);
+  CHECK(SameBytes(out, n, kReadHolding1));
+  n = WS_MB_BuildRead(out, sizeof(out), 0x01, WS_MB_FC_READ_HOLDING, 0x0000, 10);
+  CHECK(SameBytes(out, n, kReadHolding10));
+  n = WS_MB_BuildRead(out, sizeof(out), 0x11, WS_MB_FC_READ_INPUT, 0x0008, 1);
+  CHECK(SameBytes(out, n, kReadInput));
+  n = WS_MB_BuildWriteSingle(out, sizeof(out), 0x01, 0x0001, 0x0003);
+  CHECK(SameBytes(out, n, kWriteSingle));
+  const uint16_t values[] = {0x000A, 0x0102};
+  n = WS_MB_BuildWriteMultiple(out, sizeof(out), 0x01, 0x0001, values, 2);
+  CHECK(SameBytes(out, n, kWriteMultiple));
+
+  // Largest write fits WS_MB_MAX_REQ_LEN exactly.
+  uint16_t many[WS_MB_MAX_WRITE_REGS];
+  for (uint16_t i = 0; i < WS_MB_MAX_WRITE_REGS; ++i) {
+    many[i] = (uint16_t)(i * 0x0101U);
+  }
+  n = WS_MB_BuildWriteMultiple(out, sizeof(out), 0x02, 0x0100, many, WS_MB_MAX_WRITE_REGS);
+  CHECK(n == WS_MB_MAX_REQ_LEN);
+  CHECK(n > 0 && WS_MB_Crc16(out, n) == 0);
+
+  // Rejected arguments.
+  CHECK(WS_MB_BuildRead(out, sizeof(out), 0x01, WS_MB_FC_WRITE_SINGLE, 0, 1) == 0);
+  CHECK(WS_MB_BuildRead(out, sizeof(out), 0x01, WS_MB_FC_READ_HOLDING, 0, 0) == 0);
+  CHECK(WS_MB_BuildRead(out, sizeof(out), 0x01, WS_MB_FC_READ_HOLDING, 0, WS_MB_MAX_READ_REGS + 1) == 0);
+  CHECK(WS_MB_BuildRead(out, 7, 0x01, WS_MB_FC_READ_HOLDING, 0, 1) == 0);
+  CHECK(WS_MB_BuildRead(nullptr, sizeof(out), 0x01, WS_MB_FC_READ_HOLDING, 0, 1) == 0);
+  CHECK(WS_MB_BuildWriteSingle(out, 7, 0x01, 0, 0) == 0);
+  CHECK(WS_MB_BuildWriteMultiple(out, sizeof(out), 0x01, 0, values, 0) == 0);
+  CHECK(WS_MB_BuildWriteMultiple(out, sizeof(out), 0x01, 0, many, WS_MB_MAX_WRITE_REGS + 1) == 0);
+  CHECK(WS_MB_BuildWriteMultiple(out, kWriteMultiple.size() - 1, 0x01, 0x0001, values, 2) == 0);
+  CHECK(WS_MB_BuildWriteMultiple(out, sizeof(out), 0x01, 0, nullptr, 2) == 0);
+}
+
+static void TestScanner()
+{
+  WS_MB_Scanner s;
+  size_t used = 0;
+
+  printf("scanner: clean reply\n");
+  WS_MB_ScanReset(s, 0x01, WS_MB_FC_READ_HOLDING, 1);
+  CHECK(Feed(s, kReplyRead1, &used) == WS_MB_SCAN_FRAME);
+  CHECK(used == kReplyRead1.size());
+  CHECK(WS_MB_ScanReg(s, 0) == 0x0102);
+  CHECK(WS_MB_ScanReg(s, 1) == 0);
+  CHECK(s.stray_bytes == 0 && s.crc_errors == 0 && s.header_errors == 0);
+  // Trailing bytes after a reported frame change nothing.
+  CHECK(WS_MB_ScanByte(s, 0x55) == WS_MB_SCAN_FRAME);
+  CHECK(WS_MB_ScanReg(s, 0) == 0x0102);
+
+  printf("scanner: resync after garbage\n");
+  // Stray bytes, then our id with a wrong function code, then a partial echo of the request.
+  const std::vector<uint8_t> garbage = {0xFF, 0x00, 0x01, 0x07, 0x01, 0x03, 0x04};
+  WS_MB_ScanReset(s, 0x01, WS_MB_FC_READ_HOLDING, 1);
+  CHECK(Feed(s, Cat(garbage, kReplyRead1), &used) == WS_MB_SCAN_FRAME);
+  CHECK(used == garbage.size() + kReplyRead1.size());
+  CHECK(WS_MB_ScanReg(s, 0) == 0x0102);
+  CHECK(s.header_errors == 2);  // 01 07 (function), 01 03 04 (byte count)
+  CHECK(s.stray_bytes > 0);
+  CHECK(s.crc_errors == 0);
+
+  printf("scanner: CRC mismatch\n");
+  std::vector<uint8_t> bad = kReplyRead1;
+  bad[4] ^= 0x40;  // register payload corrupted in transit
+  WS_MB_ScanReset(s, 0x01, WS_MB_FC_READ_HOLDING, 1);
+  CHECK(Feed(s, bad, &used) == WS_MB_SCAN_MORE);
+  CHECK(s.crc_errors == 1);
+  CHECK(Feed(s, kReplyRead1) == WS_MB_SCAN_FRAME);
+  CHECK(WS_MB_ScanReg(s, 0) == 0x0102);
+  bad = kReplyRead1;
+  bad.back() ^= 0x01;  // CRC high byte only
+  WS_MB_ScanReset(s, 0x01, WS_MB_FC_READ_HOLDING, 1);
+  CHECK(Feed(s, bad) == WS_MB_SCAN_MORE);
+  CHECK(s.crc_errors == 1);
+
+  printf("scanner: exception reply\n");
+  WS_MB_ScanReset(s, 0x01, WS_MB_FC_READ_HOLDING, 1);
+  CHECK(Feed(s, Cat({0x00, 0xAA}, kReplyException), &used) == WS_MB_SCAN_EXCEPTION);
+  CHECK(used == 2 + kReplyException.size());
+  CHECK(WS_MB_ScanFrame(s)[1] == 0x83);
+  CHECK(WS_MB_ScanFrame(s)[2] == 0x02);
+  CHECK(WS_MB_ScanReg(s, 0) == 0);
+  // Exception from another slave is ignored.
+  WS_MB_ScanReset(s, 0x02, WS_MB_FC_READ_HOLDING, 1);
+  CHECK(Feed(s, kReplyException) == WS_MB_SCAN_MORE);
+
+  printf("scanner: write echoes\n");
+  WS_MB_ScanReset(s, 0x01, WS_MB_FC_WRITE_SINGLE, 1);
+  CHECK(Feed(s, kWriteSingle, &used) == WS_MB_SCAN_FRAME);
+  CHECK(used == kWriteSingle.size());
+  WS_MB_ScanReset(s, 0x01, WS_MB_FC_WRITE_MULTIPLE, 2);
+  CHECK(Feed(s, Cat({0x01}, kReplyWriteMultiple), &used) == WS_MB_SCAN_FRAME);
+  CHECK(used == 1 + kReplyWriteMultiple.size());
+
+  printf("scanner: compaction past the buffer\n");
+  std::vector<uint8_t> noise;
+  for (int i = 0; i < 3 * WS_MB_SCAN_BUF_LEN; ++i) {
+    noise.push_back((uint8_t)(0x20 + (i % 0x40)));  // never 0x01
+  }
+  WS_MB_ScanReset(s, 0x01, WS_MB_FC_READ_HOLDING, 1);
+  CHECK(Feed(s, Cat(noise, kReplyRead1)) == WS_MB_SCAN_FRAME);
+  CHECK(WS_MB_ScanReg(s, 0) == 0x0102);
+  CHECK(s.stray_bytes == noise.size());
+}
+
+// Scanner cost per 16-register reply; every 8th reply is preceded by a stray echo and a
+// corrupted copy so that the reject / re-examine path is part of the figure.
+static void Bench(unsigned long iters)
+{
+  uint8_t reply[5 + 2 * WS_MB_MAX_READ_REGS];
+  reply[0] = 0x01;
+  reply[1] = WS_MB_FC_READ_HOLDING;
+  reply[2] = 2 * WS_MB_MAX_READ_REGS;
+  for (int i = 0; i < 2 * WS_MB_MAX_READ_REGS; ++i) {
+    reply[3 + i] = (uint8_t)(i * 37);
+  }
+  const uint16_t crc = WS_MB_Crc16(reply, sizeof(reply) - 2);
+  reply[sizeof(reply) - 2] = (uint8_t)(crc & 0xFF);
+  reply[sizeof(reply) - 1] = (uint8_t)(crc >> 8);
+  uint8_t noisy[sizeof(reply)];
+  memcpy(noisy, reply, sizeof(reply));
+  noisy[10] ^= 0x10;
+
+  WS_MB_Scanner s;
+  unsigned long frames = 0;
+  unsigned long bytes = 0;
+  uint32_t sink = 0;
+  const uint64_t t0 = NowNs();
+  for (unsigned long it = 0; it < iters; ++it) {
+    WS_MB_ScanReset(s, 0x01, WS_MB_FC_READ_HOLDING, WS_MB_MAX_READ_REGS);
+    WS_MB_ScanResult r = WS_MB_SCAN_MORE;
+    if ((it & 7U) == 0) {
+      for (size_t i = 0; i < 8 && r == WS_MB_SCAN_MORE; ++i) {
+        r = WS_MB_ScanByte(s, reply[i]);  // request-sized partial echo
+      }
+      for (size_t i = 0; i < sizeof(noisy) && r == WS_MB_SCAN_MORE; ++i) {
+        r = WS_MB_ScanByte(s, noisy[i]);
+      }
+      bytes += 8 + sizeof(noisy);
+    }
+    for (size_t i = 0; i < sizeof(reply) && r == WS_MB_SCAN_MORE; ++i) {
+      r = WS_MB_ScanByte(s, reply[i]);
+    }
+    bytes += sizeof(reply);
+    if (r == WS_MB_SCAN_FRAME) {
+      frames++;
+      sink += WS_MB_ScanReg(s, WS_MB_MAX_READ_REGS - 1);
+    }
+  }
+  const uint64_t ns = NowNs() - t0;
+  CHECK(frames == iters);
+  printf("bench: %lu replies of %u bytes (1 in 8 noisy), %.1f ns/frame, %.2f ns/byte (sink %u)\n",
+         iters, (unsigned)sizeof(reply), (double)ns / (double)(iters ? iters : 1),
+         (double)ns / (double)(bytes ? bytes : 1), (unsigned)(sink & 0xFF));
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long iters = 200000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+      iters = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--iters N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  TestCrc();
+  TestBuilders();
+  TestScanner();
+  Bench(iters);
+
+  return CheckSummary();
+}
@@ -0,0 +1,278 @@
+// Host test for the non-blocking Modbus master (src/WS_Modbus.cpp) against a scripted
+// serial port and a scripted clock: the test decides at which millisecond each reply byte
+// becomes readable and polls the master once per millisecond, so every state transition
+// happens at a known time. Covers the inter-frame quiet gap (late bytes restart it), the
+// response timeout with retry gap, replies split across polls, a partial reply followed by
+// a retry, a late reply from the previous attempt, an exception reply (FAIL, no retry) and
+// the write echo, each with its transaction counters (sent, timeouts, latency). Build (from
+// the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Iscripts/host -Isrc scripts/modbus_master_test/modbus_master_test.cpp src/WS_Modbus.cpp src/WS_ModbusCodec.cpp -o modbus_master_test
+//
+//   ./modbus_master_test                # exit code 1 on failure
+
+#include "Arduino.h"
+#include "WS_Modbus.h"
+#include "host_check.h"
+
+#include <deque>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static uint32_t g_nowMs = 0;
+
+uint32_t millis()
+{
+  return g_nowMs;
+}
+
+// RX bytes appear at scripted times; TX frames are recorded with the time they were written.
+class ScriptStream : public Stream {
+public:
+  struct Frame {
+    uint32_t at;
+    std::vector<uint8_t> bytes;
+  };
+
+  int available() override { return (int)rx_.size(); }
+  int read() override
+  {
+    if (rx_.empty()) {
+      return -1;
+    }
+    const uint8_t b = rx_.front();
+    rx_.pop_front();
+    return b;
+  }
+  size_t write(const uint8_t* buf, size_t len) override
+  {
+    tx.push_back(Frame{millis(), std::vector<uint8_t>(buf, buf + len)});
+    return len;
+  }
+
+  void At(uint32_t ms, const std::vector<uint8_t>& bytes) { script_.push_back(Frame{ms, bytes}); }
+
+  // Move every scripted chunk that is due into the RX buffer.
+  void Deliver()
+  {
+    for (size_t i = 0; i < script_.size();) {
+      if (script_[i].at <= millis()) {
+        rx_.insert(rx_.end(), script_[i].bytes.begin(), script_[i].bytes.end());
+        script_.erase(script_.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  std::vector<Frame> tx;
+
+private:
+  std::deque<uint8_t> rx_;
+  std::vector<Frame> script_;
+};
+
+// Poll once per millisecond until OK/FAIL; returns the result, the clock holds the end time.
+static WS_ModbusResult RunToEnd(WS_ModbusMaster& m, ScriptStream& port, uint32_t limitMs = 5000)
+{
+  const uint32_t end = g_nowMs + limitMs;
+  for (; g_nowMs <= end; ++g_nowMs) {
+    port.Deliver();
+    const WS_ModbusResult r = WS_Modbus_Poll(m, g_nowMs);
+    if (r == WS_MB_RESULT_OK || r == WS_MB_RESULT_FAIL) {
+      return r;
+    }
+  }
+  return WS_MB_RESULT_BUSY;
+}
+
+static const std::vector<uint8_t> kReqRead1 = {0x01, 0x03, 0x00, 0x00, 0x00, 0x01, 0x84, 0x0A};
+static const std::vector<uint8_t> kReplyRead1 = {0x01, 0x03, 0x02, 0x01, 0x02, 0x38, 0x15};
+static const std::vector<uint8_t> kReplyException = {0x01, 0x83, 0x02, 0xC0, 0xF1};
+static const std::vector<uint8_t> kWriteSingle = {0x01, 0x06, 0x00, 0x01, 0x00, 0x03, 0x98, 0x0B};
+
+static std::vector<uint8_t> Slice(const std::vector<uint8_t>& v, size_t from, size_t to)
+{
+  return std::vector<uint8_t>(v.begin() + from, v.begin() + to);
+}
+
+// A fresh master on a fresh port, reading holding register 0 of slave 1 at t = 0.
+struct Fixture {
+  ScriptStream port;
+  WS_ModbusMaster m;
+  Fixture()
+  {
+    g_nowMs = 0;
+    WS_Modbus_Begin(m, port, 9600);
+  }
+  bool StartRead() { return WS_Modbus_StartRead(m, 0x01, WS_MB_FC_READ_HOLDING, 0x0000, 1, g_nowMs); }
+  // Time the request has left the wire when it was written at writeMs.
+  uint32_t WaitFrom(uint32_t writeMs) const { return writeMs + m.tx_time_ms; }
+};
+
+static void TestClean()
+{
+  printf("clean reply\n");
+  Fixture f;
+  CHECK(f.StartRead());
+  CHECK(!f.StartRead());  // one transaction in flight
+  CHECK(f.m.tx_time_ms == 10);  // 8 bytes * 10 bits at 9600 baud, rounded up, + 1 ms
+  const uint32_t write = f.m.quiet_ms;
+  f.port.At(f.WaitFrom(write) + 3, kReplyRead1);
+  CHECK(RunToEnd(f.m, f.port) == WS_MB_RESULT_OK);
+  CHECK(f.port.tx.size() == 1);
+  CHECK(f.port.tx[0].at == write);
+  CHECK(f.port.tx[0].bytes == kReqRead1);
+  CHECK(g_nowMs == f.WaitFrom(write) + 3);
+  CHECK(f.m.stats.latency_ms == 3);
+  CHECK(f.m.stats.sent == 1 && f.m.stats.timeouts == 0);
+  CHECK(WS_Modbus_Reg(f.m, 0) == 0x0102);
+  CHECK(!WS_Modbus_IsBusy(f.m));
+  CHECK(WS_Modbus_Poll(f.m, g_nowMs) == WS_MB_RESULT_NONE);  // reported once
+}
+
+static void TestQuietGap()
+{
+  printf("quiet gap\n");
+  Fixture f;
+  // Tail of an older frame still trickling in: each byte restarts the quiet window.
+  f.port.At(2, {0x55});
+  f.port.At(6, {0x01, 0x03});
+  f.port.At(9, {0xAA});
+  CHECK(f.StartRead());
+  f.port.At(9 + f.m.quiet_ms + f.m.tx_time_ms + 1, kReplyRead1);
+  CHECK(RunToEnd(f.m, f.port) == WS_MB_RESULT_OK);
+  CHECK(f.port.tx.size() == 1);
+  CHECK(f.port.tx[0].at == 9U + f.m.quiet_ms);
+  CHECK(WS_Modbus_Reg(f.m, 0) == 0x0102);
+}
+
+static void TestTimeout()
+{
+  printf("response timeout\n");
+  Fixture f;
+  CHECK(f.StartRead());
+  CHECK(RunToEnd(f.m, f.port) == WS_MB_RESULT_FAIL);
+  CHECK(f.port.tx.size() == 2);
+  const uint32_t first = f.m.quiet_ms;
+  const uint32_t second = f.WaitFrom(first) + f.m.timeout_ms + f.m.retry_gap_ms + f.m.quiet_ms;
+  CHECK(f.port.tx[0].at == first);
+  CHECK(f.port.tx[1].at == second);
+  CHECK(f.port.tx[1].bytes == kReqRead1);
+  CHECK(g_nowMs == f.WaitFrom(second) + f.m.timeout_ms);
+  CHECK(f.m.stats.sent == 2 && f.m.stats.timeouts == 2);
+  CHECK(f.m.last_exception == 0);
+
+  // One tick before the deadline the master is still waiting.
+  Fixture g;
+  g.m.attempts = 1;
+  CHECK(g.StartRead());
+  g.port.At(g.WaitFrom(g.m.quiet_ms) + g.m.timeout_ms - 1, kReplyRead1);
+  CHECK(RunToEnd(g.m, g.port) == WS_MB_RESULT_OK);
+  CHECK(g.m.stats.latency_ms == g.m.timeout_ms - 1);
+}
+
+static void TestSplitAndPartial()
+{
+  printf("split / partial reply\n");
+  {
+    // Reply bytes spread over several polls are assembled.
+    Fixture f;
+    CHECK(f.StartRead());
+    const uint32_t wait = f.WaitFrom(f.m.quiet_ms);
+    f.port.At(wait + 2, Slice(kReplyRead1, 0, 3));
+    f.port.At(wait + 9, Slice(kReplyRead1, 3, 5));
+    f.port.At(wait + 20, Slice(kReplyRead1, 5, 7));
+    CHECK(RunToEnd(f.m, f.port) == WS_MB_RESULT_OK);
+    CHECK(g_nowMs == wait + 20);
+    CHECK(f.m.stats.sent == 1);
+    CHECK(WS_Modbus_Reg(f.m, 0) == 0x0102);
+  }
+  {
+    // Only the head arrives: the attempt times out and the retry must not reuse the stale head.
+    Fixture f;
+    CHECK(f.StartRead());
+    const uint32_t wait1 = f.WaitFrom(f.m.quiet_ms);
+    f.port.At(wait1 + 4, Slice(kReplyRead1, 0, 4));
+    const uint32_t write2 = wait1 + f.m.timeout_ms + f.m.retry_gap_ms + f.m.quiet_ms;
+    // The second attempt's reply is preceded by the rest of the first one.
+    f.port.At(f.WaitFrom(write2) + 1, Slice(kReplyRead1, 4, 7));
+    f.port.At(f.WaitFrom(write2) + 5, kReplyRead1);
+    CHECK(RunToEnd(f.m, f.port) == WS_MB_RESULT_OK);
+    CHECK(f.port.tx.size() == 2 && f.port.tx[1].at == write2);
+    CHECK(f.m.stats.sent == 2 && f.m.stats.timeouts == 1);
+    CHECK(g_nowMs == f.WaitFrom(write2) + 5);
+    CHECK(WS_Modbus_Reg(f.m, 0) == 0x0102);
+  }
+}
+
+static void TestLateReply()
+{
+  printf("late reply\n");
+  Fixture f;
+  CHECK(f.StartRead());
+  const uint32_t wait1 = f.WaitFrom(f.m.quiet_ms);
+  const uint32_t gapEnd = wait1 + f.m.timeout_ms + f.m.retry_gap_ms;
+  // The slave answers the first request after the timeout, while the retry is queued:
+  // the late reply lands during the quiet window and pushes the retry back.
+  f.port.At(gapEnd + 2, kReplyRead1);
+  const uint32_t write2 = gapEnd + 2 + f.m.quiet_ms;
+  std::vector<uint8_t> fresh = {0x01, 0x03, 0x02, 0x00, 0x07};
+  const uint16_t crc = WS_MB_Crc16(fresh.data(), fresh.size());
+  fresh.push_back((uint8_t)(crc & 0xFF));
+  fresh.push_back((uint8_t)(crc >> 8));
+  f.port.At(f.WaitFrom(write2) + 6, Slice(fresh, 0, 5));
+  f.port.At(f.WaitFrom(write2) + 7, Slice(fresh, 5, 7));
+  CHECK(RunToEnd(f.m, f.port) == WS_MB_RESULT_OK);
+  CHECK(f.port.tx.size() == 2);
+  CHECK(f.port.tx[1].at == write2);
+  CHECK(WS_Modbus_Reg(f.m, 0) == 0x0007);  // not the stale 0x0102
+  CHECK(f.m.stats.sent == 2 && f.m.stats.timeouts == 1);
+  CHECK(f.m.stats.latency_ms == 7);
+}
+
+static void TestException()
+{
+  printf("exception reply\n");
+  Fixture f;
+  CHECK(f.StartRead());
+  const uint32_t wait = f.WaitFrom(f.m.quiet_ms);
+  f.port.At(wait + 4, {0x00});  // line noise ahead of the reply
+  f.port.At(wait + 5, kReplyException);
+  CHECK(RunToEnd(f.m, f.port) == WS_MB_RESULT_FAIL);
+  CHECK(g_nowMs == wait + 5);  // no timeout, no retry
+  CHECK(f.port.tx.size() == 1);
+  CHECK(f.m.last_exception == 0x02);
+  CHECK(f.m.stats.sent == 1 && f.m.stats.timeouts == 0);
+  CHECK(WS_Modbus_Reg(f.m, 0) == 0);
+
+  // The next transaction starts clean.
+  CHECK(f.StartRead());
+  CHECK(f.m.last_exception == 0);
+}
+
+static void TestWrite()
+{
+  printf("write echo\n");
+  Fixture f;
+  const uint16_t value = 0x0003;
+  CHECK(WS_Modbus_StartWrite(f.m, 0x01, 0x0001, &value, 1, g_nowMs));
+  f.port.At(f.WaitFrom(f.m.quiet_ms) + 12, kWriteSingle);
+  CHECK(RunToEnd(f.m, f.port) == WS_MB_RESULT_OK);
+  CHECK(f.port.tx.size() == 1 && f.port.tx[0].bytes == kWriteSingle);
+  CHECK(f.m.stats.latency_ms == 12);
+}
+
+int main()
+{
+  TestClean();
+  TestQuietGap();
+  TestTimeout();
+  TestSplitAndPartial();
+  TestLateReply();
+  TestException();
+  TestWrite();
+
+  return CheckSummary();
+}
@@ -0,0 +1,230 @@
+"""
+Modbus RTU sensor simulator on a pseudo-terminal (Linux).
+
+Emulates one or more RS485 level sensors (same register layout as the
+firmware's default WS_SensorProfile: reg0 = level mm, reg3 = temperature
+0.1 C) and can inject the faults seen on a real bus:
+
+  --latency-ms / --jitter-ms   reply delay (uniform jitter on top)
+  --stray-prob                 garbage bytes before the reply
+  --late-prob / --late-ms      reply only after the master gave up
+  --crc-prob                   corrupt one byte of the reply
+  --drop-prob                  no reply at all
+  --exc-prob                   answer with exception 0x04 (slave failure)
+
+Usage:
+  python scripts/modbus_sim.py --ids 1,2 --link /tmp/ttyMB0 --stray-prob 0.1 --crc-prob 0.05
+  # then point scripts/modbus_bench (or any Modbus master) at /tmp/ttyMB0
+"""
+
+from __future__ import annotations
+
+import argparse
+import math
+import os
+import random
+import select
+import sys
+import time
+import tty
+
+
+def crc16(data: bytes) -> int:
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def with_crc(body: bytes) -> bytes:
+    c = crc16(body)
+    return body + bytes((c & 0xFF, c >> 8))
+
+
+class Sensor:
+    def __init__(self, sid: int, regs: int) -> None:
+        self.id = sid
+        self.regs = [0] * regs
+        self.base = 1000 + 100 * sid
+
+    def refresh(self, now: float) -> None:
+        # Slow tide plus a little ripple, so filters/rates have something to chew on.
+        level = self.base + 200 * math.sin(now / 600.0) + random.randint(-3, 3)
+        self.regs[0] = max(0, min(0xFFFF, int(level)))
+        if len(self.regs) > 3:
+            self.regs[3] = 250 + random.randint(-2, 2)
+
+
+class Stats:
+    def __init__(self) -> None:
+        self.requests = 0
+        self.replies = 0
+        self.stray = 0
+        self.late = 0
+        self.crc = 0
+        self.drop = 0
+        self.exc = 0
+        self.bad_frames = 0
+
+    def line(self) -> str:
+        return (
+            f"req={self.requests} reply={self.replies} stray={self.stray} late={self.late} "
+            f"crc={self.crc} drop={self.drop} exc={self.exc} bad_rx={self.bad_frames}"
+        )
+
+
+def request_len(buf: bytes) -> int:
+    """Expected length of the request at buf[0], 0 if unknown yet, -1 if not a request."""
+    if len(buf) < 2:
+        return 0
+    fc = buf[1]
+    if fc in (0x03, 0x04, 0x06):
+        return 8
+    if fc == 0x10:
+        return 9 + buf[6] if len(buf) >= 7 else 0
+    return -1
+
+
+def handle(sensor: Sensor, req: bytes) -> bytes:
+    fc = req[1]
+    reg = (req[2] << 8) | req[3]
+    if fc in (0x03, 0x04):
+        count = (req[4] << 8) | req[5]
+        if count == 0 or reg + count > len(sensor.regs):
+            return with_crc(bytes((sensor.id, fc | 0x80, 0x02)))
+        sensor.refresh(time.time())
+        data = b"".join(sensor.regs[reg + i].to_bytes(2, "big") for i in range(count))
+        return with_crc(bytes((sensor.id, fc, 2 * count)) + data)
+    if fc == 0x06:
+        if reg >= len(sensor.regs):
+            return with_crc(bytes((sensor.id, fc | 0x80, 0x02)))
+        sensor.regs[reg] = (req[4] << 8) | req[5]
+        return req
+    if fc == 0x10:
+        count = (req[4] << 8) | req[5]
+        if reg + count > len(sensor.regs):
+            return with_crc(bytes((sensor.id, fc | 0x80, 0x02)))
+        for i in range(count):
+            sensor.regs[reg + i] = (req[7 + 2 * i] << 8) | req[8 + 2 * i]
+        return with_crc(req[:6])
+    return with_crc(bytes((sensor.id, fc | 0x80, 0x01)))
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--ids", default="1,2", help="comma separated Modbus IDs")
+    ap.add_argument("--regs", type=int, default=8, help="registers per sensor")
+    ap.add_argument("--link", default="", help="create a symlink to the pty slave at this path")
+    ap.add_argument("--baud", type=int, default=9600, help="pace replies like a real wire (0 = no pacing)")
+    ap.add_argument("--latency-ms", type=float, default=15.0)
+    ap.add_argument("--jitter-ms", type=float, default=5.0)
+    ap.add_argument("--stray-prob", type=float, default=0.0)
+    ap.add_argument("--late-prob", type=float, default=0.0)
+    ap.add_argument("--late-ms", type=float, default=400.0)
+    ap.add_argument("--crc-prob", type=float, default=0.0)
+    ap.add_argument("--drop-prob", type=float, default=0.0)
+    ap.add_argument("--exc-prob", type=float, default=0.0)
+    ap.add_argument("--seed", type=int, default=None)
+    ap.add_argument("--stats-s", type=float, default=5.0, help="print counters every N seconds (0 = off)")
+    args = ap.parse_args()
+
+    random.seed(args.seed)
+    sensors = {int(x, 0): Sensor(int(x, 0), args.regs) for x in args.ids.split(",") if x.strip()}
+
+    master_fd, slave_fd = os.openpty()
+    tty.setraw(slave_fd)
+    slave_name = os.ttyname(slave_fd)
+    if args.link:
+        try:
+            os.unlink(args.link)
+        except FileNotFoundError:
+            pass
+        os.symlink(slave_name, args.link)
+    print(f"[sim] sensors {sorted(sensors)} on {args.link or slave_name}", flush=True)
+
+    stats = Stats()
+    rx = bytearray()
+    pending: list[tuple[float, bytes]] = []   # (due time, bytes)
+    last_stats = time.monotonic()
+
+    def wire_s(n: int) -> float:
+        return (n * 10.0 / args.baud) if args.baud > 0 else 0.0
+
+    try:
+        while True:
+            now = time.monotonic()
+            timeout = 0.05
+            if pending:
+                timeout = max(0.0, min(timeout, min(t for t, _ in pending) - now))
+            r, _, _ = select.select([master_fd], [], [], timeout)
+            now = time.monotonic()
+
+            if r:
+                rx += os.read(master_fd, 256)
+                while rx:
+                    n = request_len(rx)
+                    if n < 0:
+                        del rx[0]
+                        stats.bad_frames += 1
+                        continue
+                    if n == 0 or len(rx) < n:
+                        break
+                    req = bytes(rx[:n])
+                    if crc16(req[:-2]) != (req[-2] | (req[-1] << 8)):
+                        del rx[0]
+                        stats.bad_frames += 1
+                        continue
+                    del rx[:n]
+                    sensor = sensors.get(req[0])
+                    if sensor is None:
+                        continue
+                    stats.requests += 1
+                    if random.random() < args.drop_prob:
+                        stats.drop += 1
+                        continue
+                    if random.random() < args.exc_prob:
+                        stats.exc += 1
+                        reply = with_crc(bytes((sensor.id, req[1] | 0x80, 0x04)))
+                    else:
+                        reply = handle(sensor, req)
+                    delay = (args.latency_ms + random.uniform(0.0, args.jitter_ms)) / 1000.0
+                    if random.random() < args.late_prob:
+                        stats.late += 1
+                        delay += args.late_ms / 1000.0
+                    if random.random() < args.crc_prob:
+                        stats.crc += 1
+                        b = bytearray(reply)
+                        b[random.randrange(3, len(b))] ^= 0x5A
+                        reply = bytes(b)
+                    if random.random() < args.stray_prob:
+                        stats.stray += 1
+                        # Include the slave id now and then, so the master has to resync on CRC.
+                        junk = bytes(random.choice((random.randrange(256), sensor.id)) for _ in range(random.randint(1, 6)))
+                        reply = junk + reply
+                    pending.append((now + wire_s(len(req)) + delay, reply))
+
+            due = [p for p in pending if p[0] <= now]
+            if due:
+                pending = [p for p in pending if p[0] > now]
+                for _, reply in sorted(due):
+                    os.write(master_fd, reply)
+                    stats.replies += 1
+
+            if args.stats_s > 0 and now - last_stats >= args.stats_s:
+                last_stats = now
+                print(f"[sim] {stats.line()}", flush=True)
+    except KeyboardInterrupt:
+        print(f"[sim] {stats.line()}")
+    finally:
+        if args.link:
+            try:
+                os.unlink(args.link)
+            except OSError:
+                pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,219 @@
+// Host benchmark and round-trip check for the binary MQTT encoding (src/WS_MsgPack.cpp).
+// For typical payloads (state keyframe with 2 and 8 sensors, a delta frame, RPC
+// replies) it compares JSON size and build time (snprintf, as the firmware does)
+// with the MessagePack size and the extra transcoding time, and checks that decoding
+// gives back the same JSON text. JSON files given on the command line are measured
+// and checked the same way. --check-keys compares the key table with the server's
+// copy (server/src/msgpack.js). Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Isrc scripts/msgpack_bench/msgpack_bench.cpp src/WS_MsgPack.cpp -o msgpack_bench
+//
+//   ./msgpack_bench --iters 20000 --check-keys server/src/msgpack.js
+
+#include "WS_MsgPack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+static uint64_t NowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Same layout as MQTT_BuildStateJson() in src/WS_MQTT.cpp; values vary with i.
+static size_t BuildState(char* out, size_t cap, unsigned sensors, unsigned long i)
+{
+  char s12[2][112];
+  for (unsigned k = 0; k < 2; k++) {
+    snprintf(s12[k], sizeof(s12[k]),
+             "{\"mm\":%u,\"filt_mm\":%u,\"valid\":%s,\"online\":%s,\"temp_x10\":%d,\"temp_valid\":%s}",
+             (unsigned)(1200 + k * 300 + i % 50), (unsigned)(1200 + k * 300 + i % 40), "true", "true",
+             (int)(215 + (i % 9)), "true");
+  }
+  char all[8 * 288 + 4];
+  size_t w = 0;
+  all[w++] = '[';
+  for (unsigned k = 0; k < sensors; k++) {
+    w += (size_t)snprintf(all + w, sizeof(all) - w,
+                          "%s{\"id\":%u,\"mm\":%u,\"filt_mm\":%u,\"valid\":%s,\"online\":%s,\"temp_x10\":%d,\"temp_valid\":%s,\"q\":%u,\"poll_ms\":%lu}",
+                          k ? "," : "", k + 1, (unsigned)(1200 + k * 300 + i % 50), (unsigned)(1200 + k * 300 + i % 40),
+                          "true", "true", (int)(215 + (i % 9)), "true", 100u, 2000UL);
+  }
+  all[w++] = ']';
+  all[w] = '\0';
+  const int n = snprintf(
+    out, cap,
+    "{\"sensor1\":%s,\"sensor2\":%s,\"sensors\":%s,\"gate_state\":%u,\"gate_position_open\":%s,\"auto_gate\":%s,\"auto_latched\":%s,\"manual\":{\"active\":%s,\"remain_s\":%lu,\"total_s\":%lu},\"relay1\":%u,\"relay2\":%u,\"net\":{\"wifi\":%s,\"mqtt\":%s,\"http\":%s,\"ip\":\"%s\",\"rssi\":%d,\"ssid\":\"%s\"},\"cell\":{\"enabled\":%s,\"online\":%s,\"sim_ready\":%s,\"attached\":%s,\"csq\":%d,\"rssi_dbm\":%d,\"last_rx_age_s\":%lu},\"ctrl\":{\"open_allowed\":%s,\"close_allowed\":%s,\"cooldown_remain_s\":%lu,\"min_interval_s\":%u,\"action_s\":%u,\"reason\":\"%s\"},\"alarm\":{\"active\":%s,\"severity\":%u,\"text\":\"%s\"},\"fw\":{\"current\":\"%s\",\"latest\":\"%s\",\"last_check\":\"%s\",\"last_result\":\"%s\"}}",
+    s12[0], s12[1], all, (unsigned)(i % 3), "false", "true", "false", "false", 0UL, 0UL, 0u, 0u,
+    "true", "true", "true", "192.168.1.57", -61 - (int)(i % 5), "fish-pond", "false", "false", "false", "false",
+    0, 0, 0UL, "true", "false", 0UL, 15u, 10u, "inner level below outer by 75 mm", "false", 0u, "",
+    "v1.4.2", "v1.4.2", "2024-05-07 03:00:12", "up to date");
+  return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+struct Sample {
+  std::string name;
+  std::string json;     // fixed payloads; empty = built per iteration
+  unsigned sensors;
+};
+
+struct Result {
+  size_t json_bytes = 0;
+  size_t mp_bytes = 0;
+  double build_ns = 0;
+  double transcode_ns = 0;
+  bool round_trip = false;
+};
+
+static Result Measure(const Sample& s, unsigned long iters)
+{
+  Result r;
+  static char json[8192];
+  static uint8_t mp[8192 + 64];
+  static char back[8192];
+
+  const bool built = s.json.empty();
+  size_t n = built ? BuildState(json, sizeof(json), s.sensors, 0) : s.json.size();
+  if (!built) {
+    memcpy(json, s.json.data(), n);
+  }
+  r.json_bytes = n;
+  r.mp_bytes = WS_MsgPack_FromJson(json, n, mp, sizeof(mp));
+  const size_t bn = r.mp_bytes ? WS_MsgPack_ToJson(mp, r.mp_bytes, back, sizeof(back)) : 0;
+  r.round_trip = (bn == n && memcmp(back, json, n) == 0);
+  if (!r.round_trip && r.mp_bytes) {
+    fprintf(stderr, "%s: round trip differs\n  in:  %.*s\n  out: %s\n", s.name.c_str(), (int)n, json, back);
+  }
+
+  uint64_t tBuild = 0;
+  uint64_t tMp = 0;
+  volatile size_t sink = 0;
+  for (unsigned long i = 0; i < iters; i++) {
+    const uint64_t t0 = NowNs();
+    if (built) {
+      n = BuildState(json, sizeof(json), s.sensors, i);
+    }
+    const uint64_t t1 = NowNs();
+    sink = sink + WS_MsgPack_FromJson(json, n, mp, sizeof(mp));
+    const uint64_t t2 = NowNs();
+    tBuild += t1 - t0;
+    tMp += t2 - t1;
+  }
+  (void)sink;
+  r.build_ns = built ? (double)tBuild / (double)iters : 0.0;
+  r.transcode_ns = (double)tMp / (double)iters;
+  return r;
+}
+
+static bool ReadFile(const char* path, std::string& out)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    out.append(buf, n);
+  }
+  fclose(f);
+  while (!out.empty() && (out.back() == '\n' || out.back() == '\r')) {
+    out.pop_back();
+  }
+  return true;
+}
+
+// Compares the quoted entries of "const KEYS = [ ... ];" with WS_MsgPack_Keys.
+static bool CheckKeys(const char* path)
+{
+  std::string js;
+  if (!ReadFile(path, js)) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return false;
+  }
+  const size_t a = js.find("const KEYS = [");
+  const size_t b = (a == std::string::npos) ? a : js.find("];", a);
+  if (b == std::string::npos) {
+    fprintf(stderr, "%s: KEYS table not found\n", path);
+    return false;
+  }
+  std::vector<std::string> keys;
+  for (size_t p = a; p < b; p++) {
+    if (js[p] != '\'') continue;
+    const size_t e = js.find('\'', p + 1);
+    keys.push_back(js.substr(p + 1, e - p - 1));
+    p = e;
+  }
+  bool ok = (keys.size() == WS_MsgPack_KeyCount);
+  for (size_t i = 0; ok && i < keys.size(); i++) {
+    if (keys[i] != WS_MsgPack_Keys[i]) {
+      fprintf(stderr, "key %u: firmware \"%s\", %s \"%s\"\n", (unsigned)i, WS_MsgPack_Keys[i], path, keys[i].c_str());
+      ok = false;
+    }
+  }
+  printf("keys: firmware=%u %s=%u %s\n", (unsigned)WS_MsgPack_KeyCount, path, (unsigned)keys.size(), ok ? "match" : "MISMATCH");
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long iters = 20000;
+  bool ok = true;
+  std::vector<Sample> samples;
+  samples.push_back({"state 2 sensors", "", 2});
+  samples.push_back({"state 8 sensors", "", 8});
+  samples.push_back({"delta", "{\"seq\":42,\"delta\":1,\"sensor1\":{\"mm\":1236,\"filt_mm\":1234},\"sensors\":[{\"id\":1,\"mm\":1236}],\"net\":{\"rssi\":-63}}", 0});
+  samples.push_back({"reply ok", "{\"ok\":true,\"req_id\":\"lv8x1k2a-3f9qz0pe\",\"cmd\":\"gate_open\"}", 0});
+  samples.push_back({"reply text", "{\"ok\":true,\"req_id\":\"lv8x1k2a-3f9qz0pe\",\"cmd\":\"get_log\",\"name\":\"action\",\"text\":\"2024-05-07 03:00:12 [ACTION] gate=open mode=\\\"auto\\\"\\r\\n2024-05-07 03:10:40 [ACTION] gate=close\\r\\n\",\"lines\":2,\"truncated\":false}", 0});
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+      iters = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--check-keys") == 0 && i + 1 < argc) {
+      ok = CheckKeys(argv[++i]) && ok;
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [--iters N] [--check-keys server/src/msgpack.js] [file.json...]\n", argv[0]);
+      return 2;
+    } else {
+      Sample s;
+      s.name = argv[i];
+      s.sensors = 0;
+      if (!ReadFile(argv[i], s.json) || s.json.empty()) {
+        fprintf(stderr, "cannot read %s\n", argv[i]);
+        return 2;
+      }
+      samples.push_back(s);
+    }
+  }
+  if (iters == 0) {
+    iters = 1;
+  }
+
+  printf("%-18s %8s %8s %7s %12s %14s %s\n", "payload", "json_B", "mp_B", "ratio", "json_ns", "+transcode_ns", "round_trip");
+  for (size_t i = 0; i < samples.size(); i++) {
+    const Result r = Measure(samples[i], iters);
+    if (!r.mp_bytes) {
+      printf("%-18s %8u %8s   (not valid JSON or too large)\n", samples[i].name.c_str(), (unsigned)r.json_bytes, "-");
+      ok = false;
+      continue;
+    }
+    char build[24];
+    if (r.build_ns > 0) {
+      snprintf(build, sizeof(build), "%.0f", r.build_ns);
+    } else {
+      snprintf(build, sizeof(build), "-");
+    }
+    printf("%-18s %8u %8u %6.0f%% %12s %14.0f %s\n", samples[i].name.c_str(), (unsigned)r.json_bytes,
+           (unsigned)r.mp_bytes, 100.0 * (double)r.mp_bytes / (double)r.json_bytes, build, r.transcode_ns,
+           r.round_trip ? "ok" : "FAIL");
+    ok = ok && r.round_trip;
+  }
+  return ok ? 0 : 1;
+}
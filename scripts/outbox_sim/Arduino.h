@@ -0,0 +1,12 @@
+#ifndef _OUTBOX_SIM_ARDUINO_H_
+#define _OUTBOX_SIM_ARDUINO_H_
+
+// Minimal Arduino shim so src/WS_Outbox.cpp and src/WS_LogRing.cpp build natively for outbox_sim.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#endif
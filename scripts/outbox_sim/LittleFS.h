@@ -0,0 +1,84 @@
+#ifndef _OUTBOX_SIM_LITTLEFS_H_
+#define _OUTBOX_SIM_LITTLEFS_H_
+
+// RAM-backed LittleFS stand-in, plus Truncate() so the simulator can tear the last write
+// the way a power cut does.
+
+#include "Arduino.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File {
+public:
+  File() {}
+  File(std::shared_ptr<std::vector<uint8_t> > d, size_t pos) : d_(d), pos_(pos) {}
+  size_t write(const uint8_t* b, size_t n)
+  {
+    if (!d_) return 0;
+    if (d_->size() < pos_ + n) d_->resize(pos_ + n);
+    memcpy(d_->data() + pos_, b, n);
+    pos_ += n;
+    return n;
+  }
+  size_t read(uint8_t* b, size_t n)
+  {
+    if (!d_ || pos_ >= d_->size()) return 0;
+    if (n > d_->size() - pos_) n = d_->size() - pos_;
+    memcpy(b, d_->data() + pos_, n);
+    pos_ += n;
+    return n;
+  }
+  bool seek(uint32_t off, SeekMode mode = SeekSet)
+  {
+    if (!d_) return false;
+    const size_t base = (mode == SeekSet) ? 0 : (mode == SeekCur) ? pos_ : d_->size();
+    if (base + off > d_->size()) return false;
+    pos_ = base + off;
+    return true;
+  }
+  size_t size() const { return d_ ? d_->size() : 0; }
+  void flush() {}
+  void close() { d_.reset(); }
+  explicit operator bool() const { return (bool)d_; }
+
+private:
+  std::shared_ptr<std::vector<uint8_t> > d_;
+  size_t pos_ = 0;
+};
+
+class LittleFSFS {
+public:
+  File open(const char* path, const char* mode = "r")
+  {
+    std::shared_ptr<std::vector<uint8_t> >& d = files_[path];
+    if (mode[0] == 'r' && !d) {
+      files_.erase(path);
+      return File();
+    }
+    if (!d || mode[0] == 'w') d = std::make_shared<std::vector<uint8_t> >();
+    return File(d, (mode[0] == 'a') ? d->size() : 0);
+  }
+  bool exists(const char* path) const { return files_.count(path) != 0; }
+  bool remove(const char* path) { return files_.erase(path) != 0; }
+
+  // Simulator only: drop the last n bytes of a file.
+  void Truncate(const char* path, size_t n)
+  {
+    auto it = files_.find(path);
+    if (it == files_.end() || !it->second) return;
+    std::vector<uint8_t>& d = *it->second;
+    d.resize(d.size() > n ? d.size() - n : 0);
+  }
+
+private:
+  std::map<std::string, std::shared_ptr<std::vector<uint8_t> > > files_;
+};
+
+extern LittleFSFS LittleFS;
+
+#endif
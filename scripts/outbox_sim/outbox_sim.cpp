@@ -0,0 +1,349 @@
+// Store-and-forward simulation for the MQTT outbox (src/WS_Outbox.cpp) on a RAM file system.
+// A simulated broker stands in for mosquitto: link outages on a schedule, a socket send
+// buffer drained at the link rate (a full buffer makes a publish fail = backpressure), and a
+// per-second message limit that disconnects the client when exceeded (max_inflight /
+// rate-limited bridges behave alike). The device side follows src/WS_MQTT.cpp: state is live
+// only, log pushes and batches go through the outbox while offline or while it is not drained,
+// replay runs after the live traffic of each loop. A power cut mid-replay tears the last
+// record and restarts the outbox from flash. Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Iscripts/outbox_sim -Isrc scripts/outbox_sim/outbox_sim.cpp src/WS_Outbox.cpp src/WS_LogRing.cpp -o outbox_sim
+//
+//   ./outbox_sim                       # default scenario, exit code 1 on failure
+//   ./outbox_sim --msgs 20 --tick 100 --bytes 65536   # replay too fast: broker limit trips, messages lost
+
+#include "Arduino.h"
+#include "LittleFS.h"
+#include "WS_Outbox.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+LittleFSFS LittleFS;
+
+static const char* kBase = "/outbox";
+
+// ---- Broker stand-in ----
+
+struct Outage {
+  uint32_t from_ms;
+  uint32_t to_ms;
+};
+
+enum { kStreamState, kStreamLog, kStreamBatch, kStreamCount };
+static const char* kStreamName[kStreamCount] = {"state", "log", "batch"};
+static const char* kTopic[kStreamCount] = {"dev/device/telemetry", "dev/device/log/action", "dev/device/telemetry/batch"};
+
+struct Broker {
+  // Link model
+  std::vector<Outage> outages;
+  uint32_t window = 16384;         // socket send buffer
+  uint32_t bandwidth = 32768;      // bytes/s drained from it
+  uint32_t limit_msgs = 20;        // per second; more => disconnect
+  uint32_t limit_penalty_ms = 5000;
+
+  uint32_t now = 0;
+  uint32_t buffered = 0;
+  uint32_t window_start = 0;
+  uint32_t window_msgs = 0;
+  uint32_t kicked_until = 0;
+  bool connected = false;
+
+  // In-progress streamed publish
+  bool open = false;
+  std::string topic;
+  std::string payload;
+  uint32_t expect = 0;
+
+  // Receiver checks
+  uint32_t last_seq[kStreamCount] = {0, 0, 0};
+  uint32_t received[kStreamCount] = {0, 0, 0};
+  uint32_t dups[kStreamCount] = {0, 0, 0};
+  uint32_t gaps[kStreamCount] = {0, 0, 0};
+  uint32_t limit_trips = 0;
+  uint32_t discarded = 0;
+  uint32_t max_latency_ms[kStreamCount] = {0, 0, 0};
+
+  bool LinkUp() const
+  {
+    for (const Outage& o : outages) {
+      if (now >= o.from_ms && now < o.to_ms) return false;
+    }
+    return now >= kicked_until;
+  }
+
+  void Tick(uint32_t dtMs)
+  {
+    const uint32_t drained = (uint32_t)((uint64_t)bandwidth * dtMs / 1000);
+    buffered = (buffered > drained) ? buffered - drained : 0;
+    if (!LinkUp()) {
+      connected = false;
+      buffered = 0;
+      open = false;
+    }
+  }
+
+  bool Begin(const char* t, uint32_t len)
+  {
+    if (!connected || open || buffered + len > window) return false;
+    open = true;
+    topic = t;
+    payload.clear();
+    expect = len;
+    return true;
+  }
+
+  bool Write(const uint8_t* d, size_t n)
+  {
+    if (!open) return false;
+    payload.append((const char*)d, n);
+    return true;
+  }
+
+  void Deliver()
+  {
+    // Payload: "<stream>:<seq>:<produced_ms>:" + filler
+    int stream = -1;
+    for (int i = 0; i < kStreamCount; i++) {
+      if (topic == kTopic[i]) stream = i;
+    }
+    unsigned s = 0, seq = 0, at = 0;
+    if (stream < 0 || sscanf(payload.c_str(), "%u:%u:%u:", &s, &seq, &at) != 3 || (int)s != stream) {
+      fprintf(stderr, "bad message on %s\n", topic.c_str());
+      exit(2);
+    }
+    received[stream]++;
+    if (now - at > max_latency_ms[stream]) max_latency_ms[stream] = now - at;
+    if (stream == kStreamState) {
+      last_seq[stream] = seq;   // live only: gaps expected while offline
+      return;
+    }
+    if (seq <= last_seq[stream]) {
+      dups[stream]++;
+      return;
+    }
+    gaps[stream] += seq - last_seq[stream] - 1;
+    last_seq[stream] = seq;
+  }
+
+  bool End()
+  {
+    if (!open) return false;
+    open = false;
+    if (payload.size() != expect) return false;
+    buffered += expect;
+    if (now - window_start >= 1000) {
+      window_start = now;
+      window_msgs = 0;
+    }
+    if (++window_msgs > limit_msgs) {
+      // QoS0: the client already wrote it; the broker drops it and the connection.
+      limit_trips++;
+      discarded++;
+      connected = false;
+      kicked_until = now + limit_penalty_ms;
+      return true;
+    }
+    Deliver();
+    return true;
+  }
+
+  bool Publish(const char* t, const std::string& p)
+  {
+    return Begin(t, (uint32_t)p.size()) && Write((const uint8_t*)p.data(), p.size()) && End();
+  }
+};
+
+static Broker g_broker;
+
+static bool PubBegin(void*, const char* topic, uint32_t len, bool)
+{
+  return g_broker.Begin(topic, len);
+}
+
+static bool PubWrite(void*, const uint8_t* data, size_t n)
+{
+  return g_broker.Write(data, n);
+}
+
+static bool PubEnd(void*)
+{
+  return g_broker.End();
+}
+
+// ---- Device side ----
+
+struct Producer {
+  uint32_t period_ms;
+  uint32_t bytes;
+  uint32_t next_ms;
+  uint32_t seq;
+};
+
+static std::string MakePayload(int stream, uint32_t seq, uint32_t nowMs, uint32_t bytes)
+{
+  char head[48];
+  snprintf(head, sizeof(head), "%d:%u:%u:", stream, (unsigned)seq, (unsigned)nowMs);
+  std::string p(head);
+  while (p.size() < bytes) {
+    p.push_back((char)('a' + p.size() % 26));
+  }
+  return p;
+}
+
+static bool ParseArg(int argc, char** argv, int& i, const char* name, uint32_t& out)
+{
+  if (strcmp(argv[i], name) != 0 || i + 1 >= argc) return false;
+  out = (uint32_t)strtoul(argv[++i], nullptr, 10);
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t simS = 2400;
+  uint32_t segBytes = 65536;
+  uint32_t segments = 8;
+  WS_OutboxPace pace = {250, 2, 4096, 10000};
+  uint32_t msgs = pace.msgs;
+  uint32_t powerCutS = 1505;
+  for (int i = 1; i < argc; i++) {
+    if (ParseArg(argc, argv, i, "--seconds", simS) || ParseArg(argc, argv, i, "--seg-bytes", segBytes) ||
+        ParseArg(argc, argv, i, "--segments", segments) || ParseArg(argc, argv, i, "--tick", pace.tick_ms) ||
+        ParseArg(argc, argv, i, "--msgs", msgs) || ParseArg(argc, argv, i, "--bytes", pace.bytes) ||
+        ParseArg(argc, argv, i, "--window", g_broker.window) || ParseArg(argc, argv, i, "--bandwidth", g_broker.bandwidth) ||
+        ParseArg(argc, argv, i, "--limit", g_broker.limit_msgs) || ParseArg(argc, argv, i, "--power-cut", powerCutS)) {
+      continue;
+    }
+    fprintf(stderr,
+            "usage: %s [--seconds N] [--seg-bytes N] [--segments N] [--tick MS] [--msgs N] [--bytes N]\n"
+            "          [--window N] [--bandwidth B/s] [--limit MSGS/s] [--power-cut S (0 = none)]\n",
+            argv[0]);
+    return 2;
+  }
+  pace.msgs = (uint8_t)(msgs > 255 ? 255 : msgs);
+
+  // 5 min, a 10 s blip, then 10 min whose replay the power cut (--power-cut) interrupts.
+  g_broker.outages.push_back({60000, 360000});
+  g_broker.outages.push_back({600000, 610000});
+  g_broker.outages.push_back({900000, 1500000});
+
+  Producer prod[kStreamCount] = {
+    {3000, 2048, 0, 0},    // state: interval telemetry, live only
+    {2000, 200, 0, 0},     // action/measure log push batch
+    {30000, 6000, 0, 0},   // sample batch
+  };
+
+  WS_Outbox ob;
+  if (!WS_Outbox_Open(ob, kBase, (uint8_t)segments, segBytes)) {
+    fprintf(stderr, "outbox open failed\n");
+    return 2;
+  }
+  const WS_OutboxPublisher pub = {PubBegin, PubWrite, PubEnd, nullptr};
+
+  uint32_t produced[kStreamCount] = {0, 0, 0};
+  uint32_t stateMissed = 0;     // state intervals skipped while online (live starved)
+  uint32_t torn = 0;
+  uint32_t maxPending = 0;
+  uint32_t drainedAtMs = 0;
+  bool cut = false;
+  const uint32_t dt = 10;
+
+  // Production stops at simS; up to 5 more minutes let the last replay finish.
+  const uint32_t endMs = simS * 1000UL;
+  for (uint32_t now = 0; now <= endMs + 300000UL; now += dt) {
+    if (now > endMs && WS_Outbox_Empty(ob)) {
+      break;
+    }
+    g_broker.now = now;
+    g_broker.Tick(dt);
+    if (!g_broker.connected && g_broker.LinkUp()) {
+      g_broker.connected = true;          // reconnect()
+      WS_Outbox_Resume(ob, now);
+    }
+    const bool online = g_broker.connected;
+
+    for (int s = 0; s < kStreamCount; s++) {
+      Producer& p = prod[s];
+      if (now > endMs || now < p.next_ms) continue;
+      p.next_ms = now + p.period_ms;
+      const std::string msg = MakePayload(s, ++p.seq, now, p.bytes);
+      produced[s]++;
+      if (s == kStreamState) {
+        if (online && !g_broker.Publish(kTopic[s], msg)) stateMissed++;
+        continue;
+      }
+      // MQTT_OutboxRoute(): offline or behind an undrained outbox -> store; a failed live publish too.
+      const bool store = !online || !WS_Outbox_Empty(ob);
+      if (store || !g_broker.Publish(kTopic[s], msg)) {
+        WS_Outbox_Put(ob, kTopic[s], (const uint8_t*)msg.data(), msg.size(), 0);
+      }
+    }
+
+    if (online) {
+      WS_Outbox_Replay(ob, now, pace, pub);
+    }
+    const uint32_t pending = WS_Outbox_PendingBytes(ob);
+    if (pending > maxPending) maxPending = pending;
+    if (pending == 0 && drainedAtMs == 0 && now > 1500000) drainedAtMs = now;
+
+    if (powerCutS > 0 && !cut && now >= powerCutS * 1000UL) {
+      // Power cut in the middle of an append: the record loses its tail, the cursor its
+      // unsaved progress. No Close().
+      cut = true;
+      if (WS_Outbox_Begin(ob, kTopic[kStreamLog], 200, 0)) {
+        const std::string msg = MakePayload(kStreamLog, ++prod[kStreamLog].seq, now, 200);
+        produced[kStreamLog]++;
+        WS_Outbox_Write(ob, (const uint8_t*)msg.data(), msg.size());
+        WS_Outbox_End(ob);
+        char path[48];
+        snprintf(path, sizeof(path), "%s.%u", kBase, (unsigned)ob.ring.head);
+        LittleFS.Truncate(path, 7);
+        torn++;
+      }
+      const WS_OutboxStats before = ob.stats;
+      ob = WS_Outbox();
+      if (!WS_Outbox_Open(ob, kBase, (uint8_t)segments, segBytes)) {
+        fprintf(stderr, "outbox reopen failed\n");
+        return 2;
+      }
+      ob.stats.queued += before.queued;
+      ob.stats.replayed += before.replayed;
+      ob.stats.stalls += before.stalls;
+      ob.stats.lost_segments += before.lost_segments;
+      ob.stats.rejected += before.rejected;
+      ob.stats.corrupt += before.corrupt;
+      WS_Outbox_Resume(ob, now);
+    }
+  }
+
+  const WS_OutboxStats& st = ob.stats;
+  printf("simulated %u s, outbox %u x %u B, pace %u msgs / %u B every %u ms, link %u B/s, window %u B, limit %u msgs/s\n",
+         (unsigned)simS, (unsigned)segments, (unsigned)segBytes, (unsigned)pace.msgs, (unsigned)pace.bytes,
+         (unsigned)pace.tick_ms, (unsigned)g_broker.bandwidth, (unsigned)g_broker.window, (unsigned)g_broker.limit_msgs);
+  printf("%-6s %9s %9s %6s %6s %14s\n", "stream", "produced", "received", "dups", "gaps", "max_latency_s");
+  for (int s = 0; s < kStreamCount; s++) {
+    printf("%-6s %9u %9u %6u %6s %14.1f\n", kStreamName[s], (unsigned)produced[s], (unsigned)g_broker.received[s],
+           (unsigned)g_broker.dups[s], (s == kStreamState) ? "-" : std::to_string(g_broker.gaps[s]).c_str(),
+           g_broker.max_latency_ms[s] / 1000.0);
+  }
+  printf("outbox: queued %u, replayed %u, corrupt %u, lost_segments %u, rejected %u, stalls %u, max pending %u B, pending %u B\n",
+         (unsigned)st.queued, (unsigned)st.replayed, (unsigned)st.corrupt, (unsigned)st.lost_segments,
+         (unsigned)st.rejected, (unsigned)st.stalls, (unsigned)maxPending, (unsigned)WS_Outbox_PendingBytes(ob));
+  printf("broker: limit trips %u, discarded %u; live state publishes that failed while online: %u\n",
+         (unsigned)g_broker.limit_trips, (unsigned)g_broker.discarded, (unsigned)stateMissed);
+  if (drainedAtMs > 0) {
+    printf("backlog of the long outage drained %.1f s after it ended\n", (drainedAtMs - 1500000) / 1000.0);
+  }
+
+  // Every queued record arrives exactly in order; the only loss is the torn one.
+  bool ok = g_broker.limit_trips == 0 && st.lost_segments == 0 && WS_Outbox_Empty(ob);
+  for (int s = kStreamLog; s < kStreamCount; s++) {
+    const uint32_t expectGaps = (s == kStreamLog) ? torn : 0;
+    ok = ok && g_broker.gaps[s] == expectGaps && g_broker.last_seq[s] == prod[s].seq;
+  }
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+// Host test for the lock-free sensor ring (src/WS_SpscRing.h) with a producer and a
+// consumer on two std::threads, like the acquisition task and loop() on the device.
+// Items are sample-sized records whose fields are all derived from a sequence number, so
+// a torn or stale slot shows up as a mismatch. Checks:
+//   - single thread: full ring refuses the push and counts the drop, FIFO order, Size()
+//   - lossless run (producer retries when full): every item arrives once, in order
+//   - lossy run (producer drops when full): arrivals strictly increasing, and the gaps add
+//     up exactly to Dropped()
+// Both threaded runs lap the 16-slot ring many times (slot wraparound); --wrap32 also
+// runs the free-running indices across 2^32 (about 15 s). Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Iscripts/host -Isrc scripts/spsc_ring_test/spsc_ring_test.cpp -lpthread -o spsc_ring_test
+//
+//   ./spsc_ring_test                    # exit code 1 on failure
+//   ./spsc_ring_test --items 5000000 --wrap32
+
+#include "WS_SpscRing.h"
+#include "host_check.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+static const uint32_t kRingLen = 16;  // WS_SENSOR_RING_LEN
+
+// Same size class as WS_SensorSample; every field is a function of seq.
+struct Item {
+  uint32_t seq = 0;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  uint16_t c = 0;
+  int16_t d = 0;
+  uint8_t e[8] = {0};
+};
+
+static Item Make(uint32_t seq)
+{
+  Item it;
+  it.seq = seq;
+  it.a = seq * 2654435761U;
+  it.b = ~seq;
+  it.c = (uint16_t)(seq ^ (seq >> 16));
+  it.d = (int16_t)(0 - (int32_t)(seq & 0x7FFF));
+  for (int i = 0; i < 8; ++i) {
+    it.e[i] = (uint8_t)(seq >> (i * 3));
+  }
+  return it;
+}
+
+static bool Intact(const Item& it)
+{
+  const Item want = Make(it.seq);
+  return memcmp(&it, &want, sizeof(Item)) == 0;
+}
+
+static void TestSingleThread()
+{
+  printf("single thread\n");
+  WS_SpscRing<Item, kRingLen> ring;
+  Item out;
+  CHECK(!ring.Pop(out));
+  CHECK(ring.Size() == 0);
+  for (uint32_t i = 0; i < kRingLen; ++i) {
+    CHECK(ring.Push(Make(i)));
+  }
+  CHECK(ring.Size() == kRingLen);
+  CHECK(!ring.Push(Make(99)));
+  CHECK(!ring.Push(Make(100)));
+  CHECK(ring.Dropped() == 2);
+  CHECK(ring.Size() == kRingLen);
+
+  // Half drain, refill: the second half wraps around the slot array.
+  for (uint32_t i = 0; i < kRingLen / 2; ++i) {
+    CHECK(ring.Pop(out) && out.seq == i && Intact(out));
+  }
+  for (uint32_t i = kRingLen; i < kRingLen + kRingLen / 2; ++i) {
+    CHECK(ring.Push(Make(i)));
+  }
+  CHECK(!ring.Push(Make(0)));
+  CHECK(ring.Dropped() == 3);
+  for (uint32_t i = kRingLen / 2; i < kRingLen + kRingLen / 2; ++i) {
+    CHECK(ring.Pop(out) && out.seq == i && Intact(out));
+  }
+  CHECK(!ring.Pop(out));
+  CHECK(ring.Size() == 0);
+}
+
+struct RunResult {
+  uint32_t received = 0;
+  uint32_t gaps = 0;          // items skipped between consecutive arrivals
+  uint32_t out_of_order = 0;
+  uint32_t torn = 0;
+  uint32_t push_fails = 0;    // seen by the producer
+  uint32_t dropped = 0;       // Dropped() of the ring
+  uint32_t max_size = 0;
+};
+
+// Producer pushes seq 0..items-1; a lossy producer drops on full, a lossless one retries.
+// The consumer drains until it has seen the last item or the producer finished and the ring is empty.
+static RunResult Run(uint32_t items, bool lossy)
+{
+  WS_SpscRing<Item, kRingLen> ring;
+  std::atomic<bool> done{false};
+  RunResult r;
+
+  std::thread producer([&]() {
+    for (uint32_t seq = 0; seq < items; ++seq) {
+      const Item it = Make(seq);
+      while (!ring.Push(it)) {
+        r.push_fails++;
+        if (lossy) {
+          break;
+        }
+        std::this_thread::yield();
+      }
+      if (lossy && (seq % 24U) == 23U) {
+        std::this_thread::yield();  // bursts of 1.5 rings, so some fit and some drop
+      }
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  std::thread consumer([&]() {
+    uint32_t expect = 0;
+    Item out;
+    for (;;) {
+      const uint32_t size = ring.Size();
+      if (size > r.max_size) {
+        r.max_size = size;
+      }
+      if (!ring.Pop(out)) {
+        if (done.load(std::memory_order_acquire) && ring.Size() == 0) {
+          break;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      r.received++;
+      if (!Intact(out)) {
+        r.torn++;
+      }
+      if (out.seq < expect) {
+        r.out_of_order++;
+      } else {
+        r.gaps += out.seq - expect;
+        expect = out.seq + 1;
+      }
+    }
+    // Items dropped after the last arrival are gaps too.
+    r.gaps += items - expect;
+  });
+
+  producer.join();
+  consumer.join();
+  r.dropped = ring.Dropped();
+  return r;
+}
+
+static void Report(const char* name, uint32_t items, const RunResult& r)
+{
+  printf("%s: items=%u received=%u dropped=%u gaps=%u push_fails=%u max_size=%u laps=%u\n", name,
+         (unsigned)items, (unsigned)r.received, (unsigned)r.dropped, (unsigned)r.gaps,
+         (unsigned)r.push_fails, (unsigned)r.max_size, (unsigned)(items / kRingLen));
+}
+
+static void TestThreads(uint32_t items)
+{
+  RunResult r = Run(items, false);
+  Report("lossless", items, r);
+  CHECK(r.received == items);
+  CHECK(r.gaps == 0);
+  CHECK(r.out_of_order == 0);
+  CHECK(r.torn == 0);
+  CHECK(r.dropped == r.push_fails);
+  CHECK(r.max_size <= kRingLen);
+
+  r = Run(items, true);
+  Report("lossy", items, r);
+  CHECK(r.out_of_order == 0);
+  CHECK(r.torn == 0);
+  CHECK(r.dropped == r.push_fails);
+  CHECK(r.gaps == r.dropped);
+  CHECK(r.received + r.dropped == items);
+  CHECK(r.max_size <= kRingLen);
+}
+
+// Run head/tail through 2^32: the full test (head - tail >= N) must keep working after the
+// free-running indices wrap. Single thread, so the ring alternates between full and half full.
+static void TestWrap32()
+{
+  printf("wrap32\n");
+  WS_SpscRing<uint32_t, kRingLen> ring;
+  uint32_t pushed = 0;
+  uint32_t popped = 0;
+  uint32_t bad = 0;
+  uint32_t v = 0;
+  const uint64_t total = (1ULL << 32) + 3 * kRingLen;
+  for (uint64_t n = 0; n < total; n += kRingLen / 2) {
+    while (ring.Push(pushed)) {
+      pushed++;
+    }
+    for (uint32_t i = 0; i < kRingLen / 2; ++i) {
+      if (!ring.Pop(v) || v != popped) {
+        bad++;
+      }
+      popped++;
+    }
+  }
+  printf("wrap32: pushed=%u (wrapped) size=%u dropped=%u\n", (unsigned)pushed, (unsigned)ring.Size(),
+         (unsigned)ring.Dropped());
+  CHECK(bad == 0);
+  CHECK(ring.Size() == kRingLen / 2);
+  CHECK(pushed - popped == kRingLen / 2);
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t items = 2000000;
+  bool wrap32 = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--items") == 0 && i + 1 < argc) {
+      items = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--wrap32") == 0) {
+      wrap32 = true;
+    } else {
+      fprintf(stderr, "usage: %s [--items N] [--wrap32]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  TestSingleThread();
+  TestThreads(items);
+  if (wrap32) {
+    TestWrap32();
+  }
+
+  return CheckSummary();
+}
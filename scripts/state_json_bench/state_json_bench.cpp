@@ -0,0 +1,310 @@
+// Host benchmark for the schema-driven state JSON writer (src/WS_StateJson.cpp) against
+// the snprintf formatter it replaced (copied below as the reference). For a few state
+// inputs (2 and 8 sensors, strings that need escaping) it checks that both produce the
+// same bytes, that streaming through a sink in 64-byte pieces gives the same text, and
+// compares time per build and peak stack use (measured on a painted thread stack).
+// Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -Isrc scripts/state_json_bench/state_json_bench.cpp src/WS_StateJson.cpp src/WS_JsonWriter.cpp -lpthread -o state_json_bench
+//
+//   ./state_json_bench --iters 20000
+
+#include "WS_StateJson.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+static uint64_t NowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// ---------------- reference: the former MQTT_BuildStateJson() ----------------
+static void WS_JsonEscape(const char* in, char* out, size_t outSize)
+{
+  if (out == nullptr || outSize == 0) {
+    return;
+  }
+  out[0] = '\0';
+  if (in == nullptr) {
+    return;
+  }
+  size_t w = 0;
+  for (size_t i = 0; in[i] != '\0' && (w + 1) < outSize; i++) {
+    const char c = in[i];
+    if (c == '\\' || c == '"') {
+      if ((w + 2) >= outSize) {
+        break;
+      }
+      out[w++] = '\\';
+      out[w++] = c;
+      continue;
+    }
+    if ((unsigned char)c < 0x20) {
+      out[w++] = ' ';
+      continue;
+    }
+    out[w++] = c;
+  }
+  out[w] = '\0';
+}
+
+static size_t Reference(const WS_StateInputs& in, char* json, size_t jsonSize)
+{
+  char ssidEsc[80];
+  WS_JsonEscape(in.net.ssid, ssidEsc, sizeof(ssidEsc));
+  char ipEsc[24];
+  WS_JsonEscape(in.net.ip, ipEsc, sizeof(ipEsc));
+  char reasonEsc[192];
+  WS_JsonEscape(in.ctrl.reason, reasonEsc, sizeof(reasonEsc));
+  char alarmEsc[256];
+  WS_JsonEscape(in.alarm.text, alarmEsc, sizeof(alarmEsc));
+  char fwCurEsc[64];
+  WS_JsonEscape(in.fw.current, fwCurEsc, sizeof(fwCurEsc));
+  char fwLatestEsc[64];
+  WS_JsonEscape(in.fw.latest, fwLatestEsc, sizeof(fwLatestEsc));
+  char fwLastCheckEsc[64];
+  WS_JsonEscape(in.fw.last_check, fwLastCheckEsc, sizeof(fwLastCheckEsc));
+  char fwLastResultEsc[160];
+  WS_JsonEscape(in.fw.last_result, fwLastResultEsc, sizeof(fwLastResultEsc));
+
+  char sensorJson[2][112];
+  for (uint8_t i = 0; i < 2; i++) {
+    WS_StateSensor empty;
+    memset(&empty, 0, sizeof(empty));
+    const WS_StateSensor& si = (i < in.sensor_count) ? in.sensors[i] : empty;
+    snprintf(sensorJson[i], sizeof(sensorJson[i]),
+             "{\"mm\":%u,\"filt_mm\":%u,\"valid\":%s,\"online\":%s,\"temp_x10\":%d,\"temp_valid\":%s}",
+             (unsigned)si.mm, (unsigned)si.filt_mm, si.valid ? "true" : "false", si.online ? "true" : "false",
+             (int)si.temp_x10, si.temp_valid ? "true" : "false");
+  }
+  static char sensorsJson[WS_STATE_SENSOR_MAX * 288 + 4];   // static in the firmware as well
+  {
+    size_t w = 0;
+    sensorsJson[w++] = '[';
+    for (uint8_t i = 0; i < in.sensor_count; i++) {
+      const WS_StateSensor& si = in.sensors[i];
+      const int n = snprintf(sensorsJson + w, sizeof(sensorsJson) - w,
+                             "%s{\"id\":%u,\"mm\":%u,\"filt_mm\":%u,\"valid\":%s,\"online\":%s,\"temp_x10\":%d,\"temp_valid\":%s,\"q\":%u,\"poll_ms\":%lu}",
+                             (i > 0) ? "," : "", (unsigned)si.id, (unsigned)si.mm, (unsigned)si.filt_mm,
+                             si.valid ? "true" : "false", si.online ? "true" : "false", (int)si.temp_x10,
+                             si.temp_valid ? "true" : "false", (unsigned)si.q, (unsigned long)si.poll_ms);
+      if (n < 0 || (size_t)n >= sizeof(sensorsJson) - w - 1) break;
+      w += (size_t)n;
+    }
+    sensorsJson[w++] = ']';
+    sensorsJson[w] = '\0';
+  }
+
+  const int n = snprintf(
+    json, jsonSize,
+    "{\"sensor1\":%s,\"sensor2\":%s,\"sensors\":%s,\"gate_state\":%u,\"gate_position_open\":%s,\"auto_gate\":%s,\"auto_latched\":%s,\"manual\":{\"active\":%s,\"remain_s\":%lu,\"total_s\":%lu},\"relay1\":%u,\"relay2\":%u,\"net\":{\"wifi\":%s,\"mqtt\":%s,\"http\":%s,\"ip\":\"%s\",\"rssi\":%d,\"ssid\":\"%s\",\"mqtt_rtt_ms\":%lu,\"cmd_rtt_ms\":%lu},\"cell\":{\"enabled\":%s,\"online\":%s,\"sim_ready\":%s,\"attached\":%s,\"csq\":%d,\"rssi_dbm\":%d,\"last_rx_age_s\":%lu},\"ctrl\":{\"open_allowed\":%s,\"close_allowed\":%s,\"cooldown_remain_s\":%lu,\"min_interval_s\":%u,\"action_s\":%u,\"reason\":\"%s\"},\"alarm\":{\"active\":%s,\"severity\":%u,\"text\":\"%s\"},\"fw\":{\"current\":\"%s\",\"latest\":\"%s\",\"last_check\":\"%s\",\"last_result\":\"%s\"}}",
+    sensorJson[0], sensorJson[1], sensorsJson, in.gate_state, in.gate_position_open ? "true" : "false",
+    in.auto_gate ? "true" : "false", in.auto_latched ? "true" : "false", in.manual.active ? "true" : "false",
+    (unsigned long)in.manual.remain_s, (unsigned long)in.manual.total_s, in.relay1, in.relay2,
+    in.net.wifi ? "true" : "false", in.net.mqtt ? "true" : "false", in.net.http ? "true" : "false", ipEsc,
+    (int)in.net.rssi, ssidEsc, (unsigned long)in.net.mqtt_rtt_ms, (unsigned long)in.net.cmd_rtt_ms,
+    in.cell.enabled ? "true" : "false", in.cell.online ? "true" : "false",
+    in.cell.sim_ready ? "true" : "false", in.cell.attached ? "true" : "false", (int)in.cell.csq,
+    (int)in.cell.rssi_dbm, (unsigned long)in.cell.last_rx_age_s, in.ctrl.open_allowed ? "true" : "false",
+    in.ctrl.close_allowed ? "true" : "false", (unsigned long)in.ctrl.cooldown_remain_s,
+    (unsigned)in.ctrl.min_interval_s, (unsigned)in.ctrl.action_s, reasonEsc, in.alarm.active ? "true" : "false",
+    in.alarm.severity, alarmEsc, fwCurEsc, fwLatestEsc, fwLastCheckEsc, fwLastResultEsc);
+  if (n < 0 || (size_t)n >= jsonSize) {
+    return (size_t)snprintf(json, jsonSize, "{\"ok\":false,\"error\":\"telemetry_json_overflow\"}");
+  }
+  return (size_t)n;
+}
+
+// ---------------- inputs ----------------
+static void Copy(char* dst, size_t n, const char* src)
+{
+  strncpy(dst, src, n - 1);
+}
+
+static void MakeInputs(WS_StateInputs& in, unsigned sensors, bool awkward, unsigned long i)
+{
+  memset(&in, 0, sizeof(in));
+  in.sensor_count = (uint8_t)sensors;
+  for (unsigned k = 0; k < sensors; k++) {
+    WS_StateSensor& s = in.sensors[k];
+    s.id = (uint8_t)(k + 1);
+    s.valid = true;
+    s.online = (k != 3);
+    s.temp_valid = true;
+    s.mm = (uint16_t)(1200 + k * 300 + i % 50);
+    s.filt_mm = (uint16_t)(1200 + k * 300 + i % 40);
+    s.temp_x10 = (int16_t)(k == 5 ? -35 : 215 + (int)(i % 9));
+    s.q = 100;
+    s.poll_ms = 2000;
+  }
+  in.gate_state = (uint8_t)(i % 3);
+  in.auto_gate = true;
+  in.net.wifi = true;
+  in.net.mqtt = true;
+  in.net.http = true;
+  Copy(in.net.ip, sizeof(in.net.ip), "192.168.1.57");
+  in.net.rssi = -61 - (int)(i % 5);
+  Copy(in.net.ssid, sizeof(in.net.ssid), awkward ? "pond \"north\"\\2\t" : "fish-pond");
+  in.net.mqtt_rtt_ms = 85 + (uint32_t)(i % 13);
+  in.net.cmd_rtt_ms = awkward ? 4294967295UL : 120;
+  in.cell.csq = 99;
+  in.cell.rssi_dbm = -113;
+  in.ctrl.open_allowed = true;
+  in.ctrl.min_interval_s = 15;
+  in.ctrl.action_s = 10;
+  Copy(in.ctrl.reason, sizeof(in.ctrl.reason), "inner level below outer by 75 mm");
+  in.alarm.active = awkward;
+  in.alarm.severity = awkward ? 2 : 0;
+  Copy(in.alarm.text, sizeof(in.alarm.text), awkward ? "sensor 4 offline\r\nlast \"ok\" 120 s ago" : "");
+  Copy(in.fw.current, sizeof(in.fw.current), "v1.4.2");
+  Copy(in.fw.latest, sizeof(in.fw.latest), "v1.4.2");
+  Copy(in.fw.last_check, sizeof(in.fw.last_check), "86400s");
+  Copy(in.fw.last_result, sizeof(in.fw.last_result), "up to date");
+}
+
+// ---------------- stack measurement ----------------
+static const size_t kStackSize = 64 * 1024;
+static const uint8_t kPaint = 0xA5;
+
+struct StackRun {
+  size_t (*fn)(const WS_StateInputs&, char*, size_t);
+  const WS_StateInputs* in;
+  char* out;
+  size_t cap;
+};
+
+static void* StackThread(void* arg)
+{
+  StackRun* r = static_cast<StackRun*>(arg);
+  r->fn(*r->in, r->out, r->cap);
+  return nullptr;
+}
+
+// Peak stack bytes used by fn (the thread start-up frames included; same for both).
+static size_t MeasureStack(size_t (*fn)(const WS_StateInputs&, char*, size_t), const WS_StateInputs& in)
+{
+  static uint8_t stack[kStackSize] __attribute__((aligned(64)));
+  static char out[WS_STATE_JSON_MAX];
+  memset(stack, kPaint, sizeof(stack));
+  StackRun r = {fn, &in, out, sizeof(out)};
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, stack, sizeof(stack));
+  pthread_t t;
+  if (pthread_create(&t, &attr, StackThread, &r) != 0) {
+    return 0;
+  }
+  pthread_join(t, nullptr);
+  pthread_attr_destroy(&attr);
+  size_t low = 0;
+  while (low < sizeof(stack) && stack[low] == kPaint) {
+    low++;
+  }
+  return sizeof(stack) - low;
+}
+
+static size_t Empty(const WS_StateInputs&, char*, size_t)
+{
+  return 0;
+}
+
+// ---------------- streaming check ----------------
+static void AppendSink(void* ctx, const char* data, size_t len)
+{
+  std::vector<std::string>* parts = static_cast<std::vector<std::string>*>(ctx);
+  parts->push_back(std::string(data, len));
+}
+
+static bool StreamMatches(const WS_StateInputs& in, const char* expect, size_t n, size_t& chunks)
+{
+  std::vector<std::string> parts;
+  WS_JsonWriter w(AppendSink, &parts);
+  const size_t written = WS_StateJson_Write(w, in);
+  w.Flush();
+  std::string all;
+  for (size_t i = 0; i < parts.size(); i++) {
+    all += parts[i];
+  }
+  chunks = parts.size();
+  return written == n && all.size() == n && memcmp(all.data(), expect, n) == 0;
+}
+
+struct Case {
+  const char* name;
+  unsigned sensors;
+  bool awkward;
+};
+
+int main(int argc, char** argv)
+{
+  unsigned long iters = 20000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+      iters = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--iters N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (iters == 0) {
+    iters = 1;
+  }
+
+  const Case cases[] = {
+    {"2 sensors", 2, false},
+    {"8 sensors", 8, false},
+    {"8 sensors, escapes", 8, true},
+    {"no sensors", 0, false},
+  };
+
+  printf("schema bound: %u bytes (buffer %u)\n", (unsigned)WS_StateJson_MaxLen, (unsigned)WS_STATE_JSON_MAX);
+  static WS_StateInputs in;
+  const size_t baseStack = MeasureStack(Empty, in);
+  printf("%-20s %6s %10s %10s %11s %11s %7s %s\n", "inputs", "bytes", "printf_ns", "schema_ns", "printf_stk", "schema_stk",
+         "chunks", "same");
+  bool ok = true;
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    static char a[WS_STATE_JSON_MAX];
+    static char b[WS_STATE_JSON_MAX];
+    MakeInputs(in, cases[c].sensors, cases[c].awkward, 0);
+    const size_t na = Reference(in, a, sizeof(a));
+    const size_t nb = WS_StateJson_Build(in, b, sizeof(b));
+    bool same = (na == nb && memcmp(a, b, na) == 0);
+    if (!same) {
+      fprintf(stderr, "%s: output differs\n  printf: %s\n  schema: %s\n", cases[c].name, a, b);
+    }
+    size_t chunks = 0;
+    same = StreamMatches(in, b, nb, chunks) && same;
+    ok = ok && same;
+
+    const size_t stkA = MeasureStack(Reference, in) - baseStack;
+    const size_t stkB = MeasureStack(WS_StateJson_Build, in) - baseStack;
+
+    uint64_t tA = 0;
+    uint64_t tB = 0;
+    volatile size_t sink = 0;
+    for (unsigned long i = 0; i < iters; i++) {
+      MakeInputs(in, cases[c].sensors, cases[c].awkward, i);
+      const uint64_t t0 = NowNs();
+      sink = sink + Reference(in, a, sizeof(a));
+      const uint64_t t1 = NowNs();
+      sink = sink + WS_StateJson_Build(in, b, sizeof(b));
+      const uint64_t t2 = NowNs();
+      tA += t1 - t0;
+      tB += t2 - t1;
+    }
+    (void)sink;
+    printf("%-20s %6u %10.0f %10.0f %11u %11u %7u %s\n", cases[c].name, (unsigned)nb, (double)tA / (double)iters,
+           (double)tB / (double)iters, (unsigned)stkA, (unsigned)stkB, (unsigned)chunks, same ? "ok" : "FAIL");
+  }
+  return ok ? 0 : 1;
+}
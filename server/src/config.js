@@ -26,6 +26,11 @@ const schema = z.object({
   MQTT_TELEMETRY_SUB: z.string().min(1).default('+/device/telemetry'),
   MQTT_REPLY_SUB: z.string().min(1).default('+/device/reply'),
   MQTT_LOG_SUB: z.string().min(1).default('+/device/log/#'),
+  MQTT_ENCODING: z.enum(['json', 'msgpack']).default('json'),
+  MQTT_TELEMETRY_MP_SUB: z.string().min(1).default('+/device/telemetry/mp'),
+  MQTT_REPLY_MP_SUB: z.string().min(1).default('+/device/reply/mp'),
+  MQTT_TELEMETRY_BATCH_SUB: z.string().min(1).default('+/device/telemetry/batch'),
+  MQTT_STATUS_SUB: z.string().min(1).default('+/device/status'),
   DEFAULT_DEVICE_ID: z.string().min(1).default('fish1'),
 
   DATA_RETENTION_DAYS: z.coerce.number().int().min(1).max(3650).default(30),
@@ -149,6 +149,18 @@ async function insertTelemetry(pool, deviceId, receivedAt, payload, mqttTopic) {
   );
 }
 
+// rows: [{ ts:number(ms), payload:object }], one statement for the whole batch.
+async function insertTelemetryRows(pool, deviceId, rows, mqttTopic) {
+  if (!rows || !rows.length) return;
+  const recs = rows.map((r) => ({ ts: new Date(r.ts).toISOString(), payload: r.payload || {} }));
+  await pool.query(
+    `INSERT INTO telemetry(device_id, ts, payload, mqtt_topic)
+     SELECT $1, x.ts, x.payload, $2
+     FROM jsonb_to_recordset($3::jsonb) AS x(ts timestamptz, payload jsonb)`,
+    [deviceId, mqttTopic || '', JSON.stringify(recs)]
+  );
+}
+
 async function getLatestTelemetry(pool, deviceId) {
   const r = await pool.query(
     `SELECT ts, payload
@@ -214,6 +226,7 @@ module.exports = {
   upsertDeviceSeen,
   listDevices,
   insertTelemetry,
+  insertTelemetryRows,
   getLatestTelemetry,
   cleanupTelemetry,
   countTelemetry,
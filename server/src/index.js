@@ -24,13 +24,17 @@ const {
   upsertDeviceSeen,
   listDevices,
   insertTelemetry,
+  insertTelemetryRows,
   getLatestTelemetry,
   cleanupTelemetry,
   countTelemetry,
   queryHistoryDownsampled
 } = require('./db');
-const { createMqttClient } = require('./mqtt');
+const { createMqttClient, isMsgPackTopic } = require('./mqtt');
 const { LogCache } = require('./log_cache');
+const { decodeMeasureLog } = require('./meas_codec');
+const { TelemetryAssembler } = require('./telemetry_delta');
+const { BatchExpander } = require('./telemetry_batch');
 const {
   hashPassword,
   verifyPassword,
@@ -109,19 +113,72 @@ async function main() {
   const latest = new Map(); // deviceId -> {receivedAt:number, payload:object}
   const logCache = new LogCache({ maxBytes: cfg.LOG_CACHE_MAX_BYTES });
   const configCache = new Map(); // deviceId -> { raw:string, updatedAt:number }
+  const teleAsm = new TelemetryAssembler();
+  const batchExp = new BatchExpander();
+  const encNegotiation = new Map(); // deviceId -> next attempt (ms)
+  const deviceStatus = new Map(); // deviceId -> { online, at, boot, fw } (birth / Last Will)
+
+  // A device sending another encoding than MQTT_ENCODING is asked to switch (cmd
+  // set_encoding). It answers before switching, then sends a keyframe on the new topic.
+  // Firmware without MessagePack support times out or refuses: retry rarely then.
+  // Devices fall back to JSON on reboot, so this runs again after one.
+  function negotiateEncoding(deviceId, current, now) {
+    if (current === cfg.MQTT_ENCODING) return;
+    if ((encNegotiation.get(deviceId) || 0) > now) return;
+    encNegotiation.set(deviceId, now + 60 * 1000);
+    mqtt.rpc(deviceId, { cmd: 'set_encoding', enc: cfg.MQTT_ENCODING }, { timeoutMs: 8000 }).catch(() => {
+      encNegotiation.set(deviceId, Date.now() + 30 * 60 * 1000);
+    });
+  }
 
   const mqtt = createMqttClient(cfg, {
     onTelemetry: async ({ deviceId, topic, payload, receivedAt }) => {
       try {
         if (!deviceId) return;
-        latest.set(deviceId, { receivedAt, payload: payload || {} });
         await upsertDeviceSeen(pool, deviceId, new Date(receivedAt));
-        await insertTelemetry(pool, deviceId, receivedAt, payload, topic);
+        // Delta telemetry: store the merged full state; on a seq gap ask for a keyframe.
+        const r = teleAsm.push(deviceId, payload, receivedAt);
+        if (r.needKeyframe) {
+          mqtt.publishMessage(deviceId, { cmd: 'keyframe' }).catch(() => {});
+        }
+        if (r.full) {
+          negotiateEncoding(deviceId, isMsgPackTopic(topic) ? 'msgpack' : 'json', receivedAt);
+        }
+        if (!r.state) return;
+        latest.set(deviceId, { receivedAt, payload: r.state });
+        await insertTelemetry(pool, deviceId, receivedAt, r.state, topic);
       } catch (e) {
         // eslint-disable-next-line no-console
         console.error('[mqtt] store failed:', e && e.message ? e.message : e);
       }
     },
+    onTelemetryBatch: async ({ deviceId, topic, payload, receivedAt }) => {
+      try {
+        if (!deviceId) return;
+        await upsertDeviceSeen(pool, deviceId, new Date(receivedAt));
+        // One row per sample at the device's sample time (the replay page reads these);
+        // the live state keeps coming from the full-state stream.
+        const cur = latest.get(deviceId);
+        const r = batchExp.expand(deviceId, payload, receivedAt, cur ? cur.payload : null);
+        await insertTelemetryRows(pool, deviceId, r.rows, topic);
+        if (r.dropped > 0) {
+          // eslint-disable-next-line no-console
+          console.warn('[mqtt] batch from', deviceId, 'reports', r.dropped, 'dropped samples');
+        }
+      } catch (e) {
+        // eslint-disable-next-line no-console
+        console.error('[mqtt] batch store failed:', e && e.message ? e.message : e);
+      }
+    },
+    onStatus: ({ deviceId, payload, receivedAt }) => {
+      if (!deviceId || !payload || typeof payload !== 'object') return;
+      deviceStatus.set(deviceId, {
+        online: !!payload.online,
+        at: receivedAt,
+        boot: payload.boot,
+        fw: payload.fw
+      });
+    },
     onLog: ({ deviceId, name, text }) => {
       try {
         if (!deviceId) return;
@@ -277,6 +334,7 @@ async function main() {
     res.setHeader('Cache-Control', 'no-store');
     res.json({
       mqtt_connected: !!mqtt.state.connected,
+      device_online: deviceStatus.has(deviceId) ? deviceStatus.get(deviceId).online : null,
       last_telemetry_at: lastAt || 0,
       device_id: deviceId,
       telemetry: tele || {}
@@ -388,7 +446,10 @@ async function main() {
 
   // --- Devices ---
   app.get('/api/devices', requireAuthApi, async (req, res) => {
-    const list = await listDevices(pool);
+    const list = (await listDevices(pool)).map((d) => {
+      const st = deviceStatus.get(d.device_id);
+      return { ...d, online: st ? st.online : null, status_at: st ? st.at : null };
+    });
     res.setHeader('Cache-Control', 'no-store');
     res.json({ ok: true, devices: list });
   });
@@ -471,8 +532,8 @@ async function main() {
         return res.status(503).type('text/plain').send('cache_miss');
       }
 
-      const rep = await mqtt.rpc(deviceId, { cmd: 'get_config' }, { timeoutMs: 8000 });
-      const raw = (rep && typeof rep.raw === 'string') ? rep.raw : '';
+      const got = await mqtt.rpcChunked(deviceId, { cmd: 'get_config', offset: 0 }, { timeoutMs: 30_000 });
+      const raw = got.legacy ? ((typeof got.legacy.raw === 'string') ? got.legacy.raw : '') : got.data.toString('utf8');
       if (!raw) return res.status(502).type('text/plain').send('empty_config');
       try { configCache.set(deviceId, { raw, updatedAt: Date.now() }); } catch (e2) {}
       res.setHeader('Cache-Control', 'no-store');
@@ -517,12 +578,55 @@ async function main() {
     }
   });
 
+  // Last ~tail bytes of a device log as text, fetched in CRC-checked chunks (resumable;
+  // no device-side reply size limit). The measure log arrives as binary blocks.
+  async function fetchLogTail(deviceId, name, tail, bak) {
+    if (bak) {
+      const rep = await mqtt.rpc(deviceId, { cmd: 'get_log', name, tail, bak: 1 }, { timeoutMs: 10_000 });
+      return (rep && typeof rep.text === 'string') ? rep.text : '';
+    }
+    const got = await mqtt.rpcChunked(deviceId, { cmd: 'get_log', name, tail, offset: -1 }, { timeoutMs: 60_000 });
+    if (got.legacy) return (typeof got.legacy.text === 'string') ? got.legacy.text : '';
+    if (name === 'measure') {
+      const text = decodeMeasureLog(got.data);
+      if (!tail || text.length <= tail) return text;
+      const nl = text.indexOf('\n', text.length - tail);
+      return (nl >= 0) ? text.slice(nl + 1) : '';
+    }
+    const text = got.data.toString('utf8');
+    if (got.start <= 0) return text;
+    // Started mid-line: drop the partial first line.
+    const nl = text.indexOf('\n');
+    return (nl >= 0) ? text.slice(nl + 1) : '';
+  }
+
   app.get('/api/log', requireAuthApi, async (req, res) => {
     const deviceId = pickDeviceId(req);
     const name = String((req.query && req.query.name) || 'error').toLowerCase();
     const tail = clampInt(req.query && req.query.tail, 0, 32768, 16384);
     const bak = !!(req.query && (String(req.query.bak || '') === '1'));
     const source = String((req.query && req.query.source) || '').toLowerCase(); // '', 'cache', 'rpc'
+    const q = req.query || {};
+    if (q.from !== undefined || q.to !== undefined || q.tag !== undefined) {
+      // Time/tag query: always answered by the device (it seeks via its log index).
+      try {
+        const args = { cmd: 'get_log', name, tail };
+        for (const k of ['from', 'to', 'tag']) {
+          if (q[k] === undefined) continue;
+          const v = String(q[k]);
+          args[k] = (k !== 'tag' && /^\d+$/.test(v)) ? Number(v) : v;
+        }
+        const rep = await mqtt.rpc(deviceId, args, { timeoutMs: 15_000 });
+        res.setHeader('Cache-Control', 'no-store');
+        res.setHeader('X-Log-Source', 'rpc');
+        res.setHeader('X-Log-Truncated', (rep && rep.truncated) ? '1' : '0');
+        return res.type('text/plain; charset=utf-8').send((rep && typeof rep.text === 'string') ? rep.text : '');
+      } catch (e) {
+        const msg = (e && e.message) ? String(e.message) : 'rpc_failed';
+        const code = (msg === 'timeout') ? 504 : ((msg === 'mqtt_not_connected') ? 502 : 500);
+        return res.status(code).type('text/plain').send(msg);
+      }
+    }
     try {
       // Prefer pushed cache for speed/reliability. bak isn't meaningful for push-cache, so only use cache when bak=0.
       if (!bak && source !== 'rpc' && logCache.has(deviceId, name)) {
@@ -538,8 +642,7 @@ async function main() {
         return res.status(503).type('text/plain; charset=utf-8').send('cache_miss');
       }
 
-      const rep = await mqtt.rpc(deviceId, { cmd: 'get_log', name, tail, bak: bak ? 1 : 0 }, { timeoutMs: 10_000 });
-      const text = (rep && typeof rep.text === 'string') ? rep.text : '';
+      const text = await fetchLogTail(deviceId, name, tail, bak);
       res.setHeader('Cache-Control', 'no-store');
       res.setHeader('X-Log-Source', 'rpc');
       res.type('text/plain; charset=utf-8').send(text);
@@ -595,8 +698,7 @@ async function main() {
         return res.status(503).type('text/plain; charset=utf-8').send('cache_miss');
       }
 
-      const rep = await mqtt.rpc(deviceId, { cmd: 'get_log', name, tail, bak: bak ? 1 : 0 }, { timeoutMs: 10_000 });
-      const text = (rep && typeof rep.text === 'string') ? rep.text : '';
+      const text = await fetchLogTail(deviceId, name, tail, bak);
       const filename = `log_${name}${bak ? '_1' : ''}.txt`;
       res.setHeader('Cache-Control', 'no-store');
       res.setHeader('X-Log-Source', 'rpc');
@@ -0,0 +1,107 @@
+// Decoder for the device's binary measurement log (firmware: src/WS_MeasCodec.cpp).
+// Input: raw log bytes as sent by chunked get_log (whole 512-byte blocks, zero padded).
+// Output: the same text lines the device produces for /api/log?name=measure.
+
+const BLOCK_BYTES = 512;
+const HEADER_BYTES = 12;
+const MAX_SENSORS = 8;
+const VERSION = 1;
+
+function readVarint(b, st, end) {
+  let v = 0;
+  for (let shift = 0; shift < 35; shift += 7) {
+    if (st.pos >= end) return null;
+    const x = b[st.pos++];
+    v += (x & 0x7f) * Math.pow(2, shift);
+    if ((x & 0x80) === 0) return v >>> 0;
+  }
+  return null;
+}
+
+function unZigZag(v) {
+  return (v >>> 1) ^ -(v & 1);
+}
+
+function pad2(n) {
+  return (n < 10 ? '0' : '') + n;
+}
+
+function formatLine(r) {
+  let ts;
+  if (r.epoch) {
+    // Device epoch is local time already (NTP offset applied): format as UTC.
+    const d = new Date(r.t * 1000);
+    ts = d.getUTCFullYear() + '-' + pad2(d.getUTCMonth() + 1) + '-' + pad2(d.getUTCDate()) + ' ' +
+      pad2(d.getUTCHours()) + ':' + pad2(d.getUTCMinutes()) + ':' + pad2(d.getUTCSeconds());
+  } else {
+    ts = 'ms=' + (Math.imul(r.t, 1000) >>> 0);
+  }
+  const lv = (i) => (r.count > i ? r.level[i] : 0);
+  const tp = (i) => (r.count > i ? r.temp[i] : 0);
+  const bit = (m, i) => ((m >>> i) & 1);
+  let s = `${ts} [MEAS] inner_mm=${lv(0)} outer_mm=${lv(1)} t1_x10=${tp(0)} t2_x10=${tp(1)}` +
+    ` online1=${bit(r.online, 0)} online2=${bit(r.online, 1)} valid1=${bit(r.valid, 0)} valid2=${bit(r.valid, 1)}`;
+  for (let i = 2; i < r.count; i++) {
+    s += ` s${i + 1}_mm=${r.level[i]} s${i + 1}_online=${bit(r.online, i)}`;
+  }
+  return s + '\r\n';
+}
+
+function decodeBlock(b, start, out) {
+  const end = Math.min(b.length, start + BLOCK_BYTES);
+  if (end - start < HEADER_BYTES) return;
+  if (b[start] !== 0x4d || b[start + 1] !== 0x4c || b[start + 2] !== VERSION || b[start + 3] > MAX_SENSORS) return;
+  const count = b[start + 3];
+  const r = {
+    t: b.readUInt32LE(start + 4),
+    epoch: (b[start + 8] & 1) !== 0,
+    count,
+    online: 0,
+    valid: 0,
+    level: new Array(count).fill(0),
+    temp: new Array(count).fill(0)
+  };
+  const st = { pos: start + HEADER_BYTES };
+  let first = true;
+  while (st.pos < end) {
+    const tag = b[st.pos];
+    if ((tag & 0x80) === 0) break; // padding
+    st.pos++;
+    const dt = readVarint(b, st, end);
+    if (dt === null) break;
+    if (tag & 0x01) {
+      if (st.pos + 2 > end) break;
+      r.online = b[st.pos++];
+      r.valid = b[st.pos++];
+    } else if (first) {
+      break; // a keyframe always carries the masks
+    }
+    let ok = true;
+    for (let i = 0; i < count && ok; i++) {
+      const dl = readVarint(b, st, end);
+      const dtp = (dl === null) ? null : readVarint(b, st, end);
+      if (dl === null || dtp === null) {
+        ok = false;
+        break;
+      }
+      r.level[i] = (r.level[i] + unZigZag(dl)) & 0xffff;
+      r.temp[i] = ((r.temp[i] + unZigZag(dtp)) << 16) >> 16;
+    }
+    if (!ok) break;
+    r.t = (r.t + dt) >>> 0;
+    first = false;
+    out.push(formatLine(r));
+  }
+}
+
+// Buffer of whole blocks -> text.
+function decodeMeasureLog(buf) {
+  const b = Buffer.isBuffer(buf) ? buf : Buffer.from(buf || []);
+  const out = [];
+  for (let off = 0; off + HEADER_BYTES <= b.length; off += BLOCK_BYTES) {
+    decodeBlock(b, off, out);
+  }
+  return out.join('');
+}
+
+module.exports = { decodeMeasureLog, MEAS_BLOCK_BYTES: BLOCK_BYTES };
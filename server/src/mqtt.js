@@ -1,8 +1,9 @@
 const mqtt = require('mqtt');
+const { decodeMsgPack } = require('./msgpack');
 
 function inferDeviceIdFromTopic(topic) {
   const t = String(topic || '');
-  const m = /^([^/]+)\/device\/(?:telemetry|reply|log)(?:\/.*)?$/.exec(t);
+  const m = /^([^/]+)\/device\/(?:telemetry|reply|log|status)(?:\/.*)?$/.exec(t);
   if (m && m[1]) return m[1];
   // Fallback: "fish1/device/telemetry" -> first segment still works even if suffix differs.
   const parts = t.split('/').filter(Boolean);
@@ -15,9 +16,26 @@ function isReplyTopic(topic) {
   return /\/device\/reply(?:\/.*)?$/.test(t);
 }
 
+// Full-state stream only: "<id>/device/telemetry" and its "/mp" variant. Group topics
+// ("/sensors", "/net", ...) and batches have their own shapes.
 function isTelemetryTopic(topic) {
   const t = String(topic || '');
-  return /\/device\/telemetry(?:\/.*)?$/.test(t);
+  return /\/device\/telemetry(?:\/mp)?$/.test(t);
+}
+
+function isBatchTopic(topic) {
+  return /\/device\/telemetry\/batch$/.test(String(topic || ''));
+}
+
+// MessagePack variants of telemetry / reply topics: "<topic>/mp".
+function isMsgPackTopic(topic) {
+  return /\/mp$/.test(String(topic || ''));
+}
+
+// Retained birth / Last Will: {"online":true,...} after each connect, {"online":false}
+// published by the broker when the device's link dies.
+function isStatusTopic(topic) {
+  return /\/device\/status$/.test(String(topic || ''));
 }
 
 function isLogTopic(topic) {
@@ -33,6 +51,22 @@ function inferLogNameFromTopic(topic) {
   return 'error';
 }
 
+let crcTable = null;
+
+function crc32(buf) {
+  if (!crcTable) {
+    crcTable = new Uint32Array(256);
+    for (let n = 0; n < 256; n++) {
+      let c = n;
+      for (let k = 0; k < 8; k++) c = (c & 1) ? (0xedb88320 ^ (c >>> 1)) : (c >>> 1);
+      crcTable[n] = c >>> 0;
+    }
+  }
+  let crc = 0xffffffff;
+  for (let i = 0; i < buf.length; i++) crc = crcTable[(crc ^ buf[i]) & 0xff] ^ (crc >>> 8);
+  return (crc ^ 0xffffffff) >>> 0;
+}
+
 function makeReqId() {
   // Simple, collision-resistant enough for in-process correlation.
   return Date.now().toString(36) + '-' + Math.random().toString(36).slice(2, 10);
@@ -70,10 +104,19 @@ function createMqttClient(cfg, handlers) {
     state.lastError = '';
     state.lastConnectAt = Date.now();
     if (typeof h.onConnect === 'function') h.onConnect();
-    const subs = [cfg.MQTT_TELEMETRY_SUB, cfg.MQTT_REPLY_SUB, cfg.MQTT_LOG_SUB].filter(Boolean);
+    const subs = [
+      cfg.MQTT_TELEMETRY_SUB,
+      cfg.MQTT_REPLY_SUB,
+      cfg.MQTT_LOG_SUB,
+      cfg.MQTT_TELEMETRY_MP_SUB,
+      cfg.MQTT_REPLY_MP_SUB,
+      cfg.MQTT_TELEMETRY_BATCH_SUB,
+      cfg.MQTT_STATUS_SUB
+    ].filter(Boolean);
     const uniq = Array.from(new Set(subs));
     uniq.forEach((topic) => {
-      client.subscribe(topic, { qos: 0 }, (err) => {
+      // QoS1: the device publishes batches, logs, replies and its status with QoS1.
+      client.subscribe(topic, { qos: 1 }, (err) => {
         if (err) setErr(err);
       });
     });
@@ -112,8 +155,12 @@ function createMqttClient(cfg, handlers) {
 
     let payload = null;
     try {
-      const s = payloadBuf ? payloadBuf.toString('utf8') : '';
-      payload = s ? JSON.parse(s) : null;
+      if (isMsgPackTopic(topicStr)) {
+        payload = (payloadBuf && payloadBuf.length) ? decodeMsgPack(payloadBuf) : null;
+      } else {
+        const s = payloadBuf ? payloadBuf.toString('utf8') : '';
+        payload = s ? JSON.parse(s) : null;
+      }
     } catch (e) {
       if (typeof h.onBadMessage === 'function') h.onBadMessage(topicStr, e);
       return;
@@ -144,6 +191,20 @@ function createMqttClient(cfg, handlers) {
       return;
     }
 
+    if (isStatusTopic(topicStr)) {
+      if (typeof h.onStatus === 'function') {
+        h.onStatus({ deviceId, topic: topicStr, payload, receivedAt });
+      }
+      return;
+    }
+
+    if (isBatchTopic(topicStr)) {
+      if (typeof h.onTelemetryBatch === 'function') {
+        h.onTelemetryBatch({ deviceId, topic: topicStr, payload, receivedAt });
+      }
+      return;
+    }
+
     if (!isTelemetryTopic(topicStr)) {
       // Ignore unknown topics to avoid polluting telemetry storage.
       return;
@@ -161,7 +222,7 @@ function createMqttClient(cfg, handlers) {
     if (!state.connected) throw new Error('mqtt_not_connected');
     const body = JSON.stringify(msgObj || {});
     return new Promise((resolve, reject) => {
-      client.publish(topic, body, { qos: 0, retain: false }, (err) => {
+      client.publish(topic, body, { qos: 1, retain: false }, (err) => {
         if (err) return reject(err);
         resolve({ topic });
       });
@@ -209,7 +270,71 @@ function createMqttClient(cfg, handlers) {
     });
   }
 
-  return { client, state, publishCommand, publishMessage, rpc };
+  // Chunked bulk transfer (get_log / get_config with "offset", see firmware MQTT_PublishChunk):
+  // asks for the next offset until eof, checks each piece's CRC-32, re-requests a piece
+  // that timed out or arrived corrupted, and starts over if the data generation changes
+  // (log wrapped). Resolves { data: Buffer, start, total, gen }, or { legacy: reply } when
+  // the firmware doesn't support chunks yet (it answers with the whole payload).
+  async function rpcChunked(deviceId, msgObj, options) {
+    const o = options || {};
+    const chunkTimeoutMs = Number.isFinite(o.chunkTimeoutMs) ? o.chunkTimeoutMs : 8000;
+    const maxRetries = Number.isFinite(o.maxRetries) ? o.maxRetries : 3;
+    const deadline = Date.now() + (Number.isFinite(o.timeoutMs) ? o.timeoutMs : 60_000);
+    const first = msgObj && typeof msgObj === 'object' ? { ...msgObj } : {};
+    if (first.offset === undefined) first.offset = 0;
+
+    let parts = [];
+    let start = null;
+    let gen;
+    let next = first.offset;
+    let retries = 0;
+    let restarts = 0;
+    for (;;) {
+      if (Date.now() > deadline) throw new Error('timeout');
+      const req = { ...first, offset: next };
+      if (start !== null) req.gen = gen;
+      let rep;
+      try {
+        rep = await rpc(deviceId, req, { timeoutMs: chunkTimeoutMs });
+      } catch (e) {
+        const msg = (e && e.message) ? String(e.message) : '';
+        if (msg === 'gen_changed' && restarts < 2) {
+          restarts++;
+          parts = [];
+          start = null;
+          next = first.offset;
+          continue;
+        }
+        if (msg === 'timeout' && retries < maxRetries) {
+          retries++;
+          continue;
+        }
+        throw e;
+      }
+      if (typeof rep.data !== 'string') return { legacy: rep };
+
+      const buf = Buffer.from(rep.data, 'base64');
+      if (buf.length !== (rep.len | 0) || crc32(buf) !== (parseInt(String(rep.crc || ''), 16) >>> 0)) {
+        if (retries < maxRetries) {
+          retries++;
+          continue;
+        }
+        throw new Error('bad_crc');
+      }
+      retries = 0;
+      if (start === null) {
+        start = Number(rep.offset) || 0;
+        gen = rep.gen;
+      }
+      parts.push(buf);
+      next = (Number(rep.offset) || 0) + buf.length;
+      if (rep.eof || buf.length === 0) {
+        return { data: Buffer.concat(parts), start, total: Number(rep.total) || 0, gen };
+      }
+    }
+  }
+
+  return { client, state, publishCommand, publishMessage, rpc, rpcChunked };
 }
 
-module.exports = { createMqttClient };
+module.exports = { createMqttClient, crc32, isMsgPackTopic };
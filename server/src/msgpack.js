@@ -0,0 +1,117 @@
+// Decoder for the device's MessagePack encoding (firmware: src/WS_MsgPack.cpp).
+// Map keys that are integers are ids into KEYS, which must match WS_MsgPack_Keys
+// entry for entry (checked by scripts/msgpack_bench --check-keys). Append only.
+
+const KEYS = [
+  'sensor1', 'sensor2', 'sensors', 'mm', 'filt_mm', 'valid', 'online', 'temp_x10',
+  'temp_valid', 'id', 'q', 'poll_ms', 'bus', 'req', 'retry', 'to',
+  'crc', 'hdr', 'exc', 'lat_ms', 'gate_state', 'gate_position_open', 'auto_gate', 'auto_latched',
+  'manual', 'active', 'remain_s', 'total_s', 'relay1', 'relay2', 'net', 'wifi',
+  'mqtt', 'http', 'ip', 'rssi', 'ssid', 'cell', 'enabled', 'sim_ready',
+  'attached', 'csq', 'rssi_dbm', 'last_rx_age_s', 'ctrl', 'open_allowed', 'close_allowed', 'cooldown_remain_s',
+  'min_interval_s', 'action_s', 'reason', 'alarm', 'severity', 'text', 'fw', 'current',
+  'latest', 'last_check', 'last_result', 'seq', 'kf', 'delta', 'ok', 'req_id',
+  'cmd', 'error', 'raw', 'name', 'gen', 'offset', 'total', 'len',
+  'eof', 'enc', 'data', 'lines', 'truncated', 'mqtt_rtt_ms', 'cmd_rtt_ms'
+];
+
+const MAX_DEPTH = 16;
+
+function decodeMsgPack(buf) {
+  const b = Buffer.isBuffer(buf) ? buf : Buffer.from(buf || []);
+  let pos = 0;
+
+  const need = (n) => {
+    if (pos + n > b.length) throw new Error('msgpack_truncated');
+  };
+  const str = (n) => {
+    need(n);
+    const s = b.toString('utf8', pos, pos + n);
+    pos += n;
+    return s;
+  };
+  const uintN = (n) => {
+    need(n);
+    let v = 0;
+    if (n === 8) v = Number(b.readBigUInt64BE(pos)); // like JSON.parse: beyond 2^53 is rounded
+    else for (let i = 0; i < n; i++) v = v * 256 + b[pos + i];
+    pos += n;
+    return v;
+  };
+  const intN = (n) => {
+    need(n);
+    let v;
+    if (n === 1) v = b.readInt8(pos);
+    else if (n === 2) v = b.readInt16BE(pos);
+    else if (n === 4) v = b.readInt32BE(pos);
+    else v = Number(b.readBigInt64BE(pos));
+    pos += n;
+    return v;
+  };
+
+  function key(depth) {
+    need(1);
+    const t = b[pos];
+    if (t <= 0x7f || (t >= 0xcc && t <= 0xcf)) {
+      const id = value(depth);
+      return (id < KEYS.length) ? KEYS[id] : '#' + id;
+    }
+    const k = value(depth);
+    if (typeof k !== 'string' && typeof k !== 'number') throw new Error('msgpack_bad_key');
+    return String(k);
+  }
+
+  function container(depth, count, isMap) {
+    if (isMap) {
+      const o = {};
+      for (let i = 0; i < count; i++) {
+        const k = key(depth + 1);
+        o[k] = value(depth + 1);
+      }
+      return o;
+    }
+    const a = new Array(count);
+    for (let i = 0; i < count; i++) a[i] = value(depth + 1);
+    return a;
+  }
+
+  function value(depth) {
+    if (depth > MAX_DEPTH) throw new Error('msgpack_too_deep');
+    need(1);
+    const t = b[pos++];
+    if (t <= 0x7f) return t;
+    if (t >= 0xe0) return t - 0x100;
+    if ((t & 0xe0) === 0xa0) return str(t & 0x1f);
+    if ((t & 0xf0) === 0x80) return container(depth, t & 0x0f, true);
+    if ((t & 0xf0) === 0x90) return container(depth, t & 0x0f, false);
+    switch (t) {
+      case 0xc0: return null;
+      case 0xc2: return false;
+      case 0xc3: return true;
+      case 0xca: need(4); pos += 4; return b.readFloatBE(pos - 4);
+      case 0xcb: need(8); pos += 8; return b.readDoubleBE(pos - 8);
+      case 0xcc: return uintN(1);
+      case 0xcd: return uintN(2);
+      case 0xce: return uintN(4);
+      case 0xcf: return uintN(8);
+      case 0xd0: return intN(1);
+      case 0xd1: return intN(2);
+      case 0xd2: return intN(4);
+      case 0xd3: return intN(8);
+      case 0xd9: return str(uintN(1));
+      case 0xda: return str(uintN(2));
+      case 0xdb: return str(uintN(4));
+      case 0xdc: return container(depth, uintN(2), false);
+      case 0xdd: return container(depth, uintN(4), false);
+      case 0xde: return container(depth, uintN(2), true);
+      case 0xdf: return container(depth, uintN(4), true);
+      default: throw new Error('msgpack_unsupported_type');
+    }
+  }
+
+  const v = value(0);
+  if (pos !== b.length) throw new Error('msgpack_trailing_bytes');
+  return v;
+}
+
+module.exports = { decodeMsgPack, MSGPACK_KEYS: KEYS };
@@ -0,0 +1,81 @@
+// Expands batched telemetry (firmware: MQTT_BatchFlush in src/WS_MQTT.cpp) into rows.
+// {"boot":B,"up":U,"dropped":D,"samples":[{"seq":N,"t":ms,"up":ms,"gate_state":g,"sensors":[...]}]}
+// - t is the device's UTC clock in ms; 0 before its NTP sync. Then the sample time is
+//   taken relative to the batch's "up" (device uptime at publish), anchored at receive time.
+// - seq counts samples per boot (boot: random per device start); a sample whose seq was
+//   already stored for the same boot is a duplicate and skipped.
+// Each row is the latest full state with the sample applied, so it reads like any other
+// telemetry row (sensor1/sensor2/sensors/gate_state).
+
+const MIN_EPOCH_MS = Date.UTC(2021, 0, 1);
+const BRIEF_KEYS = ['mm', 'filt_mm', 'valid', 'online', 'temp_x10', 'temp_valid'];
+
+function isPlainObject(v) {
+  return v !== null && typeof v === 'object' && !Array.isArray(v);
+}
+
+function pick(obj, keys) {
+  const out = {};
+  for (const k of keys) {
+    if (obj[k] !== undefined) out[k] = obj[k];
+  }
+  return out;
+}
+
+function applySample(base, s) {
+  const state = isPlainObject(base) ? { ...base } : {};
+  if (Number.isInteger(s.gate_state)) state.gate_state = s.gate_state;
+  const sensors = Array.isArray(s.sensors) ? s.sensors.filter(isPlainObject) : [];
+  if (sensors.length) {
+    const prev = Array.isArray(state.sensors) ? state.sensors : [];
+    state.sensors = sensors.map((x, i) => ({ id: i + 1, ...(isPlainObject(prev[i]) ? prev[i] : {}), ...pick(x, BRIEF_KEYS) }));
+    ['sensor1', 'sensor2'].forEach((k, i) => {
+      if (sensors[i]) state[k] = { ...(isPlainObject(state[k]) ? state[k] : {}), ...pick(sensors[i], BRIEF_KEYS) };
+    });
+  }
+  state.sample_seq = s.seq;
+  return state;
+}
+
+class BatchExpander {
+  constructor() {
+    this._last = new Map(); // deviceId -> { boot, seq }
+  }
+
+  // Returns { rows: [{ ts:number, payload }], dropped, duplicates } in sample order.
+  expand(deviceId, payload, receivedAt, baseState) {
+    const p = isPlainObject(payload) ? payload : {};
+    const samples = Array.isArray(p.samples) ? p.samples.filter(isPlainObject) : [];
+    const boot = Number.isFinite(p.boot) ? p.boot : null;
+    const up = Number.isFinite(p.up) ? p.up : null;
+    const now = Number.isFinite(receivedAt) ? receivedAt : Date.now();
+
+    let last = this._last.get(deviceId);
+    if (!last || last.boot !== boot) {
+      last = { boot, seq: -1 };
+      this._last.set(deviceId, last);
+    }
+
+    const rows = [];
+    let duplicates = 0;
+    let state = baseState;
+    for (const s of samples) {
+      const seq = Number.isInteger(s.seq) ? s.seq : null;
+      if (seq !== null && seq <= last.seq) {
+        duplicates++;
+        continue;
+      }
+      let ts = Number.isFinite(s.t) && s.t >= MIN_EPOCH_MS ? s.t : null;
+      if (ts === null) {
+        // Uptime is a u32 of ms: the difference wraps like the device's.
+        ts = (up !== null && Number.isFinite(s.up)) ? now - ((up - s.up) >>> 0) : now;
+      }
+      state = applySample(state, s);
+      rows.push({ ts, payload: state });
+      if (seq !== null) last.seq = seq;
+    }
+    return { rows, dropped: Number.isFinite(p.dropped) ? p.dropped : 0, duplicates };
+  }
+}
+
+module.exports = { BatchExpander, applySample };
@@ -0,0 +1,81 @@
+// Rebuilds full device state from delta telemetry (firmware: MQTT_PublishState in src/WS_MQTT.cpp).
+// - {"seq":N,"kf":1,...}    keyframe: full state
+// - {"seq":N,"delta":1,...} JSON Merge Patch (RFC 7386) against message N-1
+// - no "seq"                legacy firmware: full state every time
+// A patch that doesn't follow the last seq (lost message, device reboot) can't be
+// applied; it is dropped and the caller is asked to request a keyframe.
+
+function isPlainObject(v) {
+  return v !== null && typeof v === 'object' && !Array.isArray(v);
+}
+
+function mergePatch(target, patch) {
+  if (!isPlainObject(patch)) return patch;
+  const out = isPlainObject(target) ? { ...target } : {};
+  for (const [k, v] of Object.entries(patch)) {
+    if (v === null) {
+      delete out[k];
+    } else {
+      out[k] = mergePatch(out[k], v);
+    }
+  }
+  return out;
+}
+
+function stripMeta(obj) {
+  const out = { ...obj };
+  delete out.seq;
+  delete out.kf;
+  delete out.delta;
+  return out;
+}
+
+class TelemetryAssembler {
+  constructor(opts) {
+    const o = opts || {};
+    this.keyframeRetryMs = Number.isFinite(o.keyframeRetryMs) ? o.keyframeRetryMs : 10 * 1000;
+    this._m = new Map(); // deviceId -> { seq:number|null, state:object|null, lastRequestAt:number }
+  }
+
+  _entry(deviceId) {
+    let e = this._m.get(deviceId);
+    if (!e) {
+      e = { seq: null, state: null, lastRequestAt: -Infinity };
+      this._m.set(deviceId, e);
+    }
+    return e;
+  }
+
+  // Returns { state, full, needKeyframe }: state is the merged full state (null while
+  // waiting for a keyframe), full tells whether the message itself was a full state.
+  // needKeyframe is set at most once per keyframeRetryMs while out of sync.
+  push(deviceId, payload, now) {
+    const t = Number.isFinite(now) ? now : Date.now();
+    const e = this._entry(deviceId);
+    const p = isPlainObject(payload) ? payload : {};
+    const seq = Number.isInteger(p.seq) ? p.seq : null;
+
+    if (seq === null || !p.delta) {
+      e.state = stripMeta(p);
+      e.seq = seq;
+      return { state: e.state, full: true, needKeyframe: false };
+    }
+
+    if (e.state && e.seq !== null && seq === ((e.seq + 1) >>> 0)) {
+      e.state = mergePatch(e.state, stripMeta(p));
+      e.seq = seq;
+      return { state: e.state, full: false, needKeyframe: false };
+    }
+
+    // Out of sync: keep the last good state for reads, but stop applying patches.
+    e.seq = null;
+    let needKeyframe = false;
+    if (t - e.lastRequestAt >= this.keyframeRetryMs) {
+      e.lastRequestAt = t;
+      needKeyframe = true;
+    }
+    return { state: null, full: false, needKeyframe };
+  }
+}
+
+module.exports = { TelemetryAssembler, mergePatch };
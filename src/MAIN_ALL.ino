@@ -10,6 +10,8 @@
 #include "WS_Information.h"
 #include "WS_Control.h"
 #include "WS_Log.h"
+#include "WS_Sensor.h"
+#include "WS_History.h"
 
 #define CH1 '1'                 // CH1 Enabled Instruction
 #define CH2 '2'                 // CH2 Enabled Instruction
@@ -40,32 +42,8 @@ bool Gate_Action_Active = false;
 uint32_t Gate_Action_StartMs = 0;
 const uint32_t GATE_ACTION_DURATION_MS = (uint32_t)GATE_RELAY_ACTION_SECONDS * 1000UL;
 
-// RS485 ultrasonic level sensors (Modbus RTU)
-const uint8_t SENSOR_ID_1 = INNER_POND_SENSOR_ID;
-const uint8_t SENSOR_ID_2 = OUTER_POND_SENSOR_ID;
-const uint16_t SENSOR_POLL_INTERVAL_MS = 1000;
-
-uint16_t Sensor_Level_mm_1 = 0;
-uint16_t Sensor_Level_mm_2 = 0;
-int16_t Sensor_Temp_x10_1 = 0;
-int16_t Sensor_Temp_x10_2 = 0;
-bool Sensor_Online_1 = false;
-bool Sensor_Online_2 = false;
-bool Sensor_HasValue_1 = false;
-bool Sensor_HasValue_2 = false;
-bool Sensor_HasTemp_1 = false;
-bool Sensor_HasTemp_2 = false;
-uint32_t Last_Sensor_Poll_Ms = 0;
-uint8_t Next_Sensor_ID = SENSOR_ID_1;
+// RS485 ultrasonic level sensors (Modbus RTU): see WS_Sensor.h for the sensor table.
 uint32_t Last_Level_Log_Ms = 0;
-uint32_t Sensor_Last_Ok_Ms_1 = 0;
-uint32_t Sensor_Last_Ok_Ms_2 = 0;
-uint16_t Sensor_Prev_Level_mm_1 = 0;
-uint16_t Sensor_Prev_Level_mm_2 = 0;
-uint32_t Sensor_Prev_Level_Ms_1 = 0;
-uint32_t Sensor_Prev_Level_Ms_2 = 0;
-bool Sensor_Prev_Valid_1 = false;
-bool Sensor_Prev_Valid_2 = false;
 
 uint32_t Gate_Last_Action_EndMs = 0;
 bool Gate_Open_Allowed = true;
@@ -97,6 +75,9 @@ static uint8_t Cycle_ActiveRule = 0;
 static uint8_t Cycle_StepIndex = 0;
 static uint32_t Cycle_StepEndMs = 0;
 
+// Level-diff rules already reported as pointing at an unconfigured sensor (bit per rule)
+static uint8_t LevelDiff_BadRuleLogged = 0;
+
 // Measurement logging throttling
 static uint32_t Log_LastMeasureMs = 0;
 static const uint32_t LOG_MEASURE_INTERVAL_MS = 60000UL;
@@ -264,6 +245,7 @@ static void Ctrl_LoadIfNeeded()
   }
   CtrlCfgLoaded = WS_Control_Load(CtrlCfg);
   WS_Time_SetTzOffsetMs(CtrlCfg.tz_offset_ms);
+  WS_Sensor_SetFilter(CtrlCfg.filter);
 }
 
 // Called by HTTP/MQTT handlers after ctrl.json is updated.
@@ -277,6 +259,7 @@ void WS_Ctrl_ForceReload()
   }
   Cycle_StepEndMs = 0;
   Cycle_StepIndex = 0;
+  LevelDiff_BadRuleLogged = 0;
   Ctrl_LoadIfNeeded();
 }
 
@@ -369,9 +352,6 @@ static void Ctrl_Cycle_Loop()
 
 static void Ctrl_LevelDiff_Loop()
 {
-  if (!Sensor_HasValue_1 || !Sensor_HasValue_2) {
-    return;
-  }
   if (CtrlCfg.leveldiff_count == 0) {
     return;
   }
@@ -392,7 +372,23 @@ static void Ctrl_LevelDiff_Loop()
     return;
   }
 
-  const int32_t delta = (int32_t)Sensor_Level_mm_1 - (int32_t)Sensor_Level_mm_2;
+  const WS_SensorSlot* inner = WS_Sensor_Get(r.inner_idx);
+  const WS_SensorSlot* outer = WS_Sensor_Get(r.outer_idx);
+  if (!inner || !outer) {
+    // Index within WS_SENSOR_MAX (checked at load) but past the configured sensors.
+    if ((LevelDiff_BadRuleLogged & (1U << ridx)) == 0) {
+      LevelDiff_BadRuleLogged |= (uint8_t)(1U << ridx);
+      WS_Log_Error("leveldiff[%u] inactive: inner_idx=%u outer_idx=%u, %u sensors configured", (unsigned)ridx,
+                   (unsigned)r.inner_idx, (unsigned)r.outer_idx, (unsigned)Sensor_Count);
+    }
+    return;
+  }
+  if (!inner->has_value || !outer->has_value) {
+    return;
+  }
+
+  // Filtered levels: single noisy readings near a threshold must not toggle the gate.
+  const int32_t delta = (int32_t)inner->filt_mm - (int32_t)outer->filt_mm;
   if (delta <= r.open_threshold_mm) {
     if (!Gate_Position_Open) {
       WS_Log_Action("leveldiff[%u] open delta=%ld <= %ld", (unsigned)ridx, (long)delta, (long)r.open_threshold_mm);
@@ -535,9 +531,14 @@ static void Update_Gate_Command_Availability()
 static void Update_Alarm_Status()
 {
   const uint32_t now = millis();
-  const bool sensor1_stale = (Sensor_Last_Ok_Ms_1 == 0) || ((now - Sensor_Last_Ok_Ms_1) > SENSOR_DATA_TIMEOUT_MS);
-  const bool sensor2_stale = (Sensor_Last_Ok_Ms_2 == 0) || ((now - Sensor_Last_Ok_Ms_2) > SENSOR_DATA_TIMEOUT_MS);
-  const bool alarm_sensor_timeout = sensor1_stale || sensor2_stale;
+  bool alarm_sensor_timeout = false;
+  for (uint8_t i = 0; i < Sensor_Count; i++) {
+    const uint32_t lastOk = Sensor_Table[i].last_ok_ms;
+    if (lastOk == 0 || (now - lastOk) > WS_Sensor_ScaleTimeout(Sensor_Table[i], SENSOR_DATA_TIMEOUT_MS)) {
+      alarm_sensor_timeout = true;
+      break;
+    }
+  }
   const bool alarm_level_jump = now < Alarm_LevelJump_ExpireMs;
   const bool alarm_level_range = now < Alarm_LevelRange_ExpireMs;
   const bool alarm_interlock = Alarm_RelayInterlock;
@@ -589,215 +590,64 @@ static void Alarm_LogTransitions()
   }
 }
 
-static uint16_t Modbus_CRC16(const uint8_t* data, size_t len)
+static void Sensor_Read_Loop()
 {
-  uint16_t crc = 0xFFFF;
-  for (size_t i = 0; i < len; ++i) {
-    crc ^= data[i];
-    for (uint8_t bit = 0; bit < 8; ++bit) {
-      if (crc & 0x0001) {
-        crc = (crc >> 1) ^ 0xA001;
-      } else {
-        crc >>= 1;
-      }
-    }
+  // Full-rate sampling while the gate moves.
+  WS_Sensor_SetBoost(Gate_Action_Active);
+  bool ok = false;
+  const int8_t idx = WS_Sensor_Loop(&ok);
+  if (idx < 0) {
+    return;
   }
-  return crc;
-}
-
-static bool Read_Sensor_Data(uint8_t id, uint16_t* level_mm, int16_t* temp_x10)
-{
-  // Read 4 registers from 0x0000: level(0x0000) ... temp(0x0003)
-  uint8_t req[8] = {id, 0x03, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00};
-  const uint16_t req_crc = Modbus_CRC16(req, 6);
-  req[6] = req_crc & 0xFF;
-  req[7] = (req_crc >> 8) & 0xFF;
-
-  // Drain late bytes from the previous frame. A short quiet window helps avoid
-  // "polluting" the next response when a sensor replies after our timeout.
-  while (lidarSerial.available() > 0) {
-    lidarSerial.read();
-  }
-  delay(5);
-  while (lidarSerial.available() > 0) {
-    lidarSerial.read();
-  }
-
-  lidarSerial.write(req, sizeof(req));
-  lidarSerial.flush();  // ensure request is on the wire (helps RS485 auto-direction modules)
-
-  // Expected response:
-  // id, 0x03, 0x08, 8 bytes data, CRC(2) -> total 13 bytes.
-  // Read into a larger buffer and resync by header+CRC to tolerate stray bytes.
-  uint8_t raw[32] = {0};
-  size_t received = 0;
-  const uint32_t start_ms = millis();
-
-  while ((millis() - start_ms) < (uint32_t)SENSOR_MODBUS_TIMEOUT_MS) {
-    bool progressed = false;
-    while (lidarSerial.available() > 0 && received < sizeof(raw)) {
-      raw[received++] = (uint8_t)lidarSerial.read();
-      progressed = true;
-    }
-
-    if (received >= 13) {
-      for (size_t off = 0; off + 13 <= received; ++off) {
-        if (raw[off] != id || raw[off + 1] != 0x03 || raw[off + 2] != 0x08) {
-          continue;
-        }
-        const uint16_t resp_crc = (uint16_t)raw[off + 11] | ((uint16_t)raw[off + 12] << 8);
-        const uint16_t calc_crc = Modbus_CRC16(&raw[off], 11);
-        if (resp_crc != calc_crc) {
-          continue;
-        }
-        *level_mm = ((uint16_t)raw[off + 3] << 8) | raw[off + 4];
-        *temp_x10 = (int16_t)(((uint16_t)raw[off + 9] << 8) | raw[off + 10]);
-        return true;
-      }
-    }
 
-    if (received >= sizeof(raw)) {
-      break;
+  const WS_SensorSlot& s = Sensor_Table[idx];
+  if (ok) {
+    const uint32_t now = millis();
+    if (s.rate_mm_s > LEVEL_JUMP_THRESHOLD_MM_PER_S) {
+      Alarm_LevelJump_ExpireMs = now + 15000UL;
     }
-    if (!progressed) {
-      delay(1);  // yield
+    if (s.level_mm < LEVEL_MIN_MM || s.level_mm > LEVEL_MAX_MM) {
+      Alarm_LevelRange_ExpireMs = now + 15000UL;
     }
   }
 
-  return false;
-}
+  // The grace is stretched to each sensor's current poll interval (see WS_Sensor_ScaleTimeout).
+  WS_Sensor_UpdateOnline(millis());
 
-static bool Read_Sensor_WithRetry(uint8_t id, uint16_t* level_mm, int16_t* temp_x10)
-{
-  for (uint8_t attempt = 0; attempt < (uint8_t)SENSOR_MODBUS_RETRY_COUNT; ++attempt) {
-    if (Read_Sensor_Data(id, level_mm, temp_x10)) {
-      return true;
-    }
-    if ((attempt + 1U) < (uint8_t)SENSOR_MODBUS_RETRY_COUNT) {
-      delay(SENSOR_MODBUS_RETRY_GAP_MS);
-    }
-  }
-  return false;
-}
-
-static void Sensor_Read_Loop()
-{
-  if (millis() - Last_Sensor_Poll_Ms < SENSOR_POLL_INTERVAL_MS) {
-    return;
-  }
-  Last_Sensor_Poll_Ms = millis();
-
-  uint16_t level_tmp = 0;
-  int16_t temp_tmp = 0;
-  if (Next_Sensor_ID == SENSOR_ID_1) {
-    const bool ok = Read_Sensor_WithRetry(SENSOR_ID_1, &level_tmp, &temp_tmp);
-    if (ok) {
-      const uint32_t now = millis();
-      Sensor_Level_mm_1 = level_tmp;
-      Sensor_Temp_x10_1 = temp_tmp;
-      Sensor_HasValue_1 = true;
-      Sensor_HasTemp_1 = true;
-      Sensor_Last_Ok_Ms_1 = now;
-
-      if (Sensor_Prev_Valid_1 && Sensor_Prev_Level_Ms_1 > 0) {
-        const uint32_t dt = now - Sensor_Prev_Level_Ms_1;
-        if (dt > 0) {
-          const int32_t jump = (int32_t)Sensor_Level_mm_1 - (int32_t)Sensor_Prev_Level_mm_1;
-          const uint32_t jump_rate = (uint32_t)(abs(jump) * 1000UL / dt);
-          if (jump_rate > LEVEL_JUMP_THRESHOLD_MM_PER_S) {
-            Alarm_LevelJump_ExpireMs = now + 15000UL;
-          }
-        }
-      }
-      if (Sensor_Level_mm_1 < LEVEL_MIN_MM || Sensor_Level_mm_1 > LEVEL_MAX_MM) {
-        Alarm_LevelRange_ExpireMs = now + 15000UL;
+  if (SERIAL_LEVEL_LOG_Enable && (millis() - Last_Level_Log_Ms >= SERIAL_LEVEL_LOG_INTERVAL_MS)) {
+    Last_Level_Log_Ms = millis();
+    printf("[Level]");
+    for (uint8_t i = 0; i < Sensor_Count; i++) {
+      const WS_SensorSlot& si = Sensor_Table[i];
+      printf("%s ID%03u:", (i > 0) ? " |" : "", (unsigned)si.id);
+      if (si.has_value) {
+        printf("%umm(%.3fm)", si.level_mm, si.level_mm / 1000.0f);
+      } else {
+        printf("offline");
       }
-      Sensor_Prev_Level_mm_1 = Sensor_Level_mm_1;
-      Sensor_Prev_Level_Ms_1 = now;
-      Sensor_Prev_Valid_1 = true;
-    }
-    Next_Sensor_ID = SENSOR_ID_2;
-  } else {
-    const bool ok = Read_Sensor_WithRetry(SENSOR_ID_2, &level_tmp, &temp_tmp);
-    if (ok) {
-      const uint32_t now = millis();
-      Sensor_Level_mm_2 = level_tmp;
-      Sensor_Temp_x10_2 = temp_tmp;
-      Sensor_HasValue_2 = true;
-      Sensor_HasTemp_2 = true;
-      Sensor_Last_Ok_Ms_2 = now;
-
-      if (Sensor_Prev_Valid_2 && Sensor_Prev_Level_Ms_2 > 0) {
-        const uint32_t dt = now - Sensor_Prev_Level_Ms_2;
-        if (dt > 0) {
-          const int32_t jump = (int32_t)Sensor_Level_mm_2 - (int32_t)Sensor_Prev_Level_mm_2;
-          const uint32_t jump_rate = (uint32_t)(abs(jump) * 1000UL / dt);
-          if (jump_rate > LEVEL_JUMP_THRESHOLD_MM_PER_S) {
-            Alarm_LevelJump_ExpireMs = now + 15000UL;
-          }
-        }
+      if (si.has_temp) {
+        printf(" T:%.1fC", si.temp_x10 / 10.0f);
       }
-      if (Sensor_Level_mm_2 < LEVEL_MIN_MM || Sensor_Level_mm_2 > LEVEL_MAX_MM) {
-        Alarm_LevelRange_ExpireMs = now + 15000UL;
+      if (!si.online) {
+        printf(" [offline q=%u]", (unsigned)si.quality);
       }
-      Sensor_Prev_Level_mm_2 = Sensor_Level_mm_2;
-      Sensor_Prev_Level_Ms_2 = now;
-      Sensor_Prev_Valid_2 = true;
-    }
-    Next_Sensor_ID = SENSOR_ID_1;
-  }
-
-  // Debounce "online" to reduce flapping: treat sensor as offline only after N ms without successful data.
-  // Note: each sensor is polled every ~2s (alternating), so a 3s grace tolerates one missed poll.
-  {
-    const uint32_t now = millis();
-    Sensor_Online_1 = (Sensor_Last_Ok_Ms_1 > 0) && ((now - Sensor_Last_Ok_Ms_1) <= (uint32_t)SENSOR_ONLINE_GRACE_MS);
-    Sensor_Online_2 = (Sensor_Last_Ok_Ms_2 > 0) && ((now - Sensor_Last_Ok_Ms_2) <= (uint32_t)SENSOR_ONLINE_GRACE_MS);
-  }
-
-  if (SERIAL_LEVEL_LOG_Enable && (millis() - Last_Level_Log_Ms >= SERIAL_LEVEL_LOG_INTERVAL_MS)) {
-    Last_Level_Log_Ms = millis();
-    printf("[Level] ID001(inner):");
-    if (Sensor_HasValue_1) {
-      printf("%umm(%.3fm)", Sensor_Level_mm_1, Sensor_Level_mm_1 / 1000.0f);
-    } else {
-      printf("offline");
-    }
-    printf(" | ID002(outer):");
-    if (Sensor_HasValue_2) {
-      printf("%umm(%.3fm)", Sensor_Level_mm_2, Sensor_Level_mm_2 / 1000.0f);
-    } else {
-      printf("offline");
-    }
-    printf(" | T1:");
-    if (Sensor_HasTemp_1) {
-      printf("%.1fC", Sensor_Temp_x10_1 / 10.0f);
-    } else {
-      printf("offline");
-    }
-    printf(" | T2:");
-    if (Sensor_HasTemp_2) {
-      printf("%.1fC", Sensor_Temp_x10_2 / 10.0f);
-    } else {
-      printf("offline");
-    }
-    if (!Sensor_Online_1 || !Sensor_Online_2) {
-      printf(" [online:%d,%d]", Sensor_Online_1 ? 1 : 0, Sensor_Online_2 ? 1 : 0);
     }
     printf("\r\n");
   }
 
   if ((millis() - Log_LastMeasureMs) >= LOG_MEASURE_INTERVAL_MS) {
     Log_LastMeasureMs = millis();
-    WS_Log_Measure("inner_mm=%u outer_mm=%u t1_x10=%d t2_x10=%d online1=%d online2=%d valid1=%d valid2=%d",
-                   (unsigned)Sensor_Level_mm_1,
-                   (unsigned)Sensor_Level_mm_2,
-                   (int)Sensor_Temp_x10_1,
-                   (int)Sensor_Temp_x10_2,
-                   Sensor_Online_1 ? 1 : 0,
-                   Sensor_Online_2 ? 1 : 0,
-                   Sensor_HasValue_1 ? 1 : 0,
-                   Sensor_HasValue_2 ? 1 : 0);
+    WS_MLogRecord rec;
+    rec.count = (Sensor_Count < 2) ? 2 : ((Sensor_Count > WS_MLOG_MAX_SENSORS) ? WS_MLOG_MAX_SENSORS : Sensor_Count);
+    for (uint8_t i = 0; i < rec.count; i++) {
+      const WS_SensorSlot* si = WS_Sensor_Get(i);
+      if (!si) continue;
+      rec.level_mm[i] = si->level_mm;
+      rec.temp_x10[i] = si->temp_x10;
+      if (si->online) rec.online |= (uint8_t)(1U << i);
+      if (si->has_value) rec.valid |= (uint8_t)(1U << i);
+    }
+    WS_Log_Measure(rec);
   }
 }
 
@@ -958,6 +808,8 @@ static void Offline_Network_RGB_Loop()
 void setup() {
 // UART
   Serial_Init();
+  WS_Sensor_Init();
+  WS_History_Init();
   WS_Log_Init();
   WS_Log_SetTimeProvider(WS_Time_NowEpoch);
 // Relay . RGB . Buzzer GPIO
@@ -977,8 +829,10 @@ void setup() {
 
 /**********************************************************  While  **********************************************************/
 void loop() {
-// RS485 Read two ultrasonic level sensors
+// RS485 level sensors (round-robin, non-blocking)
   Sensor_Read_Loop();
+  WS_History_Loop();
+  WS_Log_Loop();
   Manual_Takeover_Loop();
   WS_Time_Loop();
   Ctrl_Automation_Loop();
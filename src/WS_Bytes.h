@@ -0,0 +1,40 @@
+#ifndef _WS_BYTES_H_
+#define _WS_BYTES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Little-endian fields and CRC-32 for the on-flash formats (log ring, measurement log,
+// outbox) and the MQTT chunk transfer. No Arduino dependencies, builds on the host as well.
+
+inline void WS_PutU32(uint8_t* out, uint32_t v)
+{
+  out[0] = (uint8_t)v;
+  out[1] = (uint8_t)(v >> 8);
+  out[2] = (uint8_t)(v >> 16);
+  out[3] = (uint8_t)(v >> 24);
+}
+
+inline uint32_t WS_GetU32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// CRC-32 (IEEE, reflected, poly 0xEDB88320), the same as crc32() in server/src/mqtt.js
+// and zlib: "123456789" gives 0xCBF43926. Start with crc = 0; pass the result back in to
+// continue over the next piece. Nibble table: 64 bytes instead of 1 KB.
+inline uint32_t WS_Crc32(uint32_t crc, const uint8_t* p, size_t n)
+{
+  static const uint32_t kNibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= p[i];
+    crc = (crc >> 4) ^ kNibble[crc & 0x0F];
+    crc = (crc >> 4) ^ kNibble[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "WS_Control.h"
 #include "WS_FS.h"
+#include "WS_Log.h"
+#include "WS_Sensor.h"
 
 #include <ArduinoJson.h>
 #include <LittleFS.h>
@@ -16,6 +18,11 @@ static bool g_timeValid = false;
 static int32_t g_tzOffsetMs = 8 * 3600L * 1000L;
 static uint32_t g_lastTimeOkEpoch = 0;
 static bool g_ntpStarted = false;
+// Sub-second time: NTPClient counts whole seconds; the millis() at which WS_Time_Loop saw a
+// second begin anchors the milliseconds (loop latency apart).
+static uint32_t g_secSeen = 0;
+static uint32_t g_secAnchor = 0;      // 0: no second boundary seen since the last jump
+static uint32_t g_secAnchorMs = 0;
 
 static void SetDefaults(WS_ControlConfig& cfg)
 {
@@ -44,6 +51,10 @@ static void SetDefaults(WS_ControlConfig& cfg)
   cfg.leveldiff[0].enabled = true;
   cfg.leveldiff[0].open_threshold_mm = -1;
   cfg.leveldiff[0].close_threshold_mm = 0;
+  cfg.leveldiff[0].inner_idx = 0;
+  cfg.leveldiff[0].outer_idx = 1;
+
+  cfg.filter = WS_FilterConfig();
 }
 
 static bool ParseMode(const char* s, WS_CtrlMode& out)
@@ -87,6 +98,16 @@ String WS_Control_LoadRawJson()
   return s;
 }
 
+File WS_Control_OpenRaw()
+{
+  if (!WS_FS_EnsureMounted()) return File();
+  if (!LittleFS.exists(kCtrlPath)) {
+    WS_ControlConfig cfg;
+    (void)WS_Control_Load(cfg);
+  }
+  return LittleFS.open(kCtrlPath, "r");
+}
+
 bool WS_Control_SaveRawJson(const char* json)
 {
   if (!json) return false;
@@ -136,8 +157,18 @@ bool WS_Control_Save(const WS_ControlConfig& cfg)
     o["en"] = cfg.leveldiff[i].enabled;
     o["open_mm"] = cfg.leveldiff[i].open_threshold_mm;
     o["close_mm"] = cfg.leveldiff[i].close_threshold_mm;
+    o["inner_idx"] = cfg.leveldiff[i].inner_idx;
+    o["outer_idx"] = cfg.leveldiff[i].outer_idx;
   }
 
+  JsonObject f = doc["filter"].to<JsonObject>();
+  f["en"] = cfg.filter.enabled;
+  f["median"] = cfg.filter.median_n;
+  f["kind"] = WS_Filter_KindToStr(cfg.filter.kind);
+  f["ema_shift"] = cfg.filter.ema_shift;
+  f["kf_q"] = cfg.filter.kf_q;
+  f["kf_r"] = cfg.filter.kf_r;
+
   String out;
   serializeJsonPretty(doc, out);
   return SaveToFS(out);
@@ -239,9 +270,43 @@ bool WS_Control_Load(WS_ControlConfig& outCfg)
       r.enabled = o["en"] | false;
       r.open_threshold_mm = o["open_mm"] | -1;
       r.close_threshold_mm = o["close_mm"] | 0;
+      // Out-of-range or identical sensor indexes disable the rule (a negative value would
+      // otherwise wrap into another sensor's slot).
+      const int32_t inner = o["inner_idx"] | 0;
+      const int32_t outer = o["outer_idx"] | 1;
+      if (inner < 0 || inner >= WS_SENSOR_MAX || outer < 0 || outer >= WS_SENSOR_MAX || inner == outer) {
+        if (r.enabled) {
+          WS_Log_Error("ctrl leveldiff[%u] disabled: inner_idx=%ld outer_idx=%ld (0..%u, distinct)",
+                       (unsigned)(outCfg.leveldiff_count - 1U), (long)inner, (long)outer, (unsigned)(WS_SENSOR_MAX - 1));
+        }
+        r.enabled = false;
+        r.inner_idx = 0;
+        r.outer_idx = 1;
+      } else {
+        r.inner_idx = (uint8_t)inner;
+        r.outer_idx = (uint8_t)outer;
+      }
     }
   }
 
+  if (doc["filter"].is<JsonObject>()) {
+    JsonObject f = doc["filter"].as<JsonObject>();
+    WS_FilterConfig& fc = outCfg.filter;
+    fc.enabled = f["en"] | fc.enabled;
+    // Median window: odd, 1..WS_FILTER_MEDIAN_MAX.
+    uint32_t n = f["median"] | (uint32_t)fc.median_n;
+    if (n < 1) n = 1;
+    if (n > WS_FILTER_MEDIAN_MAX) n = WS_FILTER_MEDIAN_MAX;
+    if ((n & 1U) == 0) n--;
+    fc.median_n = (uint8_t)n;
+    (void)WS_Filter_ParseKind(f["kind"] | "", fc.kind);
+    const uint32_t shift = f["ema_shift"] | (uint32_t)fc.ema_shift;
+    fc.ema_shift = (uint8_t)((shift > 8) ? 8 : shift);
+    fc.kf_q = f["kf_q"] | fc.kf_q;
+    fc.kf_r = f["kf_r"] | fc.kf_r;
+    if (fc.kf_r == 0) fc.kf_r = 1;
+  }
+
   // Apply tz to NTP module
   g_tzOffsetMs = outCfg.tz_offset_ms;
   g_ntp.setTimeOffset((long)(g_tzOffsetMs / 1000L));
@@ -258,6 +323,22 @@ uint32_t WS_Time_NowEpoch()
   return g_ntp.getEpochTime();
 }
 
+uint64_t WS_Time_NowUtcMs()
+{
+  if (!g_timeValid) {
+    return 0;
+  }
+  const uint32_t e = g_ntp.getEpochTime();
+  uint64_t ms = (uint64_t)e * 1000ULL;
+  if (g_secAnchor != 0) {
+    const uint32_t since = millis() - g_secAnchorMs;
+    if (g_secAnchor + since / 1000UL == e) {
+      ms = (uint64_t)g_secAnchor * 1000ULL + since;
+    }
+  }
+  return ms - (uint64_t)((int64_t)(g_tzOffsetMs / 1000L) * 1000LL);   // NTPClient applies the offset in seconds
+}
+
 void WS_Time_SetTzOffsetMs(int32_t offset_ms)
 {
   g_tzOffsetMs = offset_ms;
@@ -297,6 +378,13 @@ void WS_Time_Loop()
   if (e >= 1609459200UL) {
     g_timeValid = true;
     g_lastTimeOkEpoch = e;
+    if (e == g_secSeen + 1UL) {
+      g_secAnchor = e;
+      g_secAnchorMs = millis();
+    } else if (e != g_secSeen) {
+      g_secAnchor = 0;   // resync or offset change: wait for the next boundary
+    }
+    g_secSeen = e;
   } else {
     g_timeValid = false;
   }
@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include <stdint.h>
+#include <FS.h>
+#include "WS_Filter.h"
 
 // Control modes:
 // - daily: fire open/close actions at configured times
@@ -44,6 +46,9 @@ struct WS_LevelDiffRule {
   int32_t open_threshold_mm = -1;
   // Close when (inner - outer) >= close_threshold_mm. Default 0 means inner >= outer.
   int32_t close_threshold_mm = 0;
+  // Sensor table indices (WS_Sensor.h) compared by this rule.
+  uint8_t inner_idx = 0;
+  uint8_t outer_idx = 1;
 };
 
 struct WS_ControlConfig {
@@ -56,6 +61,8 @@ struct WS_ControlConfig {
   WS_CycleRule cycle[5];
   uint8_t leveldiff_count = 0;
   WS_LevelDiffRule leveldiff[4];
+  // Level filter applied to every sensor; leveldiff rules act on the filtered value.
+  WS_FilterConfig filter;
 };
 
 // Config file stored on ESP32S3 LittleFS.
@@ -63,10 +70,12 @@ bool WS_Control_Load(WS_ControlConfig& outCfg);
 bool WS_Control_Save(const WS_ControlConfig& cfg);
 bool WS_Control_SaveRawJson(const char* json);
 String WS_Control_LoadRawJson();
+File WS_Control_OpenRaw();        // read handle on the config file (written with defaults if missing)
 
 // Runtime helpers
 bool WS_Time_IsValid();
 uint32_t WS_Time_NowEpoch();
+uint64_t WS_Time_NowUtcMs();       // UTC epoch ms, 0 while time is not valid
 void WS_Time_SetTzOffsetMs(int32_t offset_ms);
 void WS_Time_OnWiFiConnected();   // call after Wi-Fi connects
 void WS_Time_Loop();              // call in main loop
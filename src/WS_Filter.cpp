@@ -0,0 +1,95 @@
+#include "WS_Filter.h"
+
+#include <string.h>
+
+void WS_Filter_Reset(WS_FilterState& f)
+{
+  f = WS_FilterState();
+}
+
+static uint16_t WS_Filter_Median(WS_FilterState& f, uint8_t n, uint16_t raw)
+{
+  if (n > WS_FILTER_MEDIAN_MAX) n = WS_FILTER_MEDIAN_MAX;
+  if (n <= 1) return raw;
+
+  f.win[f.win_pos] = raw;
+  f.win_pos = (uint8_t)((f.win_pos + 1U) % n);
+  if (f.win_len < n) f.win_len++;
+
+  // Insertion sort of a copy; n <= 9 so this beats anything clever.
+  uint16_t tmp[WS_FILTER_MEDIAN_MAX];
+  for (uint8_t i = 0; i < f.win_len; i++) {
+    const uint16_t v = f.win[i];
+    uint8_t j = i;
+    while (j > 0 && tmp[j - 1] > v) {
+      tmp[j] = tmp[j - 1];
+      j--;
+    }
+    tmp[j] = v;
+  }
+  return tmp[f.win_len / 2];
+}
+
+// Arithmetic shift that rounds toward zero for both signs.
+static int32_t WS_Filter_Shr(int32_t v, uint8_t s)
+{
+  return (v >= 0) ? (v >> s) : -((-v) >> s);
+}
+
+uint16_t WS_Filter_Step(WS_FilterState& f, const WS_FilterConfig& cfg, uint16_t raw)
+{
+  if (!cfg.enabled) {
+    return raw;
+  }
+  const uint16_t med = WS_Filter_Median(f, cfg.median_n, raw);
+  const int32_t x_q8 = (int32_t)med << 8;
+
+  if (!f.primed) {
+    f.y_q8 = x_q8;
+    f.p = cfg.kf_r;
+    f.primed = true;
+    return med;
+  }
+
+  switch (cfg.kind) {
+    case WS_FILTER_EMA: {
+      const uint8_t s = (cfg.ema_shift > 15) ? 15 : cfg.ema_shift;
+      f.y_q8 += WS_Filter_Shr(x_q8 - f.y_q8, s);
+      break;
+    }
+    case WS_FILTER_KALMAN: {
+      // Random-walk model: predict p += q, gain k = p / (p + r) in Q16.
+      const uint32_t p = f.p + cfg.kf_q;
+      const uint32_t k_q16 = (uint32_t)(((uint64_t)p << 16) / ((uint64_t)p + cfg.kf_r + 1U));
+      f.y_q8 += (int32_t)(((int64_t)k_q16 * (x_q8 - f.y_q8)) / 65536);
+      f.p = (uint32_t)(((uint64_t)p * (65536U - k_q16)) >> 16);
+      break;
+    }
+    default:
+      f.y_q8 = x_q8;
+      break;
+  }
+
+  const int32_t y = (f.y_q8 + 128) >> 8;
+  if (y < 0) return 0;
+  if (y > 0xFFFF) return 0xFFFF;
+  return (uint16_t)y;
+}
+
+const char* WS_Filter_KindToStr(WS_FilterKind k)
+{
+  switch (k) {
+    case WS_FILTER_EMA: return "ema";
+    case WS_FILTER_KALMAN: return "kalman";
+    default: return "none";
+  }
+}
+
+bool WS_Filter_ParseKind(const char* s, WS_FilterKind& out)
+{
+  if (!s) return false;
+  if (!strcmp(s, "none")) { out = WS_FILTER_NONE; return true; }
+  if (!strcmp(s, "ema")) { out = WS_FILTER_EMA; return true; }
+  if (!strcmp(s, "kalman")) { out = WS_FILTER_KALMAN; return true; }
+  return false;
+}
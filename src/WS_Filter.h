@@ -0,0 +1,44 @@
+#ifndef _WS_FILTER_H_
+#define _WS_FILTER_H_
+
+#include <stdint.h>
+
+// Level signal conditioning (integer only, no allocation, host-buildable):
+//   raw -> rolling median (outlier rejection) -> EMA or scalar Kalman -> filtered
+// One WS_FilterState per sensor; the config comes from ctrl.json "filter".
+
+#define WS_FILTER_MEDIAN_MAX 9
+
+enum WS_FilterKind : uint8_t {
+  WS_FILTER_NONE = 0,       // median only
+  WS_FILTER_EMA = 1,
+  WS_FILTER_KALMAN = 2
+};
+
+struct WS_FilterConfig {
+  bool enabled = true;
+  uint8_t median_n = 5;          // window length, odd, 1 = off
+  WS_FilterKind kind = WS_FILTER_EMA;
+  uint8_t ema_shift = 2;         // alpha = 1 / 2^shift
+  uint32_t kf_q = 100;           // process noise per sample, 0.01 mm^2
+  uint32_t kf_r = 10000;         // measurement noise, 0.01 mm^2
+};
+
+struct WS_FilterState {
+  uint16_t win[WS_FILTER_MEDIAN_MAX] = {0};
+  uint8_t win_len = 0;
+  uint8_t win_pos = 0;
+  int32_t y_q8 = 0;              // filtered value, mm * 256
+  uint32_t p = 0;                // Kalman error variance, 0.01 mm^2
+  bool primed = false;
+};
+
+void WS_Filter_Reset(WS_FilterState& f);
+
+// Feed one raw reading (mm) and return the filtered reading (mm, rounded).
+uint16_t WS_Filter_Step(WS_FilterState& f, const WS_FilterConfig& cfg, uint16_t raw);
+
+const char* WS_Filter_KindToStr(WS_FilterKind k);
+bool WS_Filter_ParseKind(const char* s, WS_FilterKind& out);
+
+#endif
@@ -0,0 +1,301 @@
+#include "WS_History.h"
+#include "WS_Control.h"
+#include "WS_Sensor.h"
+
+struct WS_HistAcc {
+  bool open = false;
+  uint32_t slot = 0;
+  int32_t sum = 0;
+  uint32_t n = 0;
+  int16_t min = 0;
+  int16_t max = 0;
+};
+
+struct WS_HistSeries {
+  int16_t raw[HISTORY_RAW_LEN];
+  WS_HistAgg mins[HISTORY_MIN_LEN];
+  WS_HistAgg hours[HISTORY_HOUR_LEN];
+  // head = next slot to commit; slots below head and within the ring length are readable.
+  uint32_t raw_head = 0;
+  uint32_t min_head = 0;
+  uint32_t hour_head = 0;
+  WS_HistAcc acc_min;
+  WS_HistAcc acc_hour;       // completed minutes of the current hour
+};
+
+static WS_HistSeries Hist_Series[HISTORY_Enable ? WS_HIST_SERIES_MAX : 1];
+static uint32_t Hist_Seconds = 0;      // seconds since WS_History_Init (no millis() wrap)
+static uint32_t Hist_LastTickMs = 0;
+static uint32_t Hist_EpochBase = 0;    // epoch of Hist_Seconds == 0, once time is valid
+static bool Hist_EpochValid = false;
+static bool Hist_Started = false;
+
+template <typename T>
+static void WS_Hist_Put(T* ring, uint32_t len, uint32_t& head, uint32_t slot, const T& v, const T& empty)
+{
+  if (slot < head) {
+    return;
+  }
+  // Fill skipped slots as gaps (at most one ring length).
+  if (slot - head > len) {
+    head = slot - len;
+  }
+  for (; head < slot; head++) {
+    ring[head % len] = empty;
+  }
+  ring[slot % len] = v;
+  head = slot + 1;
+}
+
+static void WS_Hist_AccAdd(WS_HistAcc& a, int16_t lo, int16_t hi, int32_t sum, uint32_t n)
+{
+  if (n == 0) {
+    return;
+  }
+  if (a.n == 0) {
+    a.min = lo;
+    a.max = hi;
+  } else {
+    if (lo < a.min) a.min = lo;
+    if (hi > a.max) a.max = hi;
+  }
+  a.sum += sum;
+  a.n += n;
+}
+
+static void WS_Hist_AccMerge(WS_HistAcc& into, const WS_HistAcc& from)
+{
+  WS_Hist_AccAdd(into, from.min, from.max, from.sum, from.n);
+}
+
+static WS_HistAgg WS_Hist_AccAgg(const WS_HistAcc& a)
+{
+  WS_HistAgg g;
+  if (a.n > 0) {
+    g.min = a.min;
+    g.max = a.max;
+    g.mean = (int16_t)((a.sum >= 0) ? (a.sum + (int32_t)(a.n / 2)) / (int32_t)a.n
+                                    : (a.sum - (int32_t)(a.n / 2)) / (int32_t)a.n);
+  }
+  return g;
+}
+
+static void WS_Hist_Sample(WS_HistSeries& h, uint32_t s, int16_t v)
+{
+  WS_Hist_Put(h.raw, HISTORY_RAW_LEN, h.raw_head, s, v, WS_HIST_NODATA);
+
+  const uint32_t m = s / 60U;
+  if (h.acc_min.open && h.acc_min.slot != m) {
+    // Minute done: commit it and fold it into the hour.
+    const WS_HistAgg empty;
+    WS_Hist_Put(h.mins, HISTORY_MIN_LEN, h.min_head, h.acc_min.slot, WS_Hist_AccAgg(h.acc_min), empty);
+    const uint32_t hs = h.acc_min.slot / 60U;
+    if (h.acc_hour.open && h.acc_hour.slot != hs) {
+      WS_Hist_Put(h.hours, HISTORY_HOUR_LEN, h.hour_head, h.acc_hour.slot, WS_Hist_AccAgg(h.acc_hour), empty);
+      h.acc_hour = WS_HistAcc();
+    }
+    h.acc_hour.open = true;
+    h.acc_hour.slot = hs;
+    WS_Hist_AccMerge(h.acc_hour, h.acc_min);
+    h.acc_min = WS_HistAcc();
+  }
+  h.acc_min.open = true;
+  h.acc_min.slot = m;
+  if (v != WS_HIST_NODATA) {
+    WS_Hist_AccAdd(h.acc_min, v, v, v, 1);
+  }
+}
+
+static int16_t WS_Hist_ReadSensor(uint8_t series)
+{
+  const bool temp = (series >= HISTORY_SENSOR_COUNT);
+  const WS_SensorSlot* s = WS_Sensor_Get((uint8_t)(temp ? series - HISTORY_SENSOR_COUNT : series));
+  if (!s || !s->online || !s->has_value) {
+    return WS_HIST_NODATA;
+  }
+  if (temp) {
+    return (s->has_temp && s->temp_x10 != WS_HIST_NODATA) ? s->temp_x10 : WS_HIST_NODATA;
+  }
+  return (int16_t)min((uint16_t)32767, s->filt_mm);
+}
+
+void WS_History_Init()
+{
+  for (uint8_t i = 0; i < WS_History_SeriesCount(); i++) {
+    WS_HistSeries& h = Hist_Series[i];
+    h.raw_head = h.min_head = h.hour_head = 0;
+    h.acc_min = WS_HistAcc();
+    h.acc_hour = WS_HistAcc();
+  }
+  Hist_Seconds = 0;
+  Hist_LastTickMs = millis();
+  Hist_EpochValid = false;
+  Hist_Started = true;
+}
+
+void WS_History_Loop()
+{
+  if (!HISTORY_Enable || !Hist_Started) {
+    return;
+  }
+  const uint32_t now = millis();
+  if ((now - Hist_LastTickMs) < 1000UL) {
+    return;
+  }
+  // Catch up after a stall; the skipped seconds become gaps.
+  const uint32_t steps = (now - Hist_LastTickMs) / 1000UL;
+  Hist_LastTickMs += steps * 1000UL;
+  Hist_Seconds += steps;
+
+  if (WS_Time_IsValid()) {
+    const uint32_t base = WS_Time_NowEpoch() - Hist_Seconds;
+    // Follow NTP corrections, ignore +-1 s jitter between the two clocks.
+    if (!Hist_EpochValid || base > Hist_EpochBase + 1U || base + 1U < Hist_EpochBase) {
+      Hist_EpochBase = base;
+      Hist_EpochValid = true;
+    }
+  }
+
+  for (uint8_t i = 0; i < WS_History_SeriesCount(); i++) {
+    WS_Hist_Sample(Hist_Series[i], Hist_Seconds, WS_Hist_ReadSensor(i));
+  }
+}
+
+bool WS_History_ClockIsEpoch()
+{
+  return Hist_EpochValid;
+}
+
+uint32_t WS_History_Now()
+{
+  return Hist_Seconds + (Hist_EpochValid ? Hist_EpochBase : 0);
+}
+
+uint8_t WS_History_SeriesCount()
+{
+  return HISTORY_Enable ? (uint8_t)WS_HIST_SERIES_MAX : 0;
+}
+
+const char* WS_History_SeriesName(uint8_t series)
+{
+  static char name[12];
+  if (series >= WS_History_SeriesCount()) {
+    return "";
+  }
+  if (series < HISTORY_SENSOR_COUNT) {
+    snprintf(name, sizeof(name), "level%u", (unsigned)series);
+  } else {
+    snprintf(name, sizeof(name), "temp%u", (unsigned)(series - HISTORY_SENSOR_COUNT));
+  }
+  return name;
+}
+
+int16_t WS_History_FindSeries(const char* name)
+{
+  if (!name) {
+    return -1;
+  }
+  for (uint8_t i = 0; i < WS_History_SeriesCount(); i++) {
+    if (strcmp(name, WS_History_SeriesName(i)) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static uint32_t WS_Hist_ToInternal(uint32_t t)
+{
+  if (!Hist_EpochValid) {
+    return t;
+  }
+  return (t > Hist_EpochBase) ? t - Hist_EpochBase : 0;
+}
+
+bool WS_History_Plan(uint8_t series, uint32_t from, uint32_t to, int8_t tier, WS_HistQuery& q)
+{
+  if (series >= WS_History_SeriesCount()) {
+    return false;
+  }
+  uint32_t a = WS_Hist_ToInternal(from);
+  uint32_t b = min(WS_Hist_ToInternal(to), Hist_Seconds);
+  if (a > b) {
+    return false;
+  }
+  if (tier < 0) {
+    const uint32_t age = Hist_Seconds - a;
+    tier = (age < HISTORY_RAW_LEN) ? WS_HIST_RAW : (age < HISTORY_MIN_LEN * 60UL) ? WS_HIST_MIN : WS_HIST_HOUR;
+  }
+
+  const WS_HistSeries& h = Hist_Series[series];
+  uint32_t step = 1, len = HISTORY_RAW_LEN, head = h.raw_head;
+  if (tier == WS_HIST_MIN) {
+    step = 60;
+    len = HISTORY_MIN_LEN;
+    head = h.acc_min.slot + 1U;          // in-progress minute is readable
+  } else if (tier == WS_HIST_HOUR) {
+    step = 3600;
+    len = HISTORY_HOUR_LEN;
+    head = Hist_Seconds / 3600U + 1U;
+  } else {
+    tier = WS_HIST_RAW;
+  }
+  uint32_t first = a / step;
+  const uint32_t last = b / step;
+  if (head > len && first < head - len) {
+    first = head - len;
+  }
+  if (first > last) {
+    return false;
+  }
+  q.series = series;
+  q.tier = (WS_HistTier)tier;
+  q.first_slot = first;
+  q.count = last - first + 1U;
+  q.step_s = step;
+  q.t0 = first * step + (Hist_EpochValid ? Hist_EpochBase : 0);
+  return true;
+}
+
+WS_HistAgg WS_History_Get(const WS_HistQuery& q, uint32_t i)
+{
+  WS_HistAgg g;
+  if (q.series >= WS_History_SeriesCount() || i >= q.count) {
+    return g;
+  }
+  const WS_HistSeries& h = Hist_Series[q.series];
+  const uint32_t slot = q.first_slot + i;
+
+  if (q.tier == WS_HIST_RAW) {
+    if (slot < h.raw_head && h.raw_head - slot <= HISTORY_RAW_LEN) {
+      g.min = g.max = g.mean = h.raw[slot % HISTORY_RAW_LEN];
+    }
+    return g;
+  }
+  if (q.tier == WS_HIST_MIN) {
+    if (h.acc_min.open && slot == h.acc_min.slot) {
+      return WS_Hist_AccAgg(h.acc_min);
+    }
+    if (slot < h.min_head && h.min_head - slot <= HISTORY_MIN_LEN) {
+      g = h.mins[slot % HISTORY_MIN_LEN];
+    }
+    return g;
+  }
+  // Current hour = finished minutes of the hour + the minute being filled.
+  WS_HistAcc cur;
+  bool isCur = false;
+  if (h.acc_hour.open && slot == h.acc_hour.slot) {
+    WS_Hist_AccMerge(cur, h.acc_hour);
+    isCur = true;
+  }
+  if (h.acc_min.open && slot == h.acc_min.slot / 60U) {
+    WS_Hist_AccMerge(cur, h.acc_min);
+    isCur = true;
+  }
+  if (isCur) {
+    return WS_Hist_AccAgg(cur);
+  }
+  if (slot < h.hour_head && h.hour_head - slot <= HISTORY_HOUR_LEN) {
+    g = h.hours[slot % HISTORY_HOUR_LEN];
+  }
+  return g;
+}
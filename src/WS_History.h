@@ -0,0 +1,81 @@
+#ifndef _WS_HISTORY_H_
+#define _WS_HISTORY_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "WS_Information.h"
+
+// In-RAM multi-resolution history of the sensor table (fixed memory, ring buffers).
+// Every series has three tiers, all updated incrementally from the 1 Hz sampler:
+//   raw   1 s samples                 last HISTORY_RAW_LEN s   (10 min)
+//   min   1 min min/max/mean          last HISTORY_MIN_LEN min (24 h)
+//   hour  1 h min/max/mean            last HISTORY_HOUR_LEN h  (30 days)
+// Series: "level<i>" (filtered mm) and "temp<i>" (0.1 C) for the first
+// HISTORY_SENSOR_COUNT sensors. Gaps (sensor offline, loop stalled) are stored as
+// WS_HIST_NODATA. Memory: ~14 KB per series with the defaults.
+
+#ifndef HISTORY_Enable
+#define HISTORY_Enable true
+#endif
+#ifndef HISTORY_SENSOR_COUNT
+#define HISTORY_SENSOR_COUNT 2
+#endif
+#ifndef HISTORY_TEMP_Enable
+#define HISTORY_TEMP_Enable true
+#endif
+#ifndef HISTORY_RAW_LEN
+#define HISTORY_RAW_LEN 600
+#endif
+#ifndef HISTORY_MIN_LEN
+#define HISTORY_MIN_LEN 1440
+#endif
+#ifndef HISTORY_HOUR_LEN
+#define HISTORY_HOUR_LEN 720
+#endif
+
+#define WS_HIST_NODATA ((int16_t)-32768)
+#define WS_HIST_SERIES_MAX (HISTORY_SENSOR_COUNT * (HISTORY_TEMP_Enable ? 2 : 1))
+
+enum WS_HistTier : uint8_t {
+  WS_HIST_RAW = 0,
+  WS_HIST_MIN = 1,
+  WS_HIST_HOUR = 2
+};
+
+struct WS_HistAgg {
+  int16_t min = WS_HIST_NODATA;
+  int16_t max = WS_HIST_NODATA;
+  int16_t mean = WS_HIST_NODATA;
+};
+
+// A planned read: `count` points of `step_s` seconds, the first one at `t0`
+// (same clock as WS_History_Now()).
+struct WS_HistQuery {
+  uint8_t series = 0;
+  WS_HistTier tier = WS_HIST_RAW;
+  uint32_t first_slot = 0;
+  uint32_t count = 0;
+  uint32_t step_s = 1;
+  uint32_t t0 = 0;
+};
+
+void WS_History_Init();
+void WS_History_Loop();            // call from loop(); samples the sensor table at 1 Hz
+
+// Query clock: local epoch seconds once NTP time is valid, otherwise uptime seconds.
+bool WS_History_ClockIsEpoch();
+uint32_t WS_History_Now();
+
+uint8_t WS_History_SeriesCount();
+const char* WS_History_SeriesName(uint8_t series);      // "level0", "temp0", ...
+int16_t WS_History_FindSeries(const char* name);        // -1 if unknown
+
+// Plan a read of [from, to] (inclusive). tier < 0 picks the finest tier that covers `from`.
+// Returns false for an unknown series or an empty range.
+bool WS_History_Plan(uint8_t series, uint32_t from, uint32_t to, int8_t tier, WS_HistQuery& q);
+
+// Point i of a planned read. Raw points have min == max == mean. The newest
+// min/hour point may be the bucket still being filled.
+WS_HistAgg WS_History_Get(const WS_HistQuery& q, uint32_t i);
+
+#endif
@@ -47,8 +47,36 @@
 #define MQTT_Sub                     "fish1/device/command"
 #define MQTT_TELEMETRY_INTERVAL_MS   3000UL
 #define MQTT_PUBLISH_ON_CHANGE_Enable true
+#define MQTT_TELEMETRY_DELTA_Enable  true     // between keyframes publish only changed fields (JSON Merge Patch + seq)
+#define MQTT_TELEMETRY_KEYFRAME_MS   300000UL // full state at least this often (also on reconnect / "keyframe" cmd)
 // Push appended log lines to "<device_id>/device/log/<name>" (plain text), for cloud panel caching.
 #define MQTT_LOG_PUSH_Enable        true
+#define MQTT_LOG_QUEUE_BYTES        2048     // RAM queue per log; when full the oldest lines are dropped
+#define MQTT_LOG_BATCH_MS           2000UL   // pushed lines are coalesced for up to this long ...
+#define MQTT_LOG_BATCH_BYTES        1024     // ... or until a batch reaches this many bytes
+#define MQTT_MSGPACK_Enable          true     // allow the server to switch telemetry/replies to MessagePack ("<topic>/mp")
+#define MQTT_TELEMETRY_GROUPS_Enable false    // also publish per-group topics "<MQTT_Pub>/<group>" by default ("telemetry" cmd changes it at runtime)
+#define MQTT_TELEMETRY_GROUP_TICK_MS 250UL    // how often changed groups are looked for
+#define MQTT_BATCH_Enable            false    // batch timestamped samples to "<MQTT_Pub>/batch" instead of interval state ("batch" cmd)
+#define MQTT_BATCH_SAMPLE_MS         1000UL   // sampling period while batching
+#define MQTT_BATCH_FLUSH_S           30       // publish a batch at least this often ...
+#define MQTT_BATCH_SAMPLES           30       // ... or when it holds this many samples (RAM ring size, max 255)
+#define MQTT_OUTBOX_Enable           true     // offline: keep batches / log pushes on LittleFS (/outbox.N) and replay them in order
+#define MQTT_OUTBOX_SEGMENT_BYTES    65536UL  // outbox segment size; one message must fit in a segment
+#define MQTT_OUTBOX_SEGMENTS         8        // outbox full => the oldest segment is dropped
+#define MQTT_OUTBOX_REPLAY_MS        250UL    // replay pacing: one step this often ...
+#define MQTT_OUTBOX_REPLAY_MSGS      2        // ... of at most this many messages ...
+#define MQTT_OUTBOX_REPLAY_BYTES     4096UL   // ... or payload bytes
+#define MQTT_OUTBOX_BACKOFF_MAX_MS   10000UL  // longest pause after failed replay publishes
+#define MQTT_QOS1_Enable             true     // batches, outbox replay, log pushes, RPC replies go QoS1 (resent until PUBACK)
+#define MQTT_QOS1_INFLIGHT           8        // QoS1 messages awaiting PUBACK at most ...
+#define MQTT_QOS1_WINDOW_BYTES       16384UL  // ... and their bytes (RAM); larger messages go QoS0
+#define MQTT_QOS1_RETRY_MS           5000UL   // resend (DUP) a message without PUBACK after this long
+#define MQTT_RECONNECT_MIN_MS        1000UL   // wait after the first failed connect, doubling ...
+#define MQTT_RECONNECT_MAX_MS        60000UL  // ... up to this, +-25% random jitter
+#define MQTT_CONNECT_TIMEOUT_MS      5000UL   // per connect step (DNS, TCP, CONNACK), all polled in the background
+#define MQTT_KEEPALIVE_S             15       // MQTT keepalive
+#define MQTT_CHUNK_BYTES            2048     // raw bytes per chunked get_log / get_config reply
 
 // ===================== 4G Module (Air780E AT) =====================
 #define AIR780E_Enable             false
@@ -65,6 +93,8 @@
   // Sensor role mapping: ID001 = inner pond, ID002 = outer pond
   #define INNER_POND_SENSOR_ID          0x01
   #define OUTER_POND_SENSOR_ID          0x02
+  // Full RS485 sensor table (Modbus IDs, max 8). Index 0/1 = inner/outer; leveldiff rules pick indices.
+  #define SENSOR_IDS                    { INNER_POND_SENSOR_ID, OUTER_POND_SENSOR_ID }
   #define GATE_AUTO_CONTROL_Enable      true
   #define GATE_RELAY_ACTION_SECONDS     10
   #define GATE_LEVEL_EQUAL_TOL_MM       30
@@ -77,13 +107,38 @@
 // ===================== Sensor Safety =====================
 #define SENSOR_DATA_TIMEOUT_MS         6000
 #define SENSOR_ONLINE_GRACE_MS         3000   // only report sensor offline when no valid frame for > this duration
+#define SENSOR_POLL_PERIOD_MS          2000   // nominal per-sensor poll interval (start value, and after a failed poll)
+#define SENSOR_POLL_ADAPTIVE_Enable    1      // fast polling while the gate moves / level changes, back off when stable
+#define SENSOR_POLL_FAST_MS            200    // per-sensor interval while active
+#define SENSOR_POLL_SLOW_MS            10000  // per-sensor interval when the level is stable
+#define SENSOR_POLL_NOISE_MM           3      // level steps up to this size are treated as noise
+#define SENSOR_POLL_FAST_RATE_MM_MIN   60     // level change faster than this (mm/min) -> fast polling
 #define SENSOR_MODBUS_TIMEOUT_MS       250    // single Modbus RTU response timeout (ms)
 #define SENSOR_MODBUS_RETRY_GAP_MS     80     // delay between Modbus retries (ms)
 #define SENSOR_MODBUS_RETRY_COUNT      2      // 2 = first try + 1 retry
+#define SENSOR_MODBUS_QUIET_MS         5      // RX must stay silent this long before a request is sent (ms)
+#define SENSOR_MODBUS_BAUDRATE         9600   // RS485 sensor bus baud rate (UART1, 8N1)
+#define SENSOR_TASK_Enable             1      // 1 = sensor bus runs in its own FreeRTOS task, 0 = polled from loop()
+#define SENSOR_TASK_CORE               0      // core for the sensor task (loop() runs on core 1)
 #define LEVEL_JUMP_THRESHOLD_MM_PER_S  1000
 #define LEVEL_MIN_MM                   0
 #define LEVEL_MAX_MM                   10000
 
+// ===================== History (RAM) =====================
+#define HISTORY_Enable                 true   // 1 s / 1 min / 1 h ring buffers served by GET /api/history
+#define HISTORY_SENSOR_COUNT           2      // sensors (from index 0) with history; ~14 KB RAM per series
+#define HISTORY_TEMP_Enable            true   // also keep temperature series
+
+// ===================== File Log =====================
+#define LOG_FLUSH_BYTES                768      // staged log bytes that trigger a write to flash
+#define LOG_FLUSH_INTERVAL_MS          10000UL  // max age of a staged log line (errors are written at once)
+#define LOG_SEGMENT_BYTES              65536UL  // data bytes per log segment file (multiple of 512)
+#define LOG_SEGMENTS                   8        // segment files per log (2..16); a wrap drops the oldest one
+#define LOG_INDEX_STEP                 4096UL   // text logs: bytes between time index entries
+#define LOG_DEFER_Enable               true     // action log: pack raw args on the call, format in WS_Log_Loop()
+#define LOG_DEFER_SLOTS                16       // pending deferred lines (~130 bytes each)
+#define LOG_DEFER_ARG_BYTES            112      // packed argument bytes per line; longer strings are cut
+
 // ===================== Serial Log =====================
 #define SERIAL_LEVEL_LOG_Enable             true
 #define SERIAL_LEVEL_LOG_INTERVAL_MS        8000
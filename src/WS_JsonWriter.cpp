@@ -0,0 +1,81 @@
+#include "WS_JsonWriter.h"
+
+template <typename T>
+static T Member(const void* obj, uint16_t offset)
+{
+  T v;
+  memcpy(&v, static_cast<const uint8_t*>(obj) + offset, sizeof(v));
+  return v;
+}
+
+static void WriteValue(WS_JsonWriter& w, const WS_JsonField& f, const void* obj)
+{
+  const char* p = static_cast<const char*>(obj) + f.offset;
+  switch (f.type) {
+    case WS_JT_BOOL:
+      w.Bool(Member<bool>(obj, f.offset));
+      break;
+    case WS_JT_U8:
+      w.Uint(Member<uint8_t>(obj, f.offset));
+      break;
+    case WS_JT_U16:
+      w.Uint(Member<uint16_t>(obj, f.offset));
+      break;
+    case WS_JT_U32:
+      w.Uint(Member<uint32_t>(obj, f.offset));
+      break;
+    case WS_JT_U64:
+      w.Uint64(Member<uint64_t>(obj, f.offset));
+      break;
+    case WS_JT_I16:
+      w.Int(Member<int16_t>(obj, f.offset));
+      break;
+    case WS_JT_I32:
+      w.Int(Member<int32_t>(obj, f.offset));
+      break;
+    case WS_JT_STR:
+      w.Str(p, f.size ? (size_t)f.size - 1 : 0);
+      break;
+    case WS_JT_OBJ:
+      WS_Json_WriteObject(w, f.sub, f.sub_count, p);
+      break;
+    case WS_JT_ARR: {
+      uint8_t count = Member<uint8_t>(obj, f.count_offset);
+      if (count > f.max_count) {
+        count = f.max_count;
+      }
+      w.Char('[');
+      for (uint8_t i = 0; i < count; i++) {
+        if (i > 0) {
+          w.Char(',');
+        }
+        WS_Json_WriteObject(w, f.sub, f.sub_count, p + (size_t)i * f.size);
+      }
+      w.Char(']');
+      break;
+    }
+    default:
+      w.Raw("null", 4);
+      break;
+  }
+}
+
+void WS_Json_WriteMember(WS_JsonWriter& w, const WS_JsonField& f, const void* obj)
+{
+  w.Char('"');
+  w.Raw(f.key, f.key_len);
+  w.Raw("\":", 2);
+  WriteValue(w, f, obj);
+}
+
+void WS_Json_WriteObject(WS_JsonWriter& w, const WS_JsonField* fields, size_t n, const void* obj)
+{
+  w.Char('{');
+  for (size_t i = 0; i < n; i++) {
+    if (i > 0) {
+      w.Char(',');
+    }
+    WS_Json_WriteMember(w, fields[i], obj);
+  }
+  w.Char('}');
+}
@@ -0,0 +1,251 @@
+#ifndef _WS_JSON_WRITER_H_
+#define _WS_JSON_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// Schema-driven JSON writer (no Arduino dependencies, builds on the host as well).
+//
+// A plain struct is described once by a constexpr table of WS_JsonField entries (key,
+// type and offset, deduced from the member by WS_JSON_FIELD). From the table:
+// - WS_Json_WriteObject() writes the struct as a JSON object, escaping strings on the
+//   fly (no scratch buffers, no printf);
+// - WS_Json_ObjectBound() is the maximum output length, a compile-time constant that
+//   can be static_assert'ed against the buffer it is written into.
+//
+// Output goes straight into a caller buffer, or through a small staging buffer to a
+// sink (HTTP chunks, MQTT stream). Strings are escaped like WS_JsonEscape(): '"' and
+// '\' get a backslash, control characters become spaces.
+
+typedef void (*WS_JsonSink)(void* ctx, const char* data, size_t len);
+
+class WS_JsonWriter {
+ public:
+  // Into buf (NUL terminated); overflow() is set if cap was too small.
+  WS_JsonWriter(char* buf, size_t cap) : buf_(buf), cap_(cap), sink_(nullptr), ctx_(nullptr) {}
+  // Through a staging buffer to sink; call Flush() at the end.
+  WS_JsonWriter(WS_JsonSink sink, void* ctx) : buf_(stage_), cap_(sizeof(stage_)), sink_(sink), ctx_(ctx) {}
+
+  void Raw(const char* s, size_t n)
+  {
+    while (n > 0) {
+      size_t room = Room();
+      if (room == 0) {
+        if (!sink_) {
+          overflow_ = true;
+          return;
+        }
+        Flush();
+        room = Room();
+      }
+      const size_t k = (n < room) ? n : room;
+      memcpy(buf_ + used_, s, k);
+      used_ += k;
+      total_ += k;
+      s += k;
+      n -= k;
+    }
+    Terminate();
+  }
+
+  void Char(char c) { Raw(&c, 1); }
+
+  void Uint(uint32_t v)
+  {
+    char tmp[10];
+    size_t n = 0;
+    do {
+      tmp[sizeof(tmp) - 1 - n++] = (char)('0' + v % 10U);
+      v /= 10U;
+    } while (v != 0);
+    Raw(tmp + sizeof(tmp) - n, n);
+  }
+
+  void Uint64(uint64_t v)
+  {
+    if (v <= 0xFFFFFFFFULL) {
+      Uint((uint32_t)v);
+      return;
+    }
+    char tmp[20];
+    size_t n = 0;
+    do {
+      tmp[sizeof(tmp) - 1 - n++] = (char)('0' + (unsigned)(v % 10U));
+      v /= 10U;
+    } while (v != 0);
+    Raw(tmp + sizeof(tmp) - n, n);
+  }
+
+  void Int(int32_t v)
+  {
+    if (v < 0) {
+      Char('-');
+      Uint((uint32_t)0 - (uint32_t)v);
+    } else {
+      Uint((uint32_t)v);
+    }
+  }
+
+  void Bool(bool v) { v ? Raw("true", 4) : Raw("false", 5); }
+
+  // Quoted and escaped; stops at NUL or after maxLen bytes.
+  void Str(const char* s, size_t maxLen)
+  {
+    Char('"');
+    size_t from = 0;   // start of the plain run, copied in one go
+    size_t i = 0;
+    for (; i < maxLen && s[i] != '\0'; i++) {
+      const char c = s[i];
+      if (c != '"' && c != '\\' && (unsigned char)c >= 0x20) {
+        continue;
+      }
+      Raw(s + from, i - from);
+      from = i + 1;
+      if ((unsigned char)c < 0x20) {
+        Char(' ');
+      } else {
+        const char esc[2] = {'\\', c};
+        Raw(esc, 2);
+      }
+    }
+    Raw(s + from, i - from);
+    Char('"');
+  }
+
+  void Flush()
+  {
+    if (sink_ && used_ > 0) {
+      sink_(ctx_, buf_, used_);
+      used_ = 0;
+    }
+  }
+
+  size_t length() const { return total_; }
+  bool overflow() const { return overflow_; }
+
+ private:
+  size_t Room() const
+  {
+    const size_t limit = sink_ ? cap_ : (cap_ > 0 ? cap_ - 1 : 0);   // keep room for NUL
+    return (used_ < limit) ? limit - used_ : 0;
+  }
+
+  void Terminate()
+  {
+    if (!sink_ && cap_ > 0) {
+      buf_[used_] = '\0';
+    }
+  }
+
+  char stage_[64];
+  char* buf_;
+  size_t cap_;
+  WS_JsonSink sink_;
+  void* ctx_;
+  size_t used_ = 0;
+  size_t total_ = 0;
+  bool overflow_ = false;
+};
+
+// ---------------- schema ----------------
+enum WS_JsonType : uint8_t {
+  WS_JT_BOOL,
+  WS_JT_U8,
+  WS_JT_U16,
+  WS_JT_U32,
+  WS_JT_U64,
+  WS_JT_I16,
+  WS_JT_I32,
+  WS_JT_STR,     // char[size], NUL terminated or full
+  WS_JT_OBJ,     // nested struct, described by sub
+  WS_JT_ARR      // array of structs: count in a uint8_t member, elements described by sub
+};
+
+struct WS_JsonField {
+  const char* key;
+  uint8_t key_len;
+  uint8_t type;
+  uint16_t offset;            // member offset in the described struct
+  uint16_t size;              // STR: array size, ARR: element stride
+  const WS_JsonField* sub;    // OBJ / ARR
+  uint8_t sub_count;
+  uint8_t max_count;          // ARR: array capacity
+  uint16_t count_offset;      // ARR: offset of the uint8_t element count
+};
+
+template <typename T, typename Enable = void> struct WS_JsonTypeOf;
+template <> struct WS_JsonTypeOf<bool> { static constexpr uint8_t value = WS_JT_BOOL; };
+template <> struct WS_JsonTypeOf<uint8_t> { static constexpr uint8_t value = WS_JT_U8; };
+template <> struct WS_JsonTypeOf<uint16_t> { static constexpr uint8_t value = WS_JT_U16; };
+template <> struct WS_JsonTypeOf<uint32_t> { static constexpr uint8_t value = WS_JT_U32; };
+template <> struct WS_JsonTypeOf<uint64_t> { static constexpr uint8_t value = WS_JT_U64; };
+template <> struct WS_JsonTypeOf<int16_t> { static constexpr uint8_t value = WS_JT_I16; };
+template <> struct WS_JsonTypeOf<int32_t> { static constexpr uint8_t value = WS_JT_I32; };
+template <size_t N> struct WS_JsonTypeOf<char[N]> { static constexpr uint8_t value = WS_JT_STR; };
+// int is int32_t on the ESP32 toolchain but a distinct type elsewhere.
+template <typename T>
+struct WS_JsonTypeOf<T, typename std::enable_if<std::is_same<T, int>::value && !std::is_same<int, int32_t>::value>::type> {
+  static constexpr uint8_t value = WS_JT_I32;
+};
+template <typename T>
+struct WS_JsonTypeOf<T, typename std::enable_if<std::is_same<T, unsigned>::value && !std::is_same<unsigned, uint32_t>::value>::type> {
+  static constexpr uint8_t value = WS_JT_U32;
+};
+
+#define WS_JSON_MEMBER_TYPE(S, m) typename std::remove_reference<decltype(((S*)nullptr)->m)>::type
+
+// key must be a string literal. Scalar or char[] member; the JSON type follows from the C++ type.
+#define WS_JSON_FIELD(S, m, key) \
+  WS_JsonField{key, (uint8_t)(sizeof(key) - 1), WS_JsonTypeOf<WS_JSON_MEMBER_TYPE(S, m)>::value, (uint16_t)offsetof(S, m), (uint16_t)sizeof(((S*)nullptr)->m), nullptr, 0, 0, 0}
+
+// Struct member m written as an object with schema sub (a constexpr WS_JsonField array).
+#define WS_JSON_OBJECT(S, m, key, sub) \
+  WS_JsonField{key, (uint8_t)(sizeof(key) - 1), WS_JT_OBJ, (uint16_t)offsetof(S, m), 0, sub, (uint8_t)(sizeof(sub) / sizeof(sub[0])), 0, 0}
+
+// Element i of array member m written as an object.
+#define WS_JSON_ELEMENT(S, m, i, key, sub) \
+  WS_JsonField{key, (uint8_t)(sizeof(key) - 1), WS_JT_OBJ, (uint16_t)(offsetof(S, m) + (i) * sizeof(((S*)nullptr)->m[0])), 0, sub, \
+               (uint8_t)(sizeof(sub) / sizeof(sub[0])), 0, 0}
+
+// Array member m (T m[N]) with the element count in member count.
+#define WS_JSON_ARRAY(S, m, count, key, sub) \
+  WS_JsonField{key, (uint8_t)(sizeof(key) - 1), WS_JT_ARR, (uint16_t)offsetof(S, m), (uint16_t)sizeof(((S*)nullptr)->m[0]), sub, \
+               (uint8_t)(sizeof(sub) / sizeof(sub[0])), \
+               (uint8_t)(sizeof(((S*)nullptr)->m) / sizeof(((S*)nullptr)->m[0])), (uint16_t)offsetof(S, count)}
+
+// ---------------- compile-time size bound ----------------
+constexpr size_t WS_Json_ObjectBound(const WS_JsonField* f, size_t n);
+
+constexpr size_t WS_Json_ValueBound(const WS_JsonField& f)
+{
+  return (f.type == WS_JT_BOOL) ? 5
+       : (f.type == WS_JT_U8) ? 3
+       : (f.type == WS_JT_U16) ? 5
+       : (f.type == WS_JT_U32) ? 10
+       : (f.type == WS_JT_U64) ? 20
+       : (f.type == WS_JT_I16) ? 6
+       : (f.type == WS_JT_I32) ? 11
+       : (f.type == WS_JT_STR) ? 2 + 2 * (size_t)(f.size - 1)
+       : (f.type == WS_JT_OBJ) ? WS_Json_ObjectBound(f.sub, f.sub_count)
+       : 2 + (size_t)f.max_count * WS_Json_ObjectBound(f.sub, f.sub_count) + (f.max_count ? f.max_count - 1 : 0);
+}
+
+constexpr size_t WS_Json_FieldsBound(const WS_JsonField* f, size_t n)
+{
+  return (n == 0) ? 0 : (size_t)f->key_len + 3 + WS_Json_ValueBound(*f) + WS_Json_FieldsBound(f + 1, n - 1);
+}
+
+// "{" + fields + commas + "}"
+constexpr size_t WS_Json_ObjectBound(const WS_JsonField* f, size_t n)
+{
+  return 2 + WS_Json_FieldsBound(f, n) + (n ? n - 1 : 0);
+}
+
+// ---------------- runtime ----------------
+void WS_Json_WriteObject(WS_JsonWriter& w, const WS_JsonField* fields, size_t n, const void* obj);
+// One "key":value pair, for callers that pick members out of a table.
+void WS_Json_WriteMember(WS_JsonWriter& w, const WS_JsonField& f, const void* obj);
+
+#endif
@@ -1,18 +1,67 @@
 #include "WS_Log.h"
 #include "WS_FS.h"
+#include "WS_LogRing.h"
 
 #include <LittleFS.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 static uint32_t (*g_nowEpoch)() = nullptr;
 static WS_LogLineSink g_sink = nullptr;
 
-static const char* kErrorPath = "/log_error.txt";
-static const char* kMeasurePath = "/log_measure.txt";
-static const char* kActionPath = "/log_action.txt";
-static const size_t kMaxBytes = 256U * 1024U;
+#ifndef LOG_BUFFER_BYTES
+#define LOG_BUFFER_BYTES 1024          // RAM staging per stream
+#endif
+#ifndef LOG_FLUSH_BYTES
+#define LOG_FLUSH_BYTES 768            // flush once this much is staged
+#endif
+#ifndef LOG_FLUSH_INTERVAL_MS
+#define LOG_FLUSH_INTERVAL_MS 10000UL  // ... or once the oldest staged line is this old
+#endif
+
+#ifndef LOG_SEGMENT_BYTES
+#define LOG_SEGMENT_BYTES 65536UL      // data bytes per segment file (multiple of 512)
+#endif
+#ifndef LOG_SEGMENTS
+#define LOG_SEGMENTS 8                 // segment files per log; a wrap drops the oldest one
+#endif
+#ifndef LOG_INDEX_STEP
+#define LOG_INDEX_STEP 4096UL          // text logs: one time index entry per this many bytes
+#endif
+
+static const uint32_t kEpochValid = 1609459200UL;  // earlier values are uptime, not wall time
+static const uint32_t kQuerySlackS = 300;          // tolerate clock steps before ending a query
+
+static_assert(LOG_SEGMENT_BYTES % WS_MLOG_BLOCK_BYTES == 0, "segments must hold whole measure blocks");
+static_assert(LOG_SEGMENT_BYTES >= 4 * LOG_BUFFER_BYTES, "segment too small for a flush");
+
+// One log: RAM staging in front of a segment ring (WS_LogRing.h). The ring keeps
+// the head segment's append handle open and tracks sizes, so flushes don't stat files.
+struct WS_LogStream {
+  const char* base;            // segment files are <base>.0 ... <base>.<LOG_SEGMENTS-1>
+  const char* legacy;          // pre-ring single file, imported once at boot
+  const char* name;
+  const char* tag;
+  bool flush_each_line;        // errors go to flash right away
+  bool binary;                 // WS_MeasCodec blocks, never split across segments
+  char buf[LOG_BUFFER_BYTES];
+  size_t len;
+  uint32_t first_ms;           // millis() of the oldest staged line
+  uint32_t first_t;            // epoch of the oldest staged line, 0 = unknown
+  WS_LogRing ring;
+  WS_LogStats st;
+};
+
+static WS_LogStream g_streams[] = {
+  {"/log_error", "/log_error.txt", "error", "ERR", true, false, {0}, 0, 0, 0, WS_LogRing(), WS_LogStats()},
+  {"/log_measure", "/log_measure.bin", "measure", "MEAS", false, true, {0}, 0, 0, 0, WS_LogRing(), WS_LogStats()},
+  {"/log_action", "/log_action.txt", "action", "ACT", false, false, {0}, 0, 0, 0, WS_LogRing(), WS_LogStats()},
+};
+static const uint8_t kStreamCount = sizeof(g_streams) / sizeof(g_streams[0]);
+static WS_MLogEncoder g_measEnc;
 
 static bool FormatEpochTs(uint32_t epoch, char* out, size_t outSize)
 {
@@ -35,105 +84,873 @@ static bool FormatEpochTs(uint32_t epoch, char* out, size_t outSize)
   return true;
 }
 
-static void RotateIfNeeded(const char* path)
+static WS_LogStream* FindStream(const char* name)
 {
+  for (uint8_t i = 0; name && i < kStreamCount; i++) {
+    if (strcmp(g_streams[i].name, name) == 0) {
+      return &g_streams[i];
+    }
+  }
+  return nullptr;
+}
+
+static bool OpenStream(WS_LogStream& s)
+{
+  if (s.ring.ready) {
+    return true;
+  }
   if (!WS_FS_EnsureMounted()) {
-    return;
+    return false;
   }
-  File f = LittleFS.open(path, "r");
-  if (!f) {
+  // Measure blocks carry their own time (block headers), so only text logs get an index.
+  return WS_LogRing_Open(s.ring, s.base, LOG_SEGMENTS, LOG_SEGMENT_BYTES, s.binary ? 0 : LOG_INDEX_STEP);
+}
+
+static void FlushStream(WS_LogStream& s)
+{
+  if (s.len == 0) {
     return;
   }
-  const size_t sz = (size_t)f.size();
-  f.close();
-  if (sz < kMaxBytes) {
+  const uint32_t t0 = micros();
+  if (!OpenStream(s)) {
+    // Keep the lines; a later flush may succeed once the FS is back.
     return;
   }
+  const uint32_t switches = s.ring.switches;
+  const size_t n = WS_LogRing_Append(s.ring, (const uint8_t*)s.buf, s.len, s.first_t);
+  s.st.bytes_written += n;
+  if (n < s.len) {
+    s.st.bytes_dropped += (uint32_t)(s.len - n);
+  }
+  s.st.rotations += s.ring.switches - switches;
+  s.len = 0;
+  s.st.flushes++;
+  const uint32_t us = micros() - t0;
+  s.st.flush_us_last = us;
+  if (us > s.st.flush_us_max) {
+    s.st.flush_us_max = us;
+  }
+}
 
-  String bak = String(path) + ".1";
-  if (LittleFS.exists(bak)) {
-    LittleFS.remove(bak);
+static bool StageBytes(WS_LogStream& s, const void* data, size_t n, uint32_t t = 0)
+{
+  if (s.len + n > sizeof(s.buf)) {
+    FlushStream(s);
+  }
+  if (s.len + n > sizeof(s.buf)) {
+    // Still full (FS unavailable): drop the line rather than block.
+    s.st.bytes_dropped += (uint32_t)n;
+    return false;
   }
-  LittleFS.rename(path, bak);
+  if (s.len == 0) {
+    s.first_ms = millis();
+    s.first_t = t;
+  }
+  memcpy(s.buf + s.len, data, n);
+  s.len += n;
+  if (s.flush_each_line || s.len >= LOG_FLUSH_BYTES) {
+    FlushStream(s);
+  }
+  return true;
 }
 
-static void AppendLine(const char* path, const char* name, const char* tag, const char* fmt, va_list ap)
+static void StageLine(WS_LogStream& s, const char* line, uint32_t t)
 {
-  if (!WS_FS_EnsureMounted()) {
-    return;
+  if (StageBytes(s, line, strlen(line), t)) {
+    s.st.lines++;
   }
+}
 
-  RotateIfNeeded(path);
+// Pad the head segment to the next block boundary (moving to the next segment if the
+// block would not fit) and stage a new block header. Needs the real segment size, so
+// staged bytes go out first.
+static bool StartMeasureBlock(WS_LogStream& s, const WS_MLogRecord& r)
+{
+  FlushStream(s);
+  if (s.len > 0 || !OpenStream(s)) {
+    return false;
+  }
+  const uint32_t used = WS_LogRing_HeadSize(s.ring);
+  size_t pad = (WS_MLOG_BLOCK_BYTES - (used % WS_MLOG_BLOCK_BYTES)) % WS_MLOG_BLOCK_BYTES;
+  if (used + pad + WS_MLOG_BLOCK_BYTES > LOG_SEGMENT_BYTES) {
+    const uint32_t switches = s.ring.switches;
+    if (!WS_LogRing_NextSegment(s.ring)) {
+      return false;
+    }
+    s.st.rotations += s.ring.switches - switches;
+    pad = 0;
+  }
+  static const uint8_t zeros[64] = {0};
+  while (pad > 0) {
+    const size_t n = (pad > sizeof(zeros)) ? sizeof(zeros) : pad;
+    if (!StageBytes(s, zeros, n)) {
+      return false;
+    }
+    pad -= n;
+  }
+  uint8_t hdr[WS_MLOG_HEADER_BYTES];
+  const size_t n = WS_MLog_BeginBlock(g_measEnc, r, hdr);
+  return StageBytes(s, hdr, n);
+}
 
-  char msg[256];
-  vsnprintf(msg, sizeof(msg), fmt, ap);
+static void CaptureTime(uint32_t& t, bool& epoch)
+{
+  // If time isn't valid yet, avoid logging "1970..." by falling back to millis().
+  const uint32_t ts = g_nowEpoch ? g_nowEpoch() : 0;
+  epoch = (ts >= kEpochValid);
+  t = epoch ? ts : (uint32_t)millis();
+}
 
+static void WriteLine(WS_LogStream& s, const char* msg, uint32_t t, bool epoch)
+{
+  const char* tag = s.tag;
   char line[320];
-  if (g_nowEpoch) {
-    const uint32_t ts = g_nowEpoch();
-    char tsStr[32];
-    // If time isn't valid yet, avoid logging "1970..." by falling back to millis().
-    if (ts >= 1609459200UL) {
-      if (FormatEpochTs(ts, tsStr, sizeof(tsStr))) {
-        snprintf(line, sizeof(line), "%s [%s] %s\r\n", tsStr, tag, msg);
-      } else {
-        snprintf(line, sizeof(line), "%lu [%s] %s\r\n", (unsigned long)ts, tag, msg);
-      }
+  if (epoch) {
+    char tsStr[72];
+    if (FormatEpochTs(t, tsStr, sizeof(tsStr))) {
+      snprintf(line, sizeof(line), "%s [%s] %s\r\n", tsStr, tag, msg);
     } else {
-      snprintf(line, sizeof(line), "ms=%lu [%s] %s\r\n", (unsigned long)millis(), tag, msg);
+      snprintf(line, sizeof(line), "%lu [%s] %s\r\n", (unsigned long)t, tag, msg);
     }
   } else {
-    snprintf(line, sizeof(line), "ms=%lu [%s] %s\r\n", (unsigned long)millis(), tag, msg);
+    snprintf(line, sizeof(line), "ms=%lu [%s] %s\r\n", (unsigned long)t, tag, msg);
   }
 
-  File f = LittleFS.open(path, "a");
-  if (!f) {
-    return;
-  }
-  f.print(line);
-  f.close();
+  StageLine(s, line, epoch ? t : 0);
 
   // Best-effort: send to external sink (do not block / recurse).
-  if (g_sink && name && name[0] != '\0') {
-    g_sink(name, line);
+  if (g_sink) {
+    g_sink(s.name, line);
   }
 }
 
-void WS_Log_SetLineSink(WS_LogLineSink sink)
+// ---------------- deferred formatting ----------------
+struct WS_LogPending {
+  const char* fmt;
+  uint32_t t;
+  uint8_t stream;
+  bool epoch;
+  WS_LogArgs args;
+};
+
+static WS_LogPending g_pending[LOG_DEFER_SLOTS];
+static uint8_t g_pendHead = 0;                     // oldest entry
+static uint8_t g_pendCount = 0;
+
+// Render fmt with packed arguments. Each conversion is handed to snprintf on its own
+// with the value widened to what the spec expects (integers as long long), so flags,
+// width and precision behave as with vsnprintf; a missing / mismatched argument
+// prints '?'.
+static void RenderArgs(const char* fmt, const WS_LogArgs& a, char* out, size_t cap)
 {
-  g_sink = sink;
+  size_t w = 0;
+  size_t ai = 0;
+  const char* p = fmt;
+  while (*p && w + 1 < cap) {
+    if (*p != '%') {
+      out[w++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[w++] = '%';
+      p += 2;
+      continue;
+    }
+    const char* start = p++;
+    while (*p && strchr("-+ #0", *p)) p++;
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+      p++;
+      while (*p >= '0' && *p <= '9') p++;
+    }
+    const char* lenMod = p;
+    while (*p && strchr("hlLqjzt", *p)) p++;
+    const char conv = *p;
+    if (!conv) {
+      break;
+    }
+    p++;
+
+    char spec[24];
+    size_t sl = (size_t)(lenMod - start);
+    if (sl > sizeof(spec) - 4) sl = sizeof(spec) - 4;
+    memcpy(spec, start, sl);
+    const bool isInt = (strchr("diouxX", conv) != nullptr);
+    if (isInt) {
+      spec[sl++] = 'l';
+      spec[sl++] = 'l';
+    }
+    spec[sl++] = conv;
+    spec[sl] = '\0';
+
+    uint8_t tag = 0;
+    int64_t iv = 0;
+    uint64_t uv = 0;
+    double dv = 0;
+    char sv[LOG_DEFER_ARG_BYTES + 1];
+    sv[0] = '\0';
+    // Only bytes below a.len were packed; a record that would run past it ends the
+    // arguments (everything after renders as '?').
+    if (ai < a.len) {
+      tag = a.buf[ai++];
+      if (tag == WS_LOG_ARG_STR && ai < a.len && a.buf[ai] <= a.len - ai - 1) {
+        const uint8_t n = a.buf[ai++];
+        memcpy(sv, a.buf + ai, n);
+        sv[n] = '\0';
+        ai += n;
+      } else if ((tag == WS_LOG_ARG_INT || tag == WS_LOG_ARG_UINT || tag == WS_LOG_ARG_DBL) && ai + 8 <= a.len) {
+        if (tag == WS_LOG_ARG_INT) memcpy(&iv, a.buf + ai, 8);
+        if (tag == WS_LOG_ARG_UINT) memcpy(&uv, a.buf + ai, 8);
+        if (tag == WS_LOG_ARG_DBL) memcpy(&dv, a.buf + ai, 8);
+        ai += 8;
+      } else {
+        tag = 0;
+        ai = a.len;
+      }
+    }
+    if (tag == WS_LOG_ARG_INT) {
+      uv = (uint64_t)iv;
+      dv = (double)iv;
+    } else if (tag == WS_LOG_ARG_UINT) {
+      iv = (int64_t)uv;
+      dv = (double)uv;
+    } else if (tag == WS_LOG_ARG_DBL) {
+      iv = (int64_t)dv;
+      uv = (uint64_t)iv;
+    }
+
+    int n = -1;
+    if (tag == 0 || (conv == 's') != (tag == WS_LOG_ARG_STR)) {
+      n = snprintf(out + w, cap - w, "?");
+    } else if (conv == 'd' || conv == 'i') {
+      n = snprintf(out + w, cap - w, spec, (long long)iv);
+    } else if (isInt) {
+      n = snprintf(out + w, cap - w, spec, (unsigned long long)uv);
+    } else if (conv == 'c') {
+      n = snprintf(out + w, cap - w, spec, (int)iv);
+    } else if (strchr("fFeEgGaA", conv)) {
+      n = snprintf(out + w, cap - w, spec, dv);
+    } else if (conv == 's') {
+      n = snprintf(out + w, cap - w, spec, sv);
+    }
+    if (n > 0) {
+      w += ((size_t)n < cap - w) ? (size_t)n : cap - w - 1;
+    }
+  }
+  out[w] = '\0';
 }
 
-void WS_Log_SetTimeProvider(uint32_t (*nowEpoch)())
+static void RenderOldest()
 {
-  g_nowEpoch = nowEpoch;
+  WS_LogPending& e = g_pending[g_pendHead];
+  g_pendHead = (uint8_t)((g_pendHead + 1) % LOG_DEFER_SLOTS);
+  g_pendCount--;
+  char msg[256];
+  RenderArgs(e.fmt, e.args, msg, sizeof(msg));
+  WriteLine(g_streams[e.stream], msg, e.t, e.epoch);
 }
 
-void WS_Log_Init()
+static void DrainPending()
 {
-  (void)WS_FS_EnsureMounted();
+  while (g_pendCount > 0) {
+    RenderOldest();
+  }
 }
 
-void WS_Log_Error(const char* fmt, ...)
+void WS_Log_Defer(uint8_t stream, const char* fmt, const WS_LogArgs& args)
 {
-  va_list ap;
-  va_start(ap, fmt);
-  AppendLine(kErrorPath, "error", "ERR", fmt, ap);
-  va_end(ap);
+  if (stream >= kStreamCount || !fmt) {
+    return;
+  }
+  if (g_pendCount == LOG_DEFER_SLOTS) {
+    g_streams[stream].st.defer_full++;
+    RenderOldest();
+  }
+  WS_LogPending& e = g_pending[(g_pendHead + g_pendCount) % LOG_DEFER_SLOTS];
+  g_pendCount++;
+  e.fmt = fmt;
+  e.stream = stream;
+  CaptureTime(e.t, e.epoch);
+  e.args = args;
+  g_streams[stream].st.deferred++;
 }
 
-void WS_Log_Measure(const char* fmt, ...)
+static void PrintfLine(uint8_t stream, const char* fmt, va_list ap)
 {
+  DrainPending();  // keep line order
+  char msg[256];
+  vsnprintf(msg, sizeof(msg), fmt, ap);
+  uint32_t t = 0;
+  bool epoch = false;
+  CaptureTime(t, epoch);
+  WriteLine(g_streams[stream], msg, t, epoch);
+}
+
+void WS_Log_Printf(uint8_t stream, const char* fmt, ...)
+{
+  if (stream >= kStreamCount) {
+    return;
+  }
   va_list ap;
   va_start(ap, fmt);
-  AppendLine(kMeasurePath, "measure", "MEAS", fmt, ap);
+  PrintfLine(stream, fmt, ap);
   va_end(ap);
 }
 
-void WS_Log_Action(const char* fmt, ...)
+void WS_Log_Error(const char* fmt, ...)
 {
   va_list ap;
   va_start(ap, fmt);
-  AppendLine(kActionPath, "action", "ACT", fmt, ap);
+  PrintfLine(WS_LOG_ERROR, fmt, ap);
   va_end(ap);
 }
+
+void WS_Log_Loop()
+{
+  DrainPending();
+  const uint32_t now = millis();
+  for (uint8_t i = 0; i < kStreamCount; i++) {
+    WS_LogStream& s = g_streams[i];
+    if (s.len > 0 && (now - s.first_ms) >= LOG_FLUSH_INTERVAL_MS) {
+      FlushStream(s);
+    }
+  }
+}
+
+void WS_Log_Flush(const char* name)
+{
+  DrainPending();
+  for (uint8_t i = 0; i < kStreamCount; i++) {
+    if (name == nullptr || strcmp(g_streams[i].name, name) == 0) {
+      FlushStream(g_streams[i]);
+    }
+  }
+}
+
+bool WS_Log_Clear(const char* name)
+{
+  WS_LogStream* s = FindStream(name);
+  if (!s || !OpenStream(*s)) {
+    return false;
+  }
+  DrainPending();
+  s->len = 0;
+  if (s->binary) {
+    WS_MLog_EncoderReset(g_measEnc);
+  }
+  return WS_LogRing_Clear(s->ring);
+}
+
+const char* WS_Log_PathFromName(const char* name)
+{
+  const WS_LogStream* s = FindStream(name);
+  return s ? s->base : nullptr;
+}
+
+bool WS_Log_GetStats(const char* name, WS_LogStats& out)
+{
+  const WS_LogStream* s = FindStream(name);
+  if (!s) {
+    return false;
+  }
+  out = s->st;
+  out.staged = (uint32_t)s->len;
+  return true;
+}
+
+bool WS_Log_IsBinary(const char* name)
+{
+  const WS_LogStream* s = FindStream(name);
+  return s && s->binary;
+}
+
+static WS_LogStream* OpenForRead(const char* name)
+{
+  WS_LogStream* s = FindStream(name);
+  if (!s) {
+    return nullptr;
+  }
+  DrainPending();
+  FlushStream(*s);
+  return OpenStream(*s) ? s : nullptr;
+}
+
+// Decode one block to text lines; returns the text size (w may be null to only count).
+// skip: text bytes still to drop at line granularity (a line is dropped while fewer
+// than skip bytes were dropped before it).
+static size_t DecodeBlockLines(const uint8_t* blk, size_t n, WS_LogTextWriter w, void* ctx, size_t* skip)
+{
+  WS_MLogBlockReader rd;
+  if (!WS_MLog_BlockBegin(rd, blk, n)) {
+    return 0;
+  }
+  WS_MLogRecord r;
+  char line[WS_MLOG_LINE_MAX];
+  size_t total = 0;
+  while (WS_MLog_BlockNext(rd, r)) {
+    const size_t len = WS_MLog_FormatLine(r, line, sizeof(line));
+    total += len;
+    if (skip && *skip > 0) {
+      *skip = (*skip > len) ? *skip - len : 0;
+      continue;
+    }
+    if (w) {
+      w(ctx, line, len);
+    }
+  }
+  return total;
+}
+
+bool WS_Log_ReadTail(const char* name, size_t tailBytes, WS_LogTextWriter w, void* ctx)
+{
+  WS_LogStream* s = OpenForRead(name);
+  if (!s || !w) {
+    return false;
+  }
+  const WS_LogRing& ring = s->ring;
+  static uint8_t blk[WS_MLOG_BLOCK_BYTES];
+
+  if (!s->binary) {
+    const uint32_t total = WS_LogRing_Total(ring);
+    const uint32_t start = (tailBytes > 0 && total > tailBytes) ? (uint32_t)(total - tailBytes) : 0;
+    // Begin one byte early: if it is a newline, start is already a line boundary.
+    uint32_t off = (start > 0) ? start - 1 : 0;
+    bool skipping = (start > 0);
+    while (off < total) {
+      const size_t n = WS_LogRing_Read(ring, off, blk, sizeof(blk));
+      if (n == 0) break;
+      off += (uint32_t)n;
+      size_t from = 0;
+      if (skipping) {
+        const uint8_t* nl = (const uint8_t*)memchr(blk, '\n', n);
+        if (!nl) continue;
+        from = (size_t)(nl - blk) + 1;
+        skipping = false;
+      }
+      if (from < n) {
+        w(ctx, (const char*)blk + from, n - from);
+      }
+    }
+    return true;
+  }
+
+  // Pass 1, newest block first: find the block where the last tailBytes of text begin.
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(ring, order);
+  uint8_t firstK = 0;
+  uint32_t firstB = 0;
+  size_t text = 0;
+  if (tailBytes > 0) {
+    bool found = false;
+    for (uint8_t k = cnt; k > 0 && !found; k--) {
+      const uint8_t seg = order[k - 1];
+      for (uint32_t b = (ring.size[seg] + WS_MLOG_BLOCK_BYTES - 1) / WS_MLOG_BLOCK_BYTES; b > 0; b--) {
+        const size_t n = WS_LogRing_ReadSegment(ring, seg, (b - 1) * WS_MLOG_BLOCK_BYTES, blk, WS_MLOG_BLOCK_BYTES);
+        text += DecodeBlockLines(blk, n, nullptr, nullptr, nullptr);
+        if (text >= tailBytes) {
+          firstK = (uint8_t)(k - 1);
+          firstB = b - 1;
+          found = true;
+          break;
+        }
+      }
+    }
+  }
+
+  // Pass 2, forward: drop the excess lines of the first block, stream the rest.
+  size_t skip = (tailBytes > 0 && text > tailBytes) ? text - tailBytes : 0;
+  for (uint8_t k = firstK; k < cnt; k++) {
+    const uint8_t seg = order[k];
+    for (uint32_t b = (k == firstK) ? firstB : 0; b * WS_MLOG_BLOCK_BYTES < ring.size[seg]; b++) {
+      const size_t n = WS_LogRing_ReadSegment(ring, seg, b * WS_MLOG_BLOCK_BYTES, blk, WS_MLOG_BLOCK_BYTES);
+      (void)DecodeBlockLines(blk, n, w, ctx, &skip);
+    }
+  }
+  return true;
+}
+
+// Visit every block (binary) or every chunk (text) of a log, oldest first.
+// Binary blocks are handed over as full WS_MLOG_BLOCK_BYTES, zero padded.
+static bool ForEachChunk(WS_LogStream& s, void (*fn)(void* ctx, const uint8_t* data, size_t len), void* ctx)
+{
+  static uint8_t blk[WS_MLOG_BLOCK_BYTES];
+  const WS_LogRing& ring = s.ring;
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(ring, order);
+  for (uint8_t k = 0; k < cnt; k++) {
+    const uint8_t seg = order[k];
+    for (uint32_t off = 0; off < ring.size[seg];) {
+      const size_t n = WS_LogRing_ReadSegment(ring, seg, off, blk, sizeof(blk));
+      if (n == 0) {
+        return false;
+      }
+      if (s.binary && n < sizeof(blk)) {
+        memset(blk + n, 0, sizeof(blk) - n);
+      }
+      fn(ctx, blk, s.binary ? sizeof(blk) : n);
+      off += (uint32_t)n;
+    }
+  }
+  return true;
+}
+
+struct WS_LogTextCtx {
+  WS_LogTextWriter w;
+  void* ctx;
+};
+
+bool WS_Log_ReadText(const char* name, WS_LogTextWriter w, void* ctx)
+{
+  WS_LogStream* s = OpenForRead(name);
+  if (!s || !w) {
+    return false;
+  }
+  WS_LogTextCtx tc = {w, ctx};
+  if (!s->binary) {
+    return ForEachChunk(*s, [](void* c, const uint8_t* data, size_t len) {
+      const WS_LogTextCtx* t = static_cast<const WS_LogTextCtx*>(c);
+      t->w(t->ctx, (const char*)data, len);
+    }, &tc);
+  }
+  return ForEachChunk(*s, [](void* c, const uint8_t* data, size_t len) {
+    const WS_LogTextCtx* t = static_cast<const WS_LogTextCtx*>(c);
+    (void)DecodeBlockLines(data, len, t->w, t->ctx, nullptr);
+  }, &tc);
+}
+
+bool WS_Log_ReadRaw(const char* name, WS_LogTextWriter w, void* ctx)
+{
+  WS_LogStream* s = OpenForRead(name);
+  if (!s || !w) {
+    return false;
+  }
+  WS_LogTextCtx tc = {w, ctx};
+  return ForEachChunk(*s, [](void* c, const uint8_t* data, size_t len) {
+    const WS_LogTextCtx* t = static_cast<const WS_LogTextCtx*>(c);
+    t->w(t->ctx, (const char*)data, len);
+  }, &tc);
+}
+
+// Size of a segment in the raw stream (binary: rounded up to whole blocks).
+static uint32_t RawSegmentSize(const WS_LogStream& s, uint8_t seg)
+{
+  const uint32_t n = s.ring.size[seg];
+  return s.binary ? (n + WS_MLOG_BLOCK_BYTES - 1) / WS_MLOG_BLOCK_BYTES * WS_MLOG_BLOCK_BYTES : n;
+}
+
+bool WS_Log_RawExtent(const char* name, WS_LogExtent& out)
+{
+  out = WS_LogExtent();
+  WS_LogStream* s = OpenForRead(name);
+  if (!s) {
+    return false;
+  }
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(s->ring, order);
+  for (uint8_t k = 0; k < cnt; k++) {
+    out.total += RawSegmentSize(*s, order[k]);
+  }
+  out.gen = (cnt > 0) ? s->ring.seq[order[0]] : 0;
+  return true;
+}
+
+size_t WS_Log_ReadRawAt(const char* name, uint32_t off, uint8_t* buf, size_t n)
+{
+  WS_LogStream* s = FindStream(name);
+  if (!s || !buf || !OpenStream(*s)) {
+    return 0;
+  }
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(s->ring, order);
+  size_t got = 0;
+  for (uint8_t k = 0; k < cnt && got < n; k++) {
+    const uint8_t seg = order[k];
+    const uint32_t segSize = RawSegmentSize(*s, seg);
+    if (off >= segSize) {
+      off -= segSize;
+      continue;
+    }
+    size_t want = segSize - off;
+    if (want > n - got) {
+      want = n - got;
+    }
+    const size_t m = WS_LogRing_ReadSegment(s->ring, seg, off, buf + got, want);
+    if (m < want && off + m < s->ring.size[seg]) {
+      return got + m;  // read error
+    }
+    memset(buf + got + m, 0, want - m);  // block padding
+    got += want;
+    off = 0;
+  }
+  return got;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's days_from_civil).
+static int32_t DaysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+  y -= (m <= 2) ? 1 : 0;
+  const int32_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yoe = (uint32_t)(y - era * 400);
+  const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+uint32_t WS_Log_ParseTime(const char* str)
+{
+  if (!str) {
+    return 0;
+  }
+  while (*str == ' ') str++;
+  if (str[0] < '0' || str[0] > '9') {
+    return 0;
+  }
+  if (str[4] != '-') {
+    return (uint32_t)strtoul(str, nullptr, 10);
+  }
+  unsigned y = 0, mo = 0, d = 0, h = 0, mi = 0, sec = 0;
+  const int n = sscanf(str, "%4u-%2u-%2u%*1[ T]%2u:%2u:%2u", &y, &mo, &d, &h, &mi, &sec);
+  if (n < 3 || mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || sec > 60) {
+    return 0;
+  }
+  const int32_t days = DaysFromCivil((int32_t)y, mo, d);
+  if (days < 0) {
+    return 0;
+  }
+  return (uint32_t)days * 86400UL + h * 3600UL + mi * 60UL + sec;
+}
+
+enum WS_LogMatch : uint8_t { WS_LOG_SKIP, WS_LOG_EMIT, WS_LOG_STOP };
+
+static WS_LogMatch MatchLine(WS_LogQuery& q, const char* line, size_t n, uint32_t t)
+{
+  const bool timed = (q.from != 0 || q.to != 0);
+  if (timed && t < kEpochValid) {
+    return WS_LOG_SKIP;
+  }
+  if (q.to != 0 && t > q.to) {
+    return (t > q.to + kQuerySlackS) ? WS_LOG_STOP : WS_LOG_SKIP;
+  }
+  if ((q.from != 0 && t < q.from) || (q.tag && q.tag[0] != '\0' && !strstr(line, q.tag))) {
+    return WS_LOG_SKIP;
+  }
+  if (q.max_bytes != 0 && q.bytes + n > q.max_bytes) {
+    q.truncated = true;
+    return WS_LOG_STOP;
+  }
+  return WS_LOG_EMIT;
+}
+
+static bool EmitLine(WS_LogQuery& q, const char* line, size_t n, uint32_t t, WS_LogTextWriter w, void* ctx)
+{
+  const WS_LogMatch m = MatchLine(q, line, n, t);
+  if (m == WS_LOG_EMIT) {
+    w(ctx, line, n);
+    q.bytes += n;
+    q.lines++;
+  }
+  return m != WS_LOG_STOP;
+}
+
+// Text logs: start at the index entry just before "from", then filter line by line.
+static void QueryText(WS_LogStream& s, WS_LogQuery& q, WS_LogTextWriter w, void* ctx)
+{
+  const WS_LogRing& ring = s.ring;
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(ring, order);
+  const WS_LogRingPos pos = WS_LogRing_Seek(ring, q.from);
+  static uint8_t chunk[512];
+  char line[WS_MLOG_LINE_MAX + 1];
+  for (uint8_t k = pos.seg; k < cnt; k++) {
+    File f = WS_LogRing_OpenSegment(ring, order[k]);
+    uint32_t off = (k == pos.seg) ? pos.off : 0;
+    if (!f || !f.seek(WS_LOGRING_HEADER_BYTES + off, SeekSet)) {
+      continue;
+    }
+    size_t len = 0;
+    bool more = true;
+    while (more && off < ring.size[order[k]]) {
+      const size_t n = f.read(chunk, sizeof(chunk));
+      if (n == 0) break;
+      off += (uint32_t)n;
+      for (size_t i = 0; i < n && more; i++) {
+        if (len < sizeof(line) - 1) {
+          line[len++] = (char)chunk[i];
+        }
+        if (chunk[i] == '\n') {
+          line[len] = '\0';
+          more = EmitLine(q, line, len, WS_Log_ParseTime(line), w, ctx);
+          len = 0;
+        }
+      }
+    }
+    f.close();
+    if (!more) {
+      return;
+    }
+  }
+}
+
+static bool QueryBlock(const WS_LogRing& ring, uint8_t seg, uint32_t b, WS_LogQuery& q, WS_LogTextWriter w, void* ctx)
+{
+  static uint8_t blk[WS_MLOG_BLOCK_BYTES];
+  const size_t n = WS_LogRing_ReadSegment(ring, seg, b * WS_MLOG_BLOCK_BYTES, blk, sizeof(blk));
+  WS_MLogBlockReader rd;
+  if (!WS_MLog_BlockBegin(rd, blk, n)) {
+    return true;
+  }
+  WS_MLogRecord r;
+  char line[WS_MLOG_LINE_MAX];
+  while (WS_MLog_BlockNext(rd, r)) {
+    const size_t len = WS_MLog_FormatLine(r, line, sizeof(line));
+    if (!EmitLine(q, line, len, r.epoch ? r.t : 0, w, ctx)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Binary logs: walk the block headers and decode only blocks that can hold [from, to].
+// A block's records run up to the next block's t0, so a block is decoded once the
+// following header shows it reaches past "from".
+static void QueryBinary(WS_LogStream& s, WS_LogQuery& q, WS_LogTextWriter w, void* ctx)
+{
+  const WS_LogRing& ring = s.ring;
+  const bool timed = (q.from != 0 || q.to != 0);
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(ring, order);
+  bool pending = false;
+  uint8_t pSeg = 0;
+  uint32_t pBlk = 0;
+  for (uint8_t k = 0; k < cnt; k++) {
+    const uint8_t seg = order[k];
+    File f = WS_LogRing_OpenSegment(ring, seg);
+    if (!f) {
+      continue;
+    }
+    const uint32_t blocks = (ring.size[seg] + WS_MLOG_BLOCK_BYTES - 1) / WS_MLOG_BLOCK_BYTES;
+    for (uint32_t b = 0; b < blocks; b++) {
+      uint8_t h[WS_MLOG_HEADER_BYTES];
+      WS_MLogHeader hdr;
+      const bool ok = f.seek(WS_LOGRING_HEADER_BYTES + b * WS_MLOG_BLOCK_BYTES, SeekSet) &&
+                      f.read(h, sizeof(h)) == sizeof(h) && WS_MLog_ReadHeader(h, sizeof(h), hdr);
+      const uint32_t t0 = (ok && hdr.epoch) ? hdr.t0 : 0;
+      if (pending && (t0 == 0 || q.from == 0 || t0 > q.from)) {
+        if (!QueryBlock(ring, pSeg, pBlk, q, w, ctx)) {
+          f.close();
+          return;
+        }
+      }
+      pending = false;
+      if (!ok || (timed && t0 == 0)) {
+        continue;
+      }
+      if (q.to != 0 && t0 > q.to + kQuerySlackS) {
+        f.close();
+        return;
+      }
+      pending = true;
+      pSeg = seg;
+      pBlk = b;
+    }
+    f.close();
+  }
+  if (pending) {
+    (void)QueryBlock(ring, pSeg, pBlk, q, w, ctx);
+  }
+}
+
+bool WS_Log_Query(const char* name, WS_LogQuery& q, WS_LogTextWriter w, void* ctx)
+{
+  q.truncated = false;
+  q.lines = 0;
+  q.bytes = 0;
+  WS_LogStream* s = OpenForRead(name);
+  if (!s || !w) {
+    return false;
+  }
+  if (s->binary) {
+    QueryBinary(*s, q, w, ctx);
+  } else {
+    QueryText(*s, q, w, ctx);
+  }
+  return true;
+}
+
+void WS_Log_SetLineSink(WS_LogLineSink sink)
+{
+  g_sink = sink;
+}
+
+void WS_Log_SetTimeProvider(uint32_t (*nowEpoch)())
+{
+  g_nowEpoch = nowEpoch;
+}
+
+// Copy a pre-ring log (<legacy>.1 then <legacy>) into the ring once, then delete it.
+static void ImportLegacy(WS_LogStream& s)
+{
+  const String paths[2] = {String(s.legacy) + ".1", String(s.legacy)};
+  for (uint8_t i = 0; i < 2; i++) {
+    if (!LittleFS.exists(paths[i])) {
+      continue;
+    }
+    // Binary blocks stay aligned only if the head segment is.
+    if (!s.binary || (WS_LogRing_HeadSize(s.ring) % WS_MLOG_BLOCK_BYTES) == 0) {
+      File f = LittleFS.open(paths[i], "r");
+      if (f) {
+        uint8_t chunk[512];
+        size_t n = 0;
+        while ((n = f.read(chunk, sizeof(chunk))) > 0) {
+          WS_LogRing_Append(s.ring, chunk, n, 0);
+        }
+        f.close();
+      }
+    }
+    LittleFS.remove(paths[i]);
+  }
+}
+
+void WS_Log_Init()
+{
+  if (!WS_FS_EnsureMounted()) {
+    return;
+  }
+  // Superseded by the binary measure log.
+  if (LittleFS.exists("/log_measure.txt")) LittleFS.remove("/log_measure.txt");
+  if (LittleFS.exists("/log_measure.txt.1")) LittleFS.remove("/log_measure.txt.1");
+  for (uint8_t i = 0; i < kStreamCount; i++) {
+    if (OpenStream(g_streams[i])) {
+      ImportLegacy(g_streams[i]);
+    }
+  }
+}
+
+void WS_Log_Measure(const WS_MLogRecord& rec)
+{
+  WS_LogStream& s = g_streams[1];
+  WS_MLogRecord r = rec;
+  const uint32_t ts = g_nowEpoch ? g_nowEpoch() : 0;
+  r.epoch = (ts >= kEpochValid);
+  r.t = r.epoch ? ts : (uint32_t)(millis() / 1000UL);
+
+  uint8_t buf[WS_MLOG_MAX_RECORD];
+  size_t n = WS_MLog_EncodeRecord(g_measEnc, r, buf);
+  if (n == 0) {
+    if (!StartMeasureBlock(s, r)) {
+      WS_MLog_EncoderReset(g_measEnc);
+      s.st.bytes_dropped += WS_MLOG_HEADER_BYTES;
+    } else {
+      n = WS_MLog_EncodeRecord(g_measEnc, r, buf);
+    }
+  }
+  if (n > 0 && StageBytes(s, buf, n)) {
+    s.st.lines++;
+  }
+
+  if (g_sink) {
+    char line[WS_MLOG_LINE_MAX];
+    WS_MLog_FormatLine(r, line, sizeof(line));
+    g_sink(s.name, line);
+  }
+}
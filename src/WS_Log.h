@@ -1,18 +1,197 @@
 #ifndef _WS_LOG_H_
 #define _WS_LOG_H_
 
+#include <Arduino.h>
 #include <stdint.h>
+#include <string.h>
+#include <type_traits>
 
-// Logs are stored on LittleFS:
-// - /log_error.txt
-// - /log_measure.txt
-// - /log_action.txt
+#include "WS_Information.h"
+#include "WS_MeasCodec.h"
+
+#ifndef LOG_DEFER_Enable
+#define LOG_DEFER_Enable true          // capture raw arguments, format in WS_Log_Loop()
+#endif
+#ifndef LOG_DEFER_SLOTS
+#define LOG_DEFER_SLOTS 16             // pending entries; a full ring formats the oldest one inline
+#endif
+#ifndef LOG_DEFER_ARG_BYTES
+#define LOG_DEFER_ARG_BYTES 112        // packed arguments per entry, max 255 (strings are cut to fit)
+#endif
+
+// Logs are stored on LittleFS as segment rings (WS_LogRing.h):
+// - /log_error.0 ... /log_error.<LOG_SEGMENTS-1>
+// - /log_measure.* (binary records, see WS_MeasCodec.h; read back as text)
+// - /log_action.*
+//
+// Lines are staged in RAM per log and written in batches (size / age, errors
+// immediately). Reads below flush the log first and return it oldest first.
+
+struct WS_LogStats {
+  uint32_t lines = 0;
+  uint32_t bytes_written = 0;
+  uint32_t bytes_dropped = 0;   // staging full and FS unavailable
+  uint32_t flushes = 0;
+  uint32_t rotations = 0;       // segments recycled (oldest history dropped)
+  uint32_t flush_us_last = 0;
+  uint32_t flush_us_max = 0;
+  uint32_t staged = 0;          // bytes waiting in RAM
+  uint32_t deferred = 0;        // lines captured raw (LOG_DEFER_Enable)
+  uint32_t defer_full = 0;      // ... of which forced an inline render (ring full)
+};
 
 void WS_Log_Init();
+void WS_Log_Loop();                       // call in main loop: time-based flush
+
+// name: "error" | "measure" | "action", nullptr = all
+void WS_Log_Flush(const char* name);
+bool WS_Log_Clear(const char* name);      // truncate (drops staged lines too)
+const char* WS_Log_PathFromName(const char* name);   // segment base path
+bool WS_Log_GetStats(const char* name, WS_LogStats& out);
+bool WS_Log_IsBinary(const char* name);
+
+typedef void (*WS_LogTextWriter)(void* ctx, const char* data, size_t len);
+
+// Last ~tailBytes of a log as text (0 = all), starting at a line boundary, streamed to w
+// in block-sized pieces (binary logs are decoded). RAM use doesn't depend on tailBytes.
+bool WS_Log_ReadTail(const char* name, size_t tailBytes, WS_LogTextWriter w, void* ctx);
+
+// Whole log in order: as text (binary logs decoded), or raw (binary: whole zero-padded
+// blocks, readable by scripts/meas_decode). Returns false if it can't be read.
+bool WS_Log_ReadText(const char* name, WS_LogTextWriter w, void* ctx);
+bool WS_Log_ReadRaw(const char* name, WS_LogTextWriter w, void* ctx);
+
+// Random access to the WS_Log_ReadRaw() byte stream, for resumable transfers.
+// gen is the sequence number of the oldest segment: when it changes, the oldest
+// segment was recycled and earlier offsets no longer point at the same bytes.
+struct WS_LogExtent {
+  uint32_t total = 0;
+  uint32_t gen = 0;
+};
+bool WS_Log_RawExtent(const char* name, WS_LogExtent& out);   // flushes the log first
+size_t WS_Log_ReadRawAt(const char* name, uint32_t off, uint8_t* buf, size_t n);
+
+// Lines in [from, to] (epoch seconds, same clock as the log timestamps; 0 = open) that
+// contain "tag", oldest first. Text logs seek via their sparse time index, the measure
+// log via its block headers, so only the matching region is read.
+struct WS_LogQuery {
+  uint32_t from = 0;
+  uint32_t to = 0;
+  const char* tag = nullptr;
+  size_t max_bytes = 0;         // 0 = unlimited
+  // results
+  bool truncated = false;       // stopped at max_bytes
+  uint32_t lines = 0;
+  size_t bytes = 0;
+};
+bool WS_Log_Query(const char* name, WS_LogQuery& q, WS_LogTextWriter w, void* ctx);
+
+// "YYYY-MM-DD[ HH:MM[:SS]]" (also with 'T') or plain epoch digits -> epoch seconds, 0 if invalid.
+uint32_t WS_Log_ParseTime(const char* str);
+
+enum WS_LogStreamId : uint8_t {
+  WS_LOG_ERROR = 0,
+  WS_LOG_MEASURE = 1,
+  WS_LOG_ACTION = 2
+};
+
+// Format now (vsnprintf + timestamp) and stage the line.
+void WS_Log_Printf(uint8_t stream, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Deferred path: the call only packs the raw arguments (ints, doubles, copied strings)
+// with the format pointer and a timestamp into a RAM ring. Lines are rendered by
+// WS_Log_Loop(), or earlier when a log is flushed / read / the ring is full, so the
+// text on flash and on the line sink is the same as with WS_Log_Printf().
+// fmt must be a string literal (its pointer is kept until rendering).
+struct WS_LogArgs {
+  uint8_t buf[LOG_DEFER_ARG_BYTES];
+  uint8_t len = 0;                     // end of the packed arguments; buf[len..] is not initialized
+  bool full = false;                   // an argument did not fit: it and all later ones render as '?'
+};
+
+enum WS_LogArgTag : uint8_t {
+  WS_LOG_ARG_INT = 1,                  // int64_t
+  WS_LOG_ARG_UINT = 2,                 // uint64_t
+  WS_LOG_ARG_DBL = 3,                  // double
+  WS_LOG_ARG_STR = 4                   // u8 length + bytes
+};
+
+void WS_Log_Defer(uint8_t stream, const char* fmt, const WS_LogArgs& args);
+
+inline void WS_Log_PackRaw(WS_LogArgs& a, uint8_t tag, const void* v, size_t n)
+{
+  if (a.full || a.len + 1 + n > sizeof(a.buf)) {
+    a.full = true;
+    return;
+  }
+  a.buf[a.len++] = tag;
+  memcpy(a.buf + a.len, v, n);
+  a.len = (uint8_t)(a.len + n);
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+WS_Log_Pack(WS_LogArgs& a, T v)
+{
+  if (std::is_signed<T>::value) {
+    const int64_t x = (int64_t)v;
+    WS_Log_PackRaw(a, WS_LOG_ARG_INT, &x, sizeof(x));
+  } else {
+    const uint64_t x = (uint64_t)v;
+    WS_Log_PackRaw(a, WS_LOG_ARG_UINT, &x, sizeof(x));
+  }
+}
+
+inline void WS_Log_Pack(WS_LogArgs& a, double v)
+{
+  WS_Log_PackRaw(a, WS_LOG_ARG_DBL, &v, sizeof(v));
+}
+
+inline void WS_Log_Pack(WS_LogArgs& a, const char* s)
+{
+  if (a.full || (size_t)a.len + 2 > sizeof(a.buf)) {
+    a.full = true;
+    return;
+  }
+  if (!s) s = "(null)";
+  size_t n = strlen(s);
+  const size_t room = sizeof(a.buf) - a.len - 2;
+  if (n > room) n = room;
+  a.buf[a.len++] = WS_LOG_ARG_STR;
+  a.buf[a.len++] = (uint8_t)n;
+  memcpy(a.buf + a.len, s, n);
+  a.len = (uint8_t)(a.len + n);
+}
+
+inline void WS_Log_PackAll(WS_LogArgs&) {}
+
+template <typename T, typename... Rest>
+inline void WS_Log_PackAll(WS_LogArgs& a, T v, Rest... rest)
+{
+  WS_Log_Pack(a, v);
+  WS_Log_PackAll(a, rest...);
+}
+
+template <typename... A>
+inline void WS_Log_Write(uint8_t stream, const char* fmt, A... args)
+{
+#if LOG_DEFER_Enable
+  WS_LogArgs a;
+  WS_Log_PackAll(a, args...);
+  WS_Log_Defer(stream, fmt, a);
+#else
+  WS_Log_Printf(stream, fmt, args...);
+#endif
+}
+
+// Errors are rare and written to flash at once, so they are always formatted immediately.
+void WS_Log_Error(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+template <typename... A>
+inline void WS_Log_Action(const char* fmt, A... args) { WS_Log_Write(WS_LOG_ACTION, fmt, args...); }
 
-void WS_Log_Error(const char* fmt, ...);
-void WS_Log_Measure(const char* fmt, ...);
-void WS_Log_Action(const char* fmt, ...);
+// Measurement record; the time fields are filled in by the logger.
+void WS_Log_Measure(const WS_MLogRecord& rec);
 
 // Optional: stream each appended log line to a sink (e.g. MQTT push).
 // name: "error" | "measure" | "action"
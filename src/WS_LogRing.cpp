@@ -0,0 +1,318 @@
+#include "WS_LogRing.h"
+#include "WS_Bytes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const uint8_t kMagic[4] = {'W', 'S', 'L', 'G'};
+
+static void SegmentPath(const WS_LogRing& r, uint8_t i, char* out, size_t cap)
+{
+  snprintf(out, cap, "%s.%u", r.base, (unsigned)i);
+}
+
+static void IndexPath(const WS_LogRing& r, uint8_t i, char* out, size_t cap)
+{
+  snprintf(out, cap, "%s.%u.idx", r.base, (unsigned)i);
+}
+
+// Header: magic | seq | ~seq | reserved
+static bool ScanSegment(WS_LogRing& r, uint8_t i)
+{
+  r.seq[i] = 0;
+  r.size[i] = 0;
+  char path[40];
+  SegmentPath(r, i, path, sizeof(path));
+  if (!LittleFS.exists(path)) {
+    return false;
+  }
+  File f = LittleFS.open(path, "r");
+  if (!f) {
+    return false;
+  }
+  uint8_t hdr[WS_LOGRING_HEADER_BYTES];
+  const size_t sz = (size_t)f.size();
+  const size_t n = f.read(hdr, sizeof(hdr));
+  f.close();
+  if (n != sizeof(hdr) || memcmp(hdr, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  const uint32_t seq = WS_GetU32(hdr + 4);
+  if (seq == 0 || WS_GetU32(hdr + 8) != ~seq) {
+    return false;
+  }
+  r.seq[i] = seq;
+  r.size[i] = (uint32_t)(sz - WS_LOGRING_HEADER_BYTES);
+  return true;
+}
+
+// Truncate segment i and make it the head. A power cut before the header is written
+// leaves an empty file, which the next scan treats as free.
+static bool StartSegment(WS_LogRing& r, uint8_t i, uint32_t seq)
+{
+  if (r.f) {
+    r.f.close();
+  }
+  r.f = File();
+  char path[40];
+  SegmentPath(r, i, path, sizeof(path));
+  r.seq[i] = 0;
+  r.size[i] = 0;
+  r.head = i;
+  r.index_next = 0;
+  if (r.index_step > 0) {
+    char ipath[44];
+    IndexPath(r, i, ipath, sizeof(ipath));
+    File idx = LittleFS.open(ipath, "w");
+    if (idx) idx.close();
+  }
+  File f = LittleFS.open(path, "w");
+  if (!f) {
+    return false;
+  }
+  uint8_t hdr[WS_LOGRING_HEADER_BYTES] = {0};
+  memcpy(hdr, kMagic, sizeof(kMagic));
+  WS_PutU32(hdr + 4, seq);
+  WS_PutU32(hdr + 8, ~seq);
+  if (f.write(hdr, sizeof(hdr)) != sizeof(hdr)) {
+    f.close();
+    return false;
+  }
+  f.flush();
+  r.seq[i] = seq;
+  r.f = f;
+  return true;
+}
+
+bool WS_LogRing_Open(WS_LogRing& r, const char* base, uint8_t segments, uint32_t segBytes, uint32_t indexStep)
+{
+  WS_LogRing_Close(r);
+  r.base = base;
+  r.index_step = indexStep;
+  r.segments = (segments < 2) ? 2 : ((segments > WS_LOGRING_MAX_SEGMENTS) ? WS_LOGRING_MAX_SEGMENTS : segments);
+  r.seg_bytes = segBytes;
+  r.head = 0;
+
+  uint32_t best = 0;
+  for (uint8_t i = 0; i < r.segments; i++) {
+    if (ScanSegment(r, i) && r.seq[i] > best) {
+      best = r.seq[i];
+      r.head = i;
+    }
+  }
+  if (best == 0) {
+    r.ready = StartSegment(r, 0, 1);
+    return r.ready;
+  }
+  char path[40];
+  SegmentPath(r, r.head, path, sizeof(path));
+  r.f = LittleFS.open(path, "a");
+  r.ready = (bool)r.f;
+  // Entries lost to a power cut are just skipped; the next one goes a step further on.
+  r.index_next = (r.index_step > 0) ? (r.size[r.head] / r.index_step + 1) * r.index_step : 0;
+  return r.ready;
+}
+
+void WS_LogRing_Close(WS_LogRing& r)
+{
+  if (r.f) {
+    r.f.close();
+  }
+  r.f = File();
+  r.ready = false;
+}
+
+bool WS_LogRing_NextSegment(WS_LogRing& r)
+{
+  const uint8_t next = (uint8_t)((r.head + 1) % r.segments);
+  const uint32_t seq = r.seq[r.head] + 1;
+  if (r.seq[next] != 0) {
+    r.switches++;
+  }
+  r.ready = StartSegment(r, next, seq);
+  return r.ready;
+}
+
+static void AppendIndex(WS_LogRing& r, uint32_t t)
+{
+  const uint32_t off = r.size[r.head];
+  if (r.index_step == 0 || t == 0 || (off > 0 && off < r.index_next)) {
+    return;
+  }
+  char ipath[44];
+  IndexPath(r, r.head, ipath, sizeof(ipath));
+  File idx = LittleFS.open(ipath, "a");
+  if (!idx) {
+    return;
+  }
+  uint8_t e[8];
+  WS_PutU32(e, t);
+  WS_PutU32(e + 4, off);
+  idx.write(e, sizeof(e));
+  idx.close();
+  r.index_next = off + r.index_step;
+}
+
+size_t WS_LogRing_Append(WS_LogRing& r, const uint8_t* data, size_t n, uint32_t t)
+{
+  if (!r.ready || n == 0) {
+    return 0;
+  }
+  if (r.size[r.head] > 0 && r.size[r.head] + n > r.seg_bytes) {
+    if (!WS_LogRing_NextSegment(r)) {
+      return 0;
+    }
+  }
+  const size_t w = r.f.write(data, n);
+  r.f.flush();
+  if (w > 0) {
+    AppendIndex(r, t);
+  }
+  r.size[r.head] += (uint32_t)w;
+  return w;
+}
+
+bool WS_LogRing_Clear(WS_LogRing& r)
+{
+  if (!r.base) {
+    return false;
+  }
+  uint32_t seq = 0;
+  for (uint8_t i = 0; i < r.segments; i++) {
+    if (r.seq[i] > seq) seq = r.seq[i];
+  }
+  WS_LogRing_Close(r);
+  for (uint8_t i = 1; i < r.segments; i++) {
+    char path[44];
+    SegmentPath(r, i, path, sizeof(path));
+    if (r.seq[i] != 0 || LittleFS.exists(path)) {
+      File f = LittleFS.open(path, "w");
+      if (f) f.close();
+    }
+    IndexPath(r, i, path, sizeof(path));
+    if (LittleFS.exists(path)) {
+      LittleFS.remove(path);
+    }
+    r.seq[i] = 0;
+    r.size[i] = 0;
+  }
+  r.ready = StartSegment(r, 0, seq + 1);
+  return r.ready;
+}
+
+uint32_t WS_LogRing_Total(const WS_LogRing& r)
+{
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < r.segments; i++) {
+    if (r.seq[i] != 0) total += r.size[i];
+  }
+  return total;
+}
+
+uint8_t WS_LogRing_Order(const WS_LogRing& r, uint8_t* order)
+{
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < r.segments; i++) {
+    if (r.seq[i] == 0) continue;
+    uint8_t j = n++;
+    while (j > 0 && r.seq[order[j - 1]] > r.seq[i]) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+  return n;
+}
+
+size_t WS_LogRing_ReadSegment(const WS_LogRing& r, uint8_t seg, uint32_t off, uint8_t* buf, size_t n)
+{
+  if (seg >= r.segments || r.seq[seg] == 0 || off >= r.size[seg]) {
+    return 0;
+  }
+  if (n > r.size[seg] - off) {
+    n = r.size[seg] - off;
+  }
+  char path[40];
+  SegmentPath(r, seg, path, sizeof(path));
+  File f = LittleFS.open(path, "r");
+  if (!f) {
+    return 0;
+  }
+  size_t got = 0;
+  if (f.seek(WS_LOGRING_HEADER_BYTES + off, SeekSet)) {
+    got = f.read(buf, n);
+  }
+  f.close();
+  return got;
+}
+
+size_t WS_LogRing_Read(const WS_LogRing& r, uint32_t off, uint8_t* buf, size_t n)
+{
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(r, order);
+  size_t got = 0;
+  for (uint8_t k = 0; k < cnt && got < n; k++) {
+    const uint8_t seg = order[k];
+    if (off >= r.size[seg]) {
+      off -= r.size[seg];
+      continue;
+    }
+    const size_t m = WS_LogRing_ReadSegment(r, seg, off, buf + got, n - got);
+    got += m;
+    off = 0;
+    if (m == 0) {
+      break;
+    }
+  }
+  return got;
+}
+
+File WS_LogRing_OpenSegment(const WS_LogRing& r, uint8_t seg)
+{
+  if (seg >= r.segments || r.seq[seg] == 0) {
+    return File();
+  }
+  char path[40];
+  SegmentPath(r, seg, path, sizeof(path));
+  return LittleFS.open(path, "r");
+}
+
+WS_LogRingPos WS_LogRing_Seek(const WS_LogRing& r, uint32_t t)
+{
+  WS_LogRingPos best;
+  if (r.index_step == 0 || t == 0) {
+    return best;
+  }
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(r, order);
+  for (uint8_t k = 0; k < cnt; k++) {
+    char ipath[44];
+    IndexPath(r, order[k], ipath, sizeof(ipath));
+    if (!LittleFS.exists(ipath)) {
+      continue;
+    }
+    File idx = LittleFS.open(ipath, "r");
+    if (!idx) {
+      continue;
+    }
+    uint8_t e[8];
+    bool past = false;
+    while (idx.read(e, sizeof(e)) == sizeof(e)) {
+      const uint32_t et = WS_GetU32(e);
+      const uint32_t off = WS_GetU32(e + 4);
+      if (et > t) {
+        past = true;
+        break;
+      }
+      if (off < r.size[order[k]]) {
+        best.seg = k;
+        best.off = off;
+      }
+    }
+    idx.close();
+    if (past) {
+      break;
+    }
+  }
+  return best;
+}
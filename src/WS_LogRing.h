@@ -0,0 +1,72 @@
+#ifndef _WS_LOG_RING_H_
+#define _WS_LOG_RING_H_
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdint.h>
+
+// Circular log made of a fixed set of segment files "<base>.0" ... "<base>.<n-1>".
+// Only the newest segment is appended to; when it is full the oldest one is truncated
+// and reused, so a wrap drops 1/n of the history instead of half, and nothing is
+// removed or renamed. (LittleFS rewrites a file from the modified block to its end on
+// in-place writes, so a single preallocated file overwritten in place would cost far
+// more per flush than appending to a small segment.)
+//
+// Every segment starts with a 16-byte header carrying its sequence number; the boot
+// scan orders the segments by it: the highest valid one is the head (appended at its
+// end), the lowest is the tail. A segment with a torn / missing header is free.
+//
+// Optional sparse time index: "<base>.<i>.idx" holds {epoch, data offset} pairs (u32 LE),
+// one per index_step bytes of its segment, taken at the start of an appended batch.
+// It is truncated together with its segment.
+
+#define WS_LOGRING_MAX_SEGMENTS 16
+#define WS_LOGRING_HEADER_BYTES 16
+
+struct WS_LogRing {
+  const char* base = nullptr;
+  uint8_t segments = 0;
+  uint32_t seg_bytes = 0;                        // data capacity per segment (header excluded)
+
+  uint32_t seq[WS_LOGRING_MAX_SEGMENTS] = {0};   // 0 = free
+  uint32_t size[WS_LOGRING_MAX_SEGMENTS] = {0};  // data bytes
+  uint8_t head = 0;                              // segment being appended to
+  File f;                                        // append handle of the head segment
+  bool ready = false;
+  uint32_t switches = 0;                         // segments recycled since boot
+  uint32_t index_step = 0;                       // 0 = no time index
+  uint32_t index_next = 0;                       // head offset that gets the next entry
+};
+
+struct WS_LogRingPos {
+  uint8_t seg = 0;                               // index into WS_LogRing_Order()
+  uint32_t off = 0;
+};
+
+// Recovery scan; starts segment 0 if no valid segment exists. Needs a mounted FS.
+bool WS_LogRing_Open(WS_LogRing& r, const char* base, uint8_t segments, uint32_t segBytes, uint32_t indexStep);
+void WS_LogRing_Close(WS_LogRing& r);
+
+// Append to the head segment, moving to the next one first if n doesn't fit.
+// t: epoch of the first byte (0 = unknown, not indexed).
+size_t WS_LogRing_Append(WS_LogRing& r, const uint8_t* data, size_t n, uint32_t t);
+bool WS_LogRing_NextSegment(WS_LogRing& r);
+bool WS_LogRing_Clear(WS_LogRing& r);
+
+inline uint32_t WS_LogRing_HeadSize(const WS_LogRing& r) { return r.size[r.head]; }
+uint32_t WS_LogRing_Total(const WS_LogRing& r);
+
+// Valid segments oldest first; returns the count written to order[].
+uint8_t WS_LogRing_Order(const WS_LogRing& r, uint8_t* order);
+
+// Reads by data offset inside one segment, or across the whole log (0 = oldest byte).
+size_t WS_LogRing_ReadSegment(const WS_LogRing& r, uint8_t seg, uint32_t off, uint8_t* buf, size_t n);
+size_t WS_LogRing_Read(const WS_LogRing& r, uint32_t off, uint8_t* buf, size_t n);
+
+// Read handle on a segment's data (seek to WS_LOGRING_HEADER_BYTES + offset).
+File WS_LogRing_OpenSegment(const WS_LogRing& r, uint8_t seg);
+
+// Latest indexed position whose time is <= t (oldest byte if none), for a forward scan.
+WS_LogRingPos WS_LogRing_Seek(const WS_LogRing& r, uint32_t t);
+
+#endif
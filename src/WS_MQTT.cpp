@@ -8,7 +8,14 @@
 #include "WS_Control.h"
 #include "WS_Log.h"
 #include "WS_FS.h"
+#include "WS_Sensor.h"
+#include "WS_History.h"
 #include "WS_UI_Assets.h"
+#include "WS_MsgPack.h"
+#include "WS_StateJson.h"
+#include "WS_Outbox.h"
+#include "WS_MqttInflight.h"
+#include "WS_Bytes.h"
 
 #ifndef CONTENT_LENGTH_UNKNOWN
 #define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
@@ -17,6 +24,92 @@
 #ifndef MQTT_LOG_PUSH_Enable
 #define MQTT_LOG_PUSH_Enable true
 #endif
+#ifndef MQTT_TELEMETRY_DELTA_Enable
+#define MQTT_TELEMETRY_DELTA_Enable true   // publish merge patches between keyframes
+#endif
+#ifndef MQTT_TELEMETRY_KEYFRAME_MS
+#define MQTT_TELEMETRY_KEYFRAME_MS 300000UL // full state at least this often
+#endif
+#ifndef MQTT_TELEMETRY_GROUPS_Enable
+#define MQTT_TELEMETRY_GROUPS_Enable false // per-group topics "<pub>/<group>" on by default
+#endif
+#ifndef MQTT_TELEMETRY_GROUP_TICK_MS
+#define MQTT_TELEMETRY_GROUP_TICK_MS 250UL // how often group changes are looked for
+#endif
+#ifndef MQTT_MSGPACK_Enable
+#define MQTT_MSGPACK_Enable true           // allow switching to MessagePack ("set_encoding")
+#endif
+#ifndef MQTT_BATCH_Enable
+#define MQTT_BATCH_Enable false            // batch timestamped samples instead of interval state
+#endif
+#ifndef MQTT_BATCH_SAMPLE_MS
+#define MQTT_BATCH_SAMPLE_MS 1000UL        // sampling period while batching
+#endif
+#ifndef MQTT_BATCH_FLUSH_S
+#define MQTT_BATCH_FLUSH_S 30              // publish a batch at least this often ...
+#endif
+#ifndef MQTT_BATCH_SAMPLES
+#define MQTT_BATCH_SAMPLES 30              // ... or when it has this many samples (RAM ring size)
+#endif
+#ifndef MQTT_OUTBOX_Enable
+#define MQTT_OUTBOX_Enable true            // keep batches / log pushes on LittleFS while offline
+#endif
+#ifndef MQTT_OUTBOX_SEGMENT_BYTES
+#define MQTT_OUTBOX_SEGMENT_BYTES 65536UL  // outbox segment file size (a message never spans two)
+#endif
+#ifndef MQTT_OUTBOX_SEGMENTS
+#define MQTT_OUTBOX_SEGMENTS 8             // outbox full => its oldest segment is dropped
+#endif
+#ifndef MQTT_OUTBOX_REPLAY_MS
+#define MQTT_OUTBOX_REPLAY_MS 250UL        // replay one step this often ...
+#endif
+#ifndef MQTT_OUTBOX_REPLAY_MSGS
+#define MQTT_OUTBOX_REPLAY_MSGS 2          // ... of at most this many messages ...
+#endif
+#ifndef MQTT_OUTBOX_REPLAY_BYTES
+#define MQTT_OUTBOX_REPLAY_BYTES 4096UL    // ... or payload bytes
+#endif
+#ifndef MQTT_OUTBOX_BACKOFF_MAX_MS
+#define MQTT_OUTBOX_BACKOFF_MAX_MS 10000UL // longest pause after failed replay publishes
+#endif
+#ifndef MQTT_QOS1_Enable
+#define MQTT_QOS1_Enable true              // batches, replay, log pushes, replies with QoS1
+#endif
+#ifndef MQTT_QOS1_INFLIGHT
+#define MQTT_QOS1_INFLIGHT 8               // unacknowledged QoS1 messages at most ...
+#endif
+#ifndef MQTT_QOS1_WINDOW_BYTES
+#define MQTT_QOS1_WINDOW_BYTES 16384UL     // ... and their bytes (RAM); larger ones go QoS0
+#endif
+#ifndef MQTT_QOS1_RETRY_MS
+#define MQTT_QOS1_RETRY_MS 5000UL          // resend (DUP) without PUBACK after this long
+#endif
+#ifndef MQTT_RECONNECT_MIN_MS
+#define MQTT_RECONNECT_MIN_MS 1000UL       // first wait after a failed connect ...
+#endif
+#ifndef MQTT_RECONNECT_MAX_MS
+#define MQTT_RECONNECT_MAX_MS 60000UL      // ... doubling up to this (+-25% jitter)
+#endif
+#ifndef MQTT_CONNECT_TIMEOUT_MS
+#define MQTT_CONNECT_TIMEOUT_MS 5000UL     // per connect step: DNS, TCP, CONNACK (in the background)
+#endif
+#ifndef MQTT_KEEPALIVE_S
+#define MQTT_KEEPALIVE_S 15                // MQTT keepalive (PubSubClient's default)
+#endif
+#ifndef MQTT_CHUNK_BYTES
+#define MQTT_CHUNK_BYTES 2048          // raw bytes per chunked RPC reply (sent base64 encoded)
+#endif
+#ifndef MQTT_LOG_QUEUE_BYTES
+#define MQTT_LOG_QUEUE_BYTES 2048      // RAM queue per log; full => oldest lines dropped
+#endif
+#ifndef MQTT_LOG_BATCH_MS
+#define MQTT_LOG_BATCH_MS 2000UL       // coalesce lines for up to this long ...
+#endif
+#ifndef MQTT_LOG_BATCH_BYTES
+#define MQTT_LOG_BATCH_BYTES 1024      // ... or until a batch reaches this payload size
+#endif
+
+static_assert(WS_SENSOR_MAX == WS_STATE_SENSOR_MAX, "WS_StateInputs must hold the whole sensor table");
 
 // The name and password of the WiFi access point
 const char* ssid = STASSID;
@@ -31,8 +124,8 @@ const char* pub = MQTT_Pub; // MQTT publish topic
 const char* sub = MQTT_Sub; // MQTT subscribe topic
 
 
-WiFiClient espClient;                 // MQTT initializes the contents
-PubSubClient client(espClient);
+WS_MqttLink mqttLink;                 // MQTT socket (non-blocking connect, QoS1)
+PubSubClient client(mqttLink);
 WebServer server(80);                 // Declare the WebServer object
 
 
@@ -44,16 +137,6 @@ static uint32_t g_wifiRetryLastMs = 0;
 static bool g_uiFsChecked = false;
 static bool g_uiFsAvailable = false;
 
-extern uint16_t Sensor_Level_mm_1;
-extern uint16_t Sensor_Level_mm_2;
-extern int16_t Sensor_Temp_x10_1;
-extern int16_t Sensor_Temp_x10_2;
-extern bool Sensor_HasValue_1;
-extern bool Sensor_HasValue_2;
-extern bool Sensor_HasTemp_1;
-extern bool Sensor_HasTemp_2;
-extern bool Sensor_Online_1;
-extern bool Sensor_Online_2;
 extern uint8_t Gate_State;
 extern bool Gate_Position_Open;
 extern bool Gate_AutoControl_Enabled;
@@ -84,6 +167,15 @@ static char OtaLastCheck[24] = "n/a";
 static char OtaLastResult[96] = "web_update_only";
 static bool Mqtt_State_Dirty = true;
 static uint32_t Mqtt_LastPublishMs = 0;
+static WS_MqttInflight g_qos;          // QoS1 in-flight window (see "QoS1 transport")
+static uint32_t g_mqttCmdRxMs = 0;     // arrival of the command being handled
+static uint32_t g_mqttCmdRttMs = 0;    // command received -> PUBACK of its reply
+enum : uint8_t { kMqttIdle, kMqttDns, kMqttTcp, kMqttConnack };
+static uint8_t g_mqttConnStep = kMqttIdle;   // reconnect() progress
+static uint32_t g_mqttConnectStartMs = 0;
+static uint32_t g_mqttNextTryMs = 0;
+static uint32_t g_mqttBackoffMs = 0;   // 0 after a successful connect
+static uint32_t g_mqttConnects = 0;    // since boot
 
 static void WS_JsonEscape(const char* in, char* out, size_t outSize)
 {
@@ -191,116 +283,139 @@ static void Ota_SetStatus(const char* latest, const char* result)
   snprintf(OtaLastCheck, sizeof(OtaLastCheck), "%lus", (unsigned long)(millis() / 1000UL));
 }
 
-static void MQTT_BuildStateJson(char* json, size_t jsonSize)
+static void MQTT_CopyField(char* dst, size_t n, const char* src)
 {
-  const bool wifiStaConnected = (WiFi.status() == WL_CONNECTED);
-  const int rssi = wifiStaConnected ? WiFi.RSSI() : -127;
-  const bool mqttConnected = (MQTT_CLOUD_Enable && wifiStaConnected) ? client.connected() : false;
-  const uint32_t nowMs = millis();
+  strncpy(dst, src ? src : "", n - 1);   // pads with zeros: stable bytes for the hash
+}
 
-  char ssidEsc[80];
-  WS_JsonEscape(wifiStaConnected ? WiFi.SSID().c_str() : "", ssidEsc, sizeof(ssidEsc));
+static void MQTT_GatherState(WS_StateInputs& in)
+{
+  memset(&in, 0, sizeof(in));
+  WS_StateNet& net = in.net;
+  net.wifi = (WiFi.status() == WL_CONNECTED);
+  net.rssi = net.wifi ? WiFi.RSSI() : -127;
+  net.mqtt = (MQTT_CLOUD_Enable && net.wifi) ? client.connected() : false;
+  net.http = g_httpStarted;
+  net.mqtt_rtt_ms = g_qos.srtt_ms;
+  net.cmd_rtt_ms = g_mqttCmdRttMs;
+  const uint32_t nowMs = millis();
 
-  char ipLocal[16];
+  if (net.wifi) {
+    MQTT_CopyField(net.ssid, sizeof(net.ssid), WiFi.SSID().c_str());
+  }
   {
-    const IPAddress ip = wifiStaConnected ? WiFi.localIP() : WiFi.softAPIP();
-    snprintf(ipLocal, sizeof(ipLocal), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+    const IPAddress ip = net.wifi ? WiFi.localIP() : WiFi.softAPIP();
+    snprintf(net.ip, sizeof(net.ip), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
   }
 
-  char ipEsc[24];
-  WS_JsonEscape(ipLocal, ipEsc, sizeof(ipEsc));
-
-  char reasonEsc[192];
-  WS_JsonEscape(Gate_Block_Reason, reasonEsc, sizeof(reasonEsc));
-
-  char alarmEsc[256];
-  WS_JsonEscape(Alarm_Text, alarmEsc, sizeof(alarmEsc));
-
-  char fwCurEsc[64];
-  WS_JsonEscape(FW_VERSION, fwCurEsc, sizeof(fwCurEsc));
-  char fwLatestEsc[64];
-  WS_JsonEscape(OtaLatestVersion, fwLatestEsc, sizeof(fwLatestEsc));
-  char fwLastCheckEsc[64];
-  WS_JsonEscape(OtaLastCheck, fwLastCheckEsc, sizeof(fwLastCheckEsc));
-  char fwLastResultEsc[160];
-  WS_JsonEscape(OtaLastResult, fwLastResultEsc, sizeof(fwLastResultEsc));
-
-  uint32_t manualRemainS = 0;
+  in.gate_state = Gate_State;
+  in.gate_position_open = Gate_Position_Open;
+  in.auto_gate = Gate_AutoControl_Enabled;
+  in.auto_latched = Gate_Auto_Latched_Off;
+  in.manual.active = Manual_Takeover_Active;
   if (Manual_Takeover_Active && Manual_Takeover_UntilMs > nowMs) {
-    manualRemainS = (Manual_Takeover_UntilMs - nowMs + 999UL) / 1000UL;
+    in.manual.remain_s = (Manual_Takeover_UntilMs - nowMs + 999UL) / 1000UL;
   }
-  uint32_t manualTotalS = 0;
   if (Manual_Takeover_DurationMs > 0) {
-    manualTotalS = (Manual_Takeover_DurationMs + 999UL) / 1000UL;
+    in.manual.total_s = (Manual_Takeover_DurationMs + 999UL) / 1000UL;
   }
-  uint32_t cooldownRemainS = 0;
+  in.relay1 = Relay_Flag[0] ? 1 : 0;
+  in.relay2 = Relay_Flag[1] ? 1 : 0;
+
+  in.cell.enabled = AIR780E_Enable;
+  in.cell.online = Air780E_Online;
+  in.cell.sim_ready = Air780E_SIMReady;
+  in.cell.attached = Air780E_Attached;
+  in.cell.csq = Air780E_CSQ;
+  in.cell.rssi_dbm = Air780E_RSSI_dBm;
+  if (Air780E_LastRxMs > 0 && nowMs >= Air780E_LastRxMs) {
+    in.cell.last_rx_age_s = (nowMs - Air780E_LastRxMs) / 1000UL;
+  }
+
+  in.ctrl.open_allowed = Gate_Open_Allowed;
+  in.ctrl.close_allowed = Gate_Close_Allowed;
+  in.ctrl.min_interval_s = (uint16_t)GATE_MIN_ACTION_INTERVAL_S;
+  in.ctrl.action_s = (uint16_t)GATE_RELAY_ACTION_SECONDS;
   if (!Manual_Takeover_Active) {
     const uint32_t cooldownMs = (uint32_t)GATE_MIN_ACTION_INTERVAL_S * 1000UL;
     const uint32_t untilMs = Gate_Last_Action_EndMs + cooldownMs;
     if (cooldownMs > 0 && (int32_t)(nowMs - untilMs) < 0) {
-      cooldownRemainS = (untilMs - nowMs + 999UL) / 1000UL;
+      in.ctrl.cooldown_remain_s = (untilMs - nowMs + 999UL) / 1000UL;
     }
   }
-  uint32_t airLastRxAgeS = 0;
-  if (Air780E_LastRxMs > 0 && nowMs >= Air780E_LastRxMs) {
-    airLastRxAgeS = (nowMs - Air780E_LastRxMs) / 1000UL;
-  }
-
-  const int n = snprintf(
-    json,
-    jsonSize,
-    "{\"sensor1\":{\"mm\":%u,\"valid\":%s,\"online\":%s,\"temp_x10\":%d,\"temp_valid\":%s},\"sensor2\":{\"mm\":%u,\"valid\":%s,\"online\":%s,\"temp_x10\":%d,\"temp_valid\":%s},\"gate_state\":%u,\"gate_position_open\":%s,\"auto_gate\":%s,\"auto_latched\":%s,\"manual\":{\"active\":%s,\"remain_s\":%lu,\"total_s\":%lu},\"relay1\":%u,\"relay2\":%u,\"net\":{\"wifi\":%s,\"mqtt\":%s,\"http\":%s,\"ip\":\"%s\",\"rssi\":%d,\"ssid\":\"%s\"},\"cell\":{\"enabled\":%s,\"online\":%s,\"sim_ready\":%s,\"attached\":%s,\"csq\":%d,\"rssi_dbm\":%d,\"last_rx_age_s\":%lu},\"ctrl\":{\"open_allowed\":%s,\"close_allowed\":%s,\"cooldown_remain_s\":%lu,\"min_interval_s\":%u,\"action_s\":%u,\"reason\":\"%s\"},\"alarm\":{\"active\":%s,\"severity\":%u,\"text\":\"%s\"},\"fw\":{\"current\":\"%s\",\"latest\":\"%s\",\"last_check\":\"%s\",\"last_result\":\"%s\"}}",
-    Sensor_Level_mm_1,
-    Sensor_HasValue_1 ? "true" : "false",
-    Sensor_Online_1 ? "true" : "false",
-    Sensor_Temp_x10_1,
-    Sensor_HasTemp_1 ? "true" : "false",
-    Sensor_Level_mm_2,
-    Sensor_HasValue_2 ? "true" : "false",
-    Sensor_Online_2 ? "true" : "false",
-    Sensor_Temp_x10_2,
-    Sensor_HasTemp_2 ? "true" : "false",
-    Gate_State,
-    Gate_Position_Open ? "true" : "false",
-    Gate_AutoControl_Enabled ? "true" : "false",
-    Gate_Auto_Latched_Off ? "true" : "false",
-    Manual_Takeover_Active ? "true" : "false",
-    (unsigned long)manualRemainS,
-    (unsigned long)manualTotalS,
-    Relay_Flag[0] ? 1 : 0,
-    Relay_Flag[1] ? 1 : 0,
-    wifiStaConnected ? "true" : "false",
-    mqttConnected ? "true" : "false",
-    g_httpStarted ? "true" : "false",
-    ipEsc,
-    rssi,
-    ssidEsc,
-    AIR780E_Enable ? "true" : "false",
-    Air780E_Online ? "true" : "false",
-    Air780E_SIMReady ? "true" : "false",
-    Air780E_Attached ? "true" : "false",
-    Air780E_CSQ,
-    Air780E_RSSI_dBm,
-    (unsigned long)airLastRxAgeS,
-    Gate_Open_Allowed ? "true" : "false",
-    Gate_Close_Allowed ? "true" : "false",
-    (unsigned long)cooldownRemainS,
-    (unsigned int)GATE_MIN_ACTION_INTERVAL_S,
-    (unsigned int)GATE_RELAY_ACTION_SECONDS,
-    reasonEsc,
-    Alarm_Active ? "true" : "false",
-    Alarm_Severity,
-    alarmEsc,
-    fwCurEsc,
-    fwLatestEsc,
-    fwLastCheckEsc,
-    fwLastResultEsc
-  );
-
-  if (n < 0 || (size_t)n >= jsonSize) {
-    // Keep response JSON valid even if it doesn't fit into the buffer.
-    snprintf(json, jsonSize, "{\"ok\":false,\"error\":\"telemetry_json_overflow\"}");
+  MQTT_CopyField(in.ctrl.reason, sizeof(in.ctrl.reason), Gate_Block_Reason);
+  in.alarm.active = Alarm_Active;
+  in.alarm.severity = Alarm_Severity;
+  MQTT_CopyField(in.alarm.text, sizeof(in.alarm.text), Alarm_Text);
+  MQTT_CopyField(in.fw.current, sizeof(in.fw.current), FW_VERSION);
+  MQTT_CopyField(in.fw.latest, sizeof(in.fw.latest), OtaLatestVersion);
+  MQTT_CopyField(in.fw.last_check, sizeof(in.fw.last_check), OtaLastCheck);
+  MQTT_CopyField(in.fw.last_result, sizeof(in.fw.last_result), OtaLastResult);
+
+  in.sensor_count = (Sensor_Count > WS_SENSOR_MAX) ? WS_SENSOR_MAX : Sensor_Count;
+  for (uint8_t i = 0; i < in.sensor_count; i++) {
+    const WS_SensorSlot& si = Sensor_Table[i];
+    WS_StateSensor& o = in.sensors[i];
+    o.id = si.id;
+    o.valid = si.has_value;
+    o.online = si.online;
+    o.temp_valid = si.has_temp;
+    o.mm = si.level_mm;
+    o.filt_mm = si.filt_mm;
+    o.temp_x10 = si.temp_x10;
+    o.q = si.quality;
+    o.poll_ms = si.poll_interval_ms;
+  }
+}
+
+// One state JSON for all consumers (/getData, /api/state, MQTT). Each request gathers the
+// inputs and hashes them (cheap); the JSON is only formatted again when the hash changed,
+// which also advances gen. gen is the HTTP ETag, and MQTT skips the delta diff while it
+// stays the same. Used from loop() only (HTTP handlers, MQTT callback and publisher).
+struct WS_StateSnapshot {
+  char json[WS_STATE_JSON_MAX];
+  size_t len = 0;
+  uint32_t gen = 0;
+  uint32_t hash = 0;
+};
+static WS_StateSnapshot g_stateSnap;
+static WS_StateInputs g_stateIn;     // last gathered inputs (~1 KB, static: off the stack)
+static uint32_t g_stateBootId = 0;   // ETag prefix: a reboot never repeats an old tag
+
+static uint32_t MQTT_Fnv1a(const void* data, size_t n)
+{
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ p[i]) * 16777619UL;
   }
+  return h;
+}
+
+static const WS_StateSnapshot& MQTT_StateSnapshot()
+{
+  MQTT_GatherState(g_stateIn);
+  const uint32_t h = MQTT_Fnv1a(&g_stateIn, sizeof(g_stateIn));
+  if (g_stateSnap.gen != 0 && h == g_stateSnap.hash) {
+    return g_stateSnap;
+  }
+  g_stateSnap.len = WS_StateJson_Build(g_stateIn, g_stateSnap.json, sizeof(g_stateSnap.json));
+  g_stateSnap.hash = h;
+  g_stateSnap.gen++;
+  return g_stateSnap;
+}
+
+static uint32_t MQTT_BootId()
+{
+  if (g_stateBootId == 0) {
+    g_stateBootId = esp_random() | 1UL;
+  }
+  return g_stateBootId;
+}
+
+static void MQTT_StateETag(const WS_StateSnapshot& snap, char* out, size_t n)
+{
+  snprintf(out, n, "\"%08lx-%lu\"", (unsigned long)MQTT_BootId(), (unsigned long)snap.gen);
 }
 
 static void MQTT_MarkStateDirty()
@@ -308,24 +423,625 @@ static void MQTT_MarkStateDirty()
   Mqtt_State_Dirty = true;
 }
 
+// ===================== QoS1 transport =====================
+// PubSubClient runs over WS_MqttLink (non-blocking TCP connect, QoS1 PUBLISH, PUBACKs).
+// What must arrive — batches, outbox replay, log pushes, RPC replies, the birth message —
+// goes with QoS1 through the in-flight window (WS_MqttInflight.h), sent from here and
+// resent until acknowledged, also across reconnects. State and group telemetry stay QoS0:
+// the next message supersedes a lost one. A full window refuses new messages; callers keep
+// their data (ring, queue, outbox) and try again later. The window is RAM: a reboot loses
+// what is in flight, and a message too large for it goes QoS0.
+#if MQTT_QOS1_Enable
+static uint8_t g_qosArena[MQTT_QOS1_WINDOW_BYTES];
+#endif
+
+static bool MQTT_QosReady()
+{
+  return MQTT_QOS1_Enable && g_qos.arena != nullptr;
+}
+
+static bool MQTT_QosFits(const char* topic, size_t len)
+{
+  return MQTT_QosReady() && WS_MqttInflight_Fits(g_qos, strlen(topic), (uint32_t)len);
+}
+
+// Collects PUBACKs, then sends what is due (new, or unacknowledged for MQTT_QOS1_RETRY_MS).
+static void MQTT_QosPump()
+{
+  if (!MQTT_QosReady() || !client.connected()) {
+    return;
+  }
+  const uint32_t nowMs = millis();
+  uint16_t pid = 0;
+  while (mqttLink.TakePuback(pid)) {
+    WS_MqttInflightAck ack;
+    if (WS_MqttInflight_Ack(g_qos, pid, nowMs, ack) && ack.t0_ms != 0) {
+      g_mqttCmdRttMs = nowMs - ack.t0_ms;
+    }
+  }
+  WS_MqttInflightMsg* m = nullptr;
+  while ((m = WS_MqttInflight_NextDue(g_qos, nowMs, MQTT_QOS1_RETRY_MS)) != nullptr) {
+    if (!mqttLink.PublishQos1(WS_MqttInflight_Topic(g_qos, *m), WS_MqttInflight_Payload(g_qos, *m), m->len, m->pid,
+                              m->retained, m->sends > 0)) {
+      break;   // link trouble: PubSubClient notices, everything is resent after reconnect
+    }
+    WS_MqttInflight_MarkSent(g_qos, *m, nowMs);
+  }
+}
+
+// t0 of an RPC reply: the command's arrival (never 0, which means "not a reply").
+static uint32_t MQTT_ReplyT0()
+{
+  return g_mqttCmdRxMs | 1UL;
+}
+
+// QoS1 if the window can hold the message (false while it is full), else QoS0. t0Ms != 0
+// marks an RPC reply: its PUBACK yields cmd_rtt_ms, and a full window sends it QoS0
+// instead (the server repeats a request that timed out; nothing keeps the reply).
+static bool MQTT_PublishReliable(const char* topic, const uint8_t* data, size_t n, bool retained, uint32_t t0Ms = 0)
+{
+  if (MQTT_QosFits(topic, n) && WS_MqttInflight_Put(g_qos, topic, data, n, retained, t0Ms)) {
+    MQTT_QosPump();
+    return true;
+  }
+  if (MQTT_QosFits(topic, n) && t0Ms == 0) {
+    return false;
+  }
+  return client.publish(topic, data, (unsigned int)n, retained);
+}
+
+// True while the window is full and this message would go through it: keep it for later
+// instead of sending it into the outbox.
+static bool MQTT_QosWait(const char* topic, size_t len)
+{
+  return MQTT_QosFits(topic, len) && WS_MqttInflight_Full(g_qos);
+}
+
+// The same, streamed (size known up front): Begin, Write..., End.
+static bool g_mqttStreamQos = false;
+
+static bool MQTT_StreamBegin(const char* topic, uint32_t len, bool retained, uint32_t t0Ms = 0)
+{
+  g_mqttStreamQos = MQTT_QosFits(topic, len);
+  if (g_mqttStreamQos) {
+    if (WS_MqttInflight_Begin(g_qos, topic, len, retained, t0Ms)) {
+      return true;
+    }
+    if (t0Ms == 0) {
+      return false;
+    }
+    g_mqttStreamQos = false;   // reply, window full: QoS0
+  }
+  return client.beginPublish(topic, (unsigned int)len, retained);
+}
+
+static bool MQTT_StreamWrite(const uint8_t* data, size_t n)
+{
+  if (g_mqttStreamQos) {
+    return WS_MqttInflight_Write(g_qos, data, n);
+  }
+  return client.write(data, n) == n;
+}
+
+static bool MQTT_StreamEnd()
+{
+  if (!g_mqttStreamQos) {
+    return client.endPublish() != 0;
+  }
+  const bool ok = WS_MqttInflight_End(g_qos);
+  MQTT_QosPump();
+  return ok;
+}
+
+// ===================== Binary encoding (MessagePack) =====================
+// JSON until the server sends {"cmd":"set_encoding","enc":"msgpack"} (again after a
+// reboot). Telemetry and document replies are then transcoded from their JSON text
+// (WS_MsgPack.h) and published on "<topic>/mp". Streamed replies (chunks, log text) and
+// the log push stay as they are: they are mostly payload, there is little to save.
+static bool g_mqttMsgPack = false;
+#if MQTT_MSGPACK_Enable
+static uint8_t g_mqttMpBuf[WS_STATE_JSON_MAX + 64];   // loop() only, like the state buffer
+#endif
+
+// json goes out as MessagePack on "<topic>/mp" when that encoding is on, else (or if it
+// doesn't fit) unchanged on topic. A reply goes with QoS1, timed from the command's arrival.
+static bool MQTT_PublishEncoded(const char* topic, const char* json, size_t len, bool retained = false, bool reply = false)
+{
+  const uint32_t t0Ms = reply ? MQTT_ReplyT0() : 0;
+#if MQTT_MSGPACK_Enable
+  if (g_mqttMsgPack) {
+    char mpTopic[112];
+    const int tn = snprintf(mpTopic, sizeof(mpTopic), "%s/mp", topic);
+    const size_t n = WS_MsgPack_FromJson(json, len, g_mqttMpBuf, sizeof(g_mqttMpBuf));
+    if (n > 0 && tn > 0 && (size_t)tn < sizeof(mpTopic)) {
+      if (reply) {
+        return MQTT_PublishReliable(mpTopic, g_mqttMpBuf, n, retained, t0Ms);
+      }
+      return client.publish(mpTopic, g_mqttMpBuf, (unsigned int)n, retained);
+    }
+  }
+#endif
+  if (reply) {
+    return MQTT_PublishReliable(topic, (const uint8_t*)json, len, retained, t0Ms);
+  }
+  return client.publish(topic, json, retained);
+}
+
+// Delta telemetry: a keyframe is the full state plus {"seq":N,"kf":1}; in between,
+// {"seq":N,"delta":1,...} carries a JSON Merge Patch (RFC 7386) against the previous
+// message: changed members only, null for removed ones, arrays replaced whole. seq
+// counts published messages, so a receiver that sees a gap ignores patches until the
+// next keyframe (it can ask for one with {"cmd":"keyframe"}). A keyframe also goes out
+// on (re)connect and every MQTT_TELEMETRY_KEYFRAME_MS.
+static JsonDocument g_telePrev;        // state as last published
+static bool g_telePrevValid = false;
+static bool g_teleKeyframeDue = true;
+static uint32_t g_teleSeq = 0;
+static uint32_t g_teleKeyframeMs = 0;
+static uint32_t g_telePrevGen = 0;     // snapshot generation of g_telePrev
+
+static void MQTT_RequestKeyframe()
+{
+  g_teleKeyframeDue = true;
+}
+
+static void MQTT_MergeDiff(JsonObjectConst prev, JsonObjectConst cur, JsonObject patch)
+{
+  for (JsonPairConst kv : cur) {
+    const JsonVariantConst was = prev[kv.key()];
+    if (was.isNull() && !kv.value().isNull()) {
+      patch[kv.key()] = kv.value();
+    } else if (was.is<JsonObjectConst>() && kv.value().is<JsonObjectConst>()) {
+      JsonObject sub = patch[kv.key()].to<JsonObject>();
+      MQTT_MergeDiff(was.as<JsonObjectConst>(), kv.value().as<JsonObjectConst>(), sub);
+      if (sub.size() == 0) {
+        patch.remove(kv.key());
+      }
+    } else if (was != kv.value()) {
+      patch[kv.key()] = kv.value();
+    }
+  }
+  for (JsonPairConst kv : prev) {
+    // Merge patch treats null as "absent", so a null member needs no removal either.
+    if (cur[kv.key()].isNull() && !kv.value().isNull()) {
+      patch[kv.key()] = nullptr;
+    }
+  }
+}
+
+// Turns the state JSON (snapshot generation gen) into the message to publish (in place);
+// returns false if it should go out unchanged (delta off, or not parseable). unchanged:
+// same generation as the last message, so the patch is empty and cur is not filled.
+static bool MQTT_TelemetryEncode(char* json, size_t jsonSize, uint32_t gen, bool& keyframe, bool& unchanged, JsonDocument& cur)
+{
+  if (!MQTT_TELEMETRY_DELTA_Enable) {
+    g_telePrevValid = false;
+    return false;
+  }
+  const uint32_t nowMs = millis();
+  keyframe = g_teleKeyframeDue || !g_telePrevValid || (nowMs - g_teleKeyframeMs) >= (uint32_t)MQTT_TELEMETRY_KEYFRAME_MS;
+  unchanged = !keyframe && gen == g_telePrevGen;
+  if (unchanged) {
+    const int n = snprintf(json, jsonSize, "{\"seq\":%lu,\"delta\":1}", (unsigned long)g_teleSeq);
+    return n > 0 && (size_t)n < jsonSize;
+  }
+  if (deserializeJson(cur, json)) {
+    g_telePrevValid = false;
+    return false;
+  }
+  if (keyframe) {
+    char head[40];
+    const int hn = snprintf(head, sizeof(head), "{\"seq\":%lu,\"kf\":1%s", (unsigned long)g_teleSeq, (json[1] == '}') ? "" : ",");
+    const size_t n = strlen(json);
+    if (hn <= 0 || (size_t)hn + n > jsonSize) {
+      return false;
+    }
+    memmove(json + hn, json + 1, n);   // incl. terminator
+    memcpy(json, head, (size_t)hn);
+    return true;
+  }
+  JsonDocument patch;
+  patch["seq"] = g_teleSeq;
+  patch["delta"] = 1;
+  MQTT_MergeDiff(g_telePrev.as<JsonObjectConst>(), cur.as<JsonObjectConst>(), patch.as<JsonObject>());
+  const size_t n = serializeJson(patch, json, jsonSize);
+  return n > 0 && n < jsonSize;
+}
+
+// ===================== Telemetry groups =====================
+// Besides the full state on pub, each WS_StateGroup can go out on "<pub>/<group>" as an
+// object with the group's top-level keys, e.g. "<pub>/net" -> {"net":{...}}. Group messages
+// are retained, so a new subscriber gets every enabled group at once; merging them gives
+// the full state. Each stream ("state" is the full one on pub) has a policy:
+//   period_ms  publish at least this often (0: not periodically)
+//   on_change  also publish as soon as the content changed (checked every
+//              MQTT_TELEMETRY_GROUP_TICK_MS; for "state": the dirty flag, as before)
+// period_ms 0 without on_change turns a stream off (a group's retained message is cleared).
+// Only due groups are serialized. Runtime changes ("telemetry" RPC) are not persisted.
+struct WS_TelePolicy {
+  uint32_t period_ms;
+  bool on_change;
+  bool due;            // publish at the next tick (reconnect, policy change)
+  bool sent;           // a retained message is on the broker
+  uint32_t last_ms;
+  uint32_t hash;       // group inputs as last published
+};
+
+static const uint8_t kTeleState = WS_SG_COUNT;   // g_telePolicy[] index of the full-state stream
+#define WS_TELE_POLICY(periodMs, onChange) {periodMs, onChange, true, false, 0, 0}
+static WS_TelePolicy g_telePolicy[WS_SG_COUNT + 1] = {
+#if MQTT_TELEMETRY_GROUPS_Enable
+  WS_TELE_POLICY(1000UL, false),      // sensors: levels every second
+  WS_TELE_POLICY(10000UL, true),      // gate (incl. ctrl): on change
+  WS_TELE_POLICY(60000UL, true),      // alarm
+  WS_TELE_POLICY(60000UL, false),     // net
+  WS_TELE_POLICY(60000UL, false),     // cell
+  WS_TELE_POLICY(3600000UL, true),    // fw
+#else
+  WS_TELE_POLICY(0, false), WS_TELE_POLICY(0, false), WS_TELE_POLICY(0, false),
+  WS_TELE_POLICY(0, false), WS_TELE_POLICY(0, false), WS_TELE_POLICY(0, false),
+#endif
+  WS_TELE_POLICY(MQTT_TELEMETRY_INTERVAL_MS, MQTT_PUBLISH_ON_CHANGE_Enable),   // state
+};
+static_assert(sizeof(g_telePolicy) / sizeof(g_telePolicy[0]) == WS_SG_COUNT + 1, "one policy per group + state");
+static uint32_t g_teleGroupTickMs = 0;
+
+static const char* MQTT_TeleName(uint8_t i)
+{
+  return (i == kTeleState) ? "state" : WS_StateJson_GroupName(i);
+}
+
+static int MQTT_TeleFind(const char* name)
+{
+  return (name && strcmp(name, "state") == 0) ? (int)kTeleState : WS_StateJson_GroupFind(name);
+}
+
+static bool MQTT_TeleEnabled(const WS_TelePolicy& p)
+{
+  return p.period_ms > 0 || p.on_change;
+}
+
+static void MQTT_TeleAllDue()
+{
+  for (uint8_t g = 0; g < WS_SG_COUNT; g++) {
+    g_telePolicy[g].due = true;
+  }
+}
+
+static bool MQTT_TeleGroupTopic(uint8_t g, char* out, size_t n)
+{
+  const int tn = snprintf(out, n, "%s/%s", pub, WS_StateJson_GroupName(g));
+  return tn > 0 && (size_t)tn < n;
+}
+
+// Shared with MQTT_PublishState (loop() only).
+static char g_teleJson[WS_STATE_JSON_MAX + 40];
+
+static void MQTT_PublishGroups()
+{
+  if (!MQTT_CLOUD_Enable || !client.connected()) {
+    return;
+  }
+  const uint32_t nowMs = millis();
+  if ((nowMs - g_teleGroupTickMs) < (uint32_t)MQTT_TELEMETRY_GROUP_TICK_MS) {
+    return;
+  }
+  g_teleGroupTickMs = nowMs;
+
+  bool gathered = false;
+  for (uint8_t g = 0; g < WS_SG_COUNT; g++) {
+    WS_TelePolicy& p = g_telePolicy[g];
+    char topic[112];
+    if (!MQTT_TeleGroupTopic(g, topic, sizeof(topic))) {
+      continue;
+    }
+    if (!MQTT_TeleEnabled(p)) {
+      if (p.sent) {
+        // An empty retained message clears the group on the broker (both encodings).
+        char mpTopic[120];
+        snprintf(mpTopic, sizeof(mpTopic), "%s/mp", topic);
+        p.sent = !(client.publish(topic, "", true) && client.publish(mpTopic, "", true));
+      }
+      continue;
+    }
+    const bool periodDue = p.period_ms > 0 && (nowMs - p.last_ms) >= p.period_ms;
+    if (!p.due && !periodDue && !p.on_change) {
+      continue;
+    }
+    if (!gathered) {
+      MQTT_GatherState(g_stateIn);
+      gathered = true;
+    }
+    const uint32_t h = WS_StateJson_GroupHash(g_stateIn, g);
+    if (!p.due && !periodDue && h == p.hash) {
+      continue;
+    }
+    WS_JsonWriter w(g_teleJson, sizeof(g_teleJson));
+    const size_t n = WS_StateJson_WriteGroup(w, g_stateIn, g);
+    if (w.overflow() || !MQTT_PublishEncoded(topic, g_teleJson, n, true)) {
+      continue;   // retried at the next tick
+    }
+    p.due = false;
+    p.sent = true;
+    p.last_ms = nowMs;
+    p.hash = h;
+  }
+}
+
+// ===================== Store-and-forward outbox =====================
+// While the broker is out of reach, batches ("<pub>/batch") and log pushes go to a LittleFS
+// outbox (WS_Outbox.h) instead of being dropped. With the outbox on, samples are taken while
+// offline even when batching is off, so the measurements of an outage arrive timestamped; the
+// action log carries the gate commands. After reconnect the outbox is replayed in order, a
+// paced step (MQTT_OUTBOX_REPLAY_*) after the live traffic of each loop. Until it has drained,
+// new batches and log pushes queue behind it, so neither stream arrives out of order (the
+// server drops batch samples it has already seen, by boot+seq). The state itself is not kept:
+// the newest one supersedes it, and a full state goes out on reconnect.
+static WS_Outbox g_outbox;
+static const WS_OutboxPace kOutboxPace = {MQTT_OUTBOX_REPLAY_MS, MQTT_OUTBOX_REPLAY_MSGS, MQTT_OUTBOX_REPLAY_BYTES,
+                                          MQTT_OUTBOX_BACKOFF_MAX_MS};
+
+static bool MQTT_OutboxReady()
+{
+  return MQTT_OUTBOX_Enable && WS_Outbox_Ready(g_outbox);
+}
+
+static bool MQTT_Online()
+{
+  return WiFi.status() == WL_CONNECTED && client.connected();
+}
+
+// A batch / log push goes to the outbox rather than the client.
+static bool MQTT_OutboxRoute()
+{
+  return MQTT_OutboxReady() && (!MQTT_Online() || !WS_Outbox_Empty(g_outbox));
+}
+
+static bool MQTT_OutboxBegin(void*, const char* topic, uint32_t len, bool retained)
+{
+  return MQTT_StreamBegin(topic, len, retained);
+}
+
+static bool MQTT_OutboxWrite(void*, const uint8_t* data, size_t n)
+{
+  return MQTT_StreamWrite(data, n);
+}
+
+static bool MQTT_OutboxEnd(void*)
+{
+  return MQTT_StreamEnd();
+}
+
+static void MQTT_OutboxLoop()
+{
+  if (!MQTT_OutboxReady() || !client.connected()) {
+    return;
+  }
+  if (MQTT_QosReady() && WS_MqttInflight_Full(g_qos)) {
+    return;   // wait for PUBACKs rather than back off
+  }
+  static const WS_OutboxPublisher pub = {MQTT_OutboxBegin, MQTT_OutboxWrite, MQTT_OutboxEnd, nullptr};
+  WS_Outbox_Replay(g_outbox, millis(), kOutboxPace, pub);
+}
+
+// ===================== Batched telemetry =====================
+// For slow or metered links: instead of a state message every interval, samples (UTC ms,
+// uptime, per-boot seq) collect in a RAM ring and go out together on "<pub>/batch":
+//   {"boot":2864434397,"up":123456,"dropped":0,"samples":[{"seq":1,"t":1715050812345,"up":93456,
+//    "gate_state":0,"sensors":[{"mm":1234,...}]},...]}
+// every flush_s seconds or max_samples samples, whichever comes first. A serious alarm or a
+// handled command flushes at once (the radio is awake anyway). While batching, the full state
+// goes out with each flush and on change (commands), no longer every interval. Flushes while
+// disconnected go to the outbox; without one the ring keeps sampling and drops its oldest
+// sample when full ("dropped").
+// The batch is streamed like text replies (sized first, then sent), always as JSON.
+struct WS_BatchCfg {
+  bool enabled;
+  uint32_t sample_ms;
+  uint16_t flush_s;
+  uint8_t max_samples;
+};
+static_assert(MQTT_BATCH_SAMPLES >= 1 && MQTT_BATCH_SAMPLES <= 255, "MQTT_BATCH_SAMPLES: 1..255");
+
+static WS_BatchCfg g_batchCfg = {MQTT_BATCH_Enable, MQTT_BATCH_SAMPLE_MS, MQTT_BATCH_FLUSH_S, MQTT_BATCH_SAMPLES};
+static WS_StateSample g_batchRing[MQTT_BATCH_SAMPLES];
+static uint8_t g_batchHead = 0;        // oldest sample
+static uint8_t g_batchCount = 0;
+static uint32_t g_batchSeq = 0;
+static uint32_t g_batchDropped = 0;    // since the last published batch
+static uint32_t g_batchLastSampleMs = 0;
+static bool g_batchFlushNow = false;
+static bool g_batchAlarmWas = false;
+
+static void MQTT_PublishState(bool force);
+
+static void MQTT_BatchRequestFlush()
+{
+  g_batchFlushNow = true;
+}
+
+static void MQTT_BatchSample(uint32_t nowMs)
+{
+  if (g_batchCount == MQTT_BATCH_SAMPLES) {
+    g_batchHead = (uint8_t)((g_batchHead + 1) % MQTT_BATCH_SAMPLES);
+    g_batchCount--;
+    g_batchDropped++;
+  }
+  WS_StateSample& o = g_batchRing[(g_batchHead + g_batchCount) % MQTT_BATCH_SAMPLES];
+  memset(&o, 0, sizeof(o));
+  o.seq = ++g_batchSeq;
+  o.t = WS_Time_NowUtcMs();
+  o.up = nowMs;
+  o.gate_state = Gate_State;
+  o.sensor_count = (Sensor_Count > WS_SENSOR_MAX) ? WS_SENSOR_MAX : Sensor_Count;
+  for (uint8_t i = 0; i < o.sensor_count; i++) {
+    const WS_SensorSlot& si = Sensor_Table[i];
+    o.sensors[i].mm = si.level_mm;
+    o.sensors[i].filt_mm = si.filt_mm;
+    o.sensors[i].temp_x10 = si.temp_x10;
+    o.sensors[i].valid = si.has_value;
+    o.sensors[i].online = si.online;
+    o.sensors[i].temp_valid = si.has_temp;
+  }
+  g_batchCount++;
+}
+
+enum : uint8_t { kBatchSizing, kBatchClient, kBatchOutbox };
+
+static void MQTT_BatchSinkWrite(void* ctx, const char* data, size_t len)
+{
+  switch (*static_cast<const uint8_t*>(ctx)) {
+    case kBatchClient:
+      MQTT_StreamWrite((const uint8_t*)data, len);
+      break;
+    case kBatchOutbox:
+      WS_Outbox_Write(g_outbox, (const uint8_t*)data, len);
+      break;
+    default:
+      break;
+  }
+}
+
+static void MQTT_BatchWrite(WS_JsonWriter& w, uint32_t nowMs)
+{
+  w.Raw("{\"boot\":", 8);
+  w.Uint(MQTT_BootId());
+  w.Raw(",\"up\":", 6);
+  w.Uint(nowMs);
+  w.Raw(",\"dropped\":", 11);
+  w.Uint(g_batchDropped);
+  w.Raw(",\"samples\":[", 12);
+  for (uint8_t i = 0; i < g_batchCount; i++) {
+    if (i > 0) {
+      w.Char(',');
+    }
+    WS_StateJson_WriteSample(w, g_batchRing[(g_batchHead + i) % MQTT_BATCH_SAMPLES]);
+  }
+  w.Raw("]}", 2);
+}
+
+// Sent live, or kept in the outbox while offline / behind an undrained outbox.
+static bool MQTT_BatchFlush(uint32_t nowMs)
+{
+  if (g_batchCount == 0) {
+    return true;
+  }
+  const bool store = MQTT_OutboxRoute();
+  if (!MQTT_CLOUD_Enable || (!store && !client.connected())) {
+    return false;
+  }
+  char topic[112];
+  const int tn = snprintf(topic, sizeof(topic), "%s/batch", pub);
+  if (tn <= 0 || (size_t)tn >= sizeof(topic)) {
+    return false;
+  }
+  uint8_t mode = kBatchSizing;
+  size_t plen = 0;
+  {
+    WS_JsonWriter sizing(MQTT_BatchSinkWrite, &mode);
+    MQTT_BatchWrite(sizing, nowMs);
+    plen = sizing.length();
+  }
+  if (!store && MQTT_QosWait(topic, plen)) {
+    return false;   // the ring waits for PUBACKs
+  }
+  bool done = false;
+  if (!store && MQTT_StreamBegin(topic, (uint32_t)plen, false)) {
+    mode = kBatchClient;
+    WS_JsonWriter w(MQTT_BatchSinkWrite, &mode);
+    MQTT_BatchWrite(w, nowMs);
+    w.Flush();
+    done = MQTT_StreamEnd();
+  }
+  // A failed live publish is kept too (the server drops a duplicate if it did arrive).
+  if (!done && MQTT_OutboxReady() && WS_Outbox_Begin(g_outbox, topic, (uint32_t)plen, 0)) {
+    mode = kBatchOutbox;
+    WS_JsonWriter w(MQTT_BatchSinkWrite, &mode);
+    MQTT_BatchWrite(w, nowMs);
+    w.Flush();
+    done = WS_Outbox_End(g_outbox);
+  }
+  if (!done) {
+    return false;
+  }
+  g_batchHead = (uint8_t)((g_batchHead + g_batchCount) % MQTT_BATCH_SAMPLES);
+  g_batchCount = 0;
+  g_batchDropped = 0;
+  return true;
+}
+
+static void MQTT_BatchLoop()
+{
+  const uint32_t nowMs = millis();
+  // Outage capture: with batching off, samples still go to the outbox while offline.
+  if (!g_batchCfg.enabled && !(MQTT_OutboxReady() && !MQTT_Online())) {
+    if (g_batchCount > 0 && MQTT_BatchFlush(nowMs)) {   // leftovers after switching it off / reconnecting
+      g_batchFlushNow = false;
+    }
+    return;
+  }
+  if (g_batchSeq == 0 || (nowMs - g_batchLastSampleMs) >= g_batchCfg.sample_ms) {
+    g_batchLastSampleMs = nowMs;
+    MQTT_BatchSample(nowMs);
+  }
+  const bool alarm = Alarm_Active && Alarm_Severity >= 2;
+  if (alarm && !g_batchAlarmWas) {
+    g_batchFlushNow = true;
+  }
+  g_batchAlarmWas = alarm;
+
+  if (g_batchCount == 0) {
+    return;
+  }
+  const uint32_t oldestMs = g_batchRing[g_batchHead].up;
+  const bool due = g_batchFlushNow || g_batchCount >= g_batchCfg.max_samples ||
+                   (nowMs - oldestMs) >= (uint32_t)g_batchCfg.flush_s * 1000UL;
+  if (due && MQTT_BatchFlush(nowMs)) {
+    g_batchFlushNow = false;
+    MQTT_PublishState(true);   // the state rides along with the batch
+  }
+}
+
 static void MQTT_PublishState(bool force)
 {
   if (!MQTT_CLOUD_Enable || !client.connected()) {
     return;
   }
 
+  const WS_TelePolicy& policy = g_telePolicy[kTeleState];
+  if (!MQTT_TeleEnabled(policy)) {
+    return;   // full state turned off ("telemetry" RPC); the groups carry it
+  }
   const uint32_t nowMs = millis();
-  const bool intervalDue = (nowMs - Mqtt_LastPublishMs) >= (uint32_t)MQTT_TELEMETRY_INTERVAL_MS;
-  const bool changeDue = MQTT_PUBLISH_ON_CHANGE_Enable && Mqtt_State_Dirty;
+  const bool intervalDue = !g_batchCfg.enabled && policy.period_ms > 0 && (nowMs - Mqtt_LastPublishMs) >= policy.period_ms;
+  const bool changeDue = policy.on_change && Mqtt_State_Dirty;
   if (!force && !intervalDue && !changeDue) {
     return;
   }
 
-  char json[2000];
-  MQTT_BuildStateJson(json, sizeof(json));
-  if (client.publish(pub, json, false)) {
+  char* json = g_teleJson;
+  const WS_StateSnapshot& snap = MQTT_StateSnapshot();
+  memcpy(json, snap.json, snap.len + 1);
+  JsonDocument cur;
+  bool keyframe = false;
+  bool unchanged = false;
+  const bool encoded = MQTT_TelemetryEncode(json, sizeof(g_teleJson), snap.gen, keyframe, unchanged, cur);
+  if (MQTT_PublishEncoded(pub, json, strlen(json))) {
     Mqtt_LastPublishMs = nowMs;
     Mqtt_State_Dirty = false;
+    if (encoded) {
+      // Only what was actually sent becomes the base of the next patch.
+      if (!unchanged) {
+        g_telePrev = cur;
+        g_telePrevGen = snap.gen;
+      }
+      g_telePrevValid = true;
+      g_teleSeq++;
+      if (keyframe) {
+        g_teleKeyframeDue = false;
+        g_teleKeyframeMs = nowMs;
+      }
+    }
   }
 }
 
@@ -349,27 +1065,238 @@ static const char* MQTT_ReplyTopic()
       return g_mqttReplyTopic;
     }
   }
-  // Fallback to MQTT username (often equals device_id).
-  if (mqtt_user && mqtt_user[0] != '\0') {
-    snprintf(g_mqttReplyTopic, sizeof(g_mqttReplyTopic), "%s/device/reply", mqtt_user);
-    return g_mqttReplyTopic;
-  }
-  snprintf(g_mqttReplyTopic, sizeof(g_mqttReplyTopic), "device/reply");
-  return g_mqttReplyTopic;
+  // Fallback to MQTT username (often equals device_id).
+  if (mqtt_user && mqtt_user[0] != '\0') {
+    snprintf(g_mqttReplyTopic, sizeof(g_mqttReplyTopic), "%s/device/reply", mqtt_user);
+    return g_mqttReplyTopic;
+  }
+  snprintf(g_mqttReplyTopic, sizeof(g_mqttReplyTopic), "device/reply");
+  return g_mqttReplyTopic;
+}
+
+// Birth / Last Will: retained {"online":...} on "<device_id>/device/status".
+static char g_mqttStatusTopic[96] = {0};
+
+static const char* MQTT_StatusTopic()
+{
+  if (g_mqttStatusTopic[0] != '\0') {
+    return g_mqttStatusTopic;
+  }
+  const char* p = pub;
+  if (p && p[0] != '\0') {
+    const char* slash = strchr(p, '/');
+    const size_t didLen = slash ? (size_t)(slash - p) : strlen(p);
+    if (didLen > 0 && didLen < 48) {
+      snprintf(g_mqttStatusTopic, sizeof(g_mqttStatusTopic), "%.*s/device/status", (int)didLen, p);
+      return g_mqttStatusTopic;
+    }
+  }
+  if (mqtt_user && mqtt_user[0] != '\0') {
+    snprintf(g_mqttStatusTopic, sizeof(g_mqttStatusTopic), "%s/device/status", mqtt_user);
+    return g_mqttStatusTopic;
+  }
+  snprintf(g_mqttStatusTopic, sizeof(g_mqttStatusTopic), "device/status");
+  return g_mqttStatusTopic;
+}
+
+static void MQTT_PublishReplyJson(const JsonDocument& doc)
+{
+  if (!MQTT_CLOUD_Enable || !client.connected()) {
+    return;
+  }
+  const char* t = MQTT_ReplyTopic();
+  if (!t || t[0] == '\0') {
+    return;
+  }
+  String out;
+  serializeJson(doc, out);
+  (void)MQTT_PublishEncoded(t, out.c_str(), out.length(), false, true);
+}
+
+// ===================== Chunked RPC transfer =====================
+// Bulk data (log files, config) goes out in fixed-size pieces, one reply per request:
+//   -> {"cmd":"get_log","name":"action","offset":0,"req_id":"..."}
+//   <- {"ok":true,"req_id":"...","cmd":"get_log","name":"action","gen":7,"offset":0,"seq":0,
+//       "total":40960,"len":2048,"eof":false,"enc":"base64","data":"...","crc":"1a2b3c4d"}
+// The server asks for offset+len next until eof; any piece can be re-requested, so a
+// transfer resumes after a reconnect. crc is CRC-32 (IEEE) of the raw bytes of the piece.
+// gen identifies the data version (log: oldest segment); if it changes, restart at 0.
+// The reply is streamed with beginPublish(): data is read straight from the file and
+// base64 encoded into a small buffer, so no String copy and no PubSubClient buffer limit.
+typedef size_t (*WS_ChunkReader)(void* ctx, uint32_t off, uint8_t* buf, size_t n);
+
+static size_t MQTT_Base64(const uint8_t* in, size_t n, char* out)
+{
+  static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t w = 0;
+  for (size_t i = 0; i < n; i += 3) {
+    const uint32_t v = ((uint32_t)in[i] << 16) | ((i + 1 < n) ? (uint32_t)in[i + 1] << 8 : 0) |
+                       ((i + 2 < n) ? (uint32_t)in[i + 2] : 0);
+    out[w++] = kAlphabet[(v >> 18) & 0x3F];
+    out[w++] = kAlphabet[(v >> 12) & 0x3F];
+    out[w++] = (i + 1 < n) ? kAlphabet[(v >> 6) & 0x3F] : '=';
+    out[w++] = (i + 2 < n) ? kAlphabet[v & 0x3F] : '=';
+  }
+  return w;
+}
+
+static bool MQTT_PublishChunk(const char* reqId, const char* cmd, const char* name, uint32_t gen,
+                              uint32_t total, uint32_t offset, size_t maxLen, WS_ChunkReader rd, void* ctx)
+{
+  if (!MQTT_CLOUD_Enable || !client.connected() || !reqId || reqId[0] == '\0') {
+    return false;
+  }
+  const char* topic = MQTT_ReplyTopic();
+  if (offset > total) {
+    offset = total;
+  }
+  if (maxLen == 0 || maxLen > MQTT_CHUNK_BYTES) {
+    maxLen = MQTT_CHUNK_BYTES;
+  }
+  const size_t len = (total - offset < maxLen) ? (size_t)(total - offset) : maxLen;
+
+  char reqEsc[96];
+  WS_JsonEscape(reqId, reqEsc, sizeof(reqEsc));
+  char head[320];
+  const int hn = snprintf(head, sizeof(head),
+                          "{\"ok\":true,\"req_id\":\"%s\",\"cmd\":\"%s\",\"name\":\"%s\",\"gen\":%lu,\"offset\":%lu,"
+                          "\"seq\":%lu,\"total\":%lu,\"len\":%u,\"eof\":%s,\"enc\":\"base64\",\"data\":\"",
+                          reqEsc, cmd, name ? name : "", (unsigned long)gen, (unsigned long)offset,
+                          (unsigned long)(offset / MQTT_CHUNK_BYTES), (unsigned long)total, (unsigned)len,
+                          (offset + len >= total) ? "true" : "false");
+  if (hn <= 0 || (size_t)hn >= sizeof(head)) {
+    return false;
+  }
+  static const size_t kTailLen = 19;  // "\",\"crc\":\"xxxxxxxx\"}"
+  const size_t plen = (size_t)hn + (len + 2) / 3 * 4 + kTailLen;
+  if (!MQTT_StreamBegin(topic, (uint32_t)plen, false, MQTT_ReplyT0())) {
+    return false;
+  }
+  MQTT_StreamWrite((const uint8_t*)head, (size_t)hn);
+
+  uint8_t raw[384];                 // multiple of 3: only the last piece gets '=' padding
+  char enc[sizeof(raw) / 3 * 4];
+  uint32_t crc = 0;
+  bool readOk = true;
+  for (size_t done = 0; done < len;) {
+    size_t n = (len - done < sizeof(raw)) ? len - done : sizeof(raw);
+    const size_t got = readOk ? rd(ctx, offset + (uint32_t)done, raw, n) : 0;
+    if (got < n) {
+      // Length is already announced: pad, and spoil the CRC so the server re-requests.
+      memset(raw + got, 0, n - got);
+      readOk = false;
+    }
+    crc = WS_Crc32(crc, raw, n);
+    MQTT_StreamWrite((const uint8_t*)enc, MQTT_Base64(raw, n, enc));
+    done += n;
+  }
+  if (!readOk) {
+    crc = ~crc;
+  }
+  char tail[kTailLen + 1];
+  snprintf(tail, sizeof(tail), "\",\"crc\":\"%08lx\"}", (unsigned long)crc);
+  MQTT_StreamWrite((const uint8_t*)tail, kTailLen);
+  return MQTT_StreamEnd();
+}
+
+// Reply {"ok":true,"req_id":..,<fields>,"text":"..."} with the text streamed from a producer
+// (log tail / query) and JSON-escaped on the fly. The producer runs twice: once to size
+// the payload for beginPublish(), once to send it. The second pass is held to the size of
+// the first (cut or space-padded inside the string), so the JSON stays valid even if the
+// log changed in between.
+typedef bool (*WS_TextProducer)(void* ctx, WS_LogTextWriter w, void* wctx);
+typedef void (*WS_TextFields)(void* ctx, char* out, size_t cap);
+
+struct WS_JsonTextOut {
+  bool send = false;
+  bool full = false;
+  size_t n = 0;                     // escaped bytes so far
+  size_t budget = (size_t)-1;
+  char buf[256];
+  size_t len = 0;
+};
+
+static void MQTT_JsonTextWrite(void* ctx, const char* data, size_t len)
+{
+  WS_JsonTextOut& o = *static_cast<WS_JsonTextOut*>(ctx);
+  for (size_t i = 0; i < len && !o.full; i++) {
+    const unsigned char c = (unsigned char)data[i];
+    char e[8];
+    size_t el = 0;
+    if (c == '"' || c == '\\') {
+      e[el++] = '\\';
+      e[el++] = (char)c;
+    } else if (c == '\n') {
+      e[el++] = '\\';
+      e[el++] = 'n';
+    } else if (c == '\r') {
+      e[el++] = '\\';
+      e[el++] = 'r';
+    } else if (c == '\t') {
+      e[el++] = '\\';
+      e[el++] = 't';
+    } else if (c < 0x20) {
+      el = (size_t)snprintf(e, sizeof(e), "\\u%04x", (unsigned)c);
+    } else {
+      e[el++] = (char)c;
+    }
+    if (o.n + el > o.budget) {
+      o.full = true;
+      break;
+    }
+    o.n += el;
+    if (!o.send) {
+      continue;
+    }
+    if (o.len + el > sizeof(o.buf)) {
+      MQTT_StreamWrite((const uint8_t*)o.buf, o.len);
+      o.len = 0;
+    }
+    memcpy(o.buf + o.len, e, el);
+    o.len += el;
+  }
 }
 
-static void MQTT_PublishReplyJson(const JsonDocument& doc)
+static bool MQTT_PublishTextReply(const char* reqId, WS_TextProducer produce, void* pctx,
+                                  WS_TextFields fields, void* fctx)
 {
-  if (!MQTT_CLOUD_Enable || !client.connected()) {
-    return;
+  if (!MQTT_CLOUD_Enable || !client.connected() || !reqId || reqId[0] == '\0') {
+    return true;
   }
-  const char* t = MQTT_ReplyTopic();
-  if (!t || t[0] == '\0') {
-    return;
+  WS_JsonTextOut sizing;
+  if (!produce(pctx, MQTT_JsonTextWrite, &sizing)) {
+    return false;
   }
-  String out;
-  serializeJson(doc, out);
-  (void)client.publish(t, out.c_str(), false);
+  char reqEsc[96];
+  WS_JsonEscape(reqId, reqEsc, sizeof(reqEsc));
+  char f[192];
+  fields(fctx, f, sizeof(f));
+  char head[320];
+  const int hn = snprintf(head, sizeof(head), "{\"ok\":true,\"req_id\":\"%s\",%s,\"text\":\"", reqEsc, f);
+  if (hn <= 0 || (size_t)hn >= sizeof(head)) {
+    return false;
+  }
+  if (!MQTT_StreamBegin(MQTT_ReplyTopic(), (uint32_t)((size_t)hn + sizing.n + 2), false, MQTT_ReplyT0())) {
+    return false;   // caller replies with an error
+  }
+  MQTT_StreamWrite((const uint8_t*)head, (size_t)hn);
+  WS_JsonTextOut out;
+  out.send = true;
+  out.budget = sizing.n;
+  (void)produce(pctx, MQTT_JsonTextWrite, &out);
+  while (out.n < out.budget) {
+    if (out.len == sizeof(out.buf)) {
+      MQTT_StreamWrite((const uint8_t*)out.buf, out.len);
+      out.len = 0;
+    }
+    out.buf[out.len++] = ' ';
+    out.n++;
+  }
+  if (out.len > 0) {
+    MQTT_StreamWrite((const uint8_t*)out.buf, out.len);
+  }
+  MQTT_StreamWrite((const uint8_t*)"\"}", 2);
+  return MQTT_StreamEnd();   // false: not delivered, the caller replies with an error
 }
 
 // ===================== MQTT Log Push (Device -> Cloud) =====================
@@ -401,27 +1328,121 @@ static const char* MQTT_LogTopicBase()
   return g_mqttLogTopicBase;
 }
 
-static void MQTT_PublishLogLine(const char* name, const char* line)
+// Lines are queued per log and sent from MQTT_Loop() as multi-line payloads (whole
+// lines, up to MQTT_LOG_BATCH_BYTES), so logging never waits on the TCP link and a
+// burst costs one packet. While offline due batches go to the outbox; without one the
+// queue keeps the newest lines.
+struct WS_LogPushQueue {
+  const char* name;
+  char buf[MQTT_LOG_QUEUE_BYTES];
+  size_t len;
+  uint32_t first_ms;           // millis() of the oldest queued line
+  uint32_t lines;              // queued since boot
+  uint32_t dropped;            // lines dropped (queue full)
+  uint32_t batches;            // payloads published
+};
+
+static WS_LogPushQueue g_logPush[] = {
+  {"error", {0}, 0, 0, 0, 0, 0},
+  {"measure", {0}, 0, 0, 0, 0, 0},
+  {"action", {0}, 0, 0, 0, 0, 0},
+};
+static const uint8_t kLogPushCount = sizeof(g_logPush) / sizeof(g_logPush[0]);
+
+static WS_LogPushQueue* MQTT_LogPushFind(const char* name)
 {
-  if (!MQTT_CLOUD_Enable || !MQTT_LOG_PUSH_Enable || !client.connected()) {
-    return;
+  if (!name) {
+    return nullptr;
+  }
+  for (uint8_t i = 0; i < kLogPushCount; i++) {
+    if (strcmp(g_logPush[i].name, name) == 0) {
+      return &g_logPush[i];
+    }
   }
-  if (!name || name[0] == '\0' || !line || line[0] == '\0') {
+  return nullptr;
+}
+
+static void WS_LogSink_Mqtt(const char* name, const char* line)
+{
+  // Runs inside the logger: only copy into RAM, no I/O and no logging here.
+  if (!MQTT_CLOUD_Enable || !MQTT_LOG_PUSH_Enable || !line || line[0] == '\0') {
     return;
   }
-  const char* base = MQTT_LogTopicBase();
-  if (!base || base[0] == '\0') {
+  WS_LogPushQueue* q = MQTT_LogPushFind(name);
+  if (!q) {
     return;
   }
-  char topic[128];
-  snprintf(topic, sizeof(topic), "%s/%s", base, name);
-  (void)client.publish(topic, line, false);
+  size_t n = strlen(line);
+  if (n > sizeof(q->buf)) {
+    n = sizeof(q->buf);
+  }
+  // Drop the oldest whole lines until the new one fits.
+  size_t drop = 0;
+  while (q->len - drop + n > sizeof(q->buf)) {
+    const char* nl = (const char*)memchr(q->buf + drop, '\n', q->len - drop);
+    drop = nl ? (size_t)(nl - q->buf) + 1 : q->len;
+    q->dropped++;
+  }
+  if (drop > 0) {
+    memmove(q->buf, q->buf + drop, q->len - drop);
+    q->len -= drop;
+  }
+  if (q->len == 0) {
+    q->first_ms = millis();
+  }
+  memcpy(q->buf + q->len, line, n);
+  q->len += n;
+  q->lines++;
 }
 
-static void WS_LogSink_Mqtt(const char* name, const char* line)
+static void MQTT_LogPushLoop()
 {
-  // Avoid any logging inside this sink to prevent recursion.
-  MQTT_PublishLogLine(name, line);
+  if (!MQTT_LOG_PUSH_Enable) {
+    return;
+  }
+  const bool store = MQTT_OutboxRoute();
+  if (!store && !client.connected()) {
+    return;   // no outbox: the lines wait in RAM
+  }
+  const char* base = MQTT_LogTopicBase();
+  if (!base || base[0] == '\0') {
+    return;
+  }
+  const uint32_t now = millis();
+  for (uint8_t i = 0; i < kLogPushCount; i++) {
+    WS_LogPushQueue& q = g_logPush[i];
+    if (q.len == 0) {
+      continue;
+    }
+    if (q.len < MQTT_LOG_BATCH_BYTES && (now - q.first_ms) < MQTT_LOG_BATCH_MS) {
+      continue;
+    }
+    // One payload per loop per log: the longest run of whole lines that fits.
+    size_t n = q.len;
+    if (n > MQTT_LOG_BATCH_BYTES) {
+      n = MQTT_LOG_BATCH_BYTES;
+      while (n > 0 && q.buf[n - 1] != '\n') {
+        n--;
+      }
+      if (n == 0) {
+        n = MQTT_LOG_BATCH_BYTES;  // single over-long line
+      }
+    }
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/%s", base, q.name);
+    if (!store && MQTT_QosWait(topic, n)) {
+      return;  // window full: keep the lines
+    }
+    if (store || !MQTT_PublishReliable(topic, (const uint8_t*)q.buf, n, false)) {
+      if (!MQTT_OutboxReady() || !WS_Outbox_Put(g_outbox, topic, (const uint8_t*)q.buf, n, 0)) {
+        return;  // link trouble: keep the lines, retry next loop
+      }
+    }
+    q.batches++;
+    memmove(q.buf, q.buf + n, q.len - n);
+    q.len -= n;
+    q.first_ms = now;
+  }
 }
 
 static void MQTT_RpcReplyError(const char* reqId, const char* cmd, const char* error)
@@ -558,45 +1579,29 @@ void handleRoot() {
   return;
 }
 
-static const char* kLogErrorPath = "/log_error.txt";
-static const char* kLogMeasurePath = "/log_measure.txt";
-static const char* kLogActionPath = "/log_action.txt";
-
-static const char* LogPathFromName(const String& name)
-{
-  if (name == "error") return kLogErrorPath;
-  if (name == "measure") return kLogMeasurePath;
-  if (name == "action") return kLogActionPath;
-  return nullptr;
-}
-
-static bool ReadFileTailToString(const char* path, size_t tailBytes, String& out)
-{
-  out = "";
-  if (!WS_FS_EnsureMounted()) return false;
-  if (!LittleFS.exists(path)) return true; // empty
-  File f = LittleFS.open(path, "r");
-  if (!f) return false;
-  const size_t sz = (size_t)f.size();
-  size_t start = 0;
-  if (tailBytes > 0 && sz > tailBytes) start = sz - tailBytes;
-  if (start > 0) (void)f.seek(start, SeekSet);
-  out.reserve((tailBytes > 0) ? tailBytes : sz);
-  while (f.available()) {
-    out += (char)f.read();
+struct WS_HttpChunkBuf {
+  char buf[1024];
+  size_t len = 0;
+  void Flush()
+  {
+    if (len > 0) {
+      server.sendContent(buf, len);
+      len = 0;
+    }
   }
-  f.close();
-  return true;
-}
+  void Write(const char* data, size_t n)
+  {
+    if (len + n > sizeof(buf)) Flush();
+    if (n > sizeof(buf)) {
+      server.sendContent(data, n);
+      return;
+    }
+    memcpy(buf + len, data, n);
+    len += n;
+  }
+  void Print(const char* str) { Write(str, strlen(str)); }
+};
 
-static bool TruncateFile(const char* path)
-{
-  if (!WS_FS_EnsureMounted()) return false;
-  File f = LittleFS.open(path, "w");
-  if (!f) return false;
-  f.close();
-  return true;
-}
 
 void handleLogsPage()
 {
@@ -604,6 +1609,7 @@ void handleLogsPage()
   return;
 }
 
+// GET /api/log?name=&tail=  or  ?name=&from=&to=&tag=&max= (time query, streamed)
 void handleApiLogGet()
 {
   if (!Http_Auth()) {
@@ -611,21 +1617,77 @@ void handleApiLogGet()
   }
   String name = server.hasArg("name") ? server.arg("name") : "";
   name.toLowerCase();
-  const char* path = LogPathFromName(name);
-  if (!path) {
+  if (!WS_Log_PathFromName(name.c_str())) {
     server.send(400, "text/plain", "bad name");
     return;
   }
+  if (server.hasArg("from") || server.hasArg("to") || server.hasArg("tag")) {
+    WS_LogQuery q;
+    q.from = WS_Log_ParseTime(server.arg("from").c_str());
+    q.to = WS_Log_ParseTime(server.arg("to").c_str());
+    const String tag = server.arg("tag");
+    q.tag = tag.c_str();
+    q.max_bytes = server.hasArg("max") ? (size_t)server.arg("max").toInt() : 0;
+    if ((server.hasArg("from") && q.from == 0) || (server.hasArg("to") && q.to == 0)) {
+      server.send(400, "text/plain", "bad time");
+      return;
+    }
+    server.sendHeader("Cache-Control", "no-store");
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/plain; charset=utf-8", "");
+    WS_HttpChunkBuf out;
+    (void)WS_Log_Query(name.c_str(), q, [](void* ctx, const char* data, size_t len) {
+      static_cast<WS_HttpChunkBuf*>(ctx)->Write(data, len);
+    }, &out);
+    out.Flush();
+    server.sendContent("");
+    return;
+  }
   long tailL = server.hasArg("tail") ? server.arg("tail").toInt() : 16384;
   if (tailL < 0) tailL = 0;
   if (tailL > 65536) tailL = 65536;
   const size_t tail = (size_t)tailL;
-  String out;
-  if (!ReadFileTailToString(path, tail, out)) {
+  if (!WS_FS_EnsureMounted()) {
     server.send(500, "text/plain", "read failed");
     return;
   }
-  server.send(200, "text/plain; charset=utf-8", out);
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain; charset=utf-8", "");
+  WS_HttpChunkBuf out;
+  (void)WS_Log_ReadTail(name.c_str(), tail, [](void* ctx, const char* data, size_t len) {
+    static_cast<WS_HttpChunkBuf*>(ctx)->Write(data, len);
+  }, &out);
+  out.Flush();
+  server.sendContent("");
+}
+
+void handleApiLogStats()
+{
+  if (!Http_Auth()) {
+    return;
+  }
+  static const char* const names[] = {"error", "measure", "action"};
+  String out = "{";
+  for (uint8_t i = 0; i < 3; i++) {
+    WS_LogStats st;
+    (void)WS_Log_GetStats(names[i], st);
+    const WS_LogPushQueue* q = MQTT_LogPushFind(names[i]);
+    char buf[352];
+    snprintf(buf, sizeof(buf),
+             "%s\"%s\":{\"lines\":%lu,\"bytes_written\":%lu,\"bytes_dropped\":%lu,\"flushes\":%lu,\"rotations\":%lu,"
+             "\"flush_us_last\":%lu,\"flush_us_max\":%lu,\"staged\":%lu,\"deferred\":%lu,\"defer_full\":%lu,"
+             "\"push_queued\":%lu,\"push_dropped\":%lu,\"push_batches\":%lu}",
+             (i > 0) ? "," : "", names[i],
+             (unsigned long)st.lines, (unsigned long)st.bytes_written, (unsigned long)st.bytes_dropped,
+             (unsigned long)st.flushes, (unsigned long)st.rotations,
+             (unsigned long)st.flush_us_last, (unsigned long)st.flush_us_max, (unsigned long)st.staged,
+             (unsigned long)st.deferred, (unsigned long)st.defer_full,
+             (unsigned long)(q ? q->len : 0), (unsigned long)(q ? q->dropped : 0), (unsigned long)(q ? q->batches : 0));
+    out += buf;
+  }
+  out += "}";
+  server.sendHeader("Cache-Control", "no-store");
+  server.send(200, "application/json", out);
 }
 
 void handleApiLogDownload()
@@ -635,35 +1697,35 @@ void handleApiLogDownload()
   }
   String name = server.hasArg("name") ? server.arg("name") : "";
   name.toLowerCase();
-  const char* basePath = LogPathFromName(name);
-  if (!basePath) {
+  if (!WS_Log_PathFromName(name.c_str())) {
     server.send(400, "text/plain", "bad name");
     return;
   }
-
-  const bool bak = server.hasArg("bak") ? (server.arg("bak").toInt() != 0) : false;
-  String path = String(basePath) + (bak ? ".1" : "");
-
-  if (!WS_FS_EnsureMounted()) {
-    server.send(500, "text/plain", "fs not mounted");
-    return;
-  }
-  if (!LittleFS.exists(path.c_str())) {
+  // Logs are segment rings now; there is no separate backup file any more.
+  if (server.hasArg("bak") && server.arg("bak").toInt() != 0) {
     server.send(404, "text/plain", "not found");
     return;
   }
-  File f = LittleFS.open(path.c_str(), "r");
-  if (!f) {
-    server.send(500, "text/plain", "open failed");
+  if (!WS_FS_EnsureMounted()) {
+    server.send(500, "text/plain", "fs not mounted");
     return;
   }
 
-  const String filename = String("log_") + name + (bak ? "_1" : "") + ".txt";
+  // Binary logs download as decoded text unless fmt=bin asks for the raw blocks.
+  const bool raw = WS_Log_IsBinary(name.c_str()) && server.arg("fmt") == "bin";
+  const String filename = String("log_") + name + (raw ? ".bin" : ".txt");
   const String cd = String("attachment; filename=\"") + filename + "\"";
   server.sendHeader("Cache-Control", "no-store");
   server.sendHeader("Content-Disposition", cd);
-  server.streamFile(f, "text/plain; charset=utf-8");
-  f.close();
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, raw ? "application/octet-stream" : "text/plain; charset=utf-8", "");
+  WS_HttpChunkBuf out;
+  const WS_LogTextWriter w = [](void* ctx, const char* data, size_t len) {
+    static_cast<WS_HttpChunkBuf*>(ctx)->Write(data, len);
+  };
+  (void)(raw ? WS_Log_ReadRaw(name.c_str(), w, &out) : WS_Log_ReadText(name.c_str(), w, &out));
+  out.Flush();
+  server.sendContent("");
 }
 
 static bool ParseNameFromJsonBody(String& outName)
@@ -689,26 +1751,46 @@ void handleApiLogClear()
     server.send(400, "text/plain", "invalid json");
     return;
   }
-  const char* path = LogPathFromName(name);
-  if (!path) {
+  if (!WS_Log_PathFromName(name.c_str())) {
     server.send(400, "text/plain", "bad name");
     return;
   }
-  if (!TruncateFile(path)) {
+  if (!WS_Log_Clear(name.c_str())) {
     server.send(500, "text/plain", "clear failed");
     return;
   }
   server.send(200, "application/json", "{\"ok\":true}");
 }
 
+// Sends the state ETag and answers 304 when the client already has this generation:
+// If-None-Match with the ETag, or ?since=<state_gen> (the ETag without quotes).
+static bool Http_StateNotModified(const char* etag)
+{
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache");
+  bool same = server.hasHeader("If-None-Match") && server.header("If-None-Match") == etag;
+  if (!same && server.hasArg("since")) {
+    const size_t n = strlen(etag);
+    const String since = server.arg("since");
+    same = (n >= 2 && since.length() == n - 2 && strncmp(since.c_str(), etag + 1, n - 2) == 0);
+  }
+  if (same) {
+    server.send(304);
+  }
+  return same;
+}
+
 void handleGetData() {
   if (!Http_Auth()) {
     return;
   }
-  char json[2000];
-  MQTT_BuildStateJson(json, sizeof(json));
-  server.sendHeader("Cache-Control", "no-store");
-  server.send(200, "application/json", json);
+  const WS_StateSnapshot& snap = MQTT_StateSnapshot();
+  char etag[32];
+  MQTT_StateETag(snap, etag, sizeof(etag));
+  if (Http_StateNotModified(etag)) {
+    return;
+  }
+  server.send(200, "application/json", snap.json);
 }
 
 void handleApiState()
@@ -716,26 +1798,213 @@ void handleApiState()
   if (!Http_Auth()) {
     return;
   }
-  char tele[2000];
-  MQTT_BuildStateJson(tele, sizeof(tele));
+  const WS_StateSnapshot& snap = MQTT_StateSnapshot();
+  char etag[32];
+  MQTT_StateETag(snap, etag, sizeof(etag));
+  if (Http_StateNotModified(etag)) {
+    return;
+  }
 
   const bool wifiStaConnected = (WiFi.status() == WL_CONNECTED);
   const bool mqttConnected = (MQTT_CLOUD_Enable && wifiStaConnected) ? client.connected() : false;
 
-  server.sendHeader("Cache-Control", "no-store");
   server.setContentLength(CONTENT_LENGTH_UNKNOWN);
   server.send(200, "application/json", "");
   server.sendContent("{\"mqtt_connected\":");
   server.sendContent(mqttConnected ? "true" : "false");
+  server.sendContent(",\"state_gen\":");
+  server.sendContent(etag);
   server.sendContent(",\"last_telemetry_at\":");
   char msBuf[16];
   snprintf(msBuf, sizeof(msBuf), "%lu", (unsigned long)millis());
   server.sendContent(msBuf);
   server.sendContent(",\"telemetry\":");
-  server.sendContent(tele);
+  server.sendContent(snap.json, snap.len);
   server.sendContent("}");
 }
 
+// RS485 link statistics per sensor, incl. the reply latency histogram.
+void handleApiBus()
+{
+  if (!Http_Auth()) {
+    return;
+  }
+  static char json[WS_SENSOR_MAX * 420 + 128];
+  size_t w = 0;
+  int n = snprintf(json, sizeof(json), "{\"uptime_ms\":%lu,\"timeout_ms\":%u,\"retry_count\":%u,\"ring_dropped\":%lu,\"lat_bucket_ms\":[",
+                   (unsigned long)millis(),
+                   (unsigned)SENSOR_MODBUS_TIMEOUT_MS,
+                   (unsigned)SENSOR_MODBUS_RETRY_COUNT,
+                   (unsigned long)WS_Sensor_RingDropped());
+  w = (n > 0) ? (size_t)n : 0;
+  for (uint8_t b = 0; b < WS_SENSOR_LAT_BUCKETS && w < sizeof(json); b++) {
+    // Upper bound of each bucket; the last one is open-ended (0).
+    n = snprintf(json + w, sizeof(json) - w, "%s%lu", (b > 0) ? "," : "", (unsigned long)WS_Sensor_LatBucketLimitMs(b));
+    if (n < 0) break;
+    w += (size_t)n;
+  }
+  if (w < sizeof(json)) {
+    n = snprintf(json + w, sizeof(json) - w, "],\"sensors\":[");
+    w += (n > 0) ? (size_t)n : 0;
+  }
+  for (uint8_t i = 0; i < Sensor_Count && w < sizeof(json); i++) {
+    const WS_SensorSlot& si = Sensor_Table[i];
+    const WS_SensorBusStats& b = si.bus;
+    n = snprintf(json + w, sizeof(json) - w,
+                 "%s{\"id\":%u,\"online\":%s,\"q\":%u,\"ok\":%lu,\"fail\":%lu,\"req\":%lu,\"retry\":%lu,\"to\":%lu,"
+                 "\"crc\":%lu,\"hdr\":%lu,\"exc\":%lu,\"last_exc\":%u,\"lat_last_ms\":%u,\"lat_max_ms\":%u,\"lat_hist\":[",
+                 (i > 0) ? "," : "",
+                 (unsigned)si.id,
+                 si.online ? "true" : "false",
+                 (unsigned)si.quality,
+                 (unsigned long)si.ok_count,
+                 (unsigned long)si.fail_count,
+                 (unsigned long)b.requests,
+                 (unsigned long)b.retries,
+                 (unsigned long)b.timeouts,
+                 (unsigned long)b.crc_errors,
+                 (unsigned long)b.header_errors,
+                 (unsigned long)b.exceptions,
+                 (unsigned)b.last_exception,
+                 (unsigned)b.lat_last_ms,
+                 (unsigned)b.lat_max_ms);
+    if (n < 0) break;
+    w += (size_t)n;
+    for (uint8_t k = 0; k < WS_SENSOR_LAT_BUCKETS && w < sizeof(json); k++) {
+      n = snprintf(json + w, sizeof(json) - w, "%s%lu", (k > 0) ? "," : "", (unsigned long)b.lat_hist[k]);
+      if (n < 0) break;
+      w += (size_t)n;
+    }
+    if (w < sizeof(json)) {
+      n = snprintf(json + w, sizeof(json) - w, "]}");
+      w += (n > 0) ? (size_t)n : 0;
+    }
+  }
+  if (w + 3 > sizeof(json)) {
+    Api_SendJson(500, "{\"ok\":false,\"error\":\"overflow\"}");
+    return;
+  }
+  snprintf(json + w, sizeof(json) - w, "]}");
+  server.sendHeader("Cache-Control", "no-store");
+  Api_SendJson(200, json);
+}
+
+// Buffered writer for streamed responses (chunked transfer).
+static void History_WriteJsonField(WS_HttpChunkBuf& out, const WS_HistQuery& q, const char* key, uint8_t field)
+{
+  char tmp[16];
+  snprintf(tmp, sizeof(tmp), ",\"%s\":[", key);
+  out.Print(tmp);
+  for (uint32_t i = 0; i < q.count; i++) {
+    const WS_HistAgg g = WS_History_Get(q, i);
+    const int16_t v = (field == 0) ? g.min : (field == 1) ? g.max : g.mean;
+    if (v == WS_HIST_NODATA) {
+      snprintf(tmp, sizeof(tmp), "%snull", (i > 0) ? "," : "");
+    } else {
+      snprintf(tmp, sizeof(tmp), "%s%d", (i > 0) ? "," : "", (int)v);
+    }
+    out.Print(tmp);
+  }
+  out.Print("]");
+}
+
+// GET /api/history?series=level0&from=&to=&res=auto|raw|1m|1h&fmt=json|bin
+// Without "series": list of series and the clock in use.
+void handleApiHistory()
+{
+  if (!Http_Auth()) {
+    return;
+  }
+  const uint32_t now = WS_History_Now();
+  const char* clock = WS_History_ClockIsEpoch() ? "epoch" : "uptime";
+  if (!server.hasArg("series")) {
+    String out = "{\"clock\":\"";
+    out += clock;
+    out += "\",\"now\":";
+    out += String((unsigned long)now);
+    out += ",\"series\":[";
+    for (uint8_t i = 0; i < WS_History_SeriesCount(); i++) {
+      if (i > 0) out += ",";
+      out += "\"";
+      out += WS_History_SeriesName(i);
+      out += "\"";
+    }
+    out += "]}";
+    server.sendHeader("Cache-Control", "no-store");
+    server.send(200, "application/json", out);
+    return;
+  }
+
+  const int16_t series = WS_History_FindSeries(server.arg("series").c_str());
+  if (series < 0) {
+    Api_SendJson(404, "{\"ok\":false,\"error\":\"unknown_series\"}");
+    return;
+  }
+  const String res = server.hasArg("res") ? server.arg("res") : "auto";
+  int8_t tier = -1;
+  uint32_t span = HISTORY_RAW_LEN;
+  if (res == "raw") {
+    tier = WS_HIST_RAW;
+  } else if (res == "1m") {
+    tier = WS_HIST_MIN;
+    span = 86400UL;
+  } else if (res == "1h") {
+    tier = WS_HIST_HOUR;
+    span = HISTORY_HOUR_LEN * 3600UL;
+  }
+  const uint32_t to = server.hasArg("to") ? (uint32_t)strtoul(server.arg("to").c_str(), nullptr, 10) : now;
+  const uint32_t from = server.hasArg("from") ? (uint32_t)strtoul(server.arg("from").c_str(), nullptr, 10)
+                                              : ((to > span) ? to - span : 0);
+  WS_HistQuery q;
+  if (!WS_History_Plan((uint8_t)series, from, to, tier, q)) {
+    q = WS_HistQuery();
+    q.series = (uint8_t)series;
+  }
+
+  server.sendHeader("Cache-Control", "no-store");
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  WS_HttpChunkBuf out;
+
+  if (server.arg("fmt") == "bin") {
+    // "WSH1", u8 tier, u8 fields, u16 0, u32 t0, u32 step_s, u32 n, then n * fields int16 (LE).
+    // fields = 1 (raw: v) or 3 (min, max, mean); gaps are -32768.
+    server.send(200, "application/octet-stream", "");
+    const uint8_t fields = (q.tier == WS_HIST_RAW) ? 1 : 3;
+    uint8_t hdr[20] = {'W', 'S', 'H', '1', q.tier, fields, 0, 0};
+    const uint32_t words[3] = {q.t0, q.step_s, q.count};
+    for (uint8_t w = 0; w < 3; w++) {
+      for (uint8_t b = 0; b < 4; b++) hdr[8 + w * 4 + b] = (uint8_t)(words[w] >> (8 * b));
+    }
+    out.Write((const char*)hdr, sizeof(hdr));
+    for (uint32_t i = 0; i < q.count; i++) {
+      const WS_HistAgg g = WS_History_Get(q, i);
+      const int16_t vals[3] = {g.min, g.max, g.mean};
+      for (uint8_t f = 0; f < fields; f++) {
+        const uint16_t v = (uint16_t)((fields == 1) ? g.mean : vals[f]);
+        const uint8_t le[2] = {(uint8_t)(v & 0xFF), (uint8_t)(v >> 8)};
+        out.Write((const char*)le, 2);
+      }
+    }
+    out.Flush();
+    return;
+  }
+
+  server.send(200, "application/json", "");
+  char head[192];
+  snprintf(head, sizeof(head), "{\"series\":\"%s\",\"clock\":\"%s\",\"res_s\":%lu,\"t0\":%lu,\"n\":%lu",
+           WS_History_SeriesName(q.series), clock, (unsigned long)q.step_s, (unsigned long)q.t0, (unsigned long)q.count);
+  out.Print(head);
+  if (q.tier == WS_HIST_RAW) {
+    History_WriteJsonField(out, q, "v", 2);
+  } else {
+    History_WriteJsonField(out, q, "min", 0);
+    History_WriteJsonField(out, q, "max", 1);
+    History_WriteJsonField(out, q, "mean", 2);
+  }
+  out.Print("}");
+  out.Flush();
+}
+
 void handleApiCmd()
 {
   if (!Http_Auth()) {
@@ -844,10 +2113,13 @@ static void WS_HTTP_RegisterRoutesOnce()
   server.on("/getData", handleGetData);
   server.on("/api/state", handleApiState);
   server.on("/api/cmd", HTTP_POST, handleApiCmd);
+  server.on("/api/bus", HTTP_GET, handleApiBus);
+  server.on("/api/history", HTTP_GET, handleApiHistory);
   server.on("/logs", handleLogsPage);
   server.on("/api/log", HTTP_GET, handleApiLogGet);
   server.on("/api/log/clear", HTTP_POST, handleApiLogClear);
   server.on("/api/log/download", HTTP_GET, handleApiLogDownload);
+  server.on("/api/log/stats", HTTP_GET, handleApiLogStats);
   server.on("/config", handleConfigPage);
   server.on("/api/config", HTTP_GET, handleApiConfigGet);
   server.on("/api/config", HTTP_POST, handleApiConfigPost);
@@ -885,6 +2157,8 @@ static void WS_HTTP_RegisterRoutesOnce()
   });
   if (ELEGANT_OTA_Enable) {
     ElegantOTA.begin(&server);
+    // The device reboots after an update: get staged log lines onto flash first.
+    ElegantOTA.onStart([]() { WS_Log_Flush(nullptr); });
   }
 }
 
@@ -895,6 +2169,8 @@ static void WS_HTTP_BeginOnce()
   }
   (void)WS_UI_IsFsAvailable(); // Detect UI presence once to decide FS vs embedded path.
   WS_HTTP_RegisterRoutesOnce();
+  static const char* kHeaders[] = {"If-None-Match"};
+  server.collectHeaders(kHeaders, 1);
   server.begin();
   g_httpStarted = true;
 }
@@ -907,6 +2183,7 @@ void callback(char* topic, byte* payload, unsigned int length) {
   for (unsigned int i = 0; i < length; i++) {
     inputString += (char)payload[i];
   }
+  g_mqttCmdRxMs = millis();
   printf("%s\r\n", inputString.c_str()); // Supported formats: {"data":{"CH1":1}} / {"cmd":"gate_open"}
 
   bool anyHandled = false;
@@ -929,6 +2206,163 @@ void callback(char* topic, byte* payload, unsigned int length) {
           anyHandled = true;
           stateChanged = true;
           MQTT_RpcReplyOk(reqId, c.c_str());
+        } else if (c == "set_encoding") {
+          anyHandled = true;
+          const String enc = String((const char*)(doc["enc"] | ""));
+          if (enc == "json" || (MQTT_MSGPACK_Enable && enc == "msgpack")) {
+            MQTT_RpcReplyOk(reqId, "set_encoding");   // still in the old encoding
+            g_mqttMsgPack = (enc == "msgpack");
+            MQTT_RequestKeyframe();                   // full state on the new topic
+            stateChanged = true;
+          } else {
+            MQTT_RpcReplyError(reqId, "set_encoding", "unsupported");
+          }
+        } else if (c == "telemetry") {
+          anyHandled = true;
+          // {"cmd":"telemetry","groups":{"sensors":{"period_ms":1000,"on_change":false},...}}
+          // Checked as a whole before anything is applied; no "groups": query only.
+          const char* bad = nullptr;
+          JsonObjectConst groups = doc["groups"].as<JsonObjectConst>();
+          if (!doc["groups"].isNull() && groups.isNull()) {
+            bad = "bad_groups";
+          }
+          for (JsonPairConst kv : groups) {
+            const JsonVariantConst period = kv.value()["period_ms"];
+            const JsonVariantConst onChange = kv.value()["on_change"];
+            if (MQTT_TeleFind(kv.key().c_str()) < 0) {
+              bad = "unknown_group";
+            } else if (!kv.value().is<JsonObjectConst>() || (!period.isNull() && !period.is<uint32_t>()) ||
+                       (!onChange.isNull() && !onChange.is<bool>())) {
+              bad = "bad_policy";
+            }
+          }
+          if (bad) {
+            MQTT_RpcReplyError(reqId, "telemetry", bad);
+          } else {
+            for (JsonPairConst kv : groups) {
+              WS_TelePolicy& p = g_telePolicy[MQTT_TeleFind(kv.key().c_str())];
+              if (!kv.value()["period_ms"].isNull()) {
+                const uint32_t ms = kv.value()["period_ms"].as<uint32_t>();
+                p.period_ms = (ms > 0 && ms < MQTT_TELEMETRY_GROUP_TICK_MS) ? MQTT_TELEMETRY_GROUP_TICK_MS : ms;
+              }
+              p.on_change = kv.value()["on_change"] | p.on_change;
+              p.due = true;
+            }
+            if (reqId && reqId[0] != '\0') {
+              JsonDocument rep;
+              rep["ok"] = true;
+              rep["req_id"] = reqId;
+              rep["cmd"] = "telemetry";
+              JsonObject out = rep["groups"].to<JsonObject>();
+              for (uint8_t i = 0; i <= kTeleState; i++) {
+                JsonObject o = out[MQTT_TeleName(i)].to<JsonObject>();
+                o["period_ms"] = g_telePolicy[i].period_ms;
+                o["on_change"] = g_telePolicy[i].on_change;
+              }
+              MQTT_PublishReplyJson(rep);
+            }
+          }
+        } else if (c == "batch") {
+          anyHandled = true;
+          // {"cmd":"batch","enable":true,"sample_ms":1000,"flush_s":30,"max_samples":30}
+          // Any subset; all values are checked before anything is applied.
+          const JsonVariantConst en = doc["enable"];
+          const JsonVariantConst sampleMs = doc["sample_ms"];
+          const JsonVariantConst flushS = doc["flush_s"];
+          const JsonVariantConst maxSamples = doc["max_samples"];
+          const bool ok = (en.isNull() || en.is<bool>()) &&
+                          (sampleMs.isNull() || (sampleMs.is<uint32_t>() && sampleMs.as<uint32_t>() >= 100UL)) &&
+                          (flushS.isNull() || (flushS.is<uint16_t>() && flushS.as<uint16_t>() >= 1)) &&
+                          (maxSamples.isNull() || (maxSamples.is<uint8_t>() && maxSamples.as<uint8_t>() >= 1 &&
+                                                   maxSamples.as<uint8_t>() <= MQTT_BATCH_SAMPLES));
+          if (!ok) {
+            MQTT_RpcReplyError(reqId, "batch", "bad_value");
+          } else {
+            g_batchCfg.enabled = en | g_batchCfg.enabled;
+            g_batchCfg.sample_ms = sampleMs | g_batchCfg.sample_ms;
+            g_batchCfg.flush_s = flushS | g_batchCfg.flush_s;
+            g_batchCfg.max_samples = maxSamples | g_batchCfg.max_samples;
+            if (reqId && reqId[0] != '\0') {
+              JsonDocument rep;
+              rep["ok"] = true;
+              rep["req_id"] = reqId;
+              rep["cmd"] = "batch";
+              rep["enable"] = g_batchCfg.enabled;
+              rep["sample_ms"] = g_batchCfg.sample_ms;
+              rep["flush_s"] = g_batchCfg.flush_s;
+              rep["max_samples"] = g_batchCfg.max_samples;
+              rep["pending"] = g_batchCount;
+              MQTT_PublishReplyJson(rep);
+            }
+          }
+        } else if (c == "outbox") {
+          anyHandled = true;
+          // {"cmd":"outbox"} -> counters; {"cmd":"outbox","clear":true} drops what is still queued.
+          const bool clear = doc["clear"] | false;
+          bool ok = true;
+          if (clear && MQTT_OutboxReady()) {
+            ok = WS_Outbox_Clear(g_outbox);
+          }
+          if (!ok) {
+            MQTT_RpcReplyError(reqId, "outbox", "fs_error");
+          } else if (reqId && reqId[0] != '\0') {
+            const WS_OutboxStats& st = g_outbox.stats;
+            JsonDocument rep;
+            rep["ok"] = true;
+            rep["req_id"] = reqId;
+            rep["cmd"] = "outbox";
+            rep["ready"] = MQTT_OutboxReady();
+            rep["pending_bytes"] = MQTT_OutboxReady() ? WS_Outbox_PendingBytes(g_outbox) : 0;
+            rep["queued"] = st.queued;
+            rep["replayed"] = st.replayed;
+            rep["rejected"] = st.rejected;
+            rep["corrupt"] = st.corrupt;
+            rep["lost_segments"] = st.lost_segments;
+            rep["stalls"] = st.stalls;
+            rep["backoff_ms"] = g_outbox.backoff_ms;
+            MQTT_PublishReplyJson(rep);
+          }
+        } else if (c == "link") {
+          anyHandled = true;
+          // {"cmd":"link"} -> QoS1 window and reconnect counters.
+          if (reqId && reqId[0] != '\0') {
+            JsonDocument rep;
+            rep["ok"] = true;
+            rep["req_id"] = reqId;
+            rep["cmd"] = "link";
+            rep["qos1"] = MQTT_QosReady();
+            rep["inflight"] = g_qos.count;
+            rep["window"] = g_qos.window;
+            rep["published"] = g_qos.published;
+            rep["acked"] = g_qos.acked;
+            rep["resent"] = g_qos.resent;
+            rep["refused"] = g_qos.refused;
+            rep["srtt_ms"] = g_qos.srtt_ms;
+            rep["last_rtt_ms"] = g_qos.last_rtt_ms;
+            rep["cmd_rtt_ms"] = g_mqttCmdRttMs;
+            rep["connects"] = g_mqttConnects;
+            rep["backoff_ms"] = g_mqttBackoffMs;
+            MQTT_PublishReplyJson(rep);
+          }
+        } else if (c == "keyframe") {
+          anyHandled = true;
+          MQTT_RequestKeyframe();
+          stateChanged = true;
+          MQTT_RpcReplyOk(reqId, "keyframe");
+        } else if (c == "get_config" && !doc["offset"].isNull()) {
+          anyHandled = true;
+          File f = WS_Control_OpenRaw();
+          if (!f) {
+            MQTT_RpcReplyError(reqId, "get_config", "read_failed");
+          } else {
+            (void)MQTT_PublishChunk(reqId, "get_config", "", 0, (uint32_t)f.size(),
+                                    (uint32_t)(doc["offset"] | 0UL), (size_t)(doc["len"] | 0UL),
+                                    [](void* ctx, uint32_t off, uint8_t* buf, size_t n) -> size_t {
+                                      File* fh = static_cast<File*>(ctx);
+                                      return fh->seek(off, SeekSet) ? fh->read(buf, n) : 0;
+                                    }, &f);
+            f.close();
+          }
         } else if (c == "get_config") {
           anyHandled = true;
           String raw = WS_Control_LoadRawJson();
@@ -974,33 +2408,82 @@ void callback(char* topic, byte* payload, unsigned int length) {
           if (tailL < 0) tailL = 0;
           if (tailL > 32768) tailL = 32768;
 
-          const char* basePath = LogPathFromName(name);
-          if (!basePath) {
+          const bool query = !doc["from"].isNull() || !doc["to"].isNull() || !doc["tag"].isNull();
+          const bool chunked = !doc["offset"].isNull();
+          WS_LogExtent ext;
+          if (!WS_Log_PathFromName(name.c_str())) {
             MQTT_RpcReplyError(reqId, "get_log", "bad_name");
+          } else if (chunked && !query) {
+            // Raw log bytes (measure: zero-padded binary blocks). offset<0 = start "tail" bytes
+            // before the end (block aligned for binary logs).
+            const long offL = (long)(doc["offset"] | 0L);
+            if (!WS_Log_RawExtent(name.c_str(), ext)) {
+              MQTT_RpcReplyError(reqId, "get_log", "read_failed");
+            } else if (!doc["gen"].isNull() && (uint32_t)(doc["gen"] | 0UL) != ext.gen) {
+              MQTT_RpcReplyError(reqId, "get_log", "gen_changed");
+            } else {
+              uint32_t off = (uint32_t)offL;
+              if (offL < 0) {
+                off = (ext.total > (uint32_t)tailL) ? ext.total - (uint32_t)tailL : 0;
+                if (WS_Log_IsBinary(name.c_str())) {
+                  off -= off % WS_MLOG_BLOCK_BYTES;
+                }
+              }
+              (void)MQTT_PublishChunk(reqId, "get_log", name.c_str(), ext.gen, ext.total, off,
+                                      (size_t)(doc["len"] | 0UL),
+                                      [](void* ctx, uint32_t o, uint8_t* buf, size_t n) -> size_t {
+                                        return WS_Log_ReadRawAt(static_cast<String*>(ctx)->c_str(), o, buf, n);
+                                      }, &name);
+            }
+          } else if (query) {
+            // Time query: {"from":"2024-05-07 03:00","to":...,"tag":"gate"}; from/to may also be epoch numbers.
+            WS_LogQuery q;
+            q.from = doc["from"].is<const char*>() ? WS_Log_ParseTime(doc["from"].as<const char*>()) : (uint32_t)(doc["from"] | 0UL);
+            q.to = doc["to"].is<const char*>() ? WS_Log_ParseTime(doc["to"].as<const char*>()) : (uint32_t)(doc["to"] | 0UL);
+            const String tag = String((const char*)(doc["tag"] | ""));
+            q.tag = tag.c_str();
+            q.max_bytes = (tailL > 0) ? (size_t)tailL : 32768;
+            struct QueryCtx {
+              const char* name;
+              WS_LogQuery base;
+              WS_LogQuery res;
+            } qc = {name.c_str(), q, q};
+            if (!MQTT_PublishTextReply(reqId, [](void* ctx, WS_LogTextWriter w, void* wctx) {
+                  QueryCtx& c = *static_cast<QueryCtx*>(ctx);
+                  c.res = c.base;
+                  return WS_Log_Query(c.name, c.res, w, wctx);
+                }, &qc, [](void* ctx, char* out, size_t cap) {
+                  const QueryCtx& c = *static_cast<const QueryCtx*>(ctx);
+                  snprintf(out, cap, "\"cmd\":\"get_log\",\"name\":\"%s\",\"lines\":%lu,\"truncated\":%s",
+                           c.name, (unsigned long)c.res.lines, c.res.truncated ? "true" : "false");
+                }, &qc)) {
+              MQTT_RpcReplyError(reqId, "get_log", "read_failed");
+            }
           } else {
-            const String path = String(basePath) + (bak ? ".1" : "");
-            String out;
-            if (!ReadFileTailToString(path.c_str(), (size_t)tailL, out)) {
+            // Streamed straight from the log (no String). No backup files with segment
+            // rings: bak=1 yields an empty text.
+            struct TailCtx {
+              const char* name;
+              size_t tail;
+              bool bak;
+            } tc = {name.c_str(), (size_t)tailL, bak};
+            if (!MQTT_PublishTextReply(reqId, [](void* ctx, WS_LogTextWriter w, void* wctx) {
+                  const TailCtx& c = *static_cast<const TailCtx*>(ctx);
+                  return c.bak || WS_Log_ReadTail(c.name, c.tail, w, wctx);
+                }, &tc, [](void* ctx, char* out, size_t cap) {
+                  const TailCtx& c = *static_cast<const TailCtx*>(ctx);
+                  snprintf(out, cap, "\"cmd\":\"get_log\",\"name\":\"%s\",\"bak\":%d", c.name, c.bak ? 1 : 0);
+                }, &tc)) {
               MQTT_RpcReplyError(reqId, "get_log", "read_failed");
-            } else if (reqId && reqId[0] != '\0') {
-              JsonDocument rep;
-              rep["ok"] = true;
-              rep["req_id"] = reqId;
-              rep["cmd"] = "get_log";
-              rep["name"] = name;
-              rep["bak"] = bak ? 1 : 0;
-              rep["text"] = out;
-              MQTT_PublishReplyJson(rep);
             }
           }
         } else if (c == "clear_log") {
           anyHandled = true;
           String name = String((const char*)(doc["name"] | "error"));
           name.toLowerCase();
-          const char* path = LogPathFromName(name);
-          if (!path) {
+          if (!WS_Log_PathFromName(name.c_str())) {
             MQTT_RpcReplyError(reqId, "clear_log", "bad_name");
-          } else if (!TruncateFile(path)) {
+          } else if (!WS_Log_Clear(name.c_str())) {
             MQTT_RpcReplyError(reqId, "clear_log", "clear_failed");
           } else {
             MQTT_RpcReplyOk(reqId, "clear_log");
@@ -1067,6 +2550,7 @@ void callback(char* topic, byte* payload, unsigned int length) {
 
       if (stateChanged) {
         MQTT_MarkStateDirty();
+        MQTT_BatchRequestFlush();   // the samples leading up to the command go out with it
         MQTT_PublishState(true);
       }
       if (!anyHandled) {
@@ -1349,34 +2833,132 @@ void setup_wifi() {
     printf("ElegantOTA page: http://%s/update\r\n", ipStr);
   }
 }
-// Reconnect to the MQTT server (non-blocking, throttled)
-void reconnect() {
-  static uint32_t lastAttemptMs = 0;
+// Reconnect to the MQTT server without blocking the loop: wait out the backoff, then DNS,
+// TCP connect and CONNECT / CONNACK, each polled through WS_MqttLink and each given
+// MQTT_CONNECT_TIMEOUT_MS. PubSubClient::connect() runs only once the CONNACK is in, so it
+// returns at once. Each failure doubles the wait from MQTT_RECONNECT_MIN_MS up to
+// MQTT_RECONNECT_MAX_MS, +-25% jitter, so a fleet does not come back in step after a
+// broker restart. The broker publishes the retained Last Will {"online":false} on the
+// status topic when the link dies; after each connect the birth message replaces it.
+static void MQTT_ConnectFailed(const char* stage)
+{
   static uint8_t failCount = 0;
-  const uint32_t retryIntervalMs = 5000;
+  g_mqttConnStep = kMqttIdle;
+  g_mqttBackoffMs = (g_mqttBackoffMs == 0) ? MQTT_RECONNECT_MIN_MS : g_mqttBackoffMs * 2;
+  if (g_mqttBackoffMs > MQTT_RECONNECT_MAX_MS) {
+    g_mqttBackoffMs = MQTT_RECONNECT_MAX_MS;
+  }
+  const uint32_t span = g_mqttBackoffMs / 2;
+  const uint32_t waitMs = g_mqttBackoffMs - span / 2 + ((span > 0) ? esp_random() % span : 0);
+  g_mqttNextTryMs = millis() + waitMs;
+  failCount++;
+  if ((failCount % 6) == 0) {
+    printf("warning: MQTT not connected (%s), state=%d server=%s:%d, retry in %lu ms\r\n", stage, client.state(),
+           mqtt_server, PORT, (unsigned long)waitMs);
+  }
+}
+
+static void MQTT_PublishBirth()
+{
+  char birth[160];
+  const int n = snprintf(birth, sizeof(birth), "{\"online\":true,\"boot\":%lu,\"fw\":\"%s\",\"connects\":%lu}",
+                         (unsigned long)MQTT_BootId(), FW_VERSION, (unsigned long)g_mqttConnects);
+  if (n <= 0 || (size_t)n >= sizeof(birth)) {
+    return;
+  }
+  const char* topic = MQTT_StatusTopic();
+  if (!MQTT_PublishReliable(topic, (const uint8_t*)birth, (size_t)n, true)) {
+    (void)client.publish(topic, birth, true);   // window still full from the last session
+  }
+}
 
+void reconnect() {
   if (client.connected()) {
     return;
   }
-  if (millis() - lastAttemptMs < retryIntervalMs) {
+  static const char kWill[] = "{\"online\":false}";
+  const uint32_t nowMs = millis();
+  if (g_mqttConnStep == kMqttIdle) {
+    if ((int32_t)(nowMs - g_mqttNextTryMs) < 0) {
+      return;
+    }
+    if (!mqttLink.Resolve(mqtt_server)) {
+      MQTT_ConnectFailed("dns");
+      return;
+    }
+    g_mqttConnStep = kMqttDns;
+    g_mqttConnectStartMs = nowMs;
+  }
+  const bool late = (nowMs - g_mqttConnectStartMs) >= MQTT_CONNECT_TIMEOUT_MS;
+
+  if (g_mqttConnStep == kMqttDns) {
+    IPAddress ip;
+    const int8_t r = mqttLink.PollResolve(ip);
+    if (r == 0) {
+      if (late) {
+        MQTT_ConnectFailed("dns_timeout");
+      }
+      return;
+    }
+    if (r < 0 || !mqttLink.Start(ip, (uint16_t)PORT)) {
+      MQTT_ConnectFailed(r < 0 ? "dns" : "socket");
+      return;
+    }
+    g_mqttConnStep = kMqttTcp;
+    g_mqttConnectStartMs = nowMs;
     return;
   }
-  lastAttemptMs = millis();
 
-  const bool connected = MQTT_HasAuth() ? client.connect(ID, mqtt_user, mqtt_password) : client.connect(ID);
-  if (connected) {
-    client.subscribe(sub);
-    failCount = 0;
-    MQTT_MarkStateDirty();
-    MQTT_PublishState(true);
-    printf("MQTT connected: server=%s port=%d sub=%s pub=%s\r\n", mqtt_server, PORT, sub, pub);
+  if (g_mqttConnStep == kMqttTcp) {
+    const int8_t tcp = mqttLink.Poll();
+    if (tcp == 0) {
+      if (late) {
+        mqttLink.Abort();
+        MQTT_ConnectFailed("tcp_timeout");
+      }
+      return;
+    }
+    const bool auth = MQTT_HasAuth();
+    if (tcp < 0 || !mqttLink.SendConnect(ID, auth ? mqtt_user : nullptr, auth ? mqtt_password : nullptr,
+                                         MQTT_StatusTopic(), 1, true, kWill, MQTT_KEEPALIVE_S)) {
+      mqttLink.stop();
+      MQTT_ConnectFailed("tcp");
+      return;
+    }
+    g_mqttConnStep = kMqttConnack;
+    g_mqttConnectStartMs = nowMs;
     return;
   }
 
-  failCount++;
-  if ((failCount % 6) == 0) {
-    printf("warning: MQTT not connected, state=%d server=%s:%d\r\n", client.state(), mqtt_server, PORT);
+  const int8_t ack = mqttLink.PollConnack();
+  if (ack == 0) {
+    if (late) {
+      mqttLink.stop();
+      MQTT_ConnectFailed("connack_timeout");
+    }
+    return;
+  }
+  g_mqttConnStep = kMqttIdle;
+  // CONNACK held by the link: PubSubClient's own CONNECT is dropped and it reads that.
+  const char* will = MQTT_StatusTopic();
+  const bool connected = ack > 0 && (MQTT_HasAuth() ? client.connect(ID, mqtt_user, mqtt_password, will, 1, true, kWill)
+                                                    : client.connect(ID, will, 1, true, kWill));
+  if (!connected) {
+    mqttLink.stop();
+    MQTT_ConnectFailed("mqtt");
+    return;
   }
+  g_mqttBackoffMs = 0;
+  g_mqttConnects++;
+  client.subscribe(sub, 1);
+  WS_MqttInflight_Requeue(g_qos);   // clean session: unacknowledged messages go again
+  MQTT_PublishBirth();
+  MQTT_RequestKeyframe();
+  MQTT_TeleAllDue();
+  MQTT_MarkStateDirty();
+  MQTT_PublishState(true);
+  WS_Outbox_Resume(g_outbox, millis());
+  printf("MQTT connected: server=%s port=%d sub=%s pub=%s\r\n", mqtt_server, PORT, sub, pub);
 }
 void MQTT_Init()
 {
@@ -1385,8 +2967,17 @@ void MQTT_Init()
     client.setServer(mqtt_server, PORT);
     client.setCallback(callback);
     // PubSubClient default buffer is too small for the /getData-style JSON payload.
-    client.setBufferSize(3072);
+    // Bulk RPC replies are streamed in chunks (MQTT_PublishChunk) and don't need it.
+    client.setBufferSize(WS_STATE_JSON_MAX + 256);
+    client.setKeepAlive(MQTT_KEEPALIVE_S);   // also sent in WS_MqttLink's CONNECT
+#if MQTT_QOS1_Enable
+    WS_MqttInflight_Init(g_qos, g_qosArena, sizeof(g_qosArena), MQTT_QOS1_INFLIGHT);
+#endif
     WS_Log_SetLineSink(WS_LogSink_Mqtt);
+    if (MQTT_OUTBOX_Enable && WS_FS_EnsureMounted() &&
+        !WS_Outbox_Open(g_outbox, "/outbox", MQTT_OUTBOX_SEGMENTS, MQTT_OUTBOX_SEGMENT_BYTES)) {
+      printf("warning: MQTT outbox unavailable, offline messages are not kept\r\n");
+    }
   } else {
     WS_Log_SetLineSink(nullptr);
     printf("MQTT disabled, Web panel + ElegantOTA are available.\r\n");
@@ -1415,6 +3006,8 @@ void MQTT_Loop()
       (void)WiFi.reconnect();
       WS_Net_UpdateIpStrFromWiFi();
     }
+    MQTT_BatchLoop();     // offline: into the outbox
+    MQTT_LogPushLoop();
     return;
   }
 
@@ -1422,7 +3015,12 @@ void MQTT_Loop()
     reconnect();
   }
   client.loop();
+  MQTT_QosPump();
+  MQTT_BatchLoop();
   MQTT_PublishState(false);
+  MQTT_PublishGroups();
+  MQTT_LogPushLoop();
+  MQTT_OutboxLoop();
 }
 
 
@@ -6,12 +6,13 @@
 #include <WebServer.h>
 #include "WS_GPIO.h"
 #include "WS_Information.h"
+#include "WS_MqttLink.h"
 
 #define MQTT_Mode            3
 #define WIFI_Mode            3
 
 extern PubSubClient client;
-extern WiFiClient espClient;
+extern WS_MqttLink mqttLink;
 extern WebServer server;
 
 extern bool Relay_Flag[6];       // Relay current status flag
@@ -22,6 +23,8 @@ extern void Relay_Analysis(uint8_t *buf,uint8_t Mode_Flag);
 void handleRoot();
 void handleGetData();
 void handleApiState();
+void handleApiBus();
+void handleApiHistory();
 void handleApiCmd();
 void handleConfigPage();
 void handleApiConfigGet();
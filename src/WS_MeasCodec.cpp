@@ -0,0 +1,219 @@
+#include "WS_MeasCodec.h"
+#include "WS_Bytes.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const uint8_t kTagRecord = 0x80;
+static const uint8_t kTagMasks = 0x01;
+static const uint8_t kFlagEpoch = 0x01;
+
+// ---------------- varint / zigzag ----------------
+static size_t PutVarint(uint8_t* out, uint32_t v)
+{
+  size_t n = 0;
+  while (v >= 0x80U) {
+    out[n++] = (uint8_t)(v | 0x80U);
+    v >>= 7;
+  }
+  out[n++] = (uint8_t)v;
+  return n;
+}
+
+static bool GetVarint(const uint8_t* p, size_t len, size_t& pos, uint32_t& v)
+{
+  v = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (pos >= len) {
+      return false;
+    }
+    const uint8_t b = p[pos++];
+    v |= (uint32_t)(b & 0x7FU) << shift;
+    if ((b & 0x80U) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline uint32_t ZigZag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static inline int32_t UnZigZag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1U); }
+
+// ---------------- encoder ----------------
+size_t WS_MLog_BeginBlock(WS_MLogEncoder& e, const WS_MLogRecord& r, uint8_t* out)
+{
+  const uint8_t count = (r.count > WS_MLOG_MAX_SENSORS) ? WS_MLOG_MAX_SENSORS : r.count;
+  out[0] = 'M';
+  out[1] = 'L';
+  out[2] = WS_MLOG_VERSION;
+  out[3] = count;
+  WS_PutU32(out + 4, r.t);
+  out[8] = r.epoch ? kFlagEpoch : 0;
+  out[9] = 0;
+  out[10] = 0;
+  out[11] = 0;
+
+  // Keyframe: the first record is a delta against an all-zero record at t0.
+  e.prev = WS_MLogRecord();
+  e.prev.t = r.t;
+  e.prev.epoch = r.epoch;
+  e.prev.count = count;
+  e.used = WS_MLOG_HEADER_BYTES;
+  return WS_MLOG_HEADER_BYTES;
+}
+
+size_t WS_MLog_EncodeRecord(WS_MLogEncoder& e, const WS_MLogRecord& r, uint8_t* out)
+{
+  const uint8_t count = (r.count > WS_MLOG_MAX_SENSORS) ? WS_MLOG_MAX_SENSORS : r.count;
+  if (e.used == 0 || count != e.prev.count || r.epoch != e.prev.epoch || r.t < e.prev.t) {
+    return 0;
+  }
+
+  const bool keyframe = (e.used == WS_MLOG_HEADER_BYTES);
+  const bool masks = keyframe || r.online != e.prev.online || r.valid != e.prev.valid;
+  size_t n = 0;
+  out[n++] = (uint8_t)(kTagRecord | (masks ? kTagMasks : 0));
+  n += PutVarint(out + n, r.t - e.prev.t);
+  if (masks) {
+    out[n++] = r.online;
+    out[n++] = r.valid;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    n += PutVarint(out + n, ZigZag((int32_t)r.level_mm[i] - (int32_t)e.prev.level_mm[i]));
+    n += PutVarint(out + n, ZigZag((int32_t)r.temp_x10[i] - (int32_t)e.prev.temp_x10[i]));
+  }
+
+  if ((size_t)e.used + n > WS_MLOG_BLOCK_BYTES) {
+    return 0;
+  }
+  e.used = (uint16_t)(e.used + n);
+  e.prev = r;
+  e.prev.count = count;
+  return n;
+}
+
+// ---------------- decoder ----------------
+bool WS_MLog_ReadHeader(const uint8_t* blk, size_t len, WS_MLogHeader& out)
+{
+  if (!blk || len < WS_MLOG_HEADER_BYTES) {
+    return false;
+  }
+  if (blk[0] != 'M' || blk[1] != 'L' || blk[2] != WS_MLOG_VERSION || blk[3] > WS_MLOG_MAX_SENSORS) {
+    return false;
+  }
+  out.version = blk[2];
+  out.count = blk[3];
+  out.t0 = WS_GetU32(blk + 4);
+  out.epoch = (blk[8] & kFlagEpoch) != 0;
+  return true;
+}
+
+bool WS_MLog_BlockBegin(WS_MLogBlockReader& rd, const uint8_t* blk, size_t len)
+{
+  rd = WS_MLogBlockReader();
+  if (len > WS_MLOG_BLOCK_BYTES) {
+    len = WS_MLOG_BLOCK_BYTES;
+  }
+  if (!WS_MLog_ReadHeader(blk, len, rd.hdr)) {
+    return false;
+  }
+  rd.p = blk;
+  rd.len = len;
+  rd.pos = WS_MLOG_HEADER_BYTES;
+  rd.cur.t = rd.hdr.t0;
+  rd.cur.epoch = rd.hdr.epoch;
+  rd.cur.count = rd.hdr.count;
+  return true;
+}
+
+bool WS_MLog_BlockNext(WS_MLogBlockReader& rd, WS_MLogRecord& out)
+{
+  if (!rd.p || rd.pos >= rd.len) {
+    return false;
+  }
+  const uint8_t tag = rd.p[rd.pos];
+  if ((tag & kTagRecord) == 0) {
+    return false;  // padding
+  }
+  size_t pos = rd.pos + 1;
+  WS_MLogRecord r = rd.cur;
+  uint32_t v = 0;
+  if (!GetVarint(rd.p, rd.len, pos, v)) {
+    return false;
+  }
+  r.t += v;
+  if (tag & kTagMasks) {
+    if (pos + 2 > rd.len) {
+      return false;
+    }
+    r.online = rd.p[pos++];
+    r.valid = rd.p[pos++];
+  } else if (rd.first) {
+    return false;  // a keyframe always carries the masks
+  }
+  for (uint8_t i = 0; i < r.count; i++) {
+    if (!GetVarint(rd.p, rd.len, pos, v)) {
+      return false;
+    }
+    r.level_mm[i] = (uint16_t)((int32_t)r.level_mm[i] + UnZigZag(v));
+    if (!GetVarint(rd.p, rd.len, pos, v)) {
+      return false;
+    }
+    r.temp_x10[i] = (int16_t)((int32_t)r.temp_x10[i] + UnZigZag(v));
+  }
+  rd.pos = pos;
+  rd.cur = r;
+  rd.first = false;
+  out = r;
+  return true;
+}
+
+// ---------------- text ----------------
+size_t WS_MLog_FormatLine(const WS_MLogRecord& r, char* out, size_t cap)
+{
+  if (!out || cap == 0) {
+    return 0;
+  }
+  char ts[72];
+  if (r.epoch) {
+    // Epoch is local time already (NTP offset applied), so gmtime_r yields wall time.
+    time_t tt = (time_t)r.t;
+    struct tm tmv;
+    if (gmtime_r(&tt, &tmv)) {
+      snprintf(ts, sizeof(ts), "%04d-%02d-%02d %02d:%02d:%02d",
+               tmv.tm_year + 1900, tmv.tm_mon + 1, tmv.tm_mday,
+               tmv.tm_hour, tmv.tm_min, tmv.tm_sec);
+    } else {
+      snprintf(ts, sizeof(ts), "%lu", (unsigned long)r.t);
+    }
+  } else {
+    snprintf(ts, sizeof(ts), "ms=%lu", (unsigned long)r.t * 1000UL);
+  }
+
+  // Keep the historic inner/outer fields first; extra sensors are appended as sN_*.
+  const uint16_t l1 = (r.count > 0) ? r.level_mm[0] : 0;
+  const uint16_t l2 = (r.count > 1) ? r.level_mm[1] : 0;
+  const int t1 = (r.count > 0) ? r.temp_x10[0] : 0;
+  const int t2 = (r.count > 1) ? r.temp_x10[1] : 0;
+  int w = snprintf(out, cap, "%s [MEAS] inner_mm=%u outer_mm=%u t1_x10=%d t2_x10=%d online1=%d online2=%d valid1=%d valid2=%d",
+                   ts, (unsigned)l1, (unsigned)l2, t1, t2,
+                   (r.online & 0x01) ? 1 : 0, (r.online & 0x02) ? 1 : 0,
+                   (r.valid & 0x01) ? 1 : 0, (r.valid & 0x02) ? 1 : 0);
+  for (uint8_t i = 2; i < r.count && w >= 0 && (size_t)w < cap; i++) {
+    const int n = snprintf(out + w, cap - (size_t)w, " s%u_mm=%u s%u_online=%d",
+                           (unsigned)(i + 1), (unsigned)r.level_mm[i],
+                           (unsigned)(i + 1), ((r.online >> i) & 1U) ? 1 : 0);
+    if (n < 0) break;
+    w += n;
+  }
+  if (w >= 0 && (size_t)w < cap) {
+    const int n = snprintf(out + w, cap - (size_t)w, "\r\n");
+    if (n > 0) w += n;
+  }
+  if (w < 0) {
+    out[0] = '\0';
+    return 0;
+  }
+  return ((size_t)w < cap) ? (size_t)w : cap - 1;
+}
@@ -0,0 +1,81 @@
+#ifndef _WS_MEAS_CODEC_H_
+#define _WS_MEAS_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary measurement log codec (no Arduino dependencies, builds on the host as well).
+//
+// The file is a sequence of fixed-size blocks, so block k starts at k * WS_MLOG_BLOCK_BYTES
+// and its header carries the time of its first record: that is the block index, a reader
+// can seek or bisect by time without scanning records.
+//
+// Block:  header (12 bytes) | keyframe record | delta records ... | 0x00 padding
+// Header: 'M' 'L' version sensor_count | t0 (u32 LE) | flags (bit0 = epoch time) | 3 reserved
+// Record: tag (0x80 | 0x01 if masks follow) | varint dt [s]
+//         | [online mask, valid mask] | per sensor: zigzag varint d_level_mm, zigzag varint d_temp_x10
+// The first record of a block is encoded against zero (absolute keyframe), every other
+// record against the previous one. A block ends at the first 0x00 tag or at its end.
+
+#define WS_MLOG_BLOCK_BYTES   512
+#define WS_MLOG_HEADER_BYTES  12
+#define WS_MLOG_MAX_SENSORS   8
+#define WS_MLOG_VERSION       1
+#define WS_MLOG_MAX_RECORD    (1 + 5 + 2 + WS_MLOG_MAX_SENSORS * 6)
+#define WS_MLOG_LINE_MAX      320
+
+struct WS_MLogRecord {
+  uint32_t t = 0;                 // epoch seconds (local) if epoch, else seconds since boot
+  bool epoch = false;
+  uint8_t count = 0;              // sensors in this record
+  uint8_t online = 0;             // bit i = sensor i online
+  uint8_t valid = 0;              // bit i = sensor i has a value
+  uint16_t level_mm[WS_MLOG_MAX_SENSORS] = {0};
+  int16_t temp_x10[WS_MLOG_MAX_SENSORS] = {0};
+};
+
+struct WS_MLogEncoder {
+  WS_MLogRecord prev;
+  uint16_t used = 0;              // bytes used in the open block, 0 = no open block
+};
+
+// Encode r into out (>= WS_MLOG_MAX_RECORD bytes) as a delta against the open block.
+// Returns 0 if a new block is needed first (none open, sensor count / time base changed,
+// time went backwards, or the record would not fit).
+size_t WS_MLog_EncodeRecord(WS_MLogEncoder& e, const WS_MLogRecord& r, uint8_t* out);
+
+// Start a new block for r: writes the header into out (WS_MLOG_HEADER_BYTES) and resets
+// the delta state, so the next WS_MLog_EncodeRecord() emits a keyframe.
+size_t WS_MLog_BeginBlock(WS_MLogEncoder& e, const WS_MLogRecord& r, uint8_t* out);
+
+// Forget the open block (file rotated / reopened); the next record starts a new block.
+inline void WS_MLog_EncoderReset(WS_MLogEncoder& e) { e.used = 0; }
+
+struct WS_MLogHeader {
+  uint8_t version = 0;
+  uint8_t count = 0;
+  uint32_t t0 = 0;
+  bool epoch = false;
+};
+
+bool WS_MLog_ReadHeader(const uint8_t* blk, size_t len, WS_MLogHeader& out);
+
+struct WS_MLogBlockReader {
+  const uint8_t* p = nullptr;
+  size_t len = 0;
+  size_t pos = 0;
+  WS_MLogHeader hdr;
+  WS_MLogRecord cur;
+  bool first = true;
+};
+
+// Iterate the records of one block (len may be short for the last block of a file).
+bool WS_MLog_BlockBegin(WS_MLogBlockReader& rd, const uint8_t* blk, size_t len);
+bool WS_MLog_BlockNext(WS_MLogBlockReader& rd, WS_MLogRecord& out);
+
+// Text view, same layout as the former text measure log:
+// "YYYY-MM-DD HH:MM:SS [MEAS] inner_mm=.. outer_mm=.. t1_x10=.. ... sN_mm=.. sN_online=..\r\n"
+// (records without epoch time are prefixed "ms=<uptime ms>").
+size_t WS_MLog_FormatLine(const WS_MLogRecord& r, char* out, size_t cap);
+
+#endif
@@ -0,0 +1,163 @@
+#include "WS_Modbus.h"
+
+static void WS_Modbus_Enter(WS_ModbusMaster& m, WS_ModbusState s, uint32_t nowMs)
+{
+  m.state = s;
+  m.state_ms = nowMs;
+}
+
+// Fold the scanner counters of the finished attempt into the transaction stats.
+static void WS_Modbus_EndAttempt(WS_ModbusMaster& m)
+{
+  WS_ModbusTxnStats& st = m.stats;
+  st.crc_errors = (uint8_t)min(255U, (unsigned)st.crc_errors + m.rx.crc_errors);
+  st.header_errors = (uint8_t)min(255U, (unsigned)st.header_errors + m.rx.header_errors);
+}
+
+static void WS_Modbus_Drain(WS_ModbusMaster& m, uint32_t nowMs)
+{
+  // Any byte seen here belongs to an older (late) frame: restart the quiet window.
+  bool any = false;
+  while (m.port->available() > 0) {
+    (void)m.port->read();
+    any = true;
+  }
+  if (any) {
+    m.state_ms = nowMs;
+  }
+}
+
+void WS_Modbus_Begin(WS_ModbusMaster& m, Stream& port, uint32_t baud)
+{
+  m.port = &port;
+  m.baud = (baud > 0) ? baud : 9600;
+  m.state = WS_MB_IDLE;
+}
+
+static void WS_Modbus_Queue(WS_ModbusMaster& m, uint8_t id, uint8_t fc, uint16_t count, uint32_t nowMs)
+{
+  m.id = id;
+  m.fc = fc;
+  m.reg_count = count;
+  // 8N1 = 10 bits per byte; round up and add 1 ms for the driver/transceiver turnaround.
+  m.tx_time_ms = (uint32_t)((m.req_len * 10UL * 1000UL + m.baud - 1UL) / m.baud) + 1UL;
+  m.attempt = 0;
+  m.last_exception = 0;
+  m.stats = WS_ModbusTxnStats();
+  WS_MB_ScanReset(m.rx, id, fc, count);
+  WS_Modbus_Enter(m, WS_MB_QUIET, nowMs);
+}
+
+bool WS_Modbus_StartRead(WS_ModbusMaster& m, uint8_t id, uint8_t fc, uint16_t reg, uint16_t count, uint32_t nowMs)
+{
+  if (m.port == nullptr || WS_Modbus_IsBusy(m)) {
+    return false;
+  }
+  const size_t n = WS_MB_BuildRead(m.req, sizeof(m.req), id, fc, reg, count);
+  if (n == 0) {
+    return false;
+  }
+  m.req_len = (uint8_t)n;
+  WS_Modbus_Queue(m, id, fc, count, nowMs);
+  return true;
+}
+
+bool WS_Modbus_StartWrite(WS_ModbusMaster& m, uint8_t id, uint16_t reg, const uint16_t* values, uint16_t count, uint32_t nowMs)
+{
+  if (m.port == nullptr || WS_Modbus_IsBusy(m) || values == nullptr) {
+    return false;
+  }
+  const uint8_t fc = (count == 1) ? WS_MB_FC_WRITE_SINGLE : WS_MB_FC_WRITE_MULTIPLE;
+  const size_t n = (count == 1) ? WS_MB_BuildWriteSingle(m.req, sizeof(m.req), id, reg, values[0])
+                                : WS_MB_BuildWriteMultiple(m.req, sizeof(m.req), id, reg, values, count);
+  if (n == 0) {
+    return false;
+  }
+  m.req_len = (uint8_t)n;
+  WS_Modbus_Queue(m, id, fc, count, nowMs);
+  return true;
+}
+
+bool WS_Modbus_IsBusy(const WS_ModbusMaster& m)
+{
+  return m.state != WS_MB_IDLE;
+}
+
+uint16_t WS_Modbus_Reg(const WS_ModbusMaster& m, uint16_t i)
+{
+  return WS_MB_ScanReg(m.rx, i);
+}
+
+WS_ModbusResult WS_Modbus_Poll(WS_ModbusMaster& m, uint32_t nowMs)
+{
+  switch (m.state) {
+    case WS_MB_IDLE:
+      return WS_MB_RESULT_NONE;
+
+    case WS_MB_QUIET:
+      WS_Modbus_Drain(m, nowMs);
+      if ((nowMs - m.state_ms) < m.quiet_ms) {
+        return WS_MB_RESULT_BUSY;
+      }
+      // The request fits into the UART TX FIFO, so write() returns without waiting.
+      WS_MB_ScanReset(m.rx, m.id, m.fc, m.reg_count);
+      m.port->write(m.req, m.req_len);
+      m.stats.sent++;
+      WS_Modbus_Enter(m, WS_MB_TX, nowMs);
+      return WS_MB_RESULT_BUSY;
+
+    case WS_MB_TX:
+      // Wait (without flush()) until the request has left the wire, then start the reply timer.
+      if ((nowMs - m.state_ms) < m.tx_time_ms) {
+        return WS_MB_RESULT_BUSY;
+      }
+      WS_Modbus_Enter(m, WS_MB_WAIT, nowMs);
+      // fall through - a fast slave may already have answered.
+
+    case WS_MB_WAIT: {
+      WS_MB_ScanResult scan = WS_MB_SCAN_MORE;
+      while (scan == WS_MB_SCAN_MORE && m.port->available() > 0) {
+        scan = WS_MB_ScanByte(m.rx, (uint8_t)m.port->read());
+      }
+      if (scan == WS_MB_SCAN_FRAME) {
+        WS_Modbus_EndAttempt(m);
+        m.stats.latency_ms = (uint16_t)min((uint32_t)0xFFFF, nowMs - m.state_ms);
+        WS_Modbus_Enter(m, WS_MB_DONE, nowMs);
+        break;
+      }
+      if (scan == WS_MB_SCAN_EXCEPTION) {
+        WS_Modbus_EndAttempt(m);
+        m.last_exception = WS_MB_ScanFrame(m.rx)[2];
+        WS_Modbus_Enter(m, WS_MB_TIMEOUT, nowMs);
+        break;
+      }
+      if ((nowMs - m.state_ms) < m.timeout_ms) {
+        return WS_MB_RESULT_BUSY;
+      }
+      WS_Modbus_EndAttempt(m);
+      m.stats.timeouts++;
+      m.attempt++;
+      if (m.attempt < m.attempts) {
+        WS_Modbus_Enter(m, WS_MB_GAP, nowMs);
+        return WS_MB_RESULT_BUSY;
+      }
+      WS_Modbus_Enter(m, WS_MB_TIMEOUT, nowMs);
+      break;
+    }
+
+    case WS_MB_GAP:
+      if ((nowMs - m.state_ms) < m.retry_gap_ms) {
+        return WS_MB_RESULT_BUSY;
+      }
+      WS_Modbus_Enter(m, WS_MB_QUIET, nowMs);
+      return WS_MB_RESULT_BUSY;
+
+    default:
+      break;
+  }
+
+  // Terminal states: report once and go back to idle (reply bytes stay readable).
+  const WS_ModbusResult r = (m.state == WS_MB_DONE) ? WS_MB_RESULT_OK : WS_MB_RESULT_FAIL;
+  m.state = WS_MB_IDLE;
+  return r;
+}
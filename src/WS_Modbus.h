@@ -0,0 +1,82 @@
+#ifndef _WS_MODBUS_H_
+#define _WS_MODBUS_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "WS_ModbusCodec.h"
+
+// Non-blocking Modbus RTU master (one transaction in flight).
+//
+// Call WS_Modbus_Poll() from loop(); every call only moves bytes that are already
+// buffered by the UART driver and never waits:
+//   IDLE -> QUIET (drain late bytes) -> TX (frame on the wire) -> WAIT (feed the reply
+//   scanner, see WS_ModbusCodec.h) -> DONE | TIMEOUT
+// A timed out attempt goes through GAP and back to QUIET while retries remain.
+// An exception reply ends the transaction at once (the slave is alive, retrying won't help).
+
+enum WS_ModbusState : uint8_t {
+  WS_MB_IDLE = 0,
+  WS_MB_QUIET = 1,
+  WS_MB_TX = 2,
+  WS_MB_WAIT = 3,
+  WS_MB_GAP = 4,
+  WS_MB_DONE = 5,
+  WS_MB_TIMEOUT = 6
+};
+
+enum WS_ModbusResult : uint8_t {
+  WS_MB_RESULT_NONE = 0,      // idle, nothing to report
+  WS_MB_RESULT_BUSY = 1,      // transaction in progress
+  WS_MB_RESULT_OK = 2,        // reply received, registers available
+  WS_MB_RESULT_FAIL = 3       // all attempts timed out, or exception reply
+};
+
+// Diagnostics of the current / last transaction (reset when a request is queued).
+struct WS_ModbusTxnStats {
+  uint8_t sent = 0;           // requests put on the wire (first try + retries)
+  uint8_t timeouts = 0;       // attempts that ended without a valid reply
+  uint8_t crc_errors = 0;     // candidate replies with a bad CRC
+  uint8_t header_errors = 0;  // id matched, function / byte count did not
+  uint16_t latency_ms = 0;    // request left the wire -> valid reply (OK only)
+};
+
+struct WS_ModbusMaster {
+  Stream* port = nullptr;
+  uint32_t baud = 9600;
+  uint16_t quiet_ms = 5;      // RX must stay silent this long before sending
+  uint16_t timeout_ms = 250;  // per-attempt reply timeout (after the request left the wire)
+  uint16_t retry_gap_ms = 80;
+  uint8_t attempts = 2;       // 2 = first try + 1 retry
+
+  WS_ModbusState state = WS_MB_IDLE;
+  uint8_t id = 0;
+  uint8_t fc = 0;
+  uint16_t reg_count = 0;
+  uint8_t attempt = 0;
+  uint32_t state_ms = 0;      // entry time of the current state
+  uint32_t tx_time_ms = 0;    // estimated time for the request to leave the wire
+
+  uint8_t req[WS_MB_MAX_REQ_LEN] = {0};
+  uint8_t req_len = 0;
+  WS_MB_Scanner rx;           // reply stays readable after DONE
+  uint8_t last_exception = 0; // exception code of the last failed transaction (0 = timeout)
+  WS_ModbusTxnStats stats;
+};
+
+void WS_Modbus_Begin(WS_ModbusMaster& m, Stream& port, uint32_t baud);
+
+// Queue a read request (0x03 holding / 0x04 input). Returns false if busy or arguments invalid.
+bool WS_Modbus_StartRead(WS_ModbusMaster& m, uint8_t id, uint8_t fc, uint16_t reg, uint16_t count, uint32_t nowMs);
+
+// Queue a write request (0x06 for one register, 0x10 otherwise).
+bool WS_Modbus_StartWrite(WS_ModbusMaster& m, uint8_t id, uint16_t reg, const uint16_t* values, uint16_t count, uint32_t nowMs);
+
+// Advance the state machine. OK/FAIL are reported exactly once, then the master is idle again.
+WS_ModbusResult WS_Modbus_Poll(WS_ModbusMaster& m, uint32_t nowMs);
+
+bool WS_Modbus_IsBusy(const WS_ModbusMaster& m);
+
+// Register i of the last successful reply (big-endian on the wire).
+uint16_t WS_Modbus_Reg(const WS_ModbusMaster& m, uint16_t i);
+
+#endif
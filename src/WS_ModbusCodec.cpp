@@ -0,0 +1,220 @@
+#include "WS_ModbusCodec.h"
+
+// ---------------- CRC16 ----------------
+// C++11 constexpr functions are single expressions, so the 256 entries are
+// expanded by macro and each entry runs the 8 shift/xor steps at compile time.
+static constexpr uint16_t WS_MB_CrcStep(uint16_t c)
+{
+  return (c & 1U) ? (uint16_t)((c >> 1) ^ 0xA001U) : (uint16_t)(c >> 1);
+}
+
+static constexpr uint16_t WS_MB_CrcEntry(uint16_t c)
+{
+  return WS_MB_CrcStep(WS_MB_CrcStep(WS_MB_CrcStep(WS_MB_CrcStep(
+         WS_MB_CrcStep(WS_MB_CrcStep(WS_MB_CrcStep(WS_MB_CrcStep(c))))))));
+}
+
+#define WS_MB_CRC4(n)  WS_MB_CrcEntry(n), WS_MB_CrcEntry(n + 1), WS_MB_CrcEntry(n + 2), WS_MB_CrcEntry(n + 3)
+#define WS_MB_CRC16(n) WS_MB_CRC4(n), WS_MB_CRC4(n + 4), WS_MB_CRC4(n + 8), WS_MB_CRC4(n + 12)
+#define WS_MB_CRC64(n) WS_MB_CRC16(n), WS_MB_CRC16(n + 16), WS_MB_CRC16(n + 32), WS_MB_CRC16(n + 48)
+
+static constexpr uint16_t WS_MB_CrcTable[256] = {
+  WS_MB_CRC64(0), WS_MB_CRC64(64), WS_MB_CRC64(128), WS_MB_CRC64(192)
+};
+
+#undef WS_MB_CRC4
+#undef WS_MB_CRC16
+#undef WS_MB_CRC64
+
+static_assert(WS_MB_CrcTable[0x01] == 0xC0C1 && WS_MB_CrcTable[0xFF] == 0x4040, "Modbus CRC table");
+
+uint16_t WS_MB_Crc16Update(uint16_t crc, uint8_t b)
+{
+  return (uint16_t)((crc >> 8) ^ WS_MB_CrcTable[(crc ^ b) & 0xFF]);
+}
+
+uint16_t WS_MB_Crc16(const uint8_t* data, size_t len)
+{
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; ++i) {
+    crc = WS_MB_Crc16Update(crc, data[i]);
+  }
+  return crc;
+}
+
+// ---------------- Builders ----------------
+static size_t WS_MB_Finish(uint8_t* out, size_t n)
+{
+  const uint16_t crc = WS_MB_Crc16(out, n);
+  out[n] = (uint8_t)(crc & 0xFF);
+  out[n + 1] = (uint8_t)(crc >> 8);
+  return n + 2;
+}
+
+static void WS_MB_Put16(uint8_t* p, uint16_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)(v & 0xFF);
+}
+
+size_t WS_MB_BuildRead(uint8_t* out, size_t cap, uint8_t id, uint8_t fc, uint16_t reg, uint16_t count)
+{
+  if (out == nullptr || cap < 8 || count == 0 || count > WS_MB_MAX_READ_REGS) {
+    return 0;
+  }
+  if (fc != WS_MB_FC_READ_HOLDING && fc != WS_MB_FC_READ_INPUT) {
+    return 0;
+  }
+  out[0] = id;
+  out[1] = fc;
+  WS_MB_Put16(&out[2], reg);
+  WS_MB_Put16(&out[4], count);
+  return WS_MB_Finish(out, 6);
+}
+
+size_t WS_MB_BuildWriteSingle(uint8_t* out, size_t cap, uint8_t id, uint16_t reg, uint16_t value)
+{
+  if (out == nullptr || cap < 8) {
+    return 0;
+  }
+  out[0] = id;
+  out[1] = WS_MB_FC_WRITE_SINGLE;
+  WS_MB_Put16(&out[2], reg);
+  WS_MB_Put16(&out[4], value);
+  return WS_MB_Finish(out, 6);
+}
+
+size_t WS_MB_BuildWriteMultiple(uint8_t* out, size_t cap, uint8_t id, uint16_t reg, const uint16_t* values, uint16_t count)
+{
+  const size_t n = 7U + count * 2U;
+  if (out == nullptr || values == nullptr || count == 0 || count > WS_MB_MAX_WRITE_REGS || cap < n + 2U) {
+    return 0;
+  }
+  out[0] = id;
+  out[1] = WS_MB_FC_WRITE_MULTIPLE;
+  WS_MB_Put16(&out[2], reg);
+  WS_MB_Put16(&out[4], count);
+  out[6] = (uint8_t)(count * 2U);
+  for (uint16_t i = 0; i < count; ++i) {
+    WS_MB_Put16(&out[7 + i * 2U], values[i]);
+  }
+  return WS_MB_Finish(out, n);
+}
+
+// ---------------- Scanner ----------------
+void WS_MB_ScanReset(WS_MB_Scanner& s, uint8_t id, uint8_t fc, uint16_t readCount)
+{
+  s.id = id;
+  s.fc = fc;
+  s.expect_bc = (fc == WS_MB_FC_READ_HOLDING || fc == WS_MB_FC_READ_INPUT) ? (uint8_t)(readCount * 2U) : 0;
+  s.len = 0;
+  s.start = 0;
+  s.checked = 0;
+  s.frame_len = 0;
+  s.crc = 0xFFFF;
+  s.exception = false;
+  s.stray_bytes = 0;
+  s.crc_errors = 0;
+  s.header_errors = 0;
+}
+
+// Drop the current candidate and retry from the next byte.
+static void WS_MB_ScanReject(WS_MB_Scanner& s)
+{
+  s.start++;
+  s.checked = 0;
+  s.frame_len = 0;
+  s.crc = 0xFFFF;
+  s.exception = false;
+}
+
+// Validate one more byte of the candidate. Returns false when the candidate was rejected.
+static bool WS_MB_ScanStep(WS_MB_Scanner& s, uint8_t c)
+{
+  switch (s.checked) {
+    case 0:
+      if (c != s.id) {
+        s.stray_bytes++;
+        return false;
+      }
+      break;
+    case 1:
+      if (c == s.fc) {
+        // 0x03/0x04: length follows in the byte count; 0x06/0x10 echo 4 bytes.
+        s.frame_len = (s.expect_bc > 0) ? (uint8_t)(5U + s.expect_bc) : 8U;
+      } else if (c == (uint8_t)(s.fc | 0x80U)) {
+        s.exception = true;
+        s.frame_len = 5;
+      } else {
+        s.header_errors++;
+        return false;
+      }
+      break;
+    case 2:
+      if (!s.exception && s.expect_bc > 0 && c != s.expect_bc) {
+        s.header_errors++;
+        return false;
+      }
+      break;
+    default:
+      break;
+  }
+
+  if ((uint8_t)(s.checked + 2U) < s.frame_len || s.checked < 2) {
+    s.crc = WS_MB_Crc16Update(s.crc, c);
+  } else if ((uint8_t)(s.checked + 2U) == s.frame_len) {
+    if (c != (uint8_t)(s.crc & 0xFF)) {
+      s.crc_errors++;
+      return false;
+    }
+  } else if (c != (uint8_t)(s.crc >> 8)) {
+    s.crc_errors++;
+    return false;
+  }
+  s.checked++;
+  return true;
+}
+
+WS_MB_ScanResult WS_MB_ScanByte(WS_MB_Scanner& s, uint8_t b)
+{
+  if (s.frame_len > 0 && s.checked == s.frame_len) {
+    // A frame was already reported; trailing bytes are ignored.
+    return s.exception ? WS_MB_SCAN_EXCEPTION : WS_MB_SCAN_FRAME;
+  }
+  if (s.len >= sizeof(s.buf)) {
+    // Compact: everything before the candidate has been rejected already.
+    const uint8_t keep = (uint8_t)(s.len - s.start);
+    for (uint8_t i = 0; i < keep; ++i) {
+      s.buf[i] = s.buf[s.start + i];
+    }
+    s.len = keep;
+    s.start = 0;
+    if (s.len >= sizeof(s.buf)) {
+      WS_MB_ScanReject(s);
+      return WS_MB_ScanByte(s, b);
+    }
+  }
+  s.buf[s.len++] = b;
+
+  // Only bytes past start + checked are new to the current candidate; after a
+  // reject the candidate restarts one byte later and re-examines what follows.
+  while ((uint8_t)(s.start + s.checked) < s.len) {
+    if (!WS_MB_ScanStep(s, s.buf[s.start + s.checked])) {
+      WS_MB_ScanReject(s);
+      continue;
+    }
+    if (s.checked == s.frame_len) {
+      return s.exception ? WS_MB_SCAN_EXCEPTION : WS_MB_SCAN_FRAME;
+    }
+  }
+  return WS_MB_SCAN_MORE;
+}
+
+uint16_t WS_MB_ScanReg(const WS_MB_Scanner& s, uint16_t i)
+{
+  if (s.exception || s.expect_bc == 0 || i >= s.expect_bc / 2U) {
+    return 0;
+  }
+  const uint8_t* f = WS_MB_ScanFrame(s);
+  return ((uint16_t)f[3 + i * 2U] << 8) | f[4 + i * 2U];
+}
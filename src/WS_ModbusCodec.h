@@ -0,0 +1,65 @@
+#ifndef _WS_MODBUS_CODEC_H_
+#define _WS_MODBUS_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Modbus RTU frame codec (no Arduino dependencies, builds on the host as well).
+// - CRC16 (poly 0xA001) from a table generated at compile time
+// - request builders for function codes 0x03 / 0x04 / 0x06 / 0x10
+// - incremental reply scanner: every received byte is examined once unless it
+//   was part of a candidate that matched the header and then failed the CRC
+
+#define WS_MB_FC_READ_HOLDING   0x03
+#define WS_MB_FC_READ_INPUT     0x04
+#define WS_MB_FC_WRITE_SINGLE   0x06
+#define WS_MB_FC_WRITE_MULTIPLE 0x10
+
+#define WS_MB_MAX_READ_REGS     16
+#define WS_MB_MAX_WRITE_REGS    16
+#define WS_MB_MAX_REQ_LEN       (9 + 2 * WS_MB_MAX_WRITE_REGS)
+#define WS_MB_SCAN_BUF_LEN      64
+
+uint16_t WS_MB_Crc16(const uint8_t* data, size_t len);
+uint16_t WS_MB_Crc16Update(uint16_t crc, uint8_t b);
+
+// Builders return the frame length (CRC included), or 0 if the arguments don't fit.
+size_t WS_MB_BuildRead(uint8_t* out, size_t cap, uint8_t id, uint8_t fc, uint16_t reg, uint16_t count);
+size_t WS_MB_BuildWriteSingle(uint8_t* out, size_t cap, uint8_t id, uint16_t reg, uint16_t value);
+size_t WS_MB_BuildWriteMultiple(uint8_t* out, size_t cap, uint8_t id, uint16_t reg, const uint16_t* values, uint16_t count);
+
+enum WS_MB_ScanResult : uint8_t {
+  WS_MB_SCAN_MORE = 0,        // no complete frame yet
+  WS_MB_SCAN_FRAME = 1,       // valid reply at frame()
+  WS_MB_SCAN_EXCEPTION = 2    // valid exception reply (fc | 0x80), code at frame()[2]
+};
+
+struct WS_MB_Scanner {
+  // Expected reply
+  uint8_t id = 0;
+  uint8_t fc = 0;
+  uint8_t expect_bc = 0;      // byte count for 0x03/0x04 replies
+
+  uint8_t buf[WS_MB_SCAN_BUF_LEN] = {0};
+  uint8_t len = 0;            // bytes in buf
+  uint8_t start = 0;          // current candidate start
+  uint8_t checked = 0;        // candidate bytes already validated / CRC-accumulated
+  uint8_t frame_len = 0;      // candidate length once the header is known
+  uint16_t crc = 0xFFFF;      // running CRC over the candidate
+  bool exception = false;
+
+  // Diagnostics since the last reset
+  uint16_t stray_bytes = 0;   // bytes skipped because they couldn't start a reply
+  uint8_t crc_errors = 0;     // header matched but CRC failed
+  uint8_t header_errors = 0;  // id matched but function / byte count did not
+};
+
+void WS_MB_ScanReset(WS_MB_Scanner& s, uint8_t id, uint8_t fc, uint16_t readCount);
+WS_MB_ScanResult WS_MB_ScanByte(WS_MB_Scanner& s, uint8_t b);
+
+inline const uint8_t* WS_MB_ScanFrame(const WS_MB_Scanner& s) { return &s.buf[s.start]; }
+
+// Register i of a 0x03/0x04 reply found by the scanner.
+uint16_t WS_MB_ScanReg(const WS_MB_Scanner& s, uint16_t i);
+
+#endif
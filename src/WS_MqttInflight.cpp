@@ -0,0 +1,199 @@
+#include "WS_MqttInflight.h"
+
+#include <string.h>
+
+static WS_MqttInflightMsg& At(WS_MqttInflight& q, uint8_t i)
+{
+  return q.msg[(q.first + i) % WS_MQTT_INFLIGHT_MAX];
+}
+
+static uint32_t Size(const WS_MqttInflightMsg& m)
+{
+  return (uint32_t)m.topic_len + 1 + m.len;
+}
+
+void WS_MqttInflight_Init(WS_MqttInflight& q, uint8_t* arena, uint32_t cap, uint8_t window)
+{
+  q.arena = arena;
+  q.cap = cap;
+  q.window = (window == 0) ? 1 : ((window > WS_MQTT_INFLIGHT_MAX) ? WS_MQTT_INFLIGHT_MAX : window);
+  q.first = 0;
+  q.count = 0;
+  q.building = false;
+}
+
+bool WS_MqttInflight_Fits(const WS_MqttInflight& q, size_t topicLen, uint32_t len)
+{
+  return topicLen > 0 && topicLen <= 255 && (uint64_t)topicLen + 1 + len <= q.cap;
+}
+
+// Arena offset for need contiguous bytes after the newest message (wrapping to 0 when the
+// tail is too short), or -1. Bytes in use run from the oldest message to the newest one.
+static int64_t Reserve(WS_MqttInflight& q, uint32_t need)
+{
+  if (q.count == 0) {
+    return (need <= q.cap) ? 0 : -1;
+  }
+  const WS_MqttInflightMsg& oldest = At(q, 0);
+  const WS_MqttInflightMsg& newest = At(q, q.count - 1);
+  const uint32_t rd = oldest.off;
+  const uint32_t wr = newest.off + Size(newest);
+  if (newest.off >= rd) {
+    if (q.cap - wr >= need) {
+      return wr;
+    }
+    return (need <= rd) ? 0 : -1;
+  }
+  return (rd - wr >= need) ? (int64_t)wr : -1;
+}
+
+static uint16_t NextPid(WS_MqttInflight& q)
+{
+  for (;;) {
+    const uint16_t pid = q.next_pid++;
+    if (q.next_pid == 0) {
+      q.next_pid = 1;
+    }
+    bool used = false;
+    for (uint8_t i = 0; i < q.count && !used; i++) {
+      used = (At(q, i).pid == pid);
+    }
+    if (!used && pid != 0) {
+      return pid;
+    }
+  }
+}
+
+bool WS_MqttInflight_Begin(WS_MqttInflight& q, const char* topic, uint32_t len, bool retained, uint32_t t0Ms)
+{
+  const size_t tl = topic ? strlen(topic) : 0;
+  if (q.building || !WS_MqttInflight_Fits(q, tl, len)) {
+    return false;
+  }
+  const int64_t off = WS_MqttInflight_Full(q) ? -1 : Reserve(q, (uint32_t)tl + 1 + len);
+  if (off < 0) {
+    q.refused++;
+    return false;
+  }
+  WS_MqttInflightMsg& m = q.msg[(q.first + q.count) % WS_MQTT_INFLIGHT_MAX];
+  memset(&m, 0, sizeof(m));
+  m.retained = retained;
+  m.topic_len = (uint8_t)tl;
+  m.off = (uint32_t)off;
+  m.len = len;
+  m.t0_ms = t0Ms;
+  memcpy(q.arena + m.off, topic, tl + 1);
+  q.building = true;
+  q.build_left = len;
+  q.build_pos = m.off + (uint32_t)tl + 1;
+  return true;
+}
+
+bool WS_MqttInflight_Write(WS_MqttInflight& q, const uint8_t* data, size_t n)
+{
+  if (!q.building || n > q.build_left) {
+    return false;
+  }
+  memcpy(q.arena + q.build_pos, data, n);
+  q.build_pos += (uint32_t)n;
+  q.build_left -= (uint32_t)n;
+  return true;
+}
+
+bool WS_MqttInflight_End(WS_MqttInflight& q)
+{
+  if (!q.building) {
+    return false;
+  }
+  q.building = false;
+  if (q.build_left != 0) {
+    return false;
+  }
+  WS_MqttInflightMsg& m = q.msg[(q.first + q.count) % WS_MQTT_INFLIGHT_MAX];
+  m.pid = NextPid(q);
+  m.due = true;
+  q.count++;
+  q.published++;
+  return true;
+}
+
+bool WS_MqttInflight_Put(WS_MqttInflight& q, const char* topic, const uint8_t* data, size_t n, bool retained, uint32_t t0Ms)
+{
+  if (!WS_MqttInflight_Begin(q, topic, (uint32_t)n, retained, t0Ms)) {
+    return false;
+  }
+  WS_MqttInflight_Write(q, data, n);
+  return WS_MqttInflight_End(q);
+}
+
+WS_MqttInflightMsg* WS_MqttInflight_NextDue(WS_MqttInflight& q, uint32_t nowMs, uint32_t retryMs)
+{
+  for (uint8_t i = 0; i < q.count; i++) {
+    WS_MqttInflightMsg& m = At(q, i);
+    if (m.acked) {
+      continue;
+    }
+    if (m.due || (nowMs - m.sent_ms) >= retryMs) {
+      return &m;
+    }
+  }
+  return nullptr;
+}
+
+void WS_MqttInflight_MarkSent(WS_MqttInflight& q, WS_MqttInflightMsg& m, uint32_t nowMs)
+{
+  if (m.sends > 0) {
+    q.resent++;
+  }
+  if (m.sends < 255) {
+    m.sends++;
+  }
+  m.due = false;
+  m.sent_ms = nowMs;
+}
+
+const char* WS_MqttInflight_Topic(const WS_MqttInflight& q, const WS_MqttInflightMsg& m)
+{
+  return (const char*)(q.arena + m.off);
+}
+
+const uint8_t* WS_MqttInflight_Payload(const WS_MqttInflight& q, const WS_MqttInflightMsg& m)
+{
+  return q.arena + m.off + m.topic_len + 1;
+}
+
+bool WS_MqttInflight_Ack(WS_MqttInflight& q, uint16_t pid, uint32_t nowMs, WS_MqttInflightAck& out)
+{
+  for (uint8_t i = 0; i < q.count; i++) {
+    WS_MqttInflightMsg& m = At(q, i);
+    if (m.pid != pid || m.acked || m.sends == 0) {
+      continue;
+    }
+    m.acked = true;
+    q.acked++;
+    out.t0_ms = m.t0_ms;
+    out.rtt_ms = 0;
+    if (m.sends == 1) {
+      out.rtt_ms = nowMs - m.sent_ms;
+      q.last_rtt_ms = out.rtt_ms;
+      q.srtt_ms = (q.srtt_ms == 0) ? out.rtt_ms : (7 * q.srtt_ms + out.rtt_ms) / 8;
+    }
+    // Free the acknowledged run at the front (an in-progress Begin sits behind count).
+    while (q.count > 0 && At(q, 0).acked) {
+      q.first = (uint8_t)((q.first + 1) % WS_MQTT_INFLIGHT_MAX);
+      q.count--;
+    }
+    return true;
+  }
+  return false;
+}
+
+void WS_MqttInflight_Requeue(WS_MqttInflight& q)
+{
+  for (uint8_t i = 0; i < q.count; i++) {
+    WS_MqttInflightMsg& m = At(q, i);
+    if (!m.acked) {
+      m.due = true;
+    }
+  }
+}
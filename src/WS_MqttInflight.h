@@ -0,0 +1,91 @@
+#ifndef _WS_MQTT_INFLIGHT_H_
+#define _WS_MQTT_INFLIGHT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// QoS1 in-flight window: messages published with QoS1 are kept (topic + payload, in a
+// caller-provided byte arena) until the broker's PUBACK for their packet id arrives.
+// At most `window` messages / the arena's bytes are outstanding; a full window refuses
+// new messages, which is the backpressure signal for the caller (keep the data, retry).
+//
+// Messages are held and (re)sent in publish order. An unacknowledged message goes again
+// with DUP after retry_ms, and all of them after a reconnect (WS_MqttInflight_Requeue),
+// since the session is clean. MQTT 3.1.1 has the broker acknowledge QoS1 in order, so the
+// window is a FIFO; an out-of-order PUBACK is remembered until the older ones are in.
+//
+// PUBLISH -> PUBACK times of messages sent once (Karn: resent ones are ambiguous) give the
+// smoothed round trip (srtt_ms, weight 1/8 like TCP).
+//
+// No Arduino dependencies (the socket side is WS_MqttLink.h).
+
+#define WS_MQTT_INFLIGHT_MAX 16
+
+struct WS_MqttInflightMsg {
+  uint16_t pid;
+  bool retained;
+  bool acked;
+  bool due;                    // to be (re)sent
+  uint8_t sends;
+  uint8_t topic_len;
+  uint32_t off;                // arena offset of topic, then payload
+  uint32_t len;                // payload bytes
+  uint32_t t0_ms;              // caller's reference time (WS_MqttInflightAck::t0_ms)
+  uint32_t sent_ms;
+};
+
+struct WS_MqttInflightAck {
+  uint32_t t0_ms;
+  uint32_t rtt_ms;             // 0 if the message was resent
+};
+
+struct WS_MqttInflight {
+  uint8_t* arena = nullptr;
+  uint32_t cap = 0;
+  uint8_t window = 0;
+
+  WS_MqttInflightMsg msg[WS_MQTT_INFLIGHT_MAX];
+  uint8_t first = 0;
+  uint8_t count = 0;
+  uint16_t next_pid = 1;
+
+  bool building = false;       // WS_MqttInflight_Begin .. End
+  uint32_t build_left = 0;
+  uint32_t build_pos = 0;
+
+  uint32_t srtt_ms = 0;
+  uint32_t last_rtt_ms = 0;
+  uint32_t published = 0;
+  uint32_t acked = 0;
+  uint32_t resent = 0;
+  uint32_t refused = 0;        // window / arena full
+};
+
+void WS_MqttInflight_Init(WS_MqttInflight& q, uint8_t* arena, uint32_t cap, uint8_t window);
+
+// True if a message of this size can ever be held (else send it with QoS0).
+bool WS_MqttInflight_Fits(const WS_MqttInflight& q, size_t topicLen, uint32_t len);
+
+// Streamed add: Begin with the payload length, Write it, End. Begin fails if the window
+// or the arena is full; End drops a message whose payload came up short.
+bool WS_MqttInflight_Begin(WS_MqttInflight& q, const char* topic, uint32_t len, bool retained, uint32_t t0Ms);
+bool WS_MqttInflight_Write(WS_MqttInflight& q, const uint8_t* data, size_t n);
+bool WS_MqttInflight_End(WS_MqttInflight& q);
+bool WS_MqttInflight_Put(WS_MqttInflight& q, const char* topic, const uint8_t* data, size_t n, bool retained, uint32_t t0Ms);
+
+inline bool WS_MqttInflight_Full(const WS_MqttInflight& q) { return q.count >= q.window; }
+
+// Oldest message that needs sending at nowMs (new, requeued, or unacked for retryMs), or
+// nullptr. Call MarkSent after writing it.
+WS_MqttInflightMsg* WS_MqttInflight_NextDue(WS_MqttInflight& q, uint32_t nowMs, uint32_t retryMs);
+void WS_MqttInflight_MarkSent(WS_MqttInflight& q, WS_MqttInflightMsg& m, uint32_t nowMs);
+const char* WS_MqttInflight_Topic(const WS_MqttInflight& q, const WS_MqttInflightMsg& m);
+const uint8_t* WS_MqttInflight_Payload(const WS_MqttInflight& q, const WS_MqttInflightMsg& m);
+
+// PUBACK for pid; false if no such message is outstanding.
+bool WS_MqttInflight_Ack(WS_MqttInflight& q, uint16_t pid, uint32_t nowMs, WS_MqttInflightAck& out);
+
+// New connection: every unacknowledged message is sent again, oldest first.
+void WS_MqttInflight_Requeue(WS_MqttInflight& q);
+
+#endif
@@ -0,0 +1,437 @@
+#include "WS_MqttLink.h"
+
+#include <lwip/sockets.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+
+// DNS lookup state, written from the tcpip thread. One lookup at a time; a late answer to
+// an abandoned lookup is ignored by its generation.
+static char s_dnsHost[64];
+static volatile int8_t s_dnsState = -1;   // 1 done, 0 pending, -1 failed
+static volatile uint32_t s_dnsAddr = 0;
+static volatile uint32_t s_dnsGen = 0;
+
+static void DnsFound(const char* name, const ip_addr_t* ip, void* arg)
+{
+  (void)name;
+  if ((uint32_t)(uintptr_t)arg != s_dnsGen) {
+    return;
+  }
+  if (ip && IP_IS_V4(ip)) {
+    s_dnsAddr = ip_2_ip4(ip)->addr;
+    s_dnsState = 1;
+  } else {
+    s_dnsState = -1;
+  }
+}
+
+static void DnsStart(void* arg)
+{
+  ip_addr_t addr;
+  const err_t e = dns_gethostbyname(s_dnsHost, &addr, DnsFound, arg);
+  if (e == ERR_OK) {
+    DnsFound(s_dnsHost, &addr, arg);
+  } else if (e != ERR_INPROGRESS) {
+    DnsFound(s_dnsHost, nullptr, arg);
+  }
+}
+
+bool WS_MqttLink::Resolve(const char* host)
+{
+  IPAddress ip;
+  s_dnsGen++;
+  if (!host || host[0] == '\0' || strlen(host) >= sizeof(s_dnsHost)) {
+    s_dnsState = -1;
+    return false;
+  }
+  if (ip.fromString(host)) {
+    s_dnsAddr = (uint32_t)ip;
+    s_dnsState = 1;
+    return true;
+  }
+  strcpy(s_dnsHost, host);
+  s_dnsState = 0;
+  if (tcpip_callback(DnsStart, (void*)(uintptr_t)s_dnsGen) != ERR_OK) {
+    s_dnsState = -1;
+    return false;
+  }
+  return true;
+}
+
+int8_t WS_MqttLink::PollResolve(IPAddress& ip)
+{
+  const int8_t st = s_dnsState;
+  if (st == 1) {
+    ip = IPAddress((uint32_t)s_dnsAddr);
+  }
+  return st;
+}
+
+bool WS_MqttLink::Start(const IPAddress& ip, uint16_t port)
+{
+  stop();
+  const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) {
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+    close(fd);
+    return false;
+  }
+  fd_ = fd;
+  return true;
+}
+
+int8_t WS_MqttLink::Poll()
+{
+  if (fd_ < 0) {
+    return c_.connected() ? 1 : -1;
+  }
+  fd_set wr;
+  FD_ZERO(&wr);
+  FD_SET(fd_, &wr);
+  struct timeval tv = {0, 0};
+  const int r = select(fd_ + 1, nullptr, &wr, nullptr, &tv);
+  if (r == 0) {
+    return 0;
+  }
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (r < 0 || getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+    Abort();
+    return -1;
+  }
+  // Hand the socket over the way WiFiClient::connect() leaves it: blocking, no Nagle,
+  // keepalive on.
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) & ~O_NONBLOCK);
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(fd_, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+  c_ = WiFiClient(fd_);
+  fd_ = -1;
+  ResetSniffer();
+  return 1;
+}
+
+void WS_MqttLink::Abort()
+{
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool WS_MqttLink::PublishQos1(const char* topic, const uint8_t* payload, uint32_t len, uint16_t pid, bool retained, bool dup)
+{
+  const size_t tl = topic ? strlen(topic) : 0;
+  if (tl == 0 || tl > 255 || !c_.connected()) {
+    return false;
+  }
+  // Fixed header, topic and packet id in one write, the payload in a second one.
+  uint8_t head[5 + 2 + 255 + 2];
+  size_t h = 0;
+  head[h++] = (uint8_t)(0x32 | (dup ? 0x08 : 0x00) | (retained ? 0x01 : 0x00));
+  uint32_t rem = 2 + (uint32_t)tl + 2 + len;
+  do {
+    uint8_t d = (uint8_t)(rem % 128);
+    rem /= 128;
+    if (rem > 0) {
+      d |= 0x80;
+    }
+    head[h++] = d;
+  } while (rem > 0 && h < 5);
+  head[h++] = (uint8_t)(tl >> 8);
+  head[h++] = (uint8_t)tl;
+  memcpy(head + h, topic, tl);
+  h += tl;
+  head[h++] = (uint8_t)(pid >> 8);
+  head[h++] = (uint8_t)pid;
+  if (c_.write(head, h) != h) {
+    return false;
+  }
+  return len == 0 || c_.write(payload, len) == len;
+}
+
+// Appends a 2-byte length + bytes field; false if it doesn't fit.
+static bool PutField(uint8_t* buf, size_t cap, size_t& n, const char* s)
+{
+  const size_t l = strlen(s);
+  if (l > 0xFFFF || n + 2 + l > cap) {
+    return false;
+  }
+  buf[n++] = (uint8_t)(l >> 8);
+  buf[n++] = (uint8_t)l;
+  memcpy(buf + n, s, l);
+  n += l;
+  return true;
+}
+
+bool WS_MqttLink::SendConnect(const char* id, const char* user, const char* pass, const char* willTopic,
+                              uint8_t willQos, bool willRetain, const char* willMsg, uint16_t keepAliveS)
+{
+  if (!c_.connected() || !id) {
+    return false;
+  }
+  uint8_t body[512];
+  size_t n = 0;
+  static const uint8_t kProto[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};
+  memcpy(body, kProto, sizeof(kProto));
+  n = sizeof(kProto);
+  uint8_t flags = 0x02;   // clean session
+  if (willTopic && willMsg) {
+    flags |= (uint8_t)(0x04 | ((willQos & 0x03) << 3) | (willRetain ? 0x20 : 0x00));
+  }
+  if (user && user[0] != '\0') {
+    flags |= 0x80;
+    if (pass) {
+      flags |= 0x40;
+    }
+  }
+  body[n++] = flags;
+  body[n++] = (uint8_t)(keepAliveS >> 8);
+  body[n++] = (uint8_t)keepAliveS;
+  bool ok = PutField(body, sizeof(body), n, id);
+  if (ok && (flags & 0x04)) {
+    ok = PutField(body, sizeof(body), n, willTopic) && PutField(body, sizeof(body), n, willMsg);
+  }
+  if (ok && (flags & 0x80)) {
+    ok = PutField(body, sizeof(body), n, user);
+  }
+  if (ok && (flags & 0x40)) {
+    ok = PutField(body, sizeof(body), n, pass);
+  }
+  if (!ok) {
+    return false;
+  }
+  uint8_t head[5];
+  size_t h = 0;
+  head[h++] = 0x10;
+  uint32_t rem = (uint32_t)n;
+  do {
+    uint8_t d = (uint8_t)(rem % 128);
+    rem /= 128;
+    if (rem > 0) {
+      d |= 0x80;
+    }
+    head[h++] = d;
+  } while (rem > 0);
+  if (c_.write(head, h) != h || c_.write(body, n) != n) {
+    return false;
+  }
+  hs_ = 1;
+  held_len_ = 0;
+  held_pos_ = 0;
+  return true;
+}
+
+int8_t WS_MqttLink::PollConnack()
+{
+  if (hs_ == 2) {
+    return 1;
+  }
+  if (hs_ != 1 || !c_.connected()) {
+    return -1;
+  }
+  while (held_len_ < sizeof(held_) && c_.available() > 0) {
+    const int b = c_.read();
+    if (b < 0) {
+      break;
+    }
+    held_[held_len_++] = (uint8_t)b;
+  }
+  if (held_len_ < sizeof(held_)) {
+    return 0;
+  }
+  if (held_[0] != 0x20 || held_[1] != 0x02 || held_[3] != 0) {
+    hs_ = 0;
+    return -1;
+  }
+  hs_ = 2;
+  return 1;
+}
+
+bool WS_MqttLink::TakePuback(uint16_t& pid)
+{
+  if (ack_count_ == 0) {
+    return false;
+  }
+  pid = acks_[ack_head_];
+  ack_head_ = (uint8_t)((ack_head_ + 1) % (sizeof(acks_) / sizeof(acks_[0])));
+  ack_count_--;
+  return true;
+}
+
+void WS_MqttLink::ResetSniffer()
+{
+  hs_ = 0;
+  held_len_ = 0;
+  held_pos_ = 0;
+  in_state_ = 0;
+  in_pos_ = 0;
+  ack_head_ = 0;
+  ack_count_ = 0;
+}
+
+void WS_MqttLink::Sniff(const uint8_t* p, size_t n)
+{
+  const uint8_t cap = (uint8_t)(sizeof(acks_) / sizeof(acks_[0]));
+  for (size_t i = 0; i < n; i++) {
+    const uint8_t b = p[i];
+    switch (in_state_) {
+      case 0:
+        in_type_ = (uint8_t)(b >> 4);
+        in_left_ = 0;
+        in_mul_ = 1;
+        in_pos_ = 0;
+        in_state_ = 1;
+        break;
+      case 1:
+        in_left_ += (uint32_t)(b & 0x7F) * in_mul_;
+        in_mul_ *= 128;
+        if ((b & 0x80) == 0) {
+          in_state_ = (in_left_ > 0) ? 2 : 0;
+        } else if (in_mul_ > 128UL * 128UL * 128UL) {
+          in_state_ = 0;   // malformed; PubSubClient drops the connection anyway
+        }
+        break;
+      default:
+        if (in_type_ == 4 && in_pos_ < 2) {
+          in_id_[in_pos_++] = b;
+        }
+        if (--in_left_ == 0) {
+          if (in_type_ == 4 && in_pos_ == 2) {
+            if (ack_count_ == cap) {   // full: the oldest one is lost, its message is resent
+              ack_head_ = (uint8_t)((ack_head_ + 1) % cap);
+              ack_count_--;
+            }
+            acks_[(ack_head_ + ack_count_) % cap] = (uint16_t)((in_id_[0] << 8) | in_id_[1]);
+            ack_count_++;
+          }
+          in_state_ = 0;
+        }
+        break;
+    }
+  }
+}
+
+int WS_MqttLink::connect(IPAddress ip, uint16_t port)
+{
+  Abort();
+  ResetSniffer();
+  return c_.connect(ip, port);
+}
+
+int WS_MqttLink::connect(const char* host, uint16_t port)
+{
+  Abort();
+  ResetSniffer();
+  return c_.connect(host, port);
+}
+
+int WS_MqttLink::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+  Abort();
+  ResetSniffer();
+  return c_.connect(ip, port, timeout);
+}
+
+int WS_MqttLink::connect(const char* host, uint16_t port, int32_t timeout)
+{
+  Abort();
+  ResetSniffer();
+  return c_.connect(host, port, timeout);
+}
+
+size_t WS_MqttLink::write(uint8_t b)
+{
+  return c_.write(b);
+}
+
+size_t WS_MqttLink::write(const uint8_t* buf, size_t size)
+{
+  if (hs_ == 2 && size > 0 && (buf[0] & 0xF0) == 0x10) {
+    hs_ = 3;   // PubSubClient's CONNECT: ours is already answered
+    return size;
+  }
+  return c_.write(buf, size);
+}
+
+int WS_MqttLink::available()
+{
+  if (hs_ == 3) {
+    return (held_len_ - held_pos_) + c_.available();
+  }
+  return c_.available();
+}
+
+int WS_MqttLink::read()
+{
+  if (hs_ == 3) {
+    const int b = held_[held_pos_++];
+    if (held_pos_ >= held_len_) {
+      hs_ = 0;
+    }
+    return b;
+  }
+  const int r = c_.read();
+  if (r >= 0) {
+    const uint8_t b = (uint8_t)r;
+    Sniff(&b, 1);
+  }
+  return r;
+}
+
+int WS_MqttLink::read(uint8_t* buf, size_t size)
+{
+  if (hs_ == 3 && size > 0) {
+    size_t n = 0;
+    while (n < size && held_pos_ < held_len_) {
+      buf[n++] = held_[held_pos_++];
+    }
+    if (held_pos_ >= held_len_) {
+      hs_ = 0;
+    }
+    return (int)n;
+  }
+  const int n = c_.read(buf, size);
+  if (n > 0) {
+    Sniff(buf, (size_t)n);
+  }
+  return n;
+}
+
+int WS_MqttLink::peek()
+{
+  if (hs_ == 3) {
+    return held_[held_pos_];
+  }
+  return c_.peek();
+}
+
+void WS_MqttLink::flush()
+{
+  c_.flush();
+}
+
+void WS_MqttLink::stop()
+{
+  Abort();
+  c_.stop();
+  ResetSniffer();
+}
+
+uint8_t WS_MqttLink::connected()
+{
+  return c_.connected();
+}
+
+WS_MqttLink::operator bool()
+{
+  return connected() != 0;
+}
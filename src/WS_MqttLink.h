@@ -0,0 +1,83 @@
+#ifndef _WS_MQTT_LINK_H_
+#define _WS_MQTT_LINK_H_
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// Socket under PubSubClient (it takes any Client). Adds what the library lacks:
+// - Non-blocking connect, polled from the loop: Resolve() + PollResolve() (lwIP DNS in
+//   the tcpip thread), Start() + Poll() (TCP), SendConnect() + PollConnack() (MQTT).
+//   PubSubClient::connect() is only called once the CONNACK is here: it sees connected(),
+//   its own CONNECT is swallowed and the held CONNACK is read back, so it never waits.
+// - QoS1 PUBLISH: PubSubClient only sends QoS0, so PublishQos1() writes the packet itself.
+// - PUBACKs: PubSubClient reads and drops them; the inbound byte stream is followed here
+//   (MQTT fixed header + remaining length) and their packet ids are queued for TakePuback().
+// Single-threaded like the client: the loop task only.
+
+class WS_MqttLink : public Client {
+public:
+  // Starts connecting to ip:port; false if the socket could not be set up.
+  bool Start(const IPAddress& ip, uint16_t port);
+  // 1 connected, 0 still connecting, -1 failed (or not started).
+  int8_t Poll();
+  bool Connecting() const { return fd_ >= 0; }
+  void Abort();
+
+  // Host name or dotted IP; false if the lookup could not be started. One at a time.
+  bool Resolve(const char* host);
+  // 1 resolved (ip set), 0 pending, -1 failed.
+  int8_t PollResolve(IPAddress& ip);
+
+  // MQTT 3.1.1 CONNECT (clean session) on the connected socket; will/user/pass may be null.
+  bool SendConnect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos,
+                   bool willRetain, const char* willMsg, uint16_t keepAliveS);
+  // 1 accepted (the CONNACK is held for PubSubClient::connect()), 0 pending, -1 refused.
+  int8_t PollConnack();
+
+  bool PublishQos1(const char* topic, const uint8_t* payload, uint32_t len, uint16_t pid, bool retained, bool dup);
+  bool TakePuback(uint16_t& pid);
+
+  // Client
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char* host, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  int connect(const char* host, uint16_t port, int32_t timeout);
+  size_t write(uint8_t b);
+  size_t write(const uint8_t* buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t* buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool();
+
+private:
+  void Sniff(const uint8_t* p, size_t n);
+  void ResetSniffer();
+
+  WiFiClient c_;
+  int fd_ = -1;                // socket while connecting
+
+  // Handshake: 1 waiting for CONNACK, 2 CONNACK held (next CONNECT written is dropped),
+  // 3 handing the held CONNACK to PubSubClient.
+  uint8_t hs_ = 0;
+  uint8_t held_[4] = {0, 0, 0, 0};
+  uint8_t held_len_ = 0;
+  uint8_t held_pos_ = 0;
+
+  // Inbound packet framing
+  uint8_t in_state_ = 0;       // 0 fixed header, 1 remaining length, 2 body
+  uint8_t in_type_ = 0;
+  uint32_t in_left_ = 0;
+  uint32_t in_mul_ = 1;
+  uint8_t in_id_[2] = {0, 0};
+  uint8_t in_pos_ = 0;
+
+  uint16_t acks_[16] = {0};
+  uint8_t ack_head_ = 0;
+  uint8_t ack_count_ = 0;
+};
+
+#endif
@@ -0,0 +1,600 @@
+#include "WS_MsgPack.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Append only (ids are the index). Telemetry state, delta meta, RPC replies.
+const char* const WS_MsgPack_Keys[] = {
+  "sensor1", "sensor2", "sensors", "mm", "filt_mm", "valid", "online", "temp_x10",
+  "temp_valid", "id", "q", "poll_ms", "bus", "req", "retry", "to",
+  "crc", "hdr", "exc", "lat_ms", "gate_state", "gate_position_open", "auto_gate", "auto_latched",
+  "manual", "active", "remain_s", "total_s", "relay1", "relay2", "net", "wifi",
+  "mqtt", "http", "ip", "rssi", "ssid", "cell", "enabled", "sim_ready",
+  "attached", "csq", "rssi_dbm", "last_rx_age_s", "ctrl", "open_allowed", "close_allowed", "cooldown_remain_s",
+  "min_interval_s", "action_s", "reason", "alarm", "severity", "text", "fw", "current",
+  "latest", "last_check", "last_result", "seq", "kf", "delta", "ok", "req_id",
+  "cmd", "error", "raw", "name", "gen", "offset", "total", "len",
+  "eof", "enc", "data", "lines", "truncated", "mqtt_rtt_ms", "cmd_rtt_ms"
+};
+const uint8_t WS_MsgPack_KeyCount = (uint8_t)(sizeof(WS_MsgPack_Keys) / sizeof(WS_MsgPack_Keys[0]));
+
+int WS_MsgPack_KeyId(const char* key, size_t len)
+{
+  for (uint8_t i = 0; i < WS_MsgPack_KeyCount; i++) {
+    const char* k = WS_MsgPack_Keys[i];
+    if (len > 0 && k[0] == key[0] && strncmp(k, key, len) == 0 && k[len] == '\0') {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+// ---------------- JSON -> MessagePack ----------------
+struct WS_MpEnc {
+  const char* s;
+  size_t len;
+  size_t pos;
+  uint8_t* out;
+  size_t cap;
+  size_t n;
+};
+
+static bool Put(WS_MpEnc& e, uint8_t b)
+{
+  if (e.n >= e.cap) {
+    return false;
+  }
+  e.out[e.n++] = b;
+  return true;
+}
+
+static bool PutBE(WS_MpEnc& e, uint8_t type, uint64_t v, uint8_t bytes)
+{
+  if (e.n + 1 + bytes > e.cap) {
+    return false;
+  }
+  e.out[e.n++] = type;
+  for (int i = bytes - 1; i >= 0; i--) {
+    e.out[e.n++] = (uint8_t)(v >> (8 * i));
+  }
+  return true;
+}
+
+static void SkipWs(WS_MpEnc& e)
+{
+  while (e.pos < e.len && (e.s[e.pos] == ' ' || e.s[e.pos] == '\t' || e.s[e.pos] == '\r' || e.s[e.pos] == '\n')) {
+    e.pos++;
+  }
+}
+
+static int HexVal(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool Hex4(const char* s, size_t len, size_t pos, uint32_t& v)
+{
+  if (pos + 4 > len) {
+    return false;
+  }
+  v = 0;
+  for (size_t i = 0; i < 4; i++) {
+    const int h = HexVal(s[pos + i]);
+    if (h < 0) {
+      return false;
+    }
+    v = (v << 4) | (uint32_t)h;
+  }
+  return true;
+}
+
+// Decodes the JSON string starting after the opening quote; leaves pos after the closing
+// quote. dst == nullptr only measures. Returns false on a malformed string.
+static bool ScanString(const char* s, size_t len, size_t& pos, uint8_t* dst, size_t& outLen)
+{
+  outLen = 0;
+  while (pos < len) {
+    const char c = s[pos++];
+    if (c == '"') {
+      return true;
+    }
+    if ((uint8_t)c < 0x20) {
+      return false;
+    }
+    if (c != '\\') {
+      if (dst) dst[outLen] = (uint8_t)c;
+      outLen++;
+      continue;
+    }
+    if (pos >= len) {
+      return false;
+    }
+    const char x = s[pos++];
+    char lit = 0;
+    switch (x) {
+      case '"': lit = '"'; break;
+      case '\\': lit = '\\'; break;
+      case '/': lit = '/'; break;
+      case 'b': lit = '\b'; break;
+      case 'f': lit = '\f'; break;
+      case 'n': lit = '\n'; break;
+      case 'r': lit = '\r'; break;
+      case 't': lit = '\t'; break;
+      case 'u': break;
+      default: return false;
+    }
+    if (lit) {
+      if (dst) dst[outLen] = (uint8_t)lit;
+      outLen++;
+      continue;
+    }
+    uint32_t cp = 0;
+    if (!Hex4(s, len, pos, cp)) {
+      return false;
+    }
+    pos += 4;
+    if (cp >= 0xD800 && cp <= 0xDBFF) {
+      uint32_t lo = 0;
+      if (pos + 1 < len && s[pos] == '\\' && s[pos + 1] == 'u' && Hex4(s, len, pos + 2, lo) && lo >= 0xDC00 && lo <= 0xDFFF) {
+        pos += 6;
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+      } else {
+        cp = 0xFFFD;
+      }
+    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+      cp = 0xFFFD;
+    }
+    uint8_t u[4];
+    size_t un;
+    if (cp < 0x80) {
+      u[0] = (uint8_t)cp;
+      un = 1;
+    } else if (cp < 0x800) {
+      u[0] = (uint8_t)(0xC0 | (cp >> 6));
+      u[1] = (uint8_t)(0x80 | (cp & 0x3F));
+      un = 2;
+    } else if (cp < 0x10000) {
+      u[0] = (uint8_t)(0xE0 | (cp >> 12));
+      u[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+      u[2] = (uint8_t)(0x80 | (cp & 0x3F));
+      un = 3;
+    } else {
+      u[0] = (uint8_t)(0xF0 | (cp >> 18));
+      u[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+      u[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+      u[3] = (uint8_t)(0x80 | (cp & 0x3F));
+      un = 4;
+    }
+    if (dst) memcpy(dst + outLen, u, un);
+    outLen += un;
+  }
+  return false;
+}
+
+static bool EncString(WS_MpEnc& e, bool isKey)
+{
+  const size_t start = ++e.pos;   // after the quote
+  size_t n = 0;
+  if (!ScanString(e.s, e.len, e.pos, nullptr, n)) {
+    return false;
+  }
+  if (isKey && n <= 32) {
+    uint8_t key[32];
+    size_t p = start;
+    (void)ScanString(e.s, e.len, p, key, n);
+    const int id = WS_MsgPack_KeyId((const char*)key, n);
+    if (id >= 0) {
+      return Put(e, (uint8_t)id);
+    }
+  }
+  bool ok;
+  if (n < 32) {
+    ok = Put(e, (uint8_t)(0xA0 | n));
+  } else if (n <= 0xFF) {
+    ok = PutBE(e, 0xD9, n, 1);
+  } else if (n <= 0xFFFF) {
+    ok = PutBE(e, 0xDA, n, 2);
+  } else {
+    ok = PutBE(e, 0xDB, n, 4);
+  }
+  if (!ok || e.n + n > e.cap) {
+    return false;
+  }
+  size_t p = start;
+  (void)ScanString(e.s, e.len, p, e.out + e.n, n);
+  e.n += n;
+  return true;
+}
+
+static bool EncUint(WS_MpEnc& e, uint64_t v)
+{
+  if (v <= 0x7F) return Put(e, (uint8_t)v);
+  if (v <= 0xFF) return PutBE(e, 0xCC, v, 1);
+  if (v <= 0xFFFF) return PutBE(e, 0xCD, v, 2);
+  if (v <= 0xFFFFFFFFULL) return PutBE(e, 0xCE, v, 4);
+  return PutBE(e, 0xCF, v, 8);
+}
+
+static bool EncInt(WS_MpEnc& e, int64_t v)
+{
+  if (v >= 0) return EncUint(e, (uint64_t)v);
+  if (v >= -32) return Put(e, (uint8_t)(0xE0 | (v + 32)));
+  if (v >= -128) return PutBE(e, 0xD0, (uint64_t)v, 1);
+  if (v >= -32768) return PutBE(e, 0xD1, (uint64_t)v, 2);
+  if (v >= -2147483648LL) return PutBE(e, 0xD2, (uint64_t)v, 4);
+  return PutBE(e, 0xD3, (uint64_t)v, 8);
+}
+
+static bool EncNumber(WS_MpEnc& e)
+{
+  const size_t start = e.pos;
+  const bool neg = (e.s[e.pos] == '-');
+  if (neg) e.pos++;
+  const size_t digits = e.pos;
+  uint64_t mag = 0;
+  bool overflow = false;
+  while (e.pos < e.len && e.s[e.pos] >= '0' && e.s[e.pos] <= '9') {
+    const uint64_t d = (uint64_t)(e.s[e.pos] - '0');
+    if (mag > (UINT64_MAX - d) / 10) overflow = true;
+    mag = mag * 10 + d;
+    e.pos++;
+  }
+  if (e.pos == digits) {
+    return false;
+  }
+  bool integral = true;
+  if (e.pos < e.len && e.s[e.pos] == '.') {
+    integral = false;
+    e.pos++;
+    while (e.pos < e.len && e.s[e.pos] >= '0' && e.s[e.pos] <= '9') e.pos++;
+  }
+  if (e.pos < e.len && (e.s[e.pos] == 'e' || e.s[e.pos] == 'E')) {
+    integral = false;
+    e.pos++;
+    if (e.pos < e.len && (e.s[e.pos] == '+' || e.s[e.pos] == '-')) e.pos++;
+    while (e.pos < e.len && e.s[e.pos] >= '0' && e.s[e.pos] <= '9') e.pos++;
+  }
+  if (integral && !overflow) {
+    if (!neg) return EncUint(e, mag);
+    if (mag <= (uint64_t)INT64_MAX) return EncInt(e, -(int64_t)mag);
+    if (mag == (uint64_t)INT64_MAX + 1) return EncInt(e, INT64_MIN);
+  }
+  char tmp[64];
+  const size_t n = e.pos - start;
+  if (n >= sizeof(tmp)) {
+    return false;
+  }
+  memcpy(tmp, e.s + start, n);
+  tmp[n] = '\0';
+  const double d = strtod(tmp, nullptr);
+  const float f = (float)d;
+  if ((double)f == d) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return PutBE(e, 0xCA, bits, 4);
+  }
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  return PutBE(e, 0xCB, bits, 8);
+}
+
+static bool EncLiteral(WS_MpEnc& e, const char* word, uint8_t code)
+{
+  const size_t n = strlen(word);
+  if (e.pos + n > e.len || memcmp(e.s + e.pos, word, n) != 0) {
+    return false;
+  }
+  e.pos += n;
+  return Put(e, code);
+}
+
+static bool EncValue(WS_MpEnc& e, uint8_t depth);
+
+// Containers get a 1-byte header first; one with 16+ entries is widened afterwards.
+static bool EncContainer(WS_MpEnc& e, uint8_t depth, bool isMap)
+{
+  const char close = isMap ? '}' : ']';
+  const size_t h = e.n;
+  if (!Put(e, 0)) {
+    return false;
+  }
+  e.pos++;
+  uint32_t count = 0;
+  SkipWs(e);
+  if (e.pos < e.len && e.s[e.pos] == close) {
+    e.pos++;
+  } else {
+    while (true) {
+      SkipWs(e);
+      if (isMap) {
+        if (e.pos >= e.len || e.s[e.pos] != '"' || !EncString(e, true)) {
+          return false;
+        }
+        SkipWs(e);
+        if (e.pos >= e.len || e.s[e.pos] != ':') {
+          return false;
+        }
+        e.pos++;
+        SkipWs(e);
+      }
+      if (!EncValue(e, depth + 1)) {
+        return false;
+      }
+      count++;
+      SkipWs(e);
+      if (e.pos < e.len && e.s[e.pos] == ',') {
+        e.pos++;
+        continue;
+      }
+      if (e.pos < e.len && e.s[e.pos] == close) {
+        e.pos++;
+        break;
+      }
+      return false;
+    }
+  }
+  if (count <= 15) {
+    e.out[h] = (uint8_t)((isMap ? 0x80 : 0x90) | count);
+    return true;
+  }
+  const uint8_t extra = (count <= 0xFFFF) ? 2 : 4;
+  if (e.n + extra > e.cap) {
+    return false;
+  }
+  memmove(e.out + h + 1 + extra, e.out + h + 1, e.n - h - 1);
+  e.n += extra;
+  e.out[h] = (extra == 2) ? (isMap ? 0xDE : 0xDC) : (isMap ? 0xDF : 0xDD);
+  for (uint8_t i = 0; i < extra; i++) {
+    e.out[h + 1 + i] = (uint8_t)(count >> (8 * (extra - 1 - i)));
+  }
+  return true;
+}
+
+static bool EncValue(WS_MpEnc& e, uint8_t depth)
+{
+  if (depth > WS_MSGPACK_MAX_DEPTH) {
+    return false;
+  }
+  SkipWs(e);
+  if (e.pos >= e.len) {
+    return false;
+  }
+  const char c = e.s[e.pos];
+  if (c == '{') return EncContainer(e, depth, true);
+  if (c == '[') return EncContainer(e, depth, false);
+  if (c == '"') return EncString(e, false);
+  if (c == 't') return EncLiteral(e, "true", 0xC3);
+  if (c == 'f') return EncLiteral(e, "false", 0xC2);
+  if (c == 'n') return EncLiteral(e, "null", 0xC0);
+  if (c == '-' || (c >= '0' && c <= '9')) return EncNumber(e);
+  return false;
+}
+
+size_t WS_MsgPack_FromJson(const char* json, size_t len, uint8_t* out, size_t cap)
+{
+  if (!json || !out) {
+    return 0;
+  }
+  WS_MpEnc e = {json, len, 0, out, cap, 0};
+  if (!EncValue(e, 0)) {
+    return 0;
+  }
+  SkipWs(e);
+  return (e.pos == e.len) ? e.n : 0;
+}
+
+// ---------------- MessagePack -> JSON ----------------
+struct WS_MpDec {
+  const uint8_t* p;
+  size_t len;
+  size_t pos;
+  char* out;
+  size_t cap;
+  size_t n;
+};
+
+static bool Emit(WS_MpDec& d, const char* s, size_t n)
+{
+  if (d.n + n >= d.cap) {   // keep room for the terminator
+    return false;
+  }
+  memcpy(d.out + d.n, s, n);
+  d.n += n;
+  return true;
+}
+
+static bool EmitStr(WS_MpDec& d, const char* s)
+{
+  return Emit(d, s, strlen(s));
+}
+
+static bool GetBE(WS_MpDec& d, uint8_t bytes, uint64_t& v)
+{
+  if (d.pos + bytes > d.len) {
+    return false;
+  }
+  v = 0;
+  for (uint8_t i = 0; i < bytes; i++) {
+    v = (v << 8) | d.p[d.pos++];
+  }
+  return true;
+}
+
+static bool EmitEscaped(WS_MpDec& d, const uint8_t* s, size_t n)
+{
+  if (!Emit(d, "\"", 1)) {
+    return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    const uint8_t c = s[i];
+    char esc[8];
+    const char* r = nullptr;
+    switch (c) {
+      case '"': r = "\\\""; break;
+      case '\\': r = "\\\\"; break;
+      case '\n': r = "\\n"; break;
+      case '\r': r = "\\r"; break;
+      case '\t': r = "\\t"; break;
+      case '\b': r = "\\b"; break;
+      case '\f': r = "\\f"; break;
+      default:
+        if (c < 0x20) {
+          snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)c);
+          r = esc;
+        }
+        break;
+    }
+    if (r ? !EmitStr(d, r) : !Emit(d, (const char*)&s[i], 1)) {
+      return false;
+    }
+  }
+  return Emit(d, "\"", 1);
+}
+
+// Shortest text that reads back as the same value.
+static bool EmitDouble(WS_MpDec& d, double v, bool single)
+{
+  if (!isfinite(v)) {
+    return EmitStr(d, "null");
+  }
+  char tmp[40];
+  for (int prec = single ? 6 : 15; prec <= 17; prec++) {
+    snprintf(tmp, sizeof(tmp), "%.*g", prec, v);
+    const double back = strtod(tmp, nullptr);
+    if (single ? ((float)back == (float)v) : (back == v)) {
+      break;
+    }
+  }
+  return EmitStr(d, tmp);
+}
+
+static bool DecValue(WS_MpDec& d, uint8_t depth, bool isKey);
+
+static bool DecContainer(WS_MpDec& d, uint8_t depth, uint32_t count, bool isMap)
+{
+  if (!Emit(d, isMap ? "{" : "[", 1)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (i > 0 && !Emit(d, ",", 1)) {
+      return false;
+    }
+    if (isMap) {
+      if (!DecValue(d, depth + 1, true) || !Emit(d, ":", 1)) {
+        return false;
+      }
+    }
+    if (!DecValue(d, depth + 1, false)) {
+      return false;
+    }
+  }
+  return Emit(d, isMap ? "}" : "]", 1);
+}
+
+static bool DecValue(WS_MpDec& d, uint8_t depth, bool isKey)
+{
+  if (depth > WS_MSGPACK_MAX_DEPTH || d.pos >= d.len) {
+    return false;
+  }
+  const uint8_t t = d.p[d.pos++];
+  char tmp[32];
+  uint64_t v = 0;
+
+  // Integers: in key position they are dictionary ids.
+  bool isUint = false;
+  bool isInt = false;
+  if (t <= 0x7F) {
+    v = t;
+    isUint = true;
+  } else if (t >= 0xE0) {
+    v = (uint64_t)(int64_t)(int8_t)t;
+    isInt = true;
+  } else if (t >= 0xCC && t <= 0xCF) {
+    if (!GetBE(d, (uint8_t)(1u << (t - 0xCC)), v)) return false;
+    isUint = true;
+  } else if (t >= 0xD0 && t <= 0xD3) {
+    const uint8_t bytes = (uint8_t)(1u << (t - 0xD0));
+    if (!GetBE(d, bytes, v)) return false;
+    if (bytes < 8) {
+      const uint8_t shift = (uint8_t)(64 - 8 * bytes);
+      v = (uint64_t)((int64_t)(v << shift) >> shift);
+    }
+    isInt = true;
+  }
+  if (isUint || isInt) {
+    if (isKey && isUint) {
+      if (v < WS_MsgPack_KeyCount) {
+        return Emit(d, "\"", 1) && EmitStr(d, WS_MsgPack_Keys[v]) && Emit(d, "\"", 1);
+      }
+      snprintf(tmp, sizeof(tmp), "\"#%llu\"", (unsigned long long)v);
+      return EmitStr(d, tmp);
+    }
+    if (isUint) {
+      snprintf(tmp, sizeof(tmp), isKey ? "\"%llu\"" : "%llu", (unsigned long long)v);
+    } else {
+      snprintf(tmp, sizeof(tmp), isKey ? "\"%lld\"" : "%lld", (long long)(int64_t)v);
+    }
+    return EmitStr(d, tmp);
+  }
+
+  size_t n = 0;
+  if ((t & 0xE0) == 0xA0) {
+    n = t & 0x1F;
+  } else if (t >= 0xD9 && t <= 0xDB) {
+    if (!GetBE(d, (uint8_t)(1u << (t - 0xD9)), v)) return false;
+    n = (size_t)v;
+  } else if (isKey) {
+    return false;   // keys are ids or strings
+  } else if ((t & 0xF0) == 0x80) {
+    return DecContainer(d, depth, t & 0x0F, true);
+  } else if ((t & 0xF0) == 0x90) {
+    return DecContainer(d, depth, t & 0x0F, false);
+  } else if (t == 0xDC || t == 0xDD || t == 0xDE || t == 0xDF) {
+    if (!GetBE(d, (t == 0xDC || t == 0xDE) ? 2 : 4, v)) return false;
+    return DecContainer(d, depth, (uint32_t)v, t >= 0xDE);
+  } else if (t == 0xC0) {
+    return EmitStr(d, "null");
+  } else if (t == 0xC2) {
+    return EmitStr(d, "false");
+  } else if (t == 0xC3) {
+    return EmitStr(d, "true");
+  } else if (t == 0xCA) {
+    if (!GetBE(d, 4, v)) return false;
+    const uint32_t bits = (uint32_t)v;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return EmitDouble(d, (double)f, true);
+  } else if (t == 0xCB) {
+    if (!GetBE(d, 8, v)) return false;
+    double x;
+    memcpy(&x, &v, sizeof(x));
+    return EmitDouble(d, x, false);
+  } else {
+    return false;   // bin / ext are never produced
+  }
+  if (d.pos + n > d.len) {
+    return false;
+  }
+  const uint8_t* s = d.p + d.pos;
+  d.pos += n;
+  return EmitEscaped(d, s, n);
+}
+
+size_t WS_MsgPack_ToJson(const uint8_t* in, size_t len, char* out, size_t cap)
+{
+  if (!in || !out || cap == 0) {
+    return 0;
+  }
+  WS_MpDec d = {in, len, 0, out, cap, 0};
+  if (!DecValue(d, 0, false) || d.pos != d.len) {
+    out[0] = '\0';
+    return 0;
+  }
+  out[d.n] = '\0';
+  return d.n;
+}
@@ -0,0 +1,34 @@
+#ifndef _WS_MSGPACK_H_
+#define _WS_MSGPACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// JSON text <-> MessagePack transcoder for the binary MQTT encoding (no Arduino
+// dependencies, builds on the host as well; server port: server/src/msgpack.js).
+//
+// Plain MessagePack, with one schema rule: an object key listed in WS_MsgPack_Keys is
+// written as its index (positive fixint) instead of a string. Keys not in the table
+// stay strings, so the table only affects size, never what can be sent.
+//
+// The table is shared by the firmware, the host tools (scripts/msgpack_bench) and the
+// server. Entries may only be appended: a reader with an older table shows unknown ids
+// as "#<id>" keys.
+
+#define WS_MSGPACK_MAX_DEPTH  16
+
+extern const char* const WS_MsgPack_Keys[];
+extern const uint8_t WS_MsgPack_KeyCount;
+
+int WS_MsgPack_KeyId(const char* key, size_t len);   // -1 if not in the table
+
+// JSON text (one value, no trailing data) -> MessagePack. Integers keep their exact
+// value (int/uint up to 64 bit), other numbers become float32 when that is exact,
+// else float64. Returns the encoded size, 0 if the JSON is invalid or cap is too small.
+size_t WS_MsgPack_FromJson(const char* json, size_t len, uint8_t* out, size_t cap);
+
+// MessagePack (as produced above) -> compact JSON text, NUL terminated. Returns the
+// text length, 0 on malformed input or if cap is too small.
+size_t WS_MsgPack_ToJson(const uint8_t* in, size_t len, char* out, size_t cap);
+
+#endif
@@ -0,0 +1,479 @@
+#include "WS_Outbox.h"
+#include "WS_Bytes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const uint8_t kRecMagic = 'O';
+static const uint8_t kCurMagic[4] = {'W', 'S', 'O', 'C'};
+
+static uint32_t RecordBytes(uint8_t topicLen, uint32_t len)
+{
+  return WS_OUTBOX_HEADER_BYTES + topicLen + len + 4;
+}
+
+// ---- Cursor ----
+
+// Ring slot of the segment with sequence number seq, or -1.
+static int FindSegment(const WS_LogRing& r, uint32_t seq)
+{
+  for (uint8_t i = 0; i < r.segments; i++) {
+    if (r.seq[i] != 0 && r.seq[i] == seq) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Points the cursor at an existing segment: the oldest one if its segment was recycled
+// (counted as lost when it still had unsent records) or is unknown.
+static int ResolveCursor(WS_Outbox& o)
+{
+  const WS_LogRing& r = o.ring;
+  const int slot = FindSegment(r, o.rd_seq);
+  if (slot >= 0) {
+    return slot;
+  }
+  uint8_t order[WS_LOGRING_MAX_SEGMENTS];
+  const uint8_t cnt = WS_LogRing_Order(r, order);
+  if (cnt == 0) {
+    return -1;
+  }
+  const uint32_t oldest = r.seq[order[0]];
+  if (o.rd_seq != 0 && o.rd_seq < oldest) {
+    o.stats.lost_segments += oldest - o.rd_seq;
+  }
+  o.rd_seq = oldest;
+  o.rd_off = 0;
+  o.cur_dirty = true;
+  return order[0];
+}
+
+// Moves past the end of a finished segment; false if the cursor is at the end of the head.
+static bool NextSegmentIfDone(WS_Outbox& o, int& slot)
+{
+  const WS_LogRing& r = o.ring;
+  while (o.rd_off >= r.size[slot]) {
+    if (slot == r.head) {
+      return false;
+    }
+    const int next = FindSegment(r, o.rd_seq + 1);
+    if (next < 0) {
+      return false;
+    }
+    o.rd_seq++;
+    o.rd_off = 0;
+    o.cur_dirty = true;
+    slot = next;
+  }
+  return true;
+}
+
+static bool LoadCursor(WS_Outbox& o)
+{
+  if (!LittleFS.exists(o.cur_path)) {
+    return false;
+  }
+  File f = LittleFS.open(o.cur_path, "r");
+  if (!f) {
+    return false;
+  }
+  uint8_t b[16];
+  const size_t n = f.read(b, sizeof(b));
+  f.close();
+  if (n != sizeof(b) || memcmp(b, kCurMagic, sizeof(kCurMagic)) != 0 || WS_GetU32(b + 12) != WS_Crc32(0, b, 12)) {
+    return false;
+  }
+  o.rd_seq = WS_GetU32(b + 4);
+  o.rd_off = WS_GetU32(b + 8);
+  return true;
+}
+
+static void SaveCursor(WS_Outbox& o, uint32_t nowMs)
+{
+  uint8_t b[16];
+  memcpy(b, kCurMagic, sizeof(kCurMagic));
+  WS_PutU32(b + 4, o.rd_seq);
+  WS_PutU32(b + 8, o.rd_off);
+  WS_PutU32(b + 12, WS_Crc32(0, b, 12));
+  File f = LittleFS.open(o.cur_path, "w");
+  if (!f) {
+    return;
+  }
+  f.write(b, sizeof(b));
+  f.close();
+  o.cur_dirty = false;
+  o.cur_saved_ms = nowMs;
+}
+
+// ---- Reading ----
+
+struct WS_OutboxRec {
+  int slot;
+  uint32_t off;                 // record start in the segment
+  uint8_t flags;
+  uint8_t topic_len;
+  uint32_t len;
+  char topic[WS_OUTBOX_TOPIC_MAX + 1];
+};
+
+// Framing only: the header is sane and the record lies inside the segment.
+static bool ReadHeader(File& f, uint32_t segSize, uint32_t off, WS_OutboxRec& rec)
+{
+  uint8_t h[WS_OUTBOX_HEADER_BYTES];
+  if (segSize - off < sizeof(h) || !f.seek(WS_LOGRING_HEADER_BYTES + off, SeekSet) || f.read(h, sizeof(h)) != sizeof(h)) {
+    return false;
+  }
+  rec.off = off;
+  rec.flags = h[1];
+  rec.topic_len = h[2];
+  rec.len = WS_GetU32(h + 4);
+  if (h[0] != kRecMagic || h[3] != 0 || rec.topic_len == 0 || rec.topic_len > WS_OUTBOX_TOPIC_MAX ||
+      rec.len > segSize || RecordBytes(rec.topic_len, rec.len) > segSize - off) {
+    return false;
+  }
+  return true;
+}
+
+// Reads the topic and checks the CRC over the whole record.
+static bool VerifyRecord(File& f, WS_OutboxRec& rec)
+{
+  uint8_t buf[128];
+  if (!f.seek(WS_LOGRING_HEADER_BYTES + rec.off, SeekSet)) {
+    return false;
+  }
+  uint32_t crc = 0;
+  uint32_t left = WS_OUTBOX_HEADER_BYTES + rec.topic_len + rec.len;
+  uint32_t pos = 0;
+  while (left > 0) {
+    const size_t want = (left < sizeof(buf)) ? left : sizeof(buf);
+    if (f.read(buf, want) != want) {
+      return false;
+    }
+    // The topic starts right after the header; copy whatever part of it this chunk holds.
+    for (size_t i = 0; i < want; i++) {
+      const uint32_t at = pos + (uint32_t)i;
+      if (at >= WS_OUTBOX_HEADER_BYTES && at < (uint32_t)WS_OUTBOX_HEADER_BYTES + rec.topic_len) {
+        rec.topic[at - WS_OUTBOX_HEADER_BYTES] = (char)buf[i];
+      }
+    }
+    crc = WS_Crc32(crc, buf, want);
+    pos += (uint32_t)want;
+    left -= (uint32_t)want;
+  }
+  rec.topic[rec.topic_len] = '\0';
+  uint8_t t[4];
+  return f.read(t, sizeof(t)) == sizeof(t) && WS_GetU32(t) == crc;
+}
+
+// Next intact record at the cursor; damaged ones are skipped (a bad header loses the rest
+// of its segment, since the next record can't be located).
+static bool NextRecord(WS_Outbox& o, WS_OutboxRec& rec, File& f)
+{
+  int slot = ResolveCursor(o);
+  if (slot < 0) {
+    return false;
+  }
+  while (NextSegmentIfDone(o, slot)) {
+    f = WS_LogRing_OpenSegment(o.ring, (uint8_t)slot);
+    if (!f) {
+      return false;
+    }
+    const uint32_t segSize = o.ring.size[slot];
+    if (!ReadHeader(f, segSize, o.rd_off, rec)) {
+      f.close();
+      o.stats.corrupt++;
+      o.rd_off = segSize;
+      o.cur_dirty = true;
+      continue;
+    }
+    if (!VerifyRecord(f, rec)) {
+      f.close();
+      o.stats.corrupt++;
+      o.rd_off += RecordBytes(rec.topic_len, rec.len);
+      o.cur_dirty = true;
+      continue;
+    }
+    rec.slot = slot;
+    return true;
+  }
+  return false;
+}
+
+static bool PublishRecord(File& f, const WS_OutboxRec& rec, const WS_OutboxPublisher& pub)
+{
+  if (!f.seek(WS_LOGRING_HEADER_BYTES + rec.off + WS_OUTBOX_HEADER_BYTES + rec.topic_len, SeekSet)) {
+    return false;
+  }
+  if (!pub.begin(pub.ctx, rec.topic, rec.len, (rec.flags & WS_OUTBOX_F_RETAINED) != 0)) {
+    return false;
+  }
+  uint8_t buf[256];
+  uint32_t left = rec.len;
+  while (left > 0) {
+    const size_t want = (left < sizeof(buf)) ? left : sizeof(buf);
+    if (f.read(buf, want) != want || !pub.write(pub.ctx, buf, want)) {
+      pub.end(pub.ctx);
+      return false;
+    }
+    left -= (uint32_t)want;
+  }
+  return pub.end(pub.ctx);
+}
+
+// ---- Open / append ----
+
+// End of the last well-framed record of the head segment (CRCs are checked on replay).
+static uint32_t HeadValidEnd(const WS_Outbox& o)
+{
+  const WS_LogRing& r = o.ring;
+  const uint32_t segSize = r.size[r.head];
+  if (segSize == 0) {
+    return 0;
+  }
+  File f = WS_LogRing_OpenSegment(r, r.head);
+  if (!f) {
+    return 0;
+  }
+  uint32_t off = 0;
+  WS_OutboxRec rec;
+  while (off < segSize && ReadHeader(f, segSize, off, rec)) {
+    off += RecordBytes(rec.topic_len, rec.len);
+  }
+  f.close();
+  return off;
+}
+
+bool WS_Outbox_Open(WS_Outbox& o, const char* base, uint8_t segments, uint32_t segBytes)
+{
+  WS_Outbox_Close(o);
+  snprintf(o.cur_path, sizeof(o.cur_path), "%s.cur", base);
+  if (!WS_LogRing_Open(o.ring, base, segments, segBytes, 0)) {
+    return false;
+  }
+  if (!LoadCursor(o)) {
+    o.rd_seq = 0;
+    o.rd_off = 0;
+  }
+  o.cur_dirty = false;
+  ResolveCursor(o);
+  // Appending behind a torn record would hide everything after it from the reader.
+  const uint32_t end = HeadValidEnd(o);
+  if (end != o.ring.size[o.ring.head]) {
+    WS_LogRing_NextSegment(o.ring);
+  }
+  return o.ring.ready;
+}
+
+void WS_Outbox_Close(WS_Outbox& o)
+{
+  if (o.ring.ready && o.cur_dirty) {
+    SaveCursor(o, o.cur_saved_ms);
+  }
+  WS_LogRing_Close(o.ring);
+  o.writing = false;
+  o.stage_len = 0;
+}
+
+static bool FlushStage(WS_Outbox& o)
+{
+  if (o.stage_len == 0) {
+    return true;
+  }
+  const size_t n = WS_LogRing_Append(o.ring, o.stage, o.stage_len, 0);
+  const bool ok = (n == o.stage_len);
+  o.stage_len = 0;
+  return ok;
+}
+
+static bool Stage(WS_Outbox& o, const uint8_t* data, size_t n)
+{
+  while (n > 0) {
+    size_t m = sizeof(o.stage) - o.stage_len;
+    if (m > n) {
+      m = n;
+    }
+    memcpy(o.stage + o.stage_len, data, m);
+    o.stage_len += m;
+    data += m;
+    n -= m;
+    if (o.stage_len == sizeof(o.stage) && !FlushStage(o)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WS_Outbox_Begin(WS_Outbox& o, const char* topic, uint32_t len, uint8_t flags)
+{
+  const size_t tl = topic ? strlen(topic) : 0;
+  if (!o.ring.ready || o.writing || tl == 0 || tl > WS_OUTBOX_TOPIC_MAX ||
+      len > o.ring.seg_bytes || RecordBytes((uint8_t)tl, len) > o.ring.seg_bytes) {
+    o.stats.rejected++;
+    return false;
+  }
+  // Whole record in one segment: switch now, so the staged pieces never straddle two.
+  WS_LogRing& r = o.ring;
+  if (r.size[r.head] > 0 && r.size[r.head] + RecordBytes((uint8_t)tl, len) > r.seg_bytes) {
+    if (!WS_LogRing_NextSegment(r)) {
+      o.stats.rejected++;
+      return false;
+    }
+  }
+  uint8_t h[WS_OUTBOX_HEADER_BYTES];
+  h[0] = kRecMagic;
+  h[1] = flags;
+  h[2] = (uint8_t)tl;
+  h[3] = 0;
+  WS_PutU32(h + 4, len);
+  o.writing = true;
+  o.wr_left = len;
+  o.stage_len = 0;
+  o.wr_crc = WS_Crc32(0, h, sizeof(h));
+  o.wr_crc = WS_Crc32(o.wr_crc, (const uint8_t*)topic, tl);
+  return Stage(o, h, sizeof(h)) && Stage(o, (const uint8_t*)topic, tl);
+}
+
+bool WS_Outbox_Write(WS_Outbox& o, const uint8_t* data, size_t n)
+{
+  if (!o.writing || n > o.wr_left) {
+    return false;
+  }
+  o.wr_crc = WS_Crc32(o.wr_crc, data, n);
+  o.wr_left -= (uint32_t)n;
+  return Stage(o, data, n);
+}
+
+// A short record is left without its CRC; the reader drops it, and the next append goes
+// after it in the same segment as usual.
+bool WS_Outbox_End(WS_Outbox& o)
+{
+  if (!o.writing) {
+    return false;
+  }
+  o.writing = false;
+  bool ok = (o.wr_left == 0);
+  if (ok) {
+    uint8_t t[4];
+    WS_PutU32(t, o.wr_crc);
+    ok = Stage(o, t, sizeof(t));
+  } else {
+    // Pad to the announced length so the framing of later records stays intact.
+    uint8_t zero[32] = {0};
+    while (o.wr_left > 0) {
+      const size_t m = (o.wr_left < sizeof(zero)) ? o.wr_left : sizeof(zero);
+      Stage(o, zero, m);
+      o.wr_left -= (uint32_t)m;
+    }
+    const uint8_t bad[4] = {0, 0, 0, 0};
+    Stage(o, bad, sizeof(bad));
+  }
+  ok = FlushStage(o) && ok;
+  if (ok) {
+    o.stats.queued++;
+  } else {
+    o.stats.rejected++;
+  }
+  return ok;
+}
+
+bool WS_Outbox_Put(WS_Outbox& o, const char* topic, const uint8_t* data, size_t n, uint8_t flags)
+{
+  if (!WS_Outbox_Begin(o, topic, (uint32_t)n, flags)) {
+    return false;
+  }
+  WS_Outbox_Write(o, data, n);
+  return WS_Outbox_End(o);
+}
+
+// ---- Replay ----
+
+bool WS_Outbox_Empty(const WS_Outbox& o)
+{
+  if (!o.ring.ready) {
+    return true;
+  }
+  const WS_LogRing& r = o.ring;
+  const int slot = FindSegment(r, o.rd_seq);
+  if (slot < 0) {
+    return WS_LogRing_Total(r) == 0;   // cursor on a recycled segment: everything left is unsent
+  }
+  return slot == r.head && o.rd_off >= r.size[slot];
+}
+
+uint32_t WS_Outbox_PendingBytes(const WS_Outbox& o)
+{
+  if (WS_Outbox_Empty(o)) {
+    return 0;
+  }
+  const WS_LogRing& r = o.ring;
+  const int slot = FindSegment(r, o.rd_seq);
+  if (slot < 0) {
+    return WS_LogRing_Total(r);
+  }
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < r.segments; i++) {
+    if (r.seq[i] != 0 && r.seq[i] > o.rd_seq) {
+      total += r.size[i];
+    }
+  }
+  return total + (r.size[slot] - ((o.rd_off < r.size[slot]) ? o.rd_off : r.size[slot]));
+}
+
+uint8_t WS_Outbox_Replay(WS_Outbox& o, uint32_t nowMs, const WS_OutboxPace& pace, const WS_OutboxPublisher& pub)
+{
+  if (!o.ring.ready || o.writing || (int32_t)(nowMs - o.next_ms) < 0) {
+    return 0;
+  }
+  uint8_t sent = 0;
+  uint32_t bytes = 0;
+  bool stalled = false;
+  while (sent < pace.msgs && bytes < pace.bytes) {
+    WS_OutboxRec rec;
+    File f;
+    if (!NextRecord(o, rec, f)) {
+      break;
+    }
+    const bool ok = PublishRecord(f, rec, pub);
+    f.close();
+    if (!ok) {
+      stalled = true;
+      break;
+    }
+    o.rd_off = rec.off + RecordBytes(rec.topic_len, rec.len);
+    o.cur_dirty = true;
+    o.stats.replayed++;
+    sent++;
+    bytes += rec.len;
+  }
+
+  if (stalled) {
+    o.stats.stalls++;
+    const uint32_t first = pace.tick_ms * 4;
+    o.backoff_ms = (o.backoff_ms == 0) ? first : o.backoff_ms * 2;
+    if (o.backoff_ms > pace.backoff_max_ms) {
+      o.backoff_ms = pace.backoff_max_ms;
+    }
+    o.next_ms = nowMs + o.backoff_ms;
+  } else {
+    o.backoff_ms = 0;
+    o.next_ms = nowMs + pace.tick_ms;
+  }
+  if (o.cur_dirty && (WS_Outbox_Empty(o) || (nowMs - o.cur_saved_ms) >= WS_OUTBOX_CURSOR_SAVE_MS)) {
+    SaveCursor(o, nowMs);
+  }
+  return sent;
+}
+
+bool WS_Outbox_Clear(WS_Outbox& o)
+{
+  o.writing = false;
+  o.stage_len = 0;
+  if (!WS_LogRing_Clear(o.ring)) {
+    return false;
+  }
+  o.rd_seq = o.ring.seq[o.ring.head];
+  o.rd_off = 0;
+  SaveCursor(o, o.cur_saved_ms);
+  return true;
+}
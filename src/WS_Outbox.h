@@ -0,0 +1,108 @@
+#ifndef _WS_OUTBOX_H_
+#define _WS_OUTBOX_H_
+
+#include "WS_LogRing.h"
+
+// Store-and-forward outbox: MQTT messages that could not be sent (link down) are
+// appended to a segment ring (WS_LogRing.h) on LittleFS and replayed in order once the
+// link is back. A wrap drops the oldest segment, like the logs.
+//
+// Record: magic 'O' | flags | topic_len | 0 | payload_len (u32 LE) | topic | payload | crc32
+// The CRC (zlib polynomial) covers everything before it, so a record torn by a power cut or
+// damaged on flash is skipped instead of being published. A record never spans segments.
+//
+// The read cursor (segment seq + offset) lives in "<base>.cur" and is saved at most every
+// WS_OUTBOX_CURSOR_SAVE_MS while replaying and when the outbox runs empty. Sent segments stay
+// until the ring wraps over them, so draining costs one small write. After a reboot
+// mid-replay the last few records are sent again: delivery is at least once, receivers
+// dedup on their own ids (batch boot+seq, log timestamps).
+//
+// No dependency on the MQTT client: replay goes through WS_OutboxPublisher, so
+// scripts/outbox_sim runs the same code against a simulated broker.
+
+#define WS_OUTBOX_HEADER_BYTES 8
+#define WS_OUTBOX_TOPIC_MAX 127
+#define WS_OUTBOX_STAGE_BYTES 256
+#define WS_OUTBOX_CURSOR_SAVE_MS 2000UL
+
+#define WS_OUTBOX_F_RETAINED 0x01
+
+// Replay pacing: at most msgs records / bytes payload bytes every tick_ms, so replay shares
+// the link with live traffic. A failed publish (socket full, broker gone) is backpressure:
+// the next try waits 4 ticks, doubling up to backoff_max_ms.
+struct WS_OutboxPace {
+  uint32_t tick_ms;
+  uint8_t msgs;
+  uint32_t bytes;
+  uint32_t backoff_max_ms;
+};
+
+struct WS_OutboxPublisher {
+  bool (*begin)(void* ctx, const char* topic, uint32_t len, bool retained);
+  bool (*write)(void* ctx, const uint8_t* data, size_t n);
+  bool (*end)(void* ctx);
+  void* ctx;
+};
+
+struct WS_OutboxStats {
+  uint32_t queued = 0;          // records appended since boot
+  uint32_t replayed = 0;        // records published since boot
+  uint32_t rejected = 0;        // appends refused (too large / FS error)
+  uint32_t corrupt = 0;         // records skipped on a bad CRC or broken framing
+  uint32_t lost_segments = 0;   // unsent segments overwritten by a wrap
+  uint32_t stalls = 0;          // replay publishes that failed
+};
+
+struct WS_Outbox {
+  WS_LogRing ring;
+  char cur_path[40] = {0};
+  uint32_t rd_seq = 0;          // segment seq of the read cursor (0 = oldest)
+  uint32_t rd_off = 0;
+  bool cur_dirty = false;
+  uint32_t cur_saved_ms = 0;
+
+  // Append in progress (WS_Outbox_Begin .. WS_Outbox_End).
+  bool writing = false;
+  uint32_t wr_left = 0;         // payload bytes still expected
+  uint32_t wr_crc = 0;
+  uint8_t stage[WS_OUTBOX_STAGE_BYTES];
+  size_t stage_len = 0;
+
+  // Replay pacing.
+  uint32_t next_ms = 0;
+  uint32_t backoff_ms = 0;
+
+  WS_OutboxStats stats;
+};
+
+// Recovery scan of the ring and the cursor; a torn record at the end of the newest segment
+// makes the next append start a fresh segment. Needs a mounted FS.
+bool WS_Outbox_Open(WS_Outbox& o, const char* base, uint8_t segments, uint32_t segBytes);
+void WS_Outbox_Close(WS_Outbox& o);
+inline bool WS_Outbox_Ready(const WS_Outbox& o) { return o.ring.ready; }
+
+// Streamed append: Begin with the exact payload length, Write it in any pieces, End.
+// Begin fails (and nothing is written) if the record can't fit in one segment.
+bool WS_Outbox_Begin(WS_Outbox& o, const char* topic, uint32_t len, uint8_t flags);
+bool WS_Outbox_Write(WS_Outbox& o, const uint8_t* data, size_t n);
+bool WS_Outbox_End(WS_Outbox& o);
+bool WS_Outbox_Put(WS_Outbox& o, const char* topic, const uint8_t* data, size_t n, uint8_t flags);
+
+bool WS_Outbox_Empty(const WS_Outbox& o);
+uint32_t WS_Outbox_PendingBytes(const WS_Outbox& o);   // framing included
+
+// Publishes what the pacing allows at nowMs; returns the number of records sent. Saves the
+// cursor when due and once everything is out.
+uint8_t WS_Outbox_Replay(WS_Outbox& o, uint32_t nowMs, const WS_OutboxPace& pace, const WS_OutboxPublisher& pub);
+
+// Fresh link: forget the backoff, replay may start at once.
+inline void WS_Outbox_Resume(WS_Outbox& o, uint32_t nowMs)
+{
+  o.backoff_ms = 0;
+  o.next_ms = nowMs;
+}
+
+// Drops everything (segments truncated, cursor reset).
+bool WS_Outbox_Clear(WS_Outbox& o);
+
+#endif
@@ -0,0 +1,323 @@
+#include "WS_Sensor.h"
+#include "WS_Modbus.h"
+#include "WS_Serial.h"
+#include "WS_SpscRing.h"
+
+#ifndef SENSOR_MODBUS_QUIET_MS
+#define SENSOR_MODBUS_QUIET_MS 5
+#endif
+
+WS_SensorSlot Sensor_Table[WS_SENSOR_MAX];
+uint8_t Sensor_Count = 0;
+
+// Acquisition side (sensor task, or loop() when the task is disabled).
+// Only reads id/profile from Sensor_Table, which are fixed after init.
+struct WS_SensorSched {
+  uint32_t last_start_ms = 0;
+  uint32_t interval_ms = SENSOR_POLL_PERIOD_MS;
+  uint32_t last_level_ms = 0;
+  uint16_t last_level_mm = 0;
+  bool has_level = false;
+};
+
+static WS_ModbusMaster Sensor_Bus;
+static WS_SensorSched Sensor_Sched[WS_SENSOR_MAX];
+static uint8_t Sensor_NextIdx = 0;
+static uint8_t Sensor_BusIdx = 0;
+static volatile bool Sensor_Boost = false;
+
+static WS_SpscRing<WS_SensorSample, WS_SENSOR_RING_LEN> Sensor_Ring;
+static WS_FilterConfig Sensor_FilterCfg;
+static TaskHandle_t Sensor_TaskHandle = nullptr;
+
+static uint32_t WS_Sensor_EffectiveInterval(const WS_SensorSched& c)
+{
+  if (Sensor_Boost && c.interval_ms > (uint32_t)SENSOR_POLL_FAST_MS) {
+    return SENSOR_POLL_FAST_MS;
+  }
+  return c.interval_ms;
+}
+
+// Pick the next interval from the poll result.
+static void WS_Sensor_Adapt(WS_SensorSched& c, bool ok, uint16_t level, uint32_t now)
+{
+#if SENSOR_POLL_ADAPTIVE_Enable
+  if (!ok) {
+    // Don't hammer a silent sensor; fall back to the nominal rate.
+    c.interval_ms = SENSOR_POLL_PERIOD_MS;
+    return;
+  }
+  bool moving = Sensor_Boost;
+  if (c.has_level && now != c.last_level_ms) {
+    const uint32_t step = (uint32_t)abs((int32_t)level - (int32_t)c.last_level_mm);
+    const uint32_t rateMmMin = (uint32_t)((uint64_t)step * 60000ULL / (now - c.last_level_ms));
+    moving = moving || (step > SENSOR_POLL_NOISE_MM && rateMmMin >= SENSOR_POLL_FAST_RATE_MM_MIN);
+  }
+  c.last_level_mm = level;
+  c.last_level_ms = now;
+  c.has_level = true;
+  if (moving) {
+    c.interval_ms = SENSOR_POLL_FAST_MS;
+  } else {
+    c.interval_ms = min((uint32_t)SENSOR_POLL_SLOW_MS, c.interval_ms * 2U);
+  }
+#else
+  (void)ok;
+  (void)level;
+  (void)now;
+  c.interval_ms = SENSOR_POLL_PERIOD_MS;
+#endif
+}
+
+static void WS_Sensor_Acquire()
+{
+  if (!WS_Modbus_IsBusy(Sensor_Bus)) {
+    // Most overdue sensor first; scanning from NextIdx keeps ties round-robin.
+    const uint32_t now = millis();
+    int16_t pick = -1;
+    uint32_t pickLate = 0;
+    for (uint8_t k = 0; k < Sensor_Count; k++) {
+      const uint8_t i = (uint8_t)((Sensor_NextIdx + k) % Sensor_Count);
+      const uint32_t since = now - Sensor_Sched[i].last_start_ms;
+      const uint32_t interval = WS_Sensor_EffectiveInterval(Sensor_Sched[i]);
+      if (since >= interval && (pick < 0 || (since - interval) > pickLate)) {
+        pick = i;
+        pickLate = since - interval;
+      }
+    }
+    if (pick < 0) {
+      return;
+    }
+    const WS_SensorSlot& s = Sensor_Table[pick];
+    Sensor_NextIdx = (uint8_t)((pick + 1) % Sensor_Count);
+    Sensor_Sched[pick].last_start_ms = now;
+    if (!WS_Modbus_StartRead(Sensor_Bus, s.id, s.profile.fc, s.profile.reg_start, s.profile.reg_count, now)) {
+      return;
+    }
+    Sensor_BusIdx = (uint8_t)pick;
+  }
+
+  const WS_ModbusResult res = WS_Modbus_Poll(Sensor_Bus, millis());
+  if (res != WS_MB_RESULT_OK && res != WS_MB_RESULT_FAIL) {
+    return;
+  }
+
+  const WS_SensorProfile& p = Sensor_Table[Sensor_BusIdx].profile;
+  WS_SensorSched& c = Sensor_Sched[Sensor_BusIdx];
+  WS_SensorSample smp;
+  smp.t_ms = millis();
+  smp.poll_ms = c.last_start_ms;
+  smp.idx = Sensor_BusIdx;
+  smp.ok = (res == WS_MB_RESULT_OK);
+  smp.exception = Sensor_Bus.last_exception;
+  smp.txn = Sensor_Bus.stats;
+  if (smp.ok) {
+    smp.level_mm = WS_Modbus_Reg(Sensor_Bus, p.level_reg);
+    if (p.temp_reg != 0xFF) {
+      smp.temp_x10 = (int16_t)WS_Modbus_Reg(Sensor_Bus, p.temp_reg);
+      smp.has_temp = true;
+    }
+  }
+  WS_Sensor_Adapt(c, smp.ok, smp.level_mm, smp.t_ms);
+  smp.interval_ms = c.interval_ms;
+  (void)Sensor_Ring.Push(smp);
+}
+
+#if SENSOR_TASK_Enable
+static void WS_Sensor_Task(void* arg)
+{
+  (void)arg;
+  for (;;) {
+    WS_Sensor_Acquire();
+    // The bus engine never blocks; one tick keeps the idle task fed.
+    vTaskDelay(1);
+  }
+}
+#endif
+
+void WS_Sensor_Init()
+{
+  if (Sensor_TaskHandle != nullptr) {
+    return;
+  }
+  static const uint8_t ids[] = SENSOR_IDS;
+  Sensor_Count = 0;
+  for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]) && Sensor_Count < WS_SENSOR_MAX; i++) {
+    WS_SensorSlot& s = Sensor_Table[Sensor_Count++];
+    s = WS_SensorSlot();
+    s.id = ids[i];
+  }
+
+  WS_Modbus_Begin(Sensor_Bus, lidarSerial, SENSOR_MODBUS_BAUDRATE);
+  Sensor_Bus.quiet_ms = SENSOR_MODBUS_QUIET_MS;
+  Sensor_Bus.timeout_ms = SENSOR_MODBUS_TIMEOUT_MS;
+  Sensor_Bus.retry_gap_ms = SENSOR_MODBUS_RETRY_GAP_MS;
+  Sensor_Bus.attempts = (uint8_t)SENSOR_MODBUS_RETRY_COUNT;
+  // Sensor 0 is due at once, the others are staggered over one period.
+  const uint32_t now = millis();
+  for (uint8_t i = 0; i < Sensor_Count; i++) {
+    Sensor_Sched[i] = WS_SensorSched();
+    Sensor_Sched[i].last_start_ms = now - SENSOR_POLL_PERIOD_MS + i * ((uint32_t)SENSOR_POLL_PERIOD_MS / Sensor_Count);
+  }
+  Sensor_NextIdx = 0;
+
+#if SENSOR_TASK_Enable
+  if (Sensor_Count > 0) {
+    if (xTaskCreatePinnedToCore(WS_Sensor_Task, "sensor", SENSOR_TASK_STACK, nullptr,
+                                SENSOR_TASK_PRIORITY, &Sensor_TaskHandle, SENSOR_TASK_CORE) != pdPASS) {
+      Sensor_TaskHandle = nullptr;
+      printf("[Sensor] task create failed, polling from loop()\r\n");
+    }
+  }
+#endif
+}
+
+const WS_SensorSlot* WS_Sensor_Get(uint8_t idx)
+{
+  return (idx < Sensor_Count) ? &Sensor_Table[idx] : nullptr;
+}
+
+void WS_Sensor_SetFilter(const WS_FilterConfig& cfg)
+{
+  Sensor_FilterCfg = cfg;
+  for (uint8_t i = 0; i < Sensor_Count; i++) {
+    WS_SensorSlot& s = Sensor_Table[i];
+    WS_Filter_Reset(s.filter);
+    if (s.has_value) {
+      s.filt_mm = WS_Filter_Step(s.filter, Sensor_FilterCfg, s.level_mm);
+    }
+  }
+}
+
+void WS_Sensor_SetBoost(bool on)
+{
+  Sensor_Boost = on;
+}
+
+uint32_t WS_Sensor_ScaleTimeout(const WS_SensorSlot& s, uint32_t base_ms)
+{
+  if (s.poll_interval_ms <= (uint32_t)SENSOR_POLL_PERIOD_MS) {
+    return base_ms;
+  }
+  return (uint32_t)((uint64_t)base_ms * s.poll_interval_ms / SENSOR_POLL_PERIOD_MS);
+}
+
+uint32_t WS_Sensor_RingDropped()
+{
+  return Sensor_Ring.Dropped();
+}
+
+static void WS_Sensor_Apply(WS_SensorSlot& s, const WS_SensorSample& smp)
+{
+  const uint32_t now = smp.t_ms;
+  // A long gap makes the filter history meaningless: restart from this reading.
+  if (s.prev_valid && (now - s.prev_level_ms) > WS_Sensor_ScaleTimeout(s, SENSOR_DATA_TIMEOUT_MS)) {
+    WS_Filter_Reset(s.filter);
+  }
+  s.level_mm = smp.level_mm;
+  s.filt_mm = WS_Filter_Step(s.filter, Sensor_FilterCfg, smp.level_mm);
+  s.has_value = true;
+  if (smp.has_temp) {
+    s.temp_x10 = smp.temp_x10;
+    s.has_temp = true;
+  }
+  s.last_ok_ms = now;
+
+  s.rate_mm_s = 0;
+  if (s.prev_valid && s.prev_level_ms > 0) {
+    const uint32_t dt = now - s.prev_level_ms;
+    if (dt > 0) {
+      const int32_t jump = (int32_t)s.level_mm - (int32_t)s.prev_level_mm;
+      s.rate_mm_s = (uint32_t)(abs(jump) * 1000UL / dt);
+    }
+  }
+  s.prev_level_mm = s.level_mm;
+  s.prev_level_ms = now;
+  s.prev_valid = true;
+}
+
+static uint8_t WS_Sensor_LatBucket(uint16_t ms)
+{
+  uint8_t b = 0;
+  while (b + 1U < WS_SENSOR_LAT_BUCKETS && ms >= (2U << b)) {
+    b++;
+  }
+  return b;
+}
+
+uint32_t WS_Sensor_LatBucketLimitMs(uint8_t i)
+{
+  return (i + 1U < WS_SENSOR_LAT_BUCKETS) ? (2UL << i) : 0;
+}
+
+static void WS_Sensor_UpdateBusStats(WS_SensorBusStats& b, const WS_SensorSample& smp)
+{
+  const WS_ModbusTxnStats& t = smp.txn;
+  b.requests += t.sent;
+  if (t.sent > 1) b.retries += (uint32_t)(t.sent - 1U);
+  b.timeouts += t.timeouts;
+  b.crc_errors += t.crc_errors;
+  b.header_errors += t.header_errors;
+  if (smp.exception != 0) {
+    b.exceptions++;
+    b.last_exception = smp.exception;
+  }
+  if (smp.ok) {
+    b.lat_last_ms = t.latency_ms;
+    if (t.latency_ms > b.lat_max_ms) b.lat_max_ms = t.latency_ms;
+    b.lat_hist[WS_Sensor_LatBucket(t.latency_ms)]++;
+  }
+}
+
+static void WS_Sensor_UpdateQuality(WS_SensorSlot& s, bool ok)
+{
+  // Integer EWMA with 1/8 weight per poll.
+  const int32_t target = ok ? 100 : 0;
+  int32_t q = (int32_t)s.quality;
+  q += (target - q + (ok ? 7 : -7)) / 8;
+  s.quality = (uint8_t)constrain(q, 0, 100);
+  if (ok) {
+    s.ok_count++;
+  } else {
+    s.fail_count++;
+  }
+}
+
+int8_t WS_Sensor_Loop(bool* ok)
+{
+  if (ok) {
+    *ok = false;
+  }
+  if (Sensor_Count == 0) {
+    return -1;
+  }
+  if (Sensor_TaskHandle == nullptr) {
+    WS_Sensor_Acquire();
+  }
+
+  WS_SensorSample smp;
+  if (!Sensor_Ring.Pop(smp) || smp.idx >= Sensor_Count) {
+    return -1;
+  }
+  WS_SensorSlot& s = Sensor_Table[smp.idx];
+  s.last_poll_ms = smp.poll_ms;
+  s.poll_interval_ms = smp.interval_ms;
+  if (smp.ok) {
+    WS_Sensor_Apply(s, smp);
+  }
+  WS_Sensor_UpdateQuality(s, smp.ok);
+  WS_Sensor_UpdateBusStats(s.bus, smp);
+  if (ok) {
+    *ok = smp.ok;
+  }
+  return (int8_t)smp.idx;
+}
+
+void WS_Sensor_UpdateOnline(uint32_t nowMs)
+{
+  // Debounce "online" to reduce flapping: offline only after N ms without successful data.
+  for (uint8_t i = 0; i < Sensor_Count; i++) {
+    WS_SensorSlot& s = Sensor_Table[i];
+    s.online = (s.last_ok_ms > 0) && ((nowMs - s.last_ok_ms) <= WS_Sensor_ScaleTimeout(s, SENSOR_ONLINE_GRACE_MS));
+  }
+}
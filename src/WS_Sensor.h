@@ -0,0 +1,157 @@
+#ifndef _WS_SENSOR_H_
+#define _WS_SENSOR_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "WS_Information.h"
+#include "WS_Filter.h"
+#include "WS_Modbus.h"
+
+// RS485 level sensor table (Modbus RTU on UART1).
+// Every sensor is addressed by its index in Sensor_Table[]; index 0/1 are the
+// historic "inner"/"outer" pond sensors (ID001/ID002 by default).
+
+#define WS_SENSOR_MAX 8
+
+#ifndef SENSOR_IDS
+#define SENSOR_IDS { INNER_POND_SENSOR_ID, OUTER_POND_SENSOR_ID }
+#endif
+
+#ifndef SENSOR_POLL_PERIOD_MS
+#define SENSOR_POLL_PERIOD_MS 2000    // nominal per-sensor interval (start value, and after a failed poll)
+#endif
+
+// Adaptive polling: fast while the gate moves or the level changes, then back off
+// (interval doubles per quiet poll) to the slow rate when the level is stable.
+#ifndef SENSOR_POLL_ADAPTIVE_Enable
+#define SENSOR_POLL_ADAPTIVE_Enable 1
+#endif
+#ifndef SENSOR_POLL_FAST_MS
+#define SENSOR_POLL_FAST_MS 200
+#endif
+#ifndef SENSOR_POLL_SLOW_MS
+#define SENSOR_POLL_SLOW_MS 10000
+#endif
+#ifndef SENSOR_POLL_NOISE_MM
+#define SENSOR_POLL_NOISE_MM 3        // level steps up to this size count as noise
+#endif
+#ifndef SENSOR_POLL_FAST_RATE_MM_MIN
+#define SENSOR_POLL_FAST_RATE_MM_MIN 60   // faster change than this -> fast polling
+#endif
+
+#ifndef SENSOR_TASK_Enable
+#define SENSOR_TASK_Enable 1          // 1 = dedicated FreeRTOS task owns the bus, 0 = polled from loop()
+#endif
+#ifndef SENSOR_TASK_CORE
+#define SENSOR_TASK_CORE 0            // loop() runs on core 1
+#endif
+#ifndef SENSOR_TASK_PRIORITY
+#define SENSOR_TASK_PRIORITY 2
+#endif
+#ifndef SENSOR_TASK_STACK
+#define SENSOR_TASK_STACK 3072
+#endif
+
+#define WS_SENSOR_RING_LEN 16         // samples buffered between acquisition and loop()
+
+// Register layout of one sensor model.
+struct WS_SensorProfile {
+  uint8_t fc = 0x03;            // 0x03 holding / 0x04 input registers
+  uint16_t reg_start = 0x0000;
+  uint16_t reg_count = 4;
+  uint8_t level_reg = 0;        // offset into the block, unit mm
+  uint8_t temp_reg = 3;         // offset into the block, unit 0.1 C; 0xFF = not available
+};
+
+// Reply latency histogram: bucket 0 = [0,2) ms, bucket i = [2^i, 2^(i+1)) ms,
+// the last bucket collects everything from 2^(N-1) ms up.
+#define WS_SENSOR_LAT_BUCKETS 10
+
+// Link-quality counters since boot (all attempts, see WS_ModbusTxnStats).
+struct WS_SensorBusStats {
+  uint32_t requests = 0;        // frames sent, retries included
+  uint32_t retries = 0;
+  uint32_t timeouts = 0;        // attempts without a valid reply
+  uint32_t crc_errors = 0;
+  uint32_t header_errors = 0;
+  uint32_t exceptions = 0;      // Modbus exception replies
+  uint8_t last_exception = 0;
+  uint16_t lat_last_ms = 0;
+  uint16_t lat_max_ms = 0;
+  uint32_t lat_hist[WS_SENSOR_LAT_BUCKETS] = {0};
+};
+
+struct WS_SensorSlot {
+  uint8_t id = 0;
+  WS_SensorProfile profile;
+
+  uint16_t level_mm = 0;        // last raw reading
+  uint16_t filt_mm = 0;         // level_mm after the ctrl.json "filter" chain
+  WS_FilterState filter;
+  int16_t temp_x10 = 0;
+  bool has_value = false;
+  bool has_temp = false;
+  bool online = false;
+
+  uint32_t last_poll_ms = 0;
+  uint32_t poll_interval_ms = SENSOR_POLL_PERIOD_MS;   // interval chosen by the adaptive scheduler
+  uint32_t last_ok_ms = 0;
+  uint16_t prev_level_mm = 0;
+  uint32_t prev_level_ms = 0;
+  bool prev_valid = false;
+  uint32_t rate_mm_s = 0;       // |d level / dt| between the last two good readings
+
+  uint8_t quality = 0;          // 0..100, moving success ratio of recent polls
+  uint32_t ok_count = 0;
+  uint32_t fail_count = 0;
+  WS_SensorBusStats bus;
+};
+
+// One finished poll, handed from the acquisition side to loop().
+struct WS_SensorSample {
+  uint32_t t_ms = 0;            // completion time (acquisition clock)
+  uint32_t poll_ms = 0;         // request start time
+  uint32_t interval_ms = 0;     // interval until this sensor's next poll
+  uint16_t level_mm = 0;
+  int16_t temp_x10 = 0;
+  uint8_t idx = 0;
+  bool ok = false;
+  bool has_temp = false;
+  uint8_t exception = 0;        // Modbus exception code (failed polls)
+  WS_ModbusTxnStats txn;
+};
+
+extern WS_SensorSlot Sensor_Table[WS_SENSOR_MAX];
+extern uint8_t Sensor_Count;
+
+// Build the table and start acquisition (task or loop-driven, see SENSOR_TASK_Enable).
+void WS_Sensor_Init();
+
+// Consume one finished poll and apply it to Sensor_Table. Returns the sensor
+// index (ok or failed, see *ok), or -1 when no sample is pending.
+// Sensor_Table is only written from here, i.e. from loop().
+int8_t WS_Sensor_Loop(bool* ok);
+
+// Replace the filter config (from ctrl.json) and restart every sensor's filter. loop() only.
+void WS_Sensor_SetFilter(const WS_FilterConfig& cfg);
+
+// Fast polling for every sensor while set (gate actuation). Safe to call from loop().
+void WS_Sensor_SetBoost(bool on);
+
+// Stretch a timeout defined for SENSOR_POLL_PERIOD_MS to the sensor's current interval
+// (never below base_ms), so slow polling does not read as "offline".
+uint32_t WS_Sensor_ScaleTimeout(const WS_SensorSlot& s, uint32_t base_ms);
+
+// Upper bound (exclusive, ms) of latency bucket i; 0 for the open-ended last bucket.
+uint32_t WS_Sensor_LatBucketLimitMs(uint8_t i);
+
+// Samples lost because loop() did not drain the ring in time.
+uint32_t WS_Sensor_RingDropped();
+
+// Refresh the debounced "online" flags from last_ok_ms.
+void WS_Sensor_UpdateOnline(uint32_t nowMs);
+
+// Sensor index -> slot (nullptr if out of range).
+const WS_SensorSlot* WS_Sensor_Get(uint8_t idx);
+
+#endif
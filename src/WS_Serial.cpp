@@ -174,7 +174,7 @@ static void Air780E_LogLoop()
 
 void Serial_Init()
 {
-  lidarSerial.begin(9600, SERIAL_8N1, RXD1, TXD1);
+  lidarSerial.begin(SENSOR_MODBUS_BAUDRATE, SERIAL_8N1, RXD1, TXD1);
 
   if (!AIR780E_Enable) {
     return;
@@ -6,6 +6,10 @@
 #include "WS_GPIO.h"
 #include "WS_Information.h"
 
+#ifndef SENSOR_MODBUS_BAUDRATE
+#define SENSOR_MODBUS_BAUDRATE 9600
+#endif
+
 extern HardwareSerial lidarSerial;
 extern HardwareSerial air780eSerial;
 
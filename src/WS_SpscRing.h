@@ -0,0 +1,61 @@
+#ifndef _WS_SPSC_RING_H_
+#define _WS_SPSC_RING_H_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free single-producer / single-consumer ring (no Arduino dependencies).
+//
+// Ordering: the producer writes the slot, then publishes head with release;
+// the consumer reads head with acquire before touching the slot, and hands the
+// slot back by publishing tail with release. Items therefore arrive complete
+// and in push order. Exactly one task may call Push() and one task Pop().
+// N must be a power of two; the indices are free-running and wrap naturally.
+
+template <typename T, uint32_t N>
+class WS_SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "WS_SpscRing size must be a power of two");
+
+public:
+  // Producer side. Returns false (item dropped) when the ring is full.
+  bool Push(const T& item)
+  {
+    const uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= N) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when empty.
+  bool Pop(T& out)
+  {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    out = items_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called from a third task.
+  uint32_t Size() const
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  uint32_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  T items_[N];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
+
+#endif
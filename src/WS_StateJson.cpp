@@ -0,0 +1,232 @@
+#include "WS_StateJson.h"
+
+// Key order is the wire format the server and UI have always seen; keep it.
+
+// "sensor1"/"sensor2" keep the historic inner/outer schema.
+static constexpr WS_JsonField kSensorBrief[] = {
+  WS_JSON_FIELD(WS_StateSensor, mm, "mm"),
+  WS_JSON_FIELD(WS_StateSensor, filt_mm, "filt_mm"),
+  WS_JSON_FIELD(WS_StateSensor, valid, "valid"),
+  WS_JSON_FIELD(WS_StateSensor, online, "online"),
+  WS_JSON_FIELD(WS_StateSensor, temp_x10, "temp_x10"),
+  WS_JSON_FIELD(WS_StateSensor, temp_valid, "temp_valid"),
+};
+
+// "sensors" lists the whole table. No RS485 link counters here: they change on every
+// poll, so each delta would resend the array and the snapshot gen would never settle.
+// They are on /api/bus.
+static constexpr WS_JsonField kSensorFull[] = {
+  WS_JSON_FIELD(WS_StateSensor, id, "id"),
+  WS_JSON_FIELD(WS_StateSensor, mm, "mm"),
+  WS_JSON_FIELD(WS_StateSensor, filt_mm, "filt_mm"),
+  WS_JSON_FIELD(WS_StateSensor, valid, "valid"),
+  WS_JSON_FIELD(WS_StateSensor, online, "online"),
+  WS_JSON_FIELD(WS_StateSensor, temp_x10, "temp_x10"),
+  WS_JSON_FIELD(WS_StateSensor, temp_valid, "temp_valid"),
+  WS_JSON_FIELD(WS_StateSensor, q, "q"),
+  WS_JSON_FIELD(WS_StateSensor, poll_ms, "poll_ms"),
+};
+
+static constexpr WS_JsonField kManual[] = {
+  WS_JSON_FIELD(WS_StateManual, active, "active"),
+  WS_JSON_FIELD(WS_StateManual, remain_s, "remain_s"),
+  WS_JSON_FIELD(WS_StateManual, total_s, "total_s"),
+};
+
+static constexpr WS_JsonField kNet[] = {
+  WS_JSON_FIELD(WS_StateNet, wifi, "wifi"),
+  WS_JSON_FIELD(WS_StateNet, mqtt, "mqtt"),
+  WS_JSON_FIELD(WS_StateNet, http, "http"),
+  WS_JSON_FIELD(WS_StateNet, ip, "ip"),
+  WS_JSON_FIELD(WS_StateNet, rssi, "rssi"),
+  WS_JSON_FIELD(WS_StateNet, ssid, "ssid"),
+  WS_JSON_FIELD(WS_StateNet, mqtt_rtt_ms, "mqtt_rtt_ms"),
+  WS_JSON_FIELD(WS_StateNet, cmd_rtt_ms, "cmd_rtt_ms"),
+};
+
+static constexpr WS_JsonField kCell[] = {
+  WS_JSON_FIELD(WS_StateCell, enabled, "enabled"),
+  WS_JSON_FIELD(WS_StateCell, online, "online"),
+  WS_JSON_FIELD(WS_StateCell, sim_ready, "sim_ready"),
+  WS_JSON_FIELD(WS_StateCell, attached, "attached"),
+  WS_JSON_FIELD(WS_StateCell, csq, "csq"),
+  WS_JSON_FIELD(WS_StateCell, rssi_dbm, "rssi_dbm"),
+  WS_JSON_FIELD(WS_StateCell, last_rx_age_s, "last_rx_age_s"),
+};
+
+static constexpr WS_JsonField kCtrl[] = {
+  WS_JSON_FIELD(WS_StateCtrl, open_allowed, "open_allowed"),
+  WS_JSON_FIELD(WS_StateCtrl, close_allowed, "close_allowed"),
+  WS_JSON_FIELD(WS_StateCtrl, cooldown_remain_s, "cooldown_remain_s"),
+  WS_JSON_FIELD(WS_StateCtrl, min_interval_s, "min_interval_s"),
+  WS_JSON_FIELD(WS_StateCtrl, action_s, "action_s"),
+  WS_JSON_FIELD(WS_StateCtrl, reason, "reason"),
+};
+
+static constexpr WS_JsonField kAlarm[] = {
+  WS_JSON_FIELD(WS_StateAlarm, active, "active"),
+  WS_JSON_FIELD(WS_StateAlarm, severity, "severity"),
+  WS_JSON_FIELD(WS_StateAlarm, text, "text"),
+};
+
+static constexpr WS_JsonField kFw[] = {
+  WS_JSON_FIELD(WS_StateFw, current, "current"),
+  WS_JSON_FIELD(WS_StateFw, latest, "latest"),
+  WS_JSON_FIELD(WS_StateFw, last_check, "last_check"),
+  WS_JSON_FIELD(WS_StateFw, last_result, "last_result"),
+};
+
+static constexpr WS_JsonField kState[] = {
+  WS_JSON_ELEMENT(WS_StateInputs, sensors, 0, "sensor1", kSensorBrief),
+  WS_JSON_ELEMENT(WS_StateInputs, sensors, 1, "sensor2", kSensorBrief),
+  WS_JSON_ARRAY(WS_StateInputs, sensors, sensor_count, "sensors", kSensorFull),
+  WS_JSON_FIELD(WS_StateInputs, gate_state, "gate_state"),
+  WS_JSON_FIELD(WS_StateInputs, gate_position_open, "gate_position_open"),
+  WS_JSON_FIELD(WS_StateInputs, auto_gate, "auto_gate"),
+  WS_JSON_FIELD(WS_StateInputs, auto_latched, "auto_latched"),
+  WS_JSON_OBJECT(WS_StateInputs, manual, "manual", kManual),
+  WS_JSON_FIELD(WS_StateInputs, relay1, "relay1"),
+  WS_JSON_FIELD(WS_StateInputs, relay2, "relay2"),
+  WS_JSON_OBJECT(WS_StateInputs, net, "net", kNet),
+  WS_JSON_OBJECT(WS_StateInputs, cell, "cell", kCell),
+  WS_JSON_OBJECT(WS_StateInputs, ctrl, "ctrl", kCtrl),
+  WS_JSON_OBJECT(WS_StateInputs, alarm, "alarm", kAlarm),
+  WS_JSON_OBJECT(WS_StateInputs, fw, "fw", kFw),
+};
+
+static constexpr size_t kStateCount = sizeof(kState) / sizeof(kState[0]);
+static constexpr size_t kStateBound = WS_Json_ObjectBound(kState, kStateCount);
+static_assert(kStateBound < WS_STATE_JSON_MAX, "state JSON may not fit WS_STATE_JSON_MAX");
+
+const size_t WS_StateJson_MaxLen = kStateBound;
+
+static constexpr WS_JsonField kSampleSensor[] = {
+  WS_JSON_FIELD(WS_SampleSensor, mm, "mm"),
+  WS_JSON_FIELD(WS_SampleSensor, filt_mm, "filt_mm"),
+  WS_JSON_FIELD(WS_SampleSensor, valid, "valid"),
+  WS_JSON_FIELD(WS_SampleSensor, online, "online"),
+  WS_JSON_FIELD(WS_SampleSensor, temp_x10, "temp_x10"),
+  WS_JSON_FIELD(WS_SampleSensor, temp_valid, "temp_valid"),
+};
+
+static constexpr WS_JsonField kSample[] = {
+  WS_JSON_FIELD(WS_StateSample, seq, "seq"),
+  WS_JSON_FIELD(WS_StateSample, t, "t"),
+  WS_JSON_FIELD(WS_StateSample, up, "up"),
+  WS_JSON_FIELD(WS_StateSample, gate_state, "gate_state"),
+  WS_JSON_ARRAY(WS_StateSample, sensors, sensor_count, "sensors", kSampleSensor),
+};
+
+static constexpr size_t kSampleCount = sizeof(kSample) / sizeof(kSample[0]);
+const size_t WS_StateJson_SampleMaxLen = WS_Json_ObjectBound(kSample, kSampleCount);
+
+// Groups pick their members out of kState by index, so every key is still declared once.
+struct WS_StateGroupDesc {
+  const char* name;
+  const uint8_t* members;
+  uint8_t count;
+  uint16_t begin;   // byte range of WS_StateInputs
+  uint16_t end;
+};
+
+static constexpr uint8_t kGroupSensors[] = {0, 1, 2};
+static constexpr uint8_t kGroupGate[] = {3, 4, 5, 6, 7, 8, 9, 12};
+static constexpr uint8_t kGroupAlarm[] = {13};
+static constexpr uint8_t kGroupNet[] = {10};
+static constexpr uint8_t kGroupCell[] = {11};
+static constexpr uint8_t kGroupFw[] = {14};
+
+#define WS_STATE_GROUP(name, members, first, next) \
+  WS_StateGroupDesc{name, members, (uint8_t)(sizeof(members) / sizeof(members[0])), \
+                    (uint16_t)offsetof(WS_StateInputs, first), (uint16_t)(next)}
+
+static constexpr WS_StateGroupDesc kGroups[WS_SG_COUNT] = {
+  WS_STATE_GROUP("sensors", kGroupSensors, sensor_count, offsetof(WS_StateInputs, gate_state)),
+  WS_STATE_GROUP("gate", kGroupGate, gate_state, offsetof(WS_StateInputs, alarm)),
+  WS_STATE_GROUP("alarm", kGroupAlarm, alarm, offsetof(WS_StateInputs, net)),
+  WS_STATE_GROUP("net", kGroupNet, net, offsetof(WS_StateInputs, cell)),
+  WS_STATE_GROUP("cell", kGroupCell, cell, offsetof(WS_StateInputs, fw)),
+  WS_STATE_GROUP("fw", kGroupFw, fw, sizeof(WS_StateInputs)),
+};
+
+// Every member of a group must lie in the group's byte range ...
+static constexpr bool GroupMembersInRange(const WS_StateGroupDesc& g, size_t i)
+{
+  return (i == g.count) ||
+         (kState[g.members[i]].offset >= g.begin && kState[g.members[i]].offset < g.end && GroupMembersInRange(g, i + 1));
+}
+
+static constexpr bool GroupsValid(size_t g, size_t members)
+{
+  return (g == WS_SG_COUNT) ? (members == kStateCount)
+                            : (GroupMembersInRange(kGroups[g], 0) && GroupsValid(g + 1, members + kGroups[g].count));
+}
+
+// ... and together they list each top-level key (ranges are disjoint, so no key twice).
+static_assert(GroupsValid(0, 0), "telemetry groups must cover every state key exactly once");
+
+size_t WS_StateJson_Write(WS_JsonWriter& w, const WS_StateInputs& in)
+{
+  const size_t start = w.length();
+  WS_Json_WriteObject(w, kState, kStateCount, &in);
+  return w.length() - start;
+}
+
+size_t WS_StateJson_Build(const WS_StateInputs& in, char* buf, size_t cap)
+{
+  WS_JsonWriter w(buf, cap);
+  WS_StateJson_Write(w, in);
+  return w.overflow() ? 0 : w.length();
+}
+
+size_t WS_StateJson_WriteSample(WS_JsonWriter& w, const WS_StateSample& s)
+{
+  const size_t start = w.length();
+  WS_Json_WriteObject(w, kSample, kSampleCount, &s);
+  return w.length() - start;
+}
+
+const char* WS_StateJson_GroupName(uint8_t g)
+{
+  return (g < WS_SG_COUNT) ? kGroups[g].name : nullptr;
+}
+
+int WS_StateJson_GroupFind(const char* name)
+{
+  for (uint8_t g = 0; name && g < WS_SG_COUNT; g++) {
+    if (strcmp(name, kGroups[g].name) == 0) {
+      return g;
+    }
+  }
+  return -1;
+}
+
+uint32_t WS_StateJson_GroupHash(const WS_StateInputs& in, uint8_t g)
+{
+  if (g >= WS_SG_COUNT) {
+    return 0;
+  }
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&in);
+  uint32_t h = 2166136261UL;
+  for (size_t i = kGroups[g].begin; i < kGroups[g].end; i++) {
+    h = (h ^ p[i]) * 16777619UL;
+  }
+  return h;
+}
+
+size_t WS_StateJson_WriteGroup(WS_JsonWriter& w, const WS_StateInputs& in, uint8_t g)
+{
+  const size_t start = w.length();
+  if (g >= WS_SG_COUNT) {
+    return 0;
+  }
+  w.Char('{');
+  for (uint8_t i = 0; i < kGroups[g].count; i++) {
+    if (i > 0) {
+      w.Char(',');
+    }
+    WS_Json_WriteMember(w, kState[kGroups[g].members[i]], &in);
+  }
+  w.Char('}');
+  return w.length() - start;
+}
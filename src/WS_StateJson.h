@@ -0,0 +1,161 @@
+#ifndef _WS_STATE_JSON_H_
+#define _WS_STATE_JSON_H_
+
+#include "WS_JsonWriter.h"
+
+// State JSON (/getData, /api/state, MQTT telemetry) as a typed schema (WS_JsonWriter.h).
+// WS_StateInputs mirrors the JSON object by object; WS_StateJson.cpp lists the keys once.
+// No Arduino dependencies: scripts/state_json_bench builds it on the host.
+
+#define WS_STATE_SENSOR_MAX 8   // == WS_SENSOR_MAX (checked in WS_MQTT.cpp)
+
+// Telemetry JSON buffer; WS_StateJson.cpp asserts that the schema bound fits.
+#define WS_STATE_JSON_MAX 4096
+
+// Everything the state JSON is made of, read in one go. It is zero-filled before it is
+// gathered and hashed as a whole (padding included), so a field added here is covered by
+// the snapshot change detection without further work.
+struct WS_StateSensor {
+  uint8_t id;
+  bool valid;
+  bool online;
+  bool temp_valid;
+  uint16_t mm;
+  uint16_t filt_mm;
+  int16_t temp_x10;
+  uint8_t q;
+  uint32_t poll_ms;
+};
+
+struct WS_StateManual {
+  bool active;
+  uint32_t remain_s;
+  uint32_t total_s;
+};
+
+struct WS_StateNet {
+  bool wifi;
+  bool mqtt;
+  bool http;
+  char ip[16];
+  int32_t rssi;
+  char ssid[33];
+  uint32_t mqtt_rtt_ms;        // smoothed QoS1 PUBLISH -> PUBACK
+  uint32_t cmd_rtt_ms;         // last command received -> PUBACK of its reply
+};
+
+struct WS_StateCell {
+  bool enabled;
+  bool online;
+  bool sim_ready;
+  bool attached;
+  int32_t csq;
+  int32_t rssi_dbm;
+  uint32_t last_rx_age_s;
+};
+
+struct WS_StateCtrl {
+  bool open_allowed;
+  bool close_allowed;
+  uint32_t cooldown_remain_s;
+  uint16_t min_interval_s;
+  uint16_t action_s;
+  char reason[96];
+};
+
+struct WS_StateAlarm {
+  bool active;
+  uint8_t severity;
+  char text[128];
+};
+
+struct WS_StateFw {
+  char current[32];
+  char latest[32];
+  char last_check[24];
+  char last_result[96];
+};
+
+// Members are grouped by WS_StateGroup (one contiguous run each, in enum order); the JSON
+// key order is set by the schema table, not by this layout.
+struct WS_StateInputs {
+  // WS_SG_SENSORS
+  uint8_t sensor_count;
+  WS_StateSensor sensors[WS_STATE_SENSOR_MAX];   // sensor1/sensor2 are sensors[0]/[1]
+  // WS_SG_GATE
+  uint8_t gate_state;
+  bool gate_position_open;
+  bool auto_gate;
+  bool auto_latched;
+  WS_StateManual manual;
+  uint8_t relay1;
+  uint8_t relay2;
+  WS_StateCtrl ctrl;
+  // WS_SG_ALARM
+  WS_StateAlarm alarm;
+  // WS_SG_NET
+  WS_StateNet net;
+  // WS_SG_CELL
+  WS_StateCell cell;
+  // WS_SG_FW
+  WS_StateFw fw;
+};
+
+// Telemetry groups: top-level keys that change at similar rates, published separately
+// (WS_MQTT.cpp). A group's change hash covers exactly its run of WS_StateInputs.
+enum WS_StateGroup : uint8_t {
+  WS_SG_SENSORS,   // sensor1, sensor2, sensors
+  WS_SG_GATE,      // gate_state, gate_position_open, auto_gate, auto_latched, manual, relay1, relay2, ctrl
+  WS_SG_ALARM,     // alarm
+  WS_SG_NET,       // net
+  WS_SG_CELL,      // cell
+  WS_SG_FW,        // fw
+  WS_SG_COUNT
+};
+
+// Batched telemetry (WS_MQTT.cpp): a timestamped measurement, much smaller than the
+// state, so a ring of them fits in RAM.
+struct WS_SampleSensor {
+  uint16_t mm;
+  uint16_t filt_mm;
+  int16_t temp_x10;
+  bool valid;
+  bool online;
+  bool temp_valid;
+};
+
+struct WS_StateSample {
+  uint32_t seq;             // per boot, +1 per sample
+  uint64_t t;               // UTC epoch ms, 0 if the clock was not set
+  uint32_t up;              // millis() at sampling
+  uint8_t gate_state;
+  uint8_t sensor_count;
+  WS_SampleSensor sensors[WS_STATE_SENSOR_MAX];
+};
+
+// Upper bound of WS_StateJson_Write() output (excluding NUL), from the schema.
+extern const size_t WS_StateJson_MaxLen;
+
+// Writes the state object; returns the number of bytes written.
+size_t WS_StateJson_Write(WS_JsonWriter& w, const WS_StateInputs& in);
+
+// Into buf (NUL terminated); 0 if cap is too small (never for WS_STATE_JSON_MAX).
+size_t WS_StateJson_Build(const WS_StateInputs& in, char* buf, size_t cap);
+
+// {"seq":..,"t":..,"up":..,"gate_state":..,"sensors":[{"mm":..,...}]}
+extern const size_t WS_StateJson_SampleMaxLen;
+size_t WS_StateJson_WriteSample(WS_JsonWriter& w, const WS_StateSample& s);
+
+// Group name ("sensors", "gate", ...), or nullptr if g is out of range.
+const char* WS_StateJson_GroupName(uint8_t g);
+
+// Group index for name, or -1.
+int WS_StateJson_GroupFind(const char* name);
+
+// FNV-1a over the group's inputs, for change detection.
+uint32_t WS_StateJson_GroupHash(const WS_StateInputs& in, uint8_t g);
+
+// {"<key>":...} with the group's top-level keys; returns the number of bytes written.
+size_t WS_StateJson_WriteGroup(WS_JsonWriter& w, const WS_StateInputs& in, uint8_t g);
+
+#endif